@@ -15,7 +15,6 @@ namespace FallbackLayer
     struct BVH
     {
         std::vector<AABBNode>   m_nodes;
-        std::vector<float> m_triangles;
         std::vector<PrimitiveMetaData> m_metadata;
     };
 
@@ -40,33 +39,6 @@ namespace FallbackLayer
         return v & 0x00ffffff;
     }
 
-    static
-        void ComputeBox(
-            AABB& overallBox,
-            const std::vector<AABB>& boxes,
-            const std::vector<PrimitiveMetaData>& metadata)
-    {
-        if (metadata.empty())
-        {
-            overallBox.max.x = overallBox.min.x = 0;
-            overallBox.max.y = overallBox.min.y = 0;
-            overallBox.max.z = overallBox.min.z = 0;
-            return;
-        }
-
-        overallBox = boxes[metadata[0].PrimitiveIndex];
-
-        const UINT32 numTris = (UINT32)metadata.size();
-        for (UINT32 i = 1; i < numTris; ++i)
-        {
-            const UINT32 triId = metadata[i].PrimitiveIndex;
-            assert(triId < boxes.size());
-            const AABB& newBox = boxes[triId];
-
-            AddExtentToBox(overallBox, newBox);
-        }
-    }
-
     //
     // Convert a 16-bit float to 32-bit.
     //
@@ -117,15 +89,10 @@ namespace FallbackLayer
     }
 
     static
-        UINT32 BuildBVHAddNode(
-            BVH& bvh,
-            const AABB& box,
-            UINT32 maxDimension)
+        void WriteBVHNodeBox(
+            AABBNode& packedBox,
+            const AABB& box)
     {
-        UNREFERENCED_PARAMETER(maxDimension);
-        assert(maxDimension < 3);
-        const UINT32 nodeIndex = (UINT32)bvh.m_nodes.size();
-
         float cX = (box.max.x + box.min.x) * 0.5f;
         float cY = (box.max.y + box.min.y) * 0.5f;
         float cZ = (box.max.z + box.min.z) * 0.5f;
@@ -137,7 +104,6 @@ namespace FallbackLayer
         float dY = max(box.max.y - cY, cY - box.min.y);
         float dZ = max(box.max.z - cZ, cZ - box.min.z);
 
-        AABBNode packedBox;
         packedBox.center[0] = cX;
         packedBox.center[1] = cY;
         packedBox.center[2] = cZ;
@@ -145,133 +111,335 @@ namespace FallbackLayer
         packedBox.halfDim[1] = dY;
         packedBox.halfDim[2] = dZ;
         packedBox.nodeAllBits = 0;
+    }
 
-        bvh.m_nodes.push_back(packedBox);
-
-        assert(bvh.m_nodes.size() - 1 == nodeIndex);
-
-        bvh.m_nodes[nodeIndex].internalNode.separatingAxis = 0;
+    static
+        float ComputeBoxSurfaceArea(
+            const AABB& box)
+    {
+        const float dims[3] =
+        {
+            box.max.x - box.min.x,
+            box.max.y - box.min.y,
+            box.max.z - box.min.z
+        };
 
-        return nodeIndex;
+        return 2 * (dims[0] * dims[1] + dims[0] * dims[2] + dims[1] * dims[2]);
     }
 
     static
-        UINT32 BuildBVHAddLeaf(
-            BVH& bvh,
-            const AABB& box,
-            const std::vector<PrimitiveMetaData>& metadata)
+        void InitBoxToInverseMax(
+            AABB& box)
     {
-        const UINT32 nodeIndex = BuildBVHAddNode(bvh, box, 0);
+        box.max.x = box.max.y = box.max.z = -10e10f;//FLT_MAX;
+        box.min.x = box.min.y = box.min.z = 10e10f;//FLT_MAX;
+    }
 
-        bvh.m_nodes[nodeIndex].nodeAllBits = 0;
-        bvh.m_nodes[nodeIndex].leaf = true;
+    //
+    // Nodes at or above this many primitives hand their children to the task
+    // scheduler, everything below is built serially by the owning task.
+    //
+    static const UINT32 kParallelSubtreeThreshold = 4 * 1024;
 
-        const UINT32 idIndex = (UINT32)bvh.m_metadata.size();
+    //
+    // Nodes at or above this many primitives also bin and partition in parallel.
+    // This is what keeps the cores busy near the root before there are enough
+    // subtrees to go around.
+    //
+    static const UINT32 kParallelSplitThreshold = 64 * 1024;
+    static const UINT32 kParallelChunkSize = 16 * 1024;
 
-        std::copy(metadata.begin(), metadata.end(), std::back_inserter(bvh.m_metadata));
+    static const UINT NUM_SAH_BINS = 64;
+    static const UINT NUM_SPATIAL_BINS = 32;
 
-        assert(metadata.size() < 128);
-        assert(idIndex < (1 << 24));
+    struct Centroid
+    {
+        float   pos[3];
+    };
 
-        bvh.m_nodes[nodeIndex].leafNode.firstTriangleId = idIndex;
-        bvh.m_nodes[nodeIndex].leafNode.numTriangleIds = (UINT32)metadata.size();
+    //
+    // Intermediate node produced while splitting. Children are always allocated
+    // after their parent, so a node's index is smaller than its children's. The
+    // output pass relies on that to size and place subtrees with linear sweeps.
+    //
+    struct BuildNode
+    {
+        AABB    box;
+        UINT32  firstPrimitive;
+        UINT32  numPrimitives;
+        UINT32  leftChild;      // 0 for leaves, the root is never a child
+        UINT32  rightChild;
+        UINT32  subtreeSize;
+        UINT32  outputIndex;
+        UINT32  subtreeReferences;
+        UINT32  outputPrimitive;
+    };
 
-        return nodeIndex;
-    }
+    struct BuildContext
+    {
+        BuildContext(
+            const std::vector<AABB>& boxes,
+            UINT32 maxTrisInLeaf) :
+            m_boxes(boxes),
+            m_maxTrisInLeaf(maxTrisInLeaf),
+            m_numNodes(0),
+            m_pInput(nullptr),
+            m_pPrimitiveMetaData(nullptr),
+            m_overlapThreshold(0.0f),
+            m_referenceBudget(0),
+            m_numLeafReferences(0) {}
+
+        const std::vector<AABB>&    m_boxes;
+        const UINT32                m_maxTrisInLeaf;
+        std::vector<Centroid>       m_centroids;
+
+        // Every node references a contiguous range of this array which is
+        // partitioned in place, right child first, when the node is split.
+        // Spatial split builds instead hand out leaf ranges as leaves are made.
+        std::vector<UINT32>         m_primitiveIndices;
+        std::vector<UINT32>         m_scratchIndices;
+
+        std::vector<BuildNode>      m_nodes;
+        std::atomic<UINT32>         m_numNodes;
+
+        concurrency::task_group     m_tasks;
+
+        // Spatial splits only, primitives are reloaded from the input to clip them
+        const CpuGeometryInput*     m_pInput;
+        const PrimitiveMetaData*    m_pPrimitiveMetaData;
+        float                       m_overlapThreshold;
+        std::atomic<INT64>          m_referenceBudget;
+        std::atomic<UINT32>         m_numLeafReferences;
+    };
+
+    struct SahBin
+    {
+        AABB    box;
+        UINT    numTriangles;
+        UINT    binIndex;
+    };
 
     //
-    // Sort min to max by centroid
+    // Large nodes fill all NUM_SAH_BINS bins per axis. Nodes with fewer primitives
+    // than bins only keep the occupied ones, sorted by bin index, which scores the
+    // same planes without paying for the empty bins.
     //
+    struct SahBins
+    {
+        SahBin  bins[3][NUM_SAH_BINS];
+        UINT    numBins[3];
+    };
 
     static
-        void SortByCentroid(
-            std::vector<PrimitiveMetaData>& metadata,
-            const std::vector<AABB>& boxes,
-            UINT32 maxDimension)
+        UINT GetSahBinIndex(
+            float centroid,
+            float rangeMin,
+            float inverseExtents)
     {
-        struct TriPosition
-        {
-            float   pos;
-            UINT32  id;
-        };
+        return std::min(NUM_SAH_BINS - 1,
+            UINT(NUM_SAH_BINS * ((centroid - rangeMin) * inverseExtents)));
+    }
+
+    static
+        void ComputeRangeBox(
+            const BuildContext& context,
+            UINT32 firstPrimitive,
+            UINT32 numPrimitives,
+            AABB& rangeBox)
+    {
+        const UINT32* pIndices = context.m_primitiveIndices.data() + firstPrimitive;
 
-        std::vector<TriPosition> sortTris(metadata.size());
+        InitBoxToInverseMax(rangeBox);
+        if (numPrimitives < kParallelSplitThreshold)
+        {
+            for (UINT32 i = 0; i < numPrimitives; ++i)
+            {
+                AddExtentToBox(rangeBox, context.m_boxes[pIndices[i]]);
+            }
+            return;
+        }
 
-        for (UINT32 i = 0; i < metadata.size(); ++i)
+        const UINT32 numChunks = DivideAndRoundUp(numPrimitives, kParallelChunkSize);
+        std::vector<AABB> chunkBoxes(numChunks);
+        concurrency::parallel_for(0u, numChunks, [&](UINT32 chunk)
         {
-            const UINT32 triId = metadata[i].PrimitiveIndex;
-            const AABB& box = boxes[triId];
+            const UINT32 begin = chunk * kParallelChunkSize;
+            const UINT32 end = std::min(begin + kParallelChunkSize, numPrimitives);
 
-            const float boxCenter = (box.maxArr[maxDimension] + box.minArr[maxDimension]) / 2;
+            AABB& chunkBox = chunkBoxes[chunk];
+            InitBoxToInverseMax(chunkBox);
+            for (UINT32 i = begin; i < end; ++i)
+            {
+                AddExtentToBox(chunkBox, context.m_boxes[pIndices[i]]);
+            }
+        });
 
-            sortTris[i].pos = boxCenter;
-            sortTris[i].id = metadata[i].PrimitiveIndex;
+        for (const AABB& chunkBox : chunkBoxes)
+        {
+            AddExtentToBox(rangeBox, chunkBox);
         }
+    }
+
+    static
+        void BinPrimitives(
+            const BuildContext& context,
+            const UINT32* pIndices,
+            UINT32 numPrimitives,
+            const AABB& nodeBox,
+            SahBins& sahBins)
+    {
+        float rangeMin[3];
+        float inverseExtents[3];
+        bool axisActive[3];
+        for (UINT i = 0; i < 3; ++i)
+        {
+            const float extents = nodeBox.maxArr[i] - nodeBox.minArr[i];
+            axisActive[i] = extents != 0;
+            rangeMin[i] = nodeBox.minArr[i];
+            inverseExtents[i] = axisActive[i] ? 1.f / extents : 0.0f;
 
-        // Split the list into left and right sublists
-        std::sort(sortTris.begin(), sortTris.end(), [](auto&& a, auto&& b) -> bool { return a.pos < b.pos; });
+            sahBins.numBins[i] = NUM_SAH_BINS;
+            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+            {
+                sahBins.bins[i][j].numTriangles = 0;
+                sahBins.bins[i][j].binIndex = j;
+                InitBoxToInverseMax(sahBins.bins[i][j].box);
+            }
+        }
 
-        // Update the output
-        for (UINT32 i = 0; i < metadata.size(); ++i)
+        for (UINT32 j = 0; j < numPrimitives; ++j)
         {
-            metadata[i].PrimitiveIndex = sortTris[i].id;
+            const UINT32 triId = pIndices[j];
+            const AABB& triBox = context.m_boxes[triId];
+            const Centroid& centroid = context.m_centroids[triId];
+
+            for (UINT i = 0; i < 3; ++i)
+            {
+                if (!axisActive[i])
+                    continue;
+
+                SahBin& bin = sahBins.bins[i][GetSahBinIndex(centroid.pos[i], rangeMin[i], inverseExtents[i])];
+                bin.numTriangles++;
+                AddExtentToBox(bin.box, triBox);
+            }
         }
     }
 
-
     static
-        float ComputeBoxSurfaceArea(
-            const AABB& box)
+        void BinPrimitivesSparse(
+            const BuildContext& context,
+            const UINT32* pIndices,
+            UINT32 numPrimitives,
+            const AABB& nodeBox,
+            SahBins& sahBins)
     {
-        const float dims[3] =
+        assert(numPrimitives <= NUM_SAH_BINS);
+
+        struct BinnedPrimitive
         {
-            box.max.x - box.min.x,
-            box.max.y - box.min.y,
-            box.max.z - box.min.z
+            UINT    binIndex;
+            UINT32  triId;
         };
+        BinnedPrimitive binned[NUM_SAH_BINS];
 
-        return 2 * (dims[0] * dims[1] + dims[0] * dims[2] + dims[1] * dims[2]);
+        for (UINT i = 0; i < 3; ++i)
+        {
+            sahBins.numBins[i] = 0;
+
+            const float extents = nodeBox.maxArr[i] - nodeBox.minArr[i];
+            if (extents == 0)
+                continue;
+
+            const float rangeMin = nodeBox.minArr[i];
+            const float inverseExtents = 1.f / extents;
+            for (UINT32 j = 0; j < numPrimitives; ++j)
+            {
+                const UINT32 triId = pIndices[j];
+                binned[j].binIndex = GetSahBinIndex(context.m_centroids[triId].pos[i], rangeMin, inverseExtents);
+                binned[j].triId = triId;
+            }
+            std::sort(binned, binned + numPrimitives, [](const BinnedPrimitive& a, const BinnedPrimitive& b) { return a.binIndex < b.binIndex; });
+
+            SahBin* pBin = nullptr;
+            for (UINT32 j = 0; j < numPrimitives; ++j)
+            {
+                if (!pBin || pBin->binIndex != binned[j].binIndex)
+                {
+                    pBin = &sahBins.bins[i][sahBins.numBins[i]++];
+                    pBin->binIndex = binned[j].binIndex;
+                    pBin->numTriangles = 0;
+                    InitBoxToInverseMax(pBin->box);
+                }
+                pBin->numTriangles++;
+                AddExtentToBox(pBin->box, context.m_boxes[binned[j].triId]);
+            }
+        }
     }
 
     static
-        void InitBoxToInverseMax(
-            AABB& box)
+        void ComputeSahBins(
+            const BuildContext& context,
+            const BuildNode& node,
+            SahBins& sahBins)
     {
-        box.max.x = box.max.y = box.max.z = -10e10f;//FLT_MAX;
-        box.min.x = box.min.y = box.min.z = 10e10f;//FLT_MAX;
+        const UINT32* pIndices = context.m_primitiveIndices.data() + node.firstPrimitive;
+        if (node.numPrimitives <= NUM_SAH_BINS)
+        {
+            BinPrimitivesSparse(context, pIndices, node.numPrimitives, node.box, sahBins);
+            return;
+        }
+
+        if (node.numPrimitives < kParallelSplitThreshold)
+        {
+            BinPrimitives(context, pIndices, node.numPrimitives, node.box, sahBins);
+            return;
+        }
+
+        const UINT32 numChunks = DivideAndRoundUp(node.numPrimitives, kParallelChunkSize);
+        std::vector<SahBins> chunkBins(numChunks);
+        concurrency::parallel_for(0u, numChunks, [&](UINT32 chunk)
+        {
+            const UINT32 begin = chunk * kParallelChunkSize;
+            const UINT32 end = std::min(begin + kParallelChunkSize, node.numPrimitives);
+            BinPrimitives(context, pIndices + begin, end - begin, node.box, chunkBins[chunk]);
+        });
+
+        sahBins = chunkBins[0];
+        for (UINT32 chunk = 1; chunk < numChunks; ++chunk)
+        {
+            for (UINT i = 0; i < 3; ++i)
+            {
+                for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+                {
+                    sahBins.bins[i][j].numTriangles += chunkBins[chunk].bins[i][j].numTriangles;
+                    AddExtentToBox(sahBins.bins[i][j].box, chunkBins[chunk].bins[i][j].box);
+                }
+            }
+        }
     }
 
     //
     // A feeble attempt at a SAH builder
     //
+    // Returns false if no plane could be scored, in which case the caller falls
+    // back to a median split along maxDimension.
+    //
 
     static
-        void SahSplit(
-            std::vector<PrimitiveMetaData>& metadata,
-            UINT32& maxDimension,
-            UINT32& numTrisInLeftNode,
+        bool FindBestSahSplit(
+            const SahBins& sahBins,
             const AABB& nodeBox,
-            const std::vector<AABB>& boxes)
+            UINT numTris,
+            UINT32& maxDimension,
+            UINT32& splitBin,
+            UINT32& numTrisInLeftNode)
     {
-        static const UINT NUM_SAH_BINS = 64;
-
-        struct SahBin
-        {
-            AABB    box;
-            UINT    numTriangles;
-        };
-
-        // NOTE: use vector if this blows out the stack?
-        SahBin  sahBins[3][NUM_SAH_BINS];
-
         // For the score to be meaningful it seems we need to normalize it to something
         const float normalizeToParent = 1.f / ComputeBoxSurfaceArea(nodeBox);
 
-        const UINT numTris = (UINT)metadata.size();
-
         float bestSah = FLT_MAX;
+        bool bFoundSplit = false;
         maxDimension = 0;
-        //numTrisInLeftNode = triangleIds.size() / 2;
 
         // Compute SAH score per axis
         for (UINT i = 0; i < 3; ++i)
@@ -280,52 +448,31 @@ namespace FallbackLayer
             if (extents == 0)
                 continue;
 
-            const float rangeMin = nodeBox.minArr[i];
-
-            const float inverseExtents = 1.f / extents;
-
-            // Init boxes
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
-            {
-                sahBins[i][j].numTriangles = 0;
-                InitBoxToInverseMax(sahBins[i][j].box);
-            }
-
-            // Place triangles into the buckets
-            for (UINT j = 0; j < metadata.size(); ++j)
-            {
-                const UINT triId = metadata[j].PrimitiveIndex;
-
-                const AABB& triBox = boxes[triId];
-
-                const float centroid = (triBox.maxArr[i] + triBox.minArr[i]) * 0.5f;
-
-                const UINT binIndex = std::min(NUM_SAH_BINS - 1,
-                    UINT(NUM_SAH_BINS * ((centroid - rangeMin) * inverseExtents)));
-
-                sahBins[i][binIndex].numTriangles++;
-                AddExtentToBox(sahBins[i][binIndex].box, triBox);
-            }
+            const SahBin* bins = sahBins.bins[i];
+            const UINT numBins = sahBins.numBins[i];
 
+#ifdef _DEBUG
             // Make sure we caught all of them once
             UINT testTris = 0;
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+            for (UINT j = 0; j < numBins; ++j)
             {
-                testTris += sahBins[i][j].numTriangles;
+                testTris += bins[j].numTriangles;
             }
             assert(testTris == numTris);
+#endif
 
             // Precompute left and right boxes with counts to be able to test plane positionings
 
             AABB leftBoxes[NUM_SAH_BINS];
-            AABB rightBoxes[NUM_SAH_BINS];
+            AABB rightBoxes[NUM_SAH_BINS + 1];
+            InitBoxToInverseMax(rightBoxes[numBins]);
 
-            for (UINT j = 0; j < NUM_SAH_BINS; ++j)
+            for (UINT j = 0; j < numBins; ++j)
             {
-                const UINT rightIdx = NUM_SAH_BINS - j - 1;
+                const UINT rightIdx = numBins - j - 1;
 
-                rightBoxes[rightIdx] = sahBins[i][rightIdx].box;
-                leftBoxes[j] = sahBins[i][j].box;
+                rightBoxes[rightIdx] = bins[rightIdx].box;
+                leftBoxes[j] = bins[j].box;
 
                 if (j > 0)
                 {
@@ -337,16 +484,16 @@ namespace FallbackLayer
             UINT numTrianglesOnLeft = 0;
             UINT numTrianglesOnRight = numTris;
 
-            // Find the plane with the best score
-            for (UINT j = 0; j < NUM_SAH_BINS - 1; ++j)
+            // Find the plane with the best score, there is none past the last bin
+            for (UINT j = 0; j < numBins && bins[j].binIndex < NUM_SAH_BINS - 1; ++j)
             {
-                if (!sahBins[i][j].numTriangles)
+                if (!bins[j].numTriangles)
                 {
                     continue;
                 }
 
-                numTrianglesOnLeft += sahBins[i][j].numTriangles;
-                numTrianglesOnRight -= sahBins[i][j].numTriangles;
+                numTrianglesOnLeft += bins[j].numTriangles;
+                numTrianglesOnRight -= bins[j].numTriangles;
 
                 const float sah = (numTrianglesOnLeft * ComputeBoxSurfaceArea(leftBoxes[j]) +
                     numTrianglesOnRight * ComputeBoxSurfaceArea(rightBoxes[j + 1])) *
@@ -357,329 +504,1379 @@ namespace FallbackLayer
                 if (sah < bestSah)
                 {
                     bestSah = sah;
+                    bFoundSplit = true;
                     maxDimension = i;
+                    splitBin = bins[j].binIndex;
                     numTrisInLeftNode = numTrianglesOnLeft;
                 }
             }
         }
 
-        //
-        // Split the set to try to get a balanced tree
-        //
-
-        SortByCentroid(metadata, boxes, maxDimension);
+        return bFoundSplit;
     }
 
     //
-    // It's a good idea to do a breadth-first build because then nodes from the same level
-    // get adjacent memory locations. It does take a lot of memory though.
-    //
-    // "Uniform BVH"
-    // -- both children are valid for all internal nodes
-    // -- left child's index is +1 of the parent index, right child's index is stored
-    //    in the packed AABB structure.
-    // -- there could be a varaible number of triangles in leaves
+    // Moves every primitive that satisfies goesRight to the front of the node's
+    // range and returns how many there were, along with the bounds of each side.
     //
+
+    template<typename Predicate>
     static
-        void BuildBVH(
-            BVH& bvh,
-            const std::vector<AABB>& boxes,
-            const std::vector<PrimitiveMetaData>& primitiveMetaData,
-            UINT32 maxTrisInLeaf)
+        UINT32 PartitionPrimitives(
+            BuildContext& context,
+            const BuildNode& node,
+            Predicate goesRight,
+            AABB& rightBox,
+            AABB& leftBox)
     {
-        //
-        // These are huge so use pointers
-        //
-        struct StackItem
-        {
-            std::vector<PrimitiveMetaData> primitiveMetaData;
-            UINT32              parentIndex;
-            UINT                right : 1;
-            UINT                axis : 2;
-        };
-
-        std::deque<StackItem*>   fifoLefts;
-        std::deque<StackItem*>   fifoRights;
+        UINT32* pIndices = context.m_primitiveIndices.data() + node.firstPrimitive;
+        const UINT32 numPrimitives = node.numPrimitives;
 
-        StackItem* temp = new StackItem;
-        temp->parentIndex = (UINT)-1;
-        temp->primitiveMetaData = primitiveMetaData;
-        temp->right = false;
-        temp->axis = 0;
-        fifoRights.push_back(temp);
+        InitBoxToInverseMax(rightBox);
+        InitBoxToInverseMax(leftBox);
 
-        while (!fifoLefts.empty() || !fifoRights.empty())
+        if (numPrimitives < kParallelSplitThreshold)
         {
-            // Uniform BVH pops the first left node
-            StackItem* item = nullptr;
-
-            if (!fifoRights.empty())
+            UINT32* pMiddle = std::partition(pIndices, pIndices + numPrimitives, goesRight);
+            for (UINT32* pIndex = pIndices; pIndex < pMiddle; ++pIndex)
             {
-                item = fifoRights.back();
-                fifoRights.pop_back();
+                AddExtentToBox(rightBox, context.m_boxes[*pIndex]);
             }
-
-            if (!item)
+            for (UINT32* pIndex = pMiddle; pIndex < pIndices + numPrimitives; ++pIndex)
             {
-                item = fifoLefts.back();
-                fifoLefts.pop_back();
+                AddExtentToBox(leftBox, context.m_boxes[*pIndex]);
             }
+            return (UINT32)(pMiddle - pIndices);
+        }
 
-            //
-            // Compute overall bounding box
-            //
-            AABB nodeBox;
-            ComputeBox(nodeBox, boxes, item->primitiveMetaData);
-
-            const UINT32 numTrianglesInNode = (UINT32)item->primitiveMetaData.size();
-            const UINT32 parentIndex = item->parentIndex;
+        struct ChunkPartition
+        {
+            UINT32  numRight;
+            UINT32  rightOffset;
+            UINT32  leftOffset;
+            AABB    rightBox;
+            AABB    leftBox;
+        };
 
-            UINT32 thisNodeIndex;
+        const UINT32 numChunks = DivideAndRoundUp(numPrimitives, kParallelChunkSize);
+        std::vector<ChunkPartition> chunks(numChunks);
 
-            // Leaf or internal node?
-            if (numTrianglesInNode <= maxTrisInLeaf)
-            {
-                thisNodeIndex = BuildBVHAddLeaf(bvh, nodeBox, item->primitiveMetaData);
-            }
-            else
+        // Count each side per chunk
+        concurrency::parallel_for(0u, numChunks, [&](UINT32 chunk)
+        {
+            const UINT32 begin = chunk * kParallelChunkSize;
+            const UINT32 end = std::min(begin + kParallelChunkSize, numPrimitives);
+
+            ChunkPartition& partition = chunks[chunk];
+            partition.numRight = 0;
+            InitBoxToInverseMax(partition.rightBox);
+            InitBoxToInverseMax(partition.leftBox);
+            for (UINT32 i = begin; i < end; ++i)
             {
-                //
-                // Find separating plane. Use Median for speed.
-                // SAH is better but also more expensive to build.
-                //
-
-                UINT splitDimension;
-                UINT leftChildNumNodes;
-
-                SahSplit(item->primitiveMetaData,
-                    splitDimension,
-                    leftChildNumNodes,
-                    nodeBox,
-                    boxes);
-
-                assert(leftChildNumNodes <= item->primitiveMetaData.size());
-
-                // Try to balance by using the median if SAH failed
-                if ((leftChildNumNodes == 0 ||
-                    leftChildNumNodes == item->primitiveMetaData.size()) &&
-                    item->primitiveMetaData.size() > MAX_TRIS_IN_LEAF)
+                const UINT32 triId = pIndices[i];
+                if (goesRight(triId))
                 {
-                    leftChildNumNodes = (UINT)item->primitiveMetaData.size() / 2;
+                    partition.numRight++;
+                    AddExtentToBox(partition.rightBox, context.m_boxes[triId]);
                 }
+                else
+                {
+                    AddExtentToBox(partition.leftBox, context.m_boxes[triId]);
+                }
+            }
+        });
 
-                const UINT32 rightChildNumNodes = (UINT32)item->primitiveMetaData.size() - leftChildNumNodes;
-
+        UINT32 numRight = 0;
+        for (ChunkPartition& partition : chunks)
+        {
+            partition.rightOffset = numRight;
+            numRight += partition.numRight;
+            AddExtentToBox(rightBox, partition.rightBox);
+            AddExtentToBox(leftBox, partition.leftBox);
+        }
 
-                //
-                // "Recurse"
-                //
+        UINT32 leftOffset = numRight;
+        for (UINT32 chunk = 0; chunk < numChunks; ++chunk)
+        {
+            const UINT32 chunkSize = std::min(kParallelChunkSize, numPrimitives - chunk * kParallelChunkSize);
+            chunks[chunk].leftOffset = leftOffset;
+            leftOffset += chunkSize - chunks[chunk].numRight;
+        }
 
-                thisNodeIndex = BuildBVHAddNode(bvh, nodeBox, splitDimension);
+        // Scatter into the scratch range, then copy back
+        UINT32* pScratch = context.m_scratchIndices.data() + node.firstPrimitive;
+        concurrency::parallel_for(0u, numChunks, [&](UINT32 chunk)
+        {
+            const UINT32 begin = chunk * kParallelChunkSize;
+            const UINT32 end = std::min(begin + kParallelChunkSize, numPrimitives);
 
-                StackItem* leftItem = new StackItem;
-                leftItem->parentIndex = thisNodeIndex;
-                leftItem->primitiveMetaData.resize(leftChildNumNodes);
-                leftItem->right = false;
-                leftItem->axis = splitDimension;
-                for (UINT32 i = 0; i < leftChildNumNodes; ++i)
+            UINT32 rightWrite = chunks[chunk].rightOffset;
+            UINT32 leftWrite = chunks[chunk].leftOffset;
+            for (UINT32 i = begin; i < end; ++i)
+            {
+                const UINT32 triId = pIndices[i];
+                if (goesRight(triId))
                 {
-                    leftItem->primitiveMetaData[i] = item->primitiveMetaData[i];
+                    pScratch[rightWrite++] = triId;
                 }
-
-                StackItem* rightItem = new StackItem;
-                rightItem->parentIndex = thisNodeIndex;
-                rightItem->primitiveMetaData.resize(rightChildNumNodes);
-                rightItem->right = true;
-                rightItem->axis = splitDimension;
-                for (UINT32 i = 0; i < rightChildNumNodes; ++i)
+                else
                 {
-                    rightItem->primitiveMetaData[i] = item->primitiveMetaData[i + leftChildNumNodes];
+                    pScratch[leftWrite++] = triId;
                 }
-
-                fifoLefts.push_back(leftItem);
-                fifoRights.push_back(rightItem);
             }
+        });
 
-            // Update child link of the parent
-            if (parentIndex != -1)
-            {
-                if (!item->right)
-                {
-                    bvh.m_nodes[parentIndex].internalNode.leftNodeIndex = thisNodeIndex;
-                    bvh.m_nodes[parentIndex].rightNodeIndex = parentIndex + 1;
-                }
-            }
+        concurrency::parallel_for(0u, numChunks, [&](UINT32 chunk)
+        {
+            const UINT32 begin = chunk * kParallelChunkSize;
+            const UINT32 end = std::min(begin + kParallelChunkSize, numPrimitives);
+            std::copy(pScratch + begin, pScratch + end, pIndices + begin);
+        });
 
-            // Free the item after use
-            delete item;
-        }
+        return numRight;
     }
 
-    void BuildUniformBVH(
-        _In_  UINT NumElements,
-        _In_reads_opt_(NumElements)  const D3D12_RAYTRACING_GEOMETRY_DESC *pGeometries,
-        BVH &bvh)
-    {
-        using namespace DirectX;
-        //
-        // Compute number of triangles
-        //
-
-        UINT    totalNumberOfTriangles = 0;
+    //
+    // Splits the node's primitive range in place, right child first, and returns
+    // the number of primitives that went to the right child.
+    //
 
-        for (UINT i = 0; i < NumElements; ++i)
+    static
+        UINT32 SplitNode(
+            BuildContext& context,
+            const BuildNode& node,
+            AABB& rightBox,
+            AABB& leftBox)
+    {
+        SahBins sahBins;
+        ComputeSahBins(context, node, sahBins);
+
+        UINT32 splitDimension = 0;
+        UINT32 splitBin = 0;
+        UINT32 leftChildNumNodes = 0;
+        const bool bFoundSplit = FindBestSahSplit(
+            sahBins,
+            node.box,
+            node.numPrimitives,
+            splitDimension,
+            splitBin,
+            leftChildNumNodes);
+
+        assert(leftChildNumNodes <= node.numPrimitives);
+
+        if (bFoundSplit &&
+            leftChildNumNodes != 0 &&
+            leftChildNumNodes != node.numPrimitives)
         {
-            auto &geometry = pGeometries[i];
-            if (geometry.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
-            {
-                totalNumberOfTriangles += GetPrimitiveCountFromGeometryDesc(geometry);
-            }
-            else
-            {
-                throw - 1; // Intersection shaders not supported yet
-            }
+            const float rangeMin = node.box.minArr[splitDimension];
+            const float inverseExtents = 1.f / (node.box.maxArr[splitDimension] - rangeMin);
+            const std::vector<Centroid>& centroids = context.m_centroids;
 
-        }
+            const UINT32 numRight = PartitionPrimitives(context, node,
+                [&](UINT32 triId) -> bool
+                {
+                    return GetSahBinIndex(centroids[triId].pos[splitDimension], rangeMin, inverseExtents) > splitBin;
+                },
+                rightBox,
+                leftBox);
 
-        //
-        // Create AABBs
-        //
+            assert(numRight == node.numPrimitives - leftChildNumNodes);
+            return numRight;
+        }
 
-        std::vector<AABB> boxes;
-        boxes.resize(totalNumberOfTriangles);
+        // Try to balance by using the median if SAH failed
+        const UINT32 numRight = node.numPrimitives - node.numPrimitives / 2;
+        UINT32* pIndices = context.m_primitiveIndices.data() + node.firstPrimitive;
+        const std::vector<Centroid>& centroids = context.m_centroids;
+        std::nth_element(pIndices, pIndices + numRight, pIndices + node.numPrimitives,
+            [&](UINT32 a, UINT32 b) -> bool
+            {
+                return centroids[a].pos[splitDimension] > centroids[b].pos[splitDimension];
+            });
 
-        std::vector<PrimitiveMetaData> primitiveMetaData;
-        primitiveMetaData.resize(totalNumberOfTriangles);
+        ComputeRangeBox(context, node.firstPrimitive, numRight, rightBox);
+        ComputeRangeBox(context, node.firstPrimitive + numRight, node.numPrimitives - numRight, leftBox);
+        return numRight;
+    }
 
-        std::vector<float>  triangleVertices;
-        triangleVertices.resize(totalNumberOfTriangles * 9);
+    static
+        void BuildSubtree(
+            BuildContext& context,
+            UINT32 subtreeRootIndex)
+    {
+        std::vector<UINT32> stack;
+        stack.push_back(subtreeRootIndex);
 
-        UINT triangleIndex = 0;
-        for (UINT i = 0; i < NumElements; ++i)
+        while (!stack.empty())
         {
-            auto &geometry = pGeometries[i];
-            if (geometry.Type != D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
-            {
-                throw - 1; // Intersection shaders not supported yet
-            }
+            const UINT32 nodeIndex = stack.back();
+            stack.pop_back();
 
-            auto &triangles = geometry.Triangles;
-            if (GetPrimitiveCountFromGeometryDesc(geometry) == 0)
+            BuildNode& node = context.m_nodes[nodeIndex];
+            node.leftChild = 0;
+            node.rightChild = 0;
 
+            // Leaf or internal node?
+            if (node.numPrimitives <= context.m_maxTrisInLeaf)
             {
                 continue;
             }
 
-            // 
-            const UINT64 vertexStrideDwords = triangles.VertexBuffer.StrideInBytes / 4;
-            const UINT numTris = GetPrimitiveCountFromGeometryDesc(geometry);
-
-            float *pVertexData = (float *)geometry.Triangles.VertexBuffer.StartAddress;
-            float *pIndexData = (float *)geometry.Triangles.IndexBuffer;
-
-            const float* pVertices = (float*)(pVertexData);
-            const UINT16* pIndices = (UINT16*)(pIndexData);
-
-            for (UINT j = 0; j < numTris; ++j)
-            {
-                const UINT16 i0 = pIndices[j * 3 + 0];
-                const UINT16 i1 = pIndices[j * 3 + 1];
-                const UINT16 i2 = pIndices[j * 3 + 2];
+            AABB rightBox, leftBox;
+            const UINT32 rightChildNumNodes = SplitNode(context, node, rightBox, leftBox);
 
-                const float* v0 = &pVertices[i0 * vertexStrideDwords];
-                const float* v1 = &pVertices[i1 * vertexStrideDwords];
-                const float* v2 = &pVertices[i2 * vertexStrideDwords];
+            const UINT32 childIndex = context.m_numNodes.fetch_add(2);
+            assert(childIndex + 2 <= context.m_nodes.size());
 
-                float* pTriVerts = &triangleVertices[triangleIndex * 9];
+            BuildNode& rightChild = context.m_nodes[childIndex];
+            rightChild.box = rightBox;
+            rightChild.firstPrimitive = node.firstPrimitive;
+            rightChild.numPrimitives = rightChildNumNodes;
 
-                pTriVerts[0] = v0[0];
-                pTriVerts[1] = v0[1];
-                pTriVerts[2] = v0[2];
+            BuildNode& leftChild = context.m_nodes[childIndex + 1];
+            leftChild.box = leftBox;
+            leftChild.firstPrimitive = node.firstPrimitive + rightChildNumNodes;
+            leftChild.numPrimitives = node.numPrimitives - rightChildNumNodes;
 
-                pTriVerts[3] = v1[0];
-                pTriVerts[4] = v1[1];
-                pTriVerts[5] = v1[2];
+            node.rightChild = childIndex;
+            node.leftChild = childIndex + 1;
 
-                pTriVerts[6] = v2[0];
-                pTriVerts[7] = v2[1];
-                pTriVerts[8] = v2[2];
+            //
+            // "Recurse"
+            //
 
-                AABB& box = boxes[triangleIndex];
-                for (UINT k = 0; k < 3; ++k)
+            for (UINT32 child = childIndex; child < childIndex + 2; ++child)
+            {
+                if (context.m_nodes[child].numPrimitives >= kParallelSubtreeThreshold)
                 {
-#define AABB_Min_Padding 0.001f
-                    box.minArr[k] = std::min(v2[k], std::min(v0[k], v1[k]));
-                    box.maxArr[k] = std::max(v2[k], std::max(v0[k], v1[k])) + AABB_Min_Padding;
-
-                    if (_isnan(box.minArr[k]) ||
-                        _isnan(box.maxArr[k]))
-                    {
-                        box.minArr[k] = 0;
-                        box.maxArr[k] = 0;
-                    }
+                    context.m_tasks.run([&context, child] { BuildSubtree(context, child); });
+                }
+                else
+                {
+                    stack.push_back(child);
                 }
-
-                // Create out internal triangle indices.
-                PrimitiveMetaData metadata;
-                metadata.GeometryContributionToHitGroupIndex = i;
-                metadata.PrimitiveIndex = triangleIndex;
-                metadata.GeometryFlags = geometry.Flags;
-                primitiveMetaData[triangleIndex] = metadata;
-
-                // Next triangle
-                triangleIndex++;
             }
         }
+    }
 
+    //
+    // Spatial splits (SBVH)
+    //
+    // PREFER_FAST_TRACE builds track references instead of primitives. Each
+    // reference carries its own, possibly clipped, box so a primitive that
+    // straddles a split plane can be referenced from both children. Nodes are
+    // scored with binned object splits first and only try a spatial split
+    // where the object split's children overlap, within a budget of duplicated
+    // references shared by the whole build.
+    //
+
+    struct PrimitiveReference
+    {
+        AABB    box;
+        UINT32  primitiveIndex;
+    };
+
+    typedef std::vector<PrimitiveReference> PrimitiveReferences;
+
+    struct SpatialBin
+    {
+        AABB    box;
+        UINT32  numEntries;     // references whose box starts in this bin
+        UINT32  numExits;       // references whose box ends in this bin
+    };
+
+    struct ReferenceSplit
+    {
+        float   cost;
+        UINT32  axis;
+        UINT32  bin;            // last bin that goes to the left child
+        float   position;       // split plane, spatial splits only
+        AABB    leftBox;
+        AABB    rightBox;
+        UINT32  numLeft;
+        UINT32  numRight;
+    };
+
+    static
+        void AddPointToBox(
+            AABB& box,
+            const float* pPoint)
+    {
+        for (UINT axis = 0; axis < 3; ++axis)
+        {
+            box.minArr[axis] = std::min(box.minArr[axis], pPoint[axis]);
+            box.maxArr[axis] = std::max(box.maxArr[axis], pPoint[axis]);
+        }
+    }
+
+    static
+        bool IntersectBoxes(
+            AABB& box,
+            const AABB& other)
+    {
+        bool bValid = true;
+        for (UINT axis = 0; axis < 3; ++axis)
+        {
+            box.minArr[axis] = std::max(box.minArr[axis], other.minArr[axis]);
+            box.maxArr[axis] = std::min(box.maxArr[axis], other.maxArr[axis]);
+            bValid = bValid && box.minArr[axis] <= box.maxArr[axis];
+        }
+        return bValid;
+    }
+
+    static
+        float GetReferenceCentroid(
+            const PrimitiveReference& reference,
+            UINT axis)
+    {
+        return (reference.box.minArr[axis] + reference.box.maxArr[axis]) * 0.5f;
+    }
+
+    static
+        void ComputeReferenceBounds(
+            const PrimitiveReferences& references,
+            AABB& box,
+            AABB& centroidBox)
+    {
+        InitBoxToInverseMax(box);
+        InitBoxToInverseMax(centroidBox);
+        for (const PrimitiveReference& reference : references)
+        {
+            AddExtentToBox(box, reference.box);
+
+            const float centroid[3] =
+            {
+                GetReferenceCentroid(reference, 0),
+                GetReferenceCentroid(reference, 1),
+                GetReferenceCentroid(reference, 2)
+            };
+            AddPointToBox(centroidBox, centroid);
+        }
+    }
+
+    static
+        void LoadReferencePrimitive(
+            const BuildContext& context,
+            const PrimitiveReference& reference,
+            Primitive& primitive)
+    {
+        context.m_pInput->LoadPrimitive(context.m_pPrimitiveMetaData[reference.primitiveIndex], primitive);
+    }
+
+    //
+    // Clips a reference against an axis aligned plane. Triangles are clipped
+    // exactly, other primitives just have their box cut. Either side may come
+    // back empty if the reference only touches the plane, which is reported by
+    // the return value: bit 0 for a valid left side, bit 1 for the right.
+    //
+    static
+        UINT SplitReference(
+            const Primitive& primitive,
+            const PrimitiveReference& reference,
+            UINT axis,
+            float position,
+            PrimitiveReference& leftReference,
+            PrimitiveReference& rightReference)
+    {
+        leftReference.primitiveIndex = reference.primitiveIndex;
+        rightReference.primitiveIndex = reference.primitiveIndex;
+
+        if (primitive.PrimitiveType == TRIANGLE_TYPE)
+        {
+            InitBoxToInverseMax(leftReference.box);
+            InitBoxToInverseMax(rightReference.box);
+
+            const Triangle& triangle = primitive.triangle;
+            for (UINT i = 0; i < 3; ++i)
+            {
+                const float* v0 = &triangle.v[i].x;
+                const float* v1 = &triangle.v[(i + 1) % 3].x;
+                if (v0[axis] <= position)
+                {
+                    AddPointToBox(leftReference.box, v0);
+                }
+                if (v0[axis] >= position)
+                {
+                    AddPointToBox(rightReference.box, v0);
+                }
+
+                if ((v0[axis] < position && v1[axis] > position) ||
+                    (v0[axis] > position && v1[axis] < position))
+                {
+                    const float t = (position - v0[axis]) / (v1[axis] - v0[axis]);
+                    float edgePoint[3];
+                    for (UINT k = 0; k < 3; ++k)
+                    {
+                        edgePoint[k] = v0[k] + (v1[k] - v0[k]) * t;
+                    }
+                    edgePoint[axis] = position;
+
+                    AddPointToBox(leftReference.box, edgePoint);
+                    AddPointToBox(rightReference.box, edgePoint);
+                }
+            }
+
+            // Same padding the unclipped boxes get
+            for (UINT k = 0; k < 3; ++k)
+            {
+                leftReference.box.maxArr[k] += AABB_Min_Padding;
+                rightReference.box.maxArr[k] += AABB_Min_Padding;
+            }
+        }
+        else
+        {
+            leftReference.box = reference.box;
+            rightReference.box = reference.box;
+        }
+
+        leftReference.box.maxArr[axis] = std::min(leftReference.box.maxArr[axis], position);
+        rightReference.box.minArr[axis] = std::max(rightReference.box.minArr[axis], position);
+
+        // A reference never grows past the box it was already clipped to
+        const bool bLeftValid = IntersectBoxes(leftReference.box, reference.box);
+        const bool bRightValid = IntersectBoxes(rightReference.box, reference.box);
+        return (bLeftValid ? 1 : 0) | (bRightValid ? 2 : 0);
+    }
+
+    static
+        bool FindObjectSplit(
+            const PrimitiveReferences& references,
+            const AABB& centroidBox,
+            ReferenceSplit& split)
+    {
+        split.cost = FLT_MAX;
+        for (UINT axis = 0; axis < 3; ++axis)
+        {
+            const float rangeMin = centroidBox.minArr[axis];
+            const float extents = centroidBox.maxArr[axis] - rangeMin;
+            if (!(extents > 0))
+            {
+                continue;
+            }
+            const float inverseExtents = 1.f / extents;
+
+            SahBin bins[NUM_SAH_BINS];
+            for (UINT i = 0; i < NUM_SAH_BINS; ++i)
+            {
+                bins[i].numTriangles = 0;
+                InitBoxToInverseMax(bins[i].box);
+            }
+
+            for (const PrimitiveReference& reference : references)
+            {
+                SahBin& bin = bins[GetSahBinIndex(GetReferenceCentroid(reference, axis), rangeMin, inverseExtents)];
+                bin.numTriangles++;
+                AddExtentToBox(bin.box, reference.box);
+            }
+
+            AABB rightBoxes[NUM_SAH_BINS];
+            UINT32 rightCounts[NUM_SAH_BINS];
+            AABB rightBox;
+            UINT32 rightCount = 0;
+            InitBoxToInverseMax(rightBox);
+            for (UINT i = NUM_SAH_BINS; i-- > 1;)
+            {
+                AddExtentToBox(rightBox, bins[i].box);
+                rightCount += bins[i].numTriangles;
+                rightBoxes[i] = rightBox;
+                rightCounts[i] = rightCount;
+            }
+
+            AABB leftBox;
+            UINT32 leftCount = 0;
+            InitBoxToInverseMax(leftBox);
+            for (UINT i = 0; i < NUM_SAH_BINS - 1; ++i)
+            {
+                AddExtentToBox(leftBox, bins[i].box);
+                leftCount += bins[i].numTriangles;
+                if (!leftCount || !rightCounts[i + 1])
+                {
+                    continue;
+                }
+
+                const float cost = leftCount * ComputeBoxSurfaceArea(leftBox) +
+                    rightCounts[i + 1] * ComputeBoxSurfaceArea(rightBoxes[i + 1]);
+                if (cost < split.cost)
+                {
+                    split.cost = cost;
+                    split.axis = axis;
+                    split.bin = i;
+                    split.leftBox = leftBox;
+                    split.rightBox = rightBoxes[i + 1];
+                    split.numLeft = leftCount;
+                    split.numRight = rightCounts[i + 1];
+                }
+            }
+        }
+
+        return split.cost != FLT_MAX;
+    }
+
+    static
+        UINT GetSpatialBinIndex(
+            float position,
+            float rangeMin,
+            float inverseBinSize)
+    {
+        const float bin = (position - rangeMin) * inverseBinSize;
+        return bin > 0 ? std::min(NUM_SPATIAL_BINS - 1, UINT(bin)) : 0;
+    }
+
+    static
+        bool FindSpatialSplit(
+            const BuildContext& context,
+            const PrimitiveReferences& references,
+            const AABB& nodeBox,
+            ReferenceSplit& split)
+    {
+        split.cost = FLT_MAX;
+        for (UINT axis = 0; axis < 3; ++axis)
+        {
+            const float rangeMin = nodeBox.minArr[axis];
+            const float extents = nodeBox.maxArr[axis] - rangeMin;
+            if (!(extents > 0))
+            {
+                continue;
+            }
+            const float binSize = extents / NUM_SPATIAL_BINS;
+            const float inverseBinSize = NUM_SPATIAL_BINS / extents;
+
+            SpatialBin bins[NUM_SPATIAL_BINS];
+            for (UINT i = 0; i < NUM_SPATIAL_BINS; ++i)
+            {
+                bins[i].numEntries = 0;
+                bins[i].numExits = 0;
+                InitBoxToInverseMax(bins[i].box);
+            }
+
+            // Chop every reference into the bins it spans
+            for (const PrimitiveReference& reference : references)
+            {
+                const UINT firstBin = GetSpatialBinIndex(reference.box.minArr[axis], rangeMin, inverseBinSize);
+                const UINT lastBin = std::max(firstBin, GetSpatialBinIndex(reference.box.maxArr[axis], rangeMin, inverseBinSize));
+
+                Primitive primitive;
+                if (firstBin != lastBin)
+                {
+                    LoadReferencePrimitive(context, reference, primitive);
+                }
+
+                PrimitiveReference remainder = reference;
+                bool bRemainderValid = true;
+                for (UINT i = firstBin; i < lastBin && bRemainderValid; ++i)
+                {
+                    PrimitiveReference leftReference, rightReference;
+                    const UINT validSides = SplitReference(primitive, remainder, axis, rangeMin + binSize * (i + 1), leftReference, rightReference);
+                    if (validSides & 1)
+                    {
+                        AddExtentToBox(bins[i].box, leftReference.box);
+                    }
+                    bRemainderValid = (validSides & 2) != 0;
+                    remainder = rightReference;
+                }
+                if (bRemainderValid)
+                {
+                    AddExtentToBox(bins[lastBin].box, remainder.box);
+                }
+
+                bins[firstBin].numEntries++;
+                bins[lastBin].numExits++;
+            }
+
+            AABB rightBoxes[NUM_SPATIAL_BINS];
+            UINT32 rightCounts[NUM_SPATIAL_BINS];
+            AABB rightBox;
+            UINT32 rightCount = 0;
+            InitBoxToInverseMax(rightBox);
+            for (UINT i = NUM_SPATIAL_BINS; i-- > 1;)
+            {
+                AddExtentToBox(rightBox, bins[i].box);
+                rightCount += bins[i].numExits;
+                rightBoxes[i] = rightBox;
+                rightCounts[i] = rightCount;
+            }
+
+            AABB leftBox;
+            UINT32 leftCount = 0;
+            InitBoxToInverseMax(leftBox);
+            for (UINT i = 0; i < NUM_SPATIAL_BINS - 1; ++i)
+            {
+                AddExtentToBox(leftBox, bins[i].box);
+                leftCount += bins[i].numEntries;
+                if (!leftCount || !rightCounts[i + 1])
+                {
+                    continue;
+                }
+
+                const float cost = leftCount * ComputeBoxSurfaceArea(leftBox) +
+                    rightCounts[i + 1] * ComputeBoxSurfaceArea(rightBoxes[i + 1]);
+                if (cost < split.cost)
+                {
+                    split.cost = cost;
+                    split.axis = axis;
+                    split.bin = i;
+                    split.position = rangeMin + binSize * (i + 1);
+                    split.leftBox = leftBox;
+                    split.rightBox = rightBoxes[i + 1];
+                    split.numLeft = leftCount;
+                    split.numRight = rightCounts[i + 1];
+                }
+            }
+        }
+
+        return split.cost != FLT_MAX;
+    }
+
+    //
+    // Returns false without touching the outputs if the split would need more
+    // duplicates than the remaining budget, or would leave a child empty.
+    //
+    static
+        bool PerformSpatialSplit(
+            BuildContext& context,
+            const PrimitiveReferences& references,
+            const ReferenceSplit& split,
+            PrimitiveReferences& leftReferences,
+            PrimitiveReferences& rightReferences)
+    {
+        enum Placement : BYTE { PlaceLeft, PlaceRight, PlaceBoth };
+
+        const UINT axis = split.axis;
+        const float position = split.position;
+
+        AABB leftBox = split.leftBox;
+        AABB rightBox = split.rightBox;
+        float leftArea = ComputeBoxSurfaceArea(leftBox);
+        float rightArea = ComputeBoxSurfaceArea(rightBox);
+        float numLeft = (float)split.numLeft;
+        float numRight = (float)split.numRight;
+
+        std::vector<BYTE> placements(references.size());
+        INT64 numDuplicates = 0;
+        for (size_t i = 0; i < references.size(); ++i)
+        {
+            const AABB& box = references[i].box;
+            if (box.maxArr[axis] <= position)
+            {
+                placements[i] = PlaceLeft;
+                continue;
+            }
+            if (box.minArr[axis] >= position)
+            {
+                placements[i] = PlaceRight;
+                continue;
+            }
+
+            // Reference unsplitting: keep a straddling reference whole on one
+            // side when that scores better than duplicating it
+            AABB unsplitLeftBox = leftBox;
+            AABB unsplitRightBox = rightBox;
+            AddExtentToBox(unsplitLeftBox, box);
+            AddExtentToBox(unsplitRightBox, box);
+            const float unsplitLeftArea = ComputeBoxSurfaceArea(unsplitLeftBox);
+            const float unsplitRightArea = ComputeBoxSurfaceArea(unsplitRightBox);
+
+            const float splitCost = leftArea * numLeft + rightArea * numRight;
+            const float leftCost = unsplitLeftArea * numLeft + rightArea * (numRight - 1);
+            const float rightCost = leftArea * (numLeft - 1) + unsplitRightArea * numRight;
+            if (leftCost < splitCost && leftCost <= rightCost)
+            {
+                placements[i] = PlaceLeft;
+                leftBox = unsplitLeftBox;
+                leftArea = unsplitLeftArea;
+                numRight -= 1;
+            }
+            else if (rightCost < splitCost)
+            {
+                placements[i] = PlaceRight;
+                rightBox = unsplitRightBox;
+                rightArea = unsplitRightArea;
+                numLeft -= 1;
+            }
+            else
+            {
+                placements[i] = PlaceBoth;
+                numDuplicates++;
+            }
+        }
+
+        if (context.m_referenceBudget.fetch_sub(numDuplicates) < numDuplicates)
+        {
+            context.m_referenceBudget.fetch_add(numDuplicates);
+            return false;
+        }
+
+        PrimitiveReferences left, right;
+        left.reserve(split.numLeft);
+        right.reserve(split.numRight);
+        INT64 numUnusedDuplicates = 0;
+        for (size_t i = 0; i < references.size(); ++i)
+        {
+            if (placements[i] == PlaceLeft)
+            {
+                left.push_back(references[i]);
+            }
+            else if (placements[i] == PlaceRight)
+            {
+                right.push_back(references[i]);
+            }
+            else
+            {
+                Primitive primitive;
+                LoadReferencePrimitive(context, references[i], primitive);
+
+                PrimitiveReference leftReference, rightReference;
+                const UINT validSides = SplitReference(primitive, references[i], axis, position, leftReference, rightReference);
+                if (validSides == 3)
+                {
+                    left.push_back(leftReference);
+                    right.push_back(rightReference);
+                }
+                else
+                {
+                    (validSides & 1 ? left : right).push_back(references[i]);
+                    numUnusedDuplicates++;
+                }
+            }
+        }
+
+        if (left.empty() || right.empty())
+        {
+            context.m_referenceBudget.fetch_add(numDuplicates);
+            return false;
+        }
+        context.m_referenceBudget.fetch_add(numUnusedDuplicates);
+
+        leftReferences.swap(left);
+        rightReferences.swap(right);
+        return true;
+    }
+
+    static
+        void PerformObjectSplit(
+            const PrimitiveReferences& references,
+            const ReferenceSplit* pSplit,
+            const AABB& centroidBox,
+            PrimitiveReferences& leftReferences,
+            PrimitiveReferences& rightReferences)
+    {
+        if (pSplit)
+        {
+            const UINT axis = pSplit->axis;
+            const float rangeMin = centroidBox.minArr[axis];
+            const float inverseExtents = 1.f / (centroidBox.maxArr[axis] - rangeMin);
+
+            leftReferences.reserve(pSplit->numLeft);
+            rightReferences.reserve(pSplit->numRight);
+            for (const PrimitiveReference& reference : references)
+            {
+                if (GetSahBinIndex(GetReferenceCentroid(reference, axis), rangeMin, inverseExtents) > pSplit->bin)
+                {
+                    rightReferences.push_back(reference);
+                }
+                else
+                {
+                    leftReferences.push_back(reference);
+                }
+            }
+            assert(leftReferences.size() == pSplit->numLeft);
+            return;
+        }
+
+        // Every centroid coincides, any balanced split is as good as another
+        const size_t numLeft = references.size() / 2;
+        leftReferences.assign(references.begin(), references.begin() + numLeft);
+        rightReferences.assign(references.begin() + numLeft, references.end());
+    }
+
+    static
+        void SplitReferences(
+            BuildContext& context,
+            const PrimitiveReferences& references,
+            const AABB& nodeBox,
+            const AABB& centroidBox,
+            PrimitiveReferences& leftReferences,
+            PrimitiveReferences& rightReferences)
+    {
+        ReferenceSplit objectSplit = {};
+        const bool bFoundObjectSplit = FindObjectSplit(references, centroidBox, objectSplit);
+
+        if (context.m_referenceBudget > 0)
+        {
+            float overlapArea = 0.0f;
+            if (bFoundObjectSplit)
+            {
+                AABB overlap = objectSplit.leftBox;
+                if (IntersectBoxes(overlap, objectSplit.rightBox))
+                {
+                    overlapArea = ComputeBoxSurfaceArea(overlap);
+                }
+            }
+
+            // Coincident centroids leave nothing for an object split to work with,
+            // a spatial split is the only way to separate those references
+            ReferenceSplit spatialSplit = {};
+            if ((!bFoundObjectSplit || overlapArea > context.m_overlapThreshold) &&
+                FindSpatialSplit(context, references, nodeBox, spatialSplit) &&
+                spatialSplit.cost < objectSplit.cost &&
+                PerformSpatialSplit(context, references, spatialSplit, leftReferences, rightReferences))
+            {
+                return;
+            }
+        }
+
+        PerformObjectSplit(references, bFoundObjectSplit ? &objectSplit : nullptr, centroidBox, leftReferences, rightReferences);
+    }
+
+    //
+    // Leaves reserve their range of m_primitiveIndices as they are made, the
+    // output pass puts the ranges back into tree order.
+    //
+    static
+        void BuildSpatialSubtree(
+            BuildContext& context,
+            UINT32 subtreeRootIndex,
+            PrimitiveReferences& subtreeReferences)
+    {
+        struct PendingNode
+        {
+            UINT32              nodeIndex;
+            PrimitiveReferences references;
+        };
+
+        std::vector<PendingNode> stack;
+        stack.push_back(PendingNode{ subtreeRootIndex, std::move(subtreeReferences) });
+
+        while (!stack.empty())
+        {
+            PendingNode pending = std::move(stack.back());
+            stack.pop_back();
+
+            BuildNode& node = context.m_nodes[pending.nodeIndex];
+            node.leftChild = 0;
+            node.rightChild = 0;
+            node.numPrimitives = (UINT32)pending.references.size();
+
+            AABB centroidBox;
+            ComputeReferenceBounds(pending.references, node.box, centroidBox);
+
+            // Leaf or internal node?
+            if (node.numPrimitives <= context.m_maxTrisInLeaf)
+            {
+                node.firstPrimitive = context.m_numLeafReferences.fetch_add(node.numPrimitives);
+                assert(node.firstPrimitive + node.numPrimitives <= context.m_primitiveIndices.size());
+                for (UINT32 i = 0; i < node.numPrimitives; ++i)
+                {
+                    context.m_primitiveIndices[node.firstPrimitive + i] = pending.references[i].primitiveIndex;
+                }
+                continue;
+            }
+
+            PrimitiveReferences rightReferences, leftReferences;
+            SplitReferences(context, pending.references, node.box, centroidBox, leftReferences, rightReferences);
+            PrimitiveReferences().swap(pending.references);
+
+            const UINT32 childIndex = context.m_numNodes.fetch_add(2);
+            assert(childIndex + 2 <= context.m_nodes.size());
+            node.rightChild = childIndex;
+            node.leftChild = childIndex + 1;
+
+            //
+            // "Recurse"
+            //
+
+            PrimitiveReferences* pChildReferences[2] = { &rightReferences, &leftReferences };
+            for (UINT32 i = 0; i < 2; ++i)
+            {
+                const UINT32 child = childIndex + i;
+                if (pChildReferences[i]->size() >= kParallelSubtreeThreshold)
+                {
+                    auto pReferences = std::make_shared<PrimitiveReferences>(std::move(*pChildReferences[i]));
+                    context.m_tasks.run([&context, child, pReferences] { BuildSpatialSubtree(context, child, *pReferences); });
+                }
+                else
+                {
+                    stack.push_back(PendingNode{ child, std::move(*pChildReferences[i]) });
+                }
+            }
+        }
+    }
+
+    //
+    // "Uniform BVH"
+    // -- both children are valid for all internal nodes
+    // -- nodes are laid out depth-first with the right subtree first, so the right
+    //    child's index is +1 of the parent index and the left child's index is
+    //    stored in the packed AABB structure.
+    // -- there could be a varaible number of triangles in leaves
+    // -- leaves reference contiguous ranges of primitives in the same order
+    //
+    static
+        void WriteBVH(
+            BuildContext& context,
+            const std::vector<PrimitiveMetaData>& primitiveMetaData,
+            BVH& bvh)
+    {
         //
-        // Create a BVH
+        // Children always follow their parent in the intermediate array, so a
+        // backwards sweep sizes every subtree and a forwards sweep places it.
         //
 
-        BuildBVH(bvh, boxes, primitiveMetaData, MAX_TRIS_IN_LEAF);
+        const UINT32 numNodes = context.m_numNodes;
+        std::vector<BuildNode>& nodes = context.m_nodes;
+        for (UINT32 i = numNodes; i-- > 0;)
+        {
+            BuildNode& node = nodes[i];
+            if (node.leftChild)
+            {
+                const BuildNode& leftChild = nodes[node.leftChild];
+                const BuildNode& rightChild = nodes[node.rightChild];
+                node.subtreeSize = 1 + leftChild.subtreeSize + rightChild.subtreeSize;
+                node.subtreeReferences = leftChild.subtreeReferences + rightChild.subtreeReferences;
+            }
+            else
+            {
+                node.subtreeSize = 1;
+                node.subtreeReferences = node.numPrimitives;
+            }
+        }
+
+        nodes[0].outputIndex = 0;
+        nodes[0].outputPrimitive = 0;
+        for (UINT32 i = 0; i < numNodes; ++i)
+        {
+            const BuildNode& node = nodes[i];
+            if (node.leftChild)
+            {
+                BuildNode& leftChild = nodes[node.leftChild];
+                BuildNode& rightChild = nodes[node.rightChild];
+                rightChild.outputIndex = node.outputIndex + 1;
+                rightChild.outputPrimitive = node.outputPrimitive;
+                leftChild.outputIndex = node.outputIndex + 1 + rightChild.subtreeSize;
+                leftChild.outputPrimitive = node.outputPrimitive + rightChild.subtreeReferences;
+            }
+        }
+
+        bvh.m_nodes.resize(numNodes);
+        bvh.m_metadata.resize(nodes[0].subtreeReferences);
+        concurrency::parallel_for(0u, numNodes, [&](UINT32 i)
+        {
+            const BuildNode& node = nodes[i];
+            AABBNode& packedBox = bvh.m_nodes[node.outputIndex];
+            WriteBVHNodeBox(packedBox, node.box);
+
+            if (node.leftChild)
+            {
+                packedBox.internalNode.leftNodeIndex = nodes[node.leftChild].outputIndex;
+                packedBox.internalNode.separatingAxis = 0;
+                packedBox.rightNodeIndex = nodes[node.rightChild].outputIndex;
+                assert(packedBox.rightNodeIndex == node.outputIndex + 1);
+            }
+            else
+            {
+                assert(node.numPrimitives < 128);
+                assert(node.outputPrimitive < (1 << 24));
+
+                packedBox.leaf = true;
+                packedBox.leafNode.firstTriangleId = node.outputPrimitive;
+                packedBox.leafNode.numTriangleIds = node.numPrimitives;
+                packedBox.numTriangles = node.numPrimitives;
+
+                for (UINT32 j = 0; j < node.numPrimitives; ++j)
+                {
+                    bvh.m_metadata[node.outputPrimitive + j] = primitiveMetaData[context.m_primitiveIndices[node.firstPrimitive + j]];
+                }
+            }
+        });
+    }
+
+    //
+    // The tree is split with a task per large subtree over a single index array,
+    // then written out in one pass once the size of every subtree is known.
+    //
+    static
+        void BuildBVH(
+            BVH& bvh,
+            const std::vector<AABB>& boxes,
+            const std::vector<PrimitiveMetaData>& primitiveMetaData,
+            UINT32 maxTrisInLeaf)
+    {
+        const UINT32 numPrimitives = (UINT32)primitiveMetaData.size();
+
+        BuildContext context(boxes, maxTrisInLeaf);
+        context.m_centroids.resize(numPrimitives);
+        context.m_primitiveIndices.resize(numPrimitives);
+        context.m_scratchIndices.resize(numPrimitives);
+        context.m_nodes.resize(numPrimitives ? 2 * numPrimitives - 1 : 1);
+
+        concurrency::parallel_for(0u, numPrimitives, kParallelChunkSize, [&](UINT32 chunkStart)
+        {
+            const UINT32 chunkEnd = std::min(chunkStart + kParallelChunkSize, numPrimitives);
+            for (UINT32 i = chunkStart; i < chunkEnd; ++i)
+            {
+                const AABB& box = boxes[i];
+                for (UINT axis = 0; axis < 3; ++axis)
+                {
+                    context.m_centroids[i].pos[axis] = (box.maxArr[axis] + box.minArr[axis]) * 0.5f;
+                }
+                context.m_primitiveIndices[i] = i;
+            }
+        });
+
+        BuildNode& root = context.m_nodes[0];
+        root.firstPrimitive = 0;
+        root.numPrimitives = numPrimitives;
+        if (numPrimitives)
+        {
+            ComputeRangeBox(context, 0, numPrimitives, root.box);
+        }
+        else
+        {
+            root.box.max.x = root.box.min.x = 0;
+            root.box.max.y = root.box.min.y = 0;
+            root.box.max.z = root.box.min.z = 0;
+        }
+        context.m_numNodes = 1;
+
+        context.m_tasks.run([&context] { BuildSubtree(context, 0); });
+        context.m_tasks.wait();
+
+        WriteBVH(context, primitiveMetaData, bvh);
+    }
+
+    static
+        UINT32 GetMaxPrimitiveReferences(
+            UINT32 numPrimitives,
+            const CpuSpatialSplitSettings* pSpatialSplitSettings)
+    {
+        if (!pSpatialSplitSettings || !(pSpatialSplitSettings->ReferenceBudget > 0))
+        {
+            return numPrimitives;
+        }
+        return numPrimitives + (UINT32)(numPrimitives * pSpatialSplitSettings->ReferenceBudget);
+    }
+
+    //
+    // BuildBVH with spatial splits. Straddling triangles are reloaded from
+    // input and clipped exactly, procedural primitives just have their box cut.
+    //
+    static
+        void BuildSpatialBVH(
+            BVH& bvh,
+            const std::vector<AABB>& boxes,
+            const std::vector<PrimitiveMetaData>& primitiveMetaData,
+            const CpuGeometryInput& input,
+            UINT32 maxTrisInLeaf,
+            const CpuSpatialSplitSettings& spatialSplitSettings)
+    {
+        const UINT32 numPrimitives = (UINT32)primitiveMetaData.size();
+        const UINT32 maxReferences = GetMaxPrimitiveReferences(numPrimitives, &spatialSplitSettings);
+
+        BuildContext context(boxes, maxTrisInLeaf);
+        context.m_pInput = &input;
+        context.m_pPrimitiveMetaData = primitiveMetaData.data();
+        context.m_referenceBudget = maxReferences - numPrimitives;
+        context.m_primitiveIndices.resize(maxReferences);
+        context.m_nodes.resize(maxReferences ? 2 * maxReferences - 1 : 1);
+        context.m_numNodes = 1;
+
+        if (!numPrimitives)
+        {
+            BuildNode& root = context.m_nodes[0];
+            root.box.max.x = root.box.min.x = 0;
+            root.box.max.y = root.box.min.y = 0;
+            root.box.max.z = root.box.min.z = 0;
+            root.firstPrimitive = 0;
+            root.numPrimitives = 0;
+            root.leftChild = 0;
+            root.rightChild = 0;
+            WriteBVH(context, primitiveMetaData, bvh);
+            return;
+        }
+
+        PrimitiveReferences references(numPrimitives);
+        concurrency::parallel_for(0u, numPrimitives, kParallelChunkSize, [&](UINT32 chunkStart)
+        {
+            const UINT32 chunkEnd = std::min(chunkStart + kParallelChunkSize, numPrimitives);
+            for (UINT32 i = chunkStart; i < chunkEnd; ++i)
+            {
+                references[i].box = boxes[i];
+                references[i].primitiveIndex = i;
+            }
+        });
+
+        AABB rootBox, centroidBox;
+        ComputeReferenceBounds(references, rootBox, centroidBox);
+        context.m_overlapThreshold = spatialSplitSettings.OverlapThreshold * ComputeBoxSurfaceArea(rootBox);
+
+        context.m_tasks.run([&context, &references] { BuildSpatialSubtree(context, 0, references); });
+        context.m_tasks.wait();
+
+        assert(context.m_numLeafReferences <= maxReferences);
+        WriteBVH(context, primitiveMetaData, bvh);
+    }
+
+    //
+    // pSpatialSplitSettings enables spatial splits, null builds with object
+    // splits only. Primitives aren't copied into bvh, they're written to the
+    // output straight from input once the final order is known.
+    //
+    void BuildUniformBVH(
+        _In_  const CpuGeometryInput &input,
+        _In_opt_ const CpuSpatialSplitSettings *pSpatialSplitSettings,
+        BVH &bvh)
+    {
+        //
+        // Create AABBs
+        //
+
+        const UINT numPrimitives = input.GetPrimitiveCount();
+        std::vector<AABB> boxes(numPrimitives);
+        std::vector<PrimitiveMetaData> primitiveMetaData(numPrimitives);
+        input.LoadBounds(boxes.data(), primitiveMetaData.data());
 
         //
-        // Now copy and compress geometry
+        // Create a BVH
         //
 
-        // Copy verts
-        const UINT numTris = triangleIndex;
-        bvh.m_triangles.resize(numTris * 3 * 3);
-        assert(bvh.m_triangles.size() == triangleVertices.size());
-        assert(sizeof(bvh.m_triangles[0]) == sizeof(triangleVertices[0]));
+        if (pSpatialSplitSettings)
+        {
+            BuildSpatialBVH(bvh, boxes, primitiveMetaData, input, MAX_TRIS_IN_LEAF, *pSpatialSplitSettings);
+        }
+        else
+        {
+            BuildBVH(bvh, boxes, primitiveMetaData, MAX_TRIS_IN_LEAF);
+        }
+    }
+
+    //
+    // Refit ("PERFORM_UPDATE")
+    //
+    // The CPU builder lays nodes out in pre-order, so every subtree owns a
+    // contiguous range of nodes that starts with its root and children always
+    // follow their parent. A backwards sweep over a range therefore refits
+    // that subtree bottom-up without parent links or a stack, and ranges large
+    // enough to be worth it are split between the two children and refit in
+    // parallel.
+    //
+
+    static const UINT32 kParallelRefitThreshold = 16 * 1024;
+
+    static
+        void ReadBVHNodeBox(
+            const AABBNode& packedBox,
+            AABB& box)
+    {
+        for (UINT k = 0; k < 3; ++k)
+        {
+            box.minArr[k] = packedBox.center[k] - packedBox.halfDim[k];
+            box.maxArr[k] = packedBox.center[k] + packedBox.halfDim[k];
+        }
+    }
+
+    // WriteBVHNodeBox without touching the topology bits
+    static
+        void RefitBVHNodeBox(
+            AABBNode& packedBox,
+            const AABB& box)
+    {
+        for (UINT k = 0; k < 3; ++k)
+        {
+            const float center = (box.maxArr[k] + box.minArr[k]) * 0.5f;
+            packedBox.center[k] = center;
+            packedBox.halfDim[k] = std::max(box.maxArr[k] - center, center - box.minArr[k]);
+        }
+    }
+
+    // Returns the node's contribution to the (unnormalized) SAH cost
+    static
+        float RefitNode(
+            AABBNode* pNodes,
+            const Primitive* pPrimitives,
+            UINT32 nodeIndex)
+    {
+        AABBNode& node = pNodes[nodeIndex];
+        AABB box;
+        if (node.leaf)
+        {
+            InitBoxToInverseMax(box);
+            const Primitive* pLeafPrimitives = pPrimitives + node.leafNode.firstTriangleId;
+            for (UINT32 i = 0; i < node.numTriangles; ++i)
+            {
+                AABB primitiveBox;
+                ComputePrimitiveBox(pLeafPrimitives[i], primitiveBox);
+                AddExtentToBox(box, primitiveBox);
+            }
+
+            if (!node.numTriangles)
+            {
+                box.max.x = box.min.x = 0;
+                box.max.y = box.min.y = 0;
+                box.max.z = box.min.z = 0;
+            }
+        }
+        else
+        {
+            AABB rightBox;
+            ReadBVHNodeBox(pNodes[node.internalNode.leftNodeIndex], box);
+            ReadBVHNodeBox(pNodes[node.rightNodeIndex], rightBox);
+            AddExtentToBox(box, rightBox);
+        }
+
+        RefitBVHNodeBox(node, box);
+        return ComputeBoxSurfaceArea(box) * (node.leaf ? node.numTriangles : 1);
+    }
 
-        for (UINT i = 0; i < numTris; ++i)
+    //
+    // Refits the subtree whose nodes occupy [subtreeRoot, subtreeEnd), returns
+    // its unnormalized SAH cost.
+    //
+    static
+        float RefitSubtree(
+            AABBNode* pNodes,
+            const Primitive* pPrimitives,
+            UINT32 subtreeRoot,
+            UINT32 subtreeEnd)
+    {
+        if (subtreeEnd - subtreeRoot < kParallelRefitThreshold)
         {
-            UINT inputIndex = bvh.m_metadata[i].PrimitiveIndex;
-            float *pInputTriangle = &triangleVertices.data()[inputIndex * 9];
-            float* pOutputTriangle = &bvh.m_triangles[i * 9];
+            float sahCost = 0.0f;
+            for (UINT32 i = subtreeEnd; i-- > subtreeRoot;)
+            {
+                sahCost += RefitNode(pNodes, pPrimitives, i);
+            }
+            return sahCost;
+        }
+
+        // Right child directly follows its parent, the left subtree follows the right one
+        const AABBNode& node = pNodes[subtreeRoot];
+        assert(!node.leaf && node.rightNodeIndex == subtreeRoot + 1);
+        const UINT32 leftIndex = node.internalNode.leftNodeIndex;
 
-            // Construct three planes and write to pPlanes
-            XMVECTOR V0 = XMVectorSet(pInputTriangle[0], pInputTriangle[1], pInputTriangle[2], 0.0f);
-            XMVECTOR V1 = XMVectorSet(pInputTriangle[3], pInputTriangle[4], pInputTriangle[5], 0.0f);
-            XMVECTOR V2 = XMVectorSet(pInputTriangle[6], pInputTriangle[7], pInputTriangle[8], 0.0f);
+        float rightSahCost = 0.0f;
+        float leftSahCost = 0.0f;
+        concurrency::parallel_invoke(
+            [&] { rightSahCost = RefitSubtree(pNodes, pPrimitives, subtreeRoot + 1, leftIndex); },
+            [&] { leftSahCost = RefitSubtree(pNodes, pPrimitives, leftIndex, subtreeEnd); });
 
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 0, V0);
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 1, V1);
-            XMStoreFloat3((XMFLOAT3*)pOutputTriangle + 2, V2);
+        return rightSahCost + leftSahCost + RefitNode(pNodes, pPrimitives, subtreeRoot);
+    }
+
+    // Collapsed BVH4/BVH8 nodes would be misread as BVH2 nodes and corrupted
+    static void CheckRefitNodeFormat(
+        _In_  const BYTE *pBvh)
+    {
+        if (((const BVHOffsets *)pBvh)->nodeFormat != BVH_NODE_FORMAT_BVH2)
+        {
+            ThrowFailure(E_INVALIDARG, L"Only BVH2 acceleration structures can be updated, refit before collapsing");
         }
     }
+
+    //
+    // Reloads every primitive from input, which must have the same primitive
+    // counts as the build, then refits the node boxes over the existing
+    // topology. Returns the SAH cost of the refit tree, in the same units as
+    // CpuBvh2Statistics::SahCost.
+    //
+    float RefitUniformBVH(
+        _In_  const CpuGeometryInput &input,
+        _Inout_ BYTE *pBvh)
+    {
+        CheckRefitNodeFormat(pBvh);
+        const BVHOffsets& offsets = *(const BVHOffsets*)pBvh;
+
+        AABBNode* pNodes = (AABBNode*)(pBvh + offsets.offsetToBoxes);
+        Primitive* pPrimitives = (Primitive*)(pBvh + offsets.offsetToVertices);
+        const PrimitiveMetaData* pMetaData = (const PrimitiveMetaData*)(pBvh + offsets.offsetToPrimitiveMetaData);
+        const UINT32 numNodes = (offsets.offsetToVertices - offsets.offsetToBoxes) / sizeof(AABBNode);
+        const UINT32 numPrimitives = (offsets.offsetToPrimitiveMetaData - offsets.offsetToVertices) / sizeof(Primitive);
+
+        concurrency::parallel_for(0u, numPrimitives, kParallelChunkSize, [&](UINT32 chunkStart)
+        {
+            const UINT32 chunkEnd = std::min(chunkStart + kParallelChunkSize, numPrimitives);
+            for (UINT32 i = chunkStart; i < chunkEnd; ++i)
+            {
+                input.LoadPrimitive(pMetaData[i], pPrimitives[i]);
+            }
+        });
+
+        const float sahCost = RefitSubtree(pNodes, pPrimitives, 0, numNodes);
+
+        AABB rootBox;
+        ReadBVHNodeBox(pNodes[0], rootBox);
+        const float rootArea = ComputeBoxSurfaceArea(rootBox);
+        return rootArea > 0 ? sahCost / rootArea : 0.0f;
+    }
+}
+
+// Spatial splits trade build time and memory for trace performance
+static bool UseSpatialSplits(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc)
+{
+    return (pDesc->Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE) &&
+        !(pDesc->Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD);
+}
+
+UINT GetRaytracingAccelerationStructureOnCpuMaxSize(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _In_  const CpuSpatialSplitSettings &spatialSplitSettings)
+{
+    const FallbackLayer::CpuGeometryInput input(*pDesc);
+    const UINT numPrimitives = input.GetPrimitiveCount();
+
+    const UINT maxReferences = FallbackLayer::GetMaxPrimitiveReferences(
+        numPrimitives,
+        UseSpatialSplits(pDesc) ? &spatialSplitSettings : nullptr);
+    const UINT maxNodes = maxReferences ? 2 * maxReferences - 1 : 1;
+    return sizeof(BVHOffsets) +
+        maxNodes * sizeof(AABBNode) +
+        maxReferences * (sizeof(Primitive) + sizeof(PrimitiveMetaData));
+}
+
+float RefitRaytracingAccelerationStructureOnCpu(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _Inout_ void *pData)
+{
+    // Updates are in place unless the caller names a different source
+    const BYTE *pSource = (const BYTE *)pDesc->SourceAccelerationStructureData;
+    FallbackLayer::CheckRefitNodeFormat(pSource ? pSource : (const BYTE *)pData);
+    if (pSource && pSource != pData)
+    {
+        memcpy(pData, pSource, ((const BVHOffsets *)pSource)->totalSize);
+    }
+
+    const FallbackLayer::CpuGeometryInput input(*pDesc);
+    return FallbackLayer::RefitUniformBVH(input, (BYTE *)pData);
 }
 
 void BuildRaytracingAccelerationStructureOnCpu(
     _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
-    _Out_ void *pData)
+    _Out_ void *pData,
+    _In_  const CpuSpatialSplitSettings &spatialSplitSettings)
 {
+    if (pDesc->Flags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE)
+    {
+        RefitRaytracingAccelerationStructureOnCpu(pDesc, pData);
+        return;
+    }
+
+    const FallbackLayer::CpuGeometryInput input(*pDesc);
     FallbackLayer::BVH bvh;
-    FallbackLayer::BuildUniformBVH(pDesc->NumDescs, pDesc->pGeometryDescs, bvh);
+    FallbackLayer::BuildUniformBVH(
+        input,
+        UseSpatialSplits(pDesc) ? &spatialSplitSettings : nullptr,
+        bvh);
 
     BYTE* outputData = (BYTE*)pData;
     BVHOffsets offsets;
     offsets.offsetToBoxes = sizeof(BVHOffsets);
+    offsets.nodeFormat = BVH_NODE_FORMAT_BVH2;
     const UINT sizeofBoxes = (UINT)(bvh.m_nodes.size() * sizeof(*bvh.m_nodes.data()));
     offsets.offsetToVertices = offsets.offsetToBoxes + sizeofBoxes;
     
-    UINT numTriangles = (UINT)bvh.m_triangles.size() / 9;
-    const UINT sizeofVertices = numTriangles * sizeof(Primitive);
+    // One primitive per reference, spatial splits may have duplicated some
+    const UINT numPrimitives = (UINT)bvh.m_metadata.size();
+    const UINT sizeofVertices = numPrimitives * sizeof(Primitive);
     offsets.offsetToPrimitiveMetaData = offsets.offsetToVertices + sizeofVertices;
 
     const UINT sizeofMetadata = (UINT)(bvh.m_metadata.size() * sizeof(*bvh.m_metadata.data()));
@@ -689,11 +1886,9 @@ void BuildRaytracingAccelerationStructureOnCpu(
     memcpy(outputData + offsets.offsetToBoxes, bvh.m_nodes.data(), sizeofBoxes);
 
     Primitive *pPrimitives = (Primitive *)(outputData + offsets.offsetToVertices);
-    for (UINT i = 0; i < numTriangles; i++)
+    concurrency::parallel_for(0u, numPrimitives, [&](UINT i)
     {
-        Triangle *pTriangle = (Triangle *)((BYTE *)bvh.m_triangles.data() + sizeof(Triangle) * i);
-        pPrimitives[i].PrimitiveType = TRIANGLE_TYPE;
-        pPrimitives[i].triangle = *pTriangle;
-    }
+        input.LoadPrimitive(bvh.m_metadata[i], pPrimitives[i]);
+    });
     memcpy(outputData + offsets.offsetToPrimitiveMetaData, bvh.m_metadata.data(), sizeofMetadata);
 }
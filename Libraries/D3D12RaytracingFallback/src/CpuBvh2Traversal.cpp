@@ -0,0 +1,174 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "pch.h"
+#include "CpuTraversalPackets.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace FallbackLayer
+{
+    CpuBvh2Traversal::CpuBvh2Traversal(const BYTE *pBottomLevelAccelerationStructure)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBottomLevelAccelerationStructure;
+        assert(offsets.nodeFormat == BVH_NODE_FORMAT_BVH2);
+        m_pNodes = (const AABBNode *)(pBottomLevelAccelerationStructure + offsets.offsetToBoxes);
+        m_pPrimitives = (const Primitive *)(pBottomLevelAccelerationStructure + offsets.offsetToVertices);
+        m_pPrimitiveMetaData = (const PrimitiveMetaData *)(pBottomLevelAccelerationStructure + offsets.offsetToPrimitiveMetaData);
+    }
+
+    template<typename Simd>
+    void CpuBvh2Traversal::Trace(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics) const
+    {
+        typedef typename Simd::Float Float;
+
+        PacketTraversalState<Simd> state(rays, query);
+        if (!state.GetActiveMask())
+        {
+            return;
+        }
+
+        UINT64 nodesVisited = 0;
+        UINT64 primitivesTested = 0;
+
+        TraversalStack stack;
+        stack.Push(0);
+        while (!stack.Empty() && state.GetActiveMask())
+        {
+            const AABBNode &node = m_pNodes[stack.Pop()];
+            nodesVisited++;
+
+            const float boxMin[3] = { node.center[0] - node.halfDim[0], node.center[1] - node.halfDim[1], node.center[2] - node.halfDim[2] };
+            const float boxMax[3] = { node.center[0] + node.halfDim[0], node.center[1] + node.halfDim[1], node.center[2] + node.halfDim[2] };
+            Float tNear;
+            const UINT nodeMask = state.IntersectBox(boxMin, boxMax, tNear);
+            if (!nodeMask)
+            {
+                continue;
+            }
+
+            if (node.leaf)
+            {
+                // flags.y holds the triangle count for both the CPU and GPU builders
+                state.IntersectPrimitives(m_pPrimitives, node.leafNode.firstTriangleId, node.numTriangles);
+                primitivesTested += node.numTriangles;
+            }
+            else
+            {
+                const UINT leftIndex = node.internalNode.leftNodeIndex;
+                const UINT rightIndex = node.rightNodeIndex;
+                const AABBNode &leftNode = m_pNodes[leftIndex];
+                const AABBNode &rightNode = m_pNodes[rightIndex];
+
+                // Visit the child nearer to the first ray in the packet first, judged
+                // along the axis the children are furthest apart on
+                UINT axis = 0;
+                float separation = fabs(leftNode.center[0] - rightNode.center[0]);
+                for (UINT i = 1; i < 3; i++)
+                {
+                    const float axisSeparation = fabs(leftNode.center[i] - rightNode.center[i]);
+                    if (axisSeparation > separation)
+                    {
+                        separation = axisSeparation;
+                        axis = i;
+                    }
+                }
+
+                UINT firstLane = 0;
+                while (!(nodeMask & (1u << firstLane)))
+                {
+                    firstLane++;
+                }
+                const float *directions[3] = { rays.DirectionX, rays.DirectionY, rays.DirectionZ };
+                const bool bLeftFirst = (directions[axis][firstLane] >= 0.0f) == (leftNode.center[axis] <= rightNode.center[axis]);
+
+                stack.Push(bLeftFirst ? rightIndex : leftIndex);
+                stack.Push(bLeftFirst ? leftIndex : rightIndex);
+            }
+        }
+
+        state.WriteHits(hits);
+
+        if (pStatistics)
+        {
+            pStatistics->NodesVisited += nodesVisited;
+            pStatistics->PrimitivesTested += primitivesTested;
+        }
+    }
+
+    void CpuBvh2Traversal::Trace4(const RayPacket4 &rays, HitPacket4 &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics) const
+    {
+        Trace<Sse>(rays, hits, query, pStatistics);
+    }
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+    void CpuBvh2Traversal::Trace8(const RayPacket8 &rays, HitPacket8 &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics) const
+    {
+        Trace<Avx>(rays, hits, query, pStatistics);
+    }
+
+    bool CpuBvh2Traversal::IsAvxSupported()
+    {
+#ifdef _MSC_VER
+        int cpuInfo[4];
+        __cpuid(cpuInfo, 1);
+        const bool bOsUsesXSave = (cpuInfo[2] & (1 << 27)) != 0;
+        const bool bCpuSupportsAvx = (cpuInfo[2] & (1 << 28)) != 0;
+        return bOsUsesXSave && bCpuSupportsAvx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+        return __builtin_cpu_supports("avx") != 0;
+#endif
+    }
+#endif
+
+    static float ComputeNodeSurfaceArea(const AABBNode &node)
+    {
+        const float dims[3] = { node.halfDim[0] * 2, node.halfDim[1] * 2, node.halfDim[2] * 2 };
+        return 2 * (dims[0] * dims[1] + dims[0] * dims[2] + dims[1] * dims[2]);
+    }
+
+    void ComputeCpuBvh2Statistics(const BYTE *pBottomLevelAccelerationStructure, CpuBvh2Statistics &statistics)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBottomLevelAccelerationStructure;
+        assert(offsets.nodeFormat == BVH_NODE_FORMAT_BVH2);
+        const AABBNode *pNodes = (const AABBNode *)(pBottomLevelAccelerationStructure + offsets.offsetToBoxes);
+
+        statistics = {};
+        const float rootArea = ComputeNodeSurfaceArea(pNodes[0]);
+        const float inverseRootArea = rootArea > 0 ? 1.0f / rootArea : 0.0f;
+
+        std::vector<std::pair<UINT, UINT>> stack;
+        stack.emplace_back(0, 1);
+        while (!stack.empty())
+        {
+            const UINT nodeIndex = stack.back().first;
+            const UINT depth = stack.back().second;
+            stack.pop_back();
+
+            const AABBNode &node = pNodes[nodeIndex];
+            const float relativeArea = ComputeNodeSurfaceArea(node) * inverseRootArea;
+            statistics.NumNodes++;
+            statistics.MaxDepth = std::max(statistics.MaxDepth, depth);
+            if (node.leaf)
+            {
+                statistics.NumLeaves++;
+                statistics.NumPrimitiveReferences += node.numTriangles;
+                statistics.SahCost += relativeArea * node.numTriangles;
+            }
+            else
+            {
+                statistics.SahCost += relativeArea;
+                stack.emplace_back(node.internalNode.leftNodeIndex, depth + 1);
+                stack.emplace_back(node.rightNodeIndex, depth + 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,130 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+// 8-wide packets need AVX, which MSVC exposes unconditionally and other
+// compilers only when targeting it (-mavx)
+#if defined(_MSC_VER) || defined(__AVX__)
+#define CPU_TRAVERSAL_SUPPORTS_AVX 1
+#else
+#define CPU_TRAVERSAL_SUPPORTS_AVX 0
+#endif
+
+namespace FallbackLayer
+{
+    enum class CpuTraversalQuery
+    {
+        // Find the nearest hit along each ray
+        ClosestHit,
+
+        // Stop each ray at the first hit found, for shadow/occlusion rays
+        AnyHit
+    };
+
+    //
+    // Structure-of-arrays ray packet. Lanes not set in ActiveMask are ignored
+    // and their hit results are left untouched.
+    //
+    template<UINT Width>
+    struct RayPacket
+    {
+        alignas(32) float OriginX[Width];
+        alignas(32) float OriginY[Width];
+        alignas(32) float OriginZ[Width];
+        alignas(32) float DirectionX[Width];
+        alignas(32) float DirectionY[Width];
+        alignas(32) float DirectionZ[Width];
+        alignas(32) float TMin[Width];
+        alignas(32) float TMax[Width];
+        UINT ActiveMask;
+    };
+
+    template<UINT Width>
+    struct HitPacket
+    {
+        alignas(32) float T[Width];
+
+        // Barycentric weights of the second and third vertices, as in the HLSL traversal
+        alignas(32) float U[Width];
+        alignas(32) float V[Width];
+
+        // Index into the primitive and primitive metadata arrays, CpuBvh2Traversal::NoHit on a miss
+        UINT PrimitiveId[Width];
+    };
+
+    typedef RayPacket<4> RayPacket4;
+    typedef HitPacket<4> HitPacket4;
+    typedef RayPacket<8> RayPacket8;
+    typedef HitPacket<8> HitPacket8;
+
+    // Per-packet work counters, accumulated across calls
+    struct CpuTraversalStatistics
+    {
+        UINT64 NodesVisited;
+        UINT64 PrimitivesTested;
+    };
+
+    //
+    // Quality report for a BVH2. SahCost is the expected cost of tracing a
+    // random ray that hits the root, counting 1 per node box and 1 per
+    // primitive test. Primitives duplicated by spatial splits are counted once
+    // per reference.
+    //
+    struct CpuBvh2Statistics
+    {
+        float SahCost;
+        UINT NumNodes;
+        UINT NumLeaves;
+        UINT NumPrimitiveReferences;
+        UINT MaxDepth;
+    };
+
+    void ComputeCpuBvh2Statistics(const BYTE *pBottomLevelAccelerationStructure, CpuBvh2Statistics &statistics);
+
+    //
+    // Traces ray packets through a bottom-level acceleration structure in the BVH2
+    // layout described by BVHOffsets, as written by BuildRaytracingAccelerationStructureOnCpu
+    // or read back from the GPU builder. Traversal only reads the acceleration
+    // structure so a single instance can be shared across threads.
+    //
+    // Triangles are intersected with Moller-Trumbore rather than the watertight
+    // test used by the traversal shader, so hits exactly on shared edges may differ.
+    // Procedural primitives have no intersection shader to run on the CPU and
+    // are reported where the ray enters their AABB.
+    //
+    class CpuBvh2Traversal
+    {
+    public:
+        static const UINT NoHit = 0xffffffff;
+
+        CpuBvh2Traversal(const BYTE *pBottomLevelAccelerationStructure);
+
+        // pStatistics, if set, is accumulated into rather than reset
+        void Trace4(const RayPacket4 &rays, HitPacket4 &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics = nullptr) const;
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+        // Callers must check IsAvxSupported() before using 8-wide packets
+        void Trace8(const RayPacket8 &rays, HitPacket8 &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics = nullptr) const;
+        static bool IsAvxSupported();
+#endif
+
+        const PrimitiveMetaData &GetPrimitiveMetaData(UINT primitiveId) const { return m_pPrimitiveMetaData[primitiveId]; }
+        const Primitive &GetPrimitive(UINT primitiveId) const { return m_pPrimitives[primitiveId]; }
+
+    private:
+        template<typename Simd>
+        void Trace(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query, CpuTraversalStatistics *pStatistics) const;
+
+        const AABBNode *m_pNodes;
+        const Primitive *m_pPrimitives;
+        const PrimitiveMetaData *m_pPrimitiveMetaData;
+    };
+}
@@ -0,0 +1,246 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "pch.h"
+#include <DirectXPackedVector.h>
+
+namespace FallbackLayer
+{
+    using namespace DirectX;
+    using namespace DirectX::PackedVector;
+
+    static const UINT kParallelLoadChunkSize = 16 * 1024;
+
+    static bool IsCpuVertexFormatSupported(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        case DXGI_FORMAT_R16G16_SNORM:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Two component formats leave z at 0, w is never used
+    static XMVECTOR LoadVertex(DXGI_FORMAT format, const BYTE *pVertex)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            return XMLoadFloat3((const XMFLOAT3 *)pVertex);
+        case DXGI_FORMAT_R32G32_FLOAT:
+            return XMLoadFloat2((const XMFLOAT2 *)pVertex);
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            return XMLoadHalf4((const XMHALF4 *)pVertex);
+        case DXGI_FORMAT_R16G16_FLOAT:
+            return XMLoadHalf2((const XMHALF2 *)pVertex);
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+            return XMLoadShortN4((const XMSHORTN4 *)pVertex);
+        case DXGI_FORMAT_R16G16_SNORM:
+            return XMLoadShortN2((const XMSHORTN2 *)pVertex);
+        default:
+            assert(false);
+            return XMVectorZero();
+        }
+    }
+
+    CpuGeometryInput::CpuGeometryInput(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC &desc) :
+        m_geometries(desc.NumDescs),
+        m_numPrimitives(0)
+    {
+        for (UINT i = 0; i < desc.NumDescs; ++i)
+        {
+            const D3D12_RAYTRACING_GEOMETRY_DESC &geometryDesc = GetGeometryDesc(desc, i);
+            Geometry &geometry = m_geometries[i];
+            geometry.pDesc = &geometryDesc;
+            geometry.firstPrimitive = m_numPrimitives;
+            geometry.bHasTransform = false;
+
+            if (geometryDesc.Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
+            {
+                const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC &triangles = geometryDesc.Triangles;
+                if (!IsCpuVertexFormatSupported(triangles.VertexFormat))
+                {
+                    ThrowFailure(E_NOTIMPL, L"Unsupported vertex buffer format provided");
+                }
+
+                if (triangles.Transform)
+                {
+                    // The 3x4 transform is row major and applied to column vectors
+                    const float *pTransform = (const float *)triangles.Transform;
+                    XMMATRIX transform(
+                        XMLoadFloat4((const XMFLOAT4 *)pTransform),
+                        XMLoadFloat4((const XMFLOAT4 *)(pTransform + 4)),
+                        XMLoadFloat4((const XMFLOAT4 *)(pTransform + 8)),
+                        g_XMIdentityR3);
+                    XMStoreFloat4x4(&geometry.transform, XMMatrixTranspose(transform));
+                    geometry.bHasTransform = true;
+                }
+            }
+
+            m_numPrimitives += GetPrimitiveCountFromGeometryDesc(geometryDesc);
+        }
+    }
+
+    // Index of the geometry that holds a primitive, skipping empty geometries
+    UINT CpuGeometryInput::FindGeometry(UINT primitive) const
+    {
+        assert(primitive < m_numPrimitives);
+        auto geometry = std::upper_bound(m_geometries.begin(), m_geometries.end(), primitive,
+            [](UINT value, const Geometry &geometry) { return value < geometry.firstPrimitive; });
+        return (UINT)(geometry - m_geometries.begin()) - 1;
+    }
+
+    void CpuGeometryInput::LoadTriangle(const Geometry &geometry, UINT triangleIndex, XMVECTOR (&vertices)[3]) const
+    {
+        const D3D12_RAYTRACING_GEOMETRY_TRIANGLES_DESC &triangles = geometry.pDesc->Triangles;
+
+        UINT indices[3];
+        switch (triangles.IndexFormat)
+        {
+        case DXGI_FORMAT_R16_UINT:
+        {
+            const UINT16 *pIndices = (const UINT16 *)triangles.IndexBuffer + triangleIndex * 3;
+            indices[0] = pIndices[0];
+            indices[1] = pIndices[1];
+            indices[2] = pIndices[2];
+            break;
+        }
+        case DXGI_FORMAT_R32_UINT:
+        {
+            const UINT32 *pIndices = (const UINT32 *)triangles.IndexBuffer + triangleIndex * 3;
+            indices[0] = pIndices[0];
+            indices[1] = pIndices[1];
+            indices[2] = pIndices[2];
+            break;
+        }
+        default:
+            indices[0] = triangleIndex * 3;
+            indices[1] = triangleIndex * 3 + 1;
+            indices[2] = triangleIndex * 3 + 2;
+            break;
+        }
+
+        const BYTE *pVertexData = (const BYTE *)triangles.VertexBuffer.StartAddress;
+        const UINT64 stride = triangles.VertexBuffer.StrideInBytes;
+        for (UINT i = 0; i < 3; ++i)
+        {
+            vertices[i] = LoadVertex(triangles.VertexFormat, pVertexData + indices[i] * stride);
+        }
+
+        if (geometry.bHasTransform)
+        {
+            const XMMATRIX transform = XMLoadFloat4x4(&geometry.transform);
+            for (UINT i = 0; i < 3; ++i)
+            {
+                vertices[i] = XMVector3Transform(vertices[i], transform);
+            }
+        }
+    }
+
+    void CpuGeometryInput::LoadPrimitive(const PrimitiveMetaData &primitiveMetaData, Primitive &primitive) const
+    {
+        assert(primitiveMetaData.GeometryContributionToHitGroupIndex < m_geometries.size());
+        const Geometry &geometry = m_geometries[primitiveMetaData.GeometryContributionToHitGroupIndex];
+        const UINT primitiveIndex = primitiveMetaData.PrimitiveIndex;
+
+        if (geometry.pDesc->Type == D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES)
+        {
+            XMVECTOR vertices[3];
+            LoadTriangle(geometry, primitiveIndex, vertices);
+
+            primitive.PrimitiveType = TRIANGLE_TYPE;
+            for (UINT i = 0; i < 3; ++i)
+            {
+                XMStoreFloat3((XMFLOAT3 *)&primitive.triangle.v[i], vertices[i]);
+            }
+        }
+        else
+        {
+            const D3D12_RAYTRACING_GEOMETRY_AABBS_DESC &aabbs = geometry.pDesc->AABBs;
+            const D3D12_RAYTRACING_AABB &aabb = *(const D3D12_RAYTRACING_AABB *)
+                (aabbs.AABBs.StartAddress + primitiveIndex * aabbs.AABBs.StrideInBytes);
+
+            primitive.PrimitiveType = PROCEDURAL_PRIMITIVE_TYPE;
+            AABB &box = primitive.aabb;
+            box.min.x = aabb.MinX;
+            box.min.y = aabb.MinY;
+            box.min.z = aabb.MinZ;
+            box.max.x = aabb.MaxX;
+            box.max.y = aabb.MaxY;
+            box.max.z = aabb.MaxZ;
+        }
+    }
+
+    //
+    // Work is split into fixed size chunks over the primitives of all
+    // geometries, so one large geometry is spread over every thread and many
+    // small ones share chunks.
+    //
+    void CpuGeometryInput::LoadBounds(AABB *pBoxes, PrimitiveMetaData *pPrimitiveMetaData) const
+    {
+        concurrency::parallel_for(0u, m_numPrimitives, kParallelLoadChunkSize, [&](UINT chunkStart)
+        {
+            const UINT chunkEnd = std::min(chunkStart + kParallelLoadChunkSize, m_numPrimitives);
+            UINT geometryIndex = FindGeometry(chunkStart);
+            for (UINT i = chunkStart; i < chunkEnd; ++i)
+            {
+                while (geometryIndex + 1 < m_geometries.size() && m_geometries[geometryIndex + 1].firstPrimitive <= i)
+                {
+                    geometryIndex++;
+                }
+                const Geometry &geometry = m_geometries[geometryIndex];
+
+                PrimitiveMetaData &metadata = pPrimitiveMetaData[i];
+                metadata.GeometryContributionToHitGroupIndex = geometryIndex;
+                metadata.PrimitiveIndex = i - geometry.firstPrimitive;
+                metadata.GeometryFlags = geometry.pDesc->Flags;
+
+                Primitive primitive;
+                LoadPrimitive(metadata, primitive);
+                ComputePrimitiveBox(primitive, pBoxes[i]);
+            }
+        });
+    }
+
+    void ComputePrimitiveBox(const Primitive &primitive, AABB &box)
+    {
+        if (primitive.PrimitiveType != TRIANGLE_TYPE)
+        {
+            box = primitive.aabb;
+            return;
+        }
+
+        const Triangle &triangle = primitive.triangle;
+        const XMVECTOR v0 = XMLoadFloat3((const XMFLOAT3 *)&triangle.v0);
+        const XMVECTOR v1 = XMLoadFloat3((const XMFLOAT3 *)&triangle.v1);
+        const XMVECTOR v2 = XMLoadFloat3((const XMFLOAT3 *)&triangle.v2);
+        XMStoreFloat3((XMFLOAT3 *)&box.min, XMVectorMin(v2, XMVectorMin(v0, v1)));
+        XMStoreFloat3((XMFLOAT3 *)&box.max, XMVectorAdd(XMVectorMax(v2, XMVectorMax(v0, v1)), XMVectorReplicate(AABB_Min_Padding)));
+
+        for (UINT k = 0; k < 3; ++k)
+        {
+            if (_isnan(box.minArr[k]) ||
+                _isnan(box.maxArr[k]))
+            {
+                box.minArr[k] = 0;
+                box.maxArr[k] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+// Added to the max corner of triangle boxes, see ComputePrimitiveBox
+#define AABB_Min_Padding 0.001f
+
+namespace FallbackLayer
+{
+    //
+    // Input assembly for the CPU builder. Reads the geometry descs of a bottom
+    // level build straight from CPU memory (GPU virtual addresses are treated
+    // as pointers) and decodes primitives on demand, so builds and refits
+    // never keep a copy of the vertices.
+    //
+    // Triangles may use R16, R32 or no index buffer, any vertex stride, any of
+    // the DXR vertex formats and an optional 3x4 transform. Procedural AABBs
+    // are read as is.
+    //
+    class CpuGeometryInput
+    {
+    public:
+        CpuGeometryInput(const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC &desc);
+
+        UINT GetPrimitiveCount() const { return m_numPrimitives; }
+
+        // Fills GetPrimitiveCount() boxes and metadata, geometry by geometry.
+        // PrimitiveIndex is local to its geometry as with the GPU builder.
+        void LoadBounds(AABB *pBoxes, PrimitiveMetaData *pPrimitiveMetaData) const;
+
+        // Decodes the primitive a LoadBounds entry was made from
+        void LoadPrimitive(const PrimitiveMetaData &primitiveMetaData, Primitive &primitive) const;
+
+    private:
+        struct Geometry
+        {
+            const D3D12_RAYTRACING_GEOMETRY_DESC *pDesc;
+            UINT firstPrimitive;
+            bool bHasTransform;
+
+            // Transposed so rows can be combined with XMVector3Transform
+            DirectX::XMFLOAT4X4 transform;
+        };
+
+        UINT FindGeometry(UINT primitive) const;
+        void LoadTriangle(const Geometry &geometry, UINT triangleIndex, DirectX::XMVECTOR (&vertices)[3]) const;
+
+        std::vector<Geometry> m_geometries;
+        UINT m_numPrimitives;
+    };
+
+    // Box the builders use for a primitive: triangles are padded so flat
+    // triangles still get a volume, procedural AABBs are used unchanged
+    void ComputePrimitiveBox(const Primitive &primitive, AABB &box);
+}
@@ -0,0 +1,323 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+#include <immintrin.h>
+
+// Packet intersection shared by the CPU traversal of each node format, only
+// included by the CPU traversal translation units
+namespace FallbackLayer
+{
+    //
+    // Thin wrappers so the packet traversal can be written once for both widths
+    //
+
+    struct Sse
+    {
+        static const UINT Width = 4;
+        typedef __m128 Float;
+
+        static Float Load(const float *p) { return _mm_load_ps(p); }
+        static void Store(float *p, Float v) { _mm_store_ps(p, v); }
+        static Float Set1(float v) { return _mm_set1_ps(v); }
+        static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+        static Float And(Float a, Float b) { return _mm_and_ps(a, b); }
+        static Float AndNot(Float a, Float b) { return _mm_andnot_ps(a, b); }
+        static Float Or(Float a, Float b) { return _mm_or_ps(a, b); }
+        static Float Select(Float mask, Float a, Float b) { return Or(And(mask, a), AndNot(mask, b)); }
+        static Float CmpLt(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static Float CmpLe(Float a, Float b) { return _mm_cmple_ps(a, b); }
+        static Float CmpGt(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+        static Float CmpGe(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static Float CmpNeq(Float a, Float b) { return _mm_cmpneq_ps(a, b); }
+        static UINT MoveMask(Float a) { return (UINT)_mm_movemask_ps(a); }
+    };
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+    struct Avx
+    {
+        static const UINT Width = 8;
+        typedef __m256 Float;
+
+        static Float Load(const float *p) { return _mm256_load_ps(p); }
+        static void Store(float *p, Float v) { _mm256_store_ps(p, v); }
+        static Float Set1(float v) { return _mm256_set1_ps(v); }
+        static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+        static Float And(Float a, Float b) { return _mm256_and_ps(a, b); }
+        static Float AndNot(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+        static Float Or(Float a, Float b) { return _mm256_or_ps(a, b); }
+        static Float Select(Float mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+        static Float CmpLt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Float CmpLe(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static Float CmpGt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static Float CmpGe(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Float CmpNeq(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+        static UINT MoveMask(Float a) { return (UINT)_mm256_movemask_ps(a); }
+    };
+#endif
+
+    //
+    // Node indices still to visit. The CPU builder doesn't bound tree depth the
+    // way the traversal shader's TRAVERSAL_MAX_STACK_DEPTH assumes, so spill to
+    // the heap rather than overflow on degenerate trees.
+    //
+    class TraversalStack
+    {
+    public:
+        TraversalStack() : m_size(0) {}
+
+        bool Empty() const { return m_size == 0; }
+
+        void Push(UINT nodeIndex)
+        {
+            if (m_size < ARRAYSIZE(m_inlineStack))
+            {
+                m_inlineStack[m_size] = nodeIndex;
+            }
+            else
+            {
+                m_spillStack.push_back(nodeIndex);
+            }
+            m_size++;
+        }
+
+        UINT Pop()
+        {
+            assert(m_size > 0);
+            m_size--;
+            if (m_size < ARRAYSIZE(m_inlineStack))
+            {
+                return m_inlineStack[m_size];
+            }
+
+            const UINT nodeIndex = m_spillStack.back();
+            m_spillStack.pop_back();
+            return nodeIndex;
+        }
+
+    private:
+        UINT m_inlineStack[64];
+        std::vector<UINT> m_spillStack;
+        UINT m_size;
+    };
+
+    //
+    // Per-packet ray data and closest hits found so far. Node traversal order is
+    // left to the caller, this only answers which lanes overlap a box and
+    // records primitive hits.
+    //
+    template<typename Simd>
+    class PacketTraversalState
+    {
+    public:
+        typedef typename Simd::Float Float;
+        static const UINT Width = Simd::Width;
+
+        PacketTraversalState(const RayPacket<Width> &rays, CpuTraversalQuery query) :
+            m_query(query)
+        {
+            m_packetMask = rays.ActiveMask & ((1u << Width) - 1);
+            m_activeMask = m_packetMask;
+
+            m_origin[0] = Simd::Load(rays.OriginX);
+            m_origin[1] = Simd::Load(rays.OriginY);
+            m_origin[2] = Simd::Load(rays.OriginZ);
+            m_direction[0] = Simd::Load(rays.DirectionX);
+            m_direction[1] = Simd::Load(rays.DirectionY);
+            m_direction[2] = Simd::Load(rays.DirectionZ);
+            m_tMin = Simd::Load(rays.TMin);
+            m_tMax = Simd::Load(rays.TMax);
+
+            // Nudge zero direction components so the slab test never computes 0 * inf
+            const float minDirection = 1e-20f;
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                const Float absDirection = Simd::AndNot(Simd::Set1(-0.0f), m_direction[axis]);
+                const Float sign = Simd::And(Simd::Set1(-0.0f), m_direction[axis]);
+                const Float safeDirection = Simd::Select(
+                    Simd::CmpLt(absDirection, Simd::Set1(minDirection)),
+                    Simd::Or(Simd::Set1(minDirection), sign),
+                    m_direction[axis]);
+                m_inverseDirection[axis] = Simd::Div(Simd::Set1(1.0f), safeDirection);
+                m_originTimesInverseDirection[axis] = Simd::Mul(m_origin[axis], m_inverseDirection[axis]);
+            }
+
+            alignas(32) float laneMaskData[Width];
+            for (UINT lane = 0; lane < Width; lane++)
+            {
+                const UINT allBits = (m_packetMask & (1u << lane)) ? 0xffffffff : 0;
+                memcpy(&laneMaskData[lane], &allBits, sizeof(float));
+            }
+            m_activeLanes = Simd::Load(laneMaskData);
+
+            m_hitU = Simd::Set1(0.0f);
+            m_hitV = Simd::Set1(0.0f);
+            for (UINT lane = 0; lane < Width; lane++)
+            {
+                m_primitiveIds[lane] = CpuBvh2Traversal::NoHit;
+            }
+        }
+
+        // Lanes still looking for a hit
+        UINT GetActiveMask() const { return m_activeMask; }
+
+        // Returns the active lanes that overlap the box before their current
+        // closest hit, along with where each lane enters it
+        UINT IntersectBox(const float boxMin[3], const float boxMax[3], Float &tNear) const
+        {
+            return Simd::MoveMask(Simd::And(IntersectBoxAllLanes(boxMin, boxMax, tNear), m_activeLanes));
+        }
+
+        void IntersectPrimitives(const Primitive *pPrimitives, UINT firstPrimitive, UINT numPrimitives)
+        {
+            UINT foundMask = 0;
+            for (UINT primitiveId = firstPrimitive; primitiveId < firstPrimitive + numPrimitives; primitiveId++)
+            {
+                const Primitive &primitive = pPrimitives[primitiveId];
+
+                Float t, u, v, valid;
+                if (primitive.PrimitiveType == TRIANGLE_TYPE)
+                {
+                    valid = IntersectTriangle(primitive.triangle, t, u, v);
+                }
+                else
+                {
+                    valid = IntersectBoxAllLanes(&primitive.aabb.min.x, &primitive.aabb.max.x, t);
+                    u = v = Simd::Set1(0.0f);
+                }
+                valid = Simd::And(valid, m_activeLanes);
+
+                const UINT hitMask = Simd::MoveMask(valid);
+                if (!hitMask)
+                {
+                    continue;
+                }
+
+                m_tMax = Simd::Select(valid, t, m_tMax);
+                m_hitU = Simd::Select(valid, u, m_hitU);
+                m_hitV = Simd::Select(valid, v, m_hitV);
+                for (UINT lane = 0; lane < Width; lane++)
+                {
+                    if (hitMask & (1u << lane))
+                    {
+                        m_primitiveIds[lane] = primitiveId;
+                    }
+                }
+
+                if (m_query == CpuTraversalQuery::AnyHit)
+                {
+                    m_activeLanes = Simd::AndNot(valid, m_activeLanes);
+                    foundMask |= hitMask;
+                }
+            }
+            m_activeMask &= ~foundMask;
+        }
+
+        void WriteHits(HitPacket<Width> &hits) const
+        {
+            alignas(32) float resultT[Width];
+            alignas(32) float resultU[Width];
+            alignas(32) float resultV[Width];
+            Simd::Store(resultT, m_tMax);
+            Simd::Store(resultU, m_hitU);
+            Simd::Store(resultV, m_hitV);
+            for (UINT lane = 0; lane < Width; lane++)
+            {
+                if (m_packetMask & (1u << lane))
+                {
+                    hits.T[lane] = resultT[lane];
+                    hits.U[lane] = resultU[lane];
+                    hits.V[lane] = resultV[lane];
+                    hits.PrimitiveId[lane] = m_primitiveIds[lane];
+                }
+            }
+        }
+
+    private:
+        // Ray/AABB slab test
+        Float IntersectBoxAllLanes(const float boxMin[3], const float boxMax[3], Float &tNear) const
+        {
+            tNear = m_tMin;
+            Float tFar = m_tMax;
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                const Float t0 = Simd::Sub(Simd::Mul(Simd::Set1(boxMin[axis]), m_inverseDirection[axis]), m_originTimesInverseDirection[axis]);
+                const Float t1 = Simd::Sub(Simd::Mul(Simd::Set1(boxMax[axis]), m_inverseDirection[axis]), m_originTimesInverseDirection[axis]);
+                tNear = Simd::Max(tNear, Simd::Min(t0, t1));
+                tFar = Simd::Min(tFar, Simd::Max(t0, t1));
+            }
+            return Simd::CmpLe(tNear, tFar);
+        }
+
+        // Moller-Trumbore, one triangle against every lane
+        Float IntersectTriangle(const Triangle &triangle, Float &t, Float &u, Float &v) const
+        {
+            const float3 e1 = triangle.v1 - triangle.v0;
+            const float3 e2 = triangle.v2 - triangle.v0;
+            const Float e1x = Simd::Set1(e1.x), e1y = Simd::Set1(e1.y), e1z = Simd::Set1(e1.z);
+            const Float e2x = Simd::Set1(e2.x), e2y = Simd::Set1(e2.y), e2z = Simd::Set1(e2.z);
+            const Float *d = m_direction;
+
+            const Float px = Simd::Sub(Simd::Mul(d[1], e2z), Simd::Mul(d[2], e2y));
+            const Float py = Simd::Sub(Simd::Mul(d[2], e2x), Simd::Mul(d[0], e2z));
+            const Float pz = Simd::Sub(Simd::Mul(d[0], e2y), Simd::Mul(d[1], e2x));
+            const Float det = Simd::Add(Simd::Add(Simd::Mul(e1x, px), Simd::Mul(e1y, py)), Simd::Mul(e1z, pz));
+            const Float inverseDet = Simd::Div(Simd::Set1(1.0f), det);
+
+            const Float tx = Simd::Sub(m_origin[0], Simd::Set1(triangle.v0.x));
+            const Float ty = Simd::Sub(m_origin[1], Simd::Set1(triangle.v0.y));
+            const Float tz = Simd::Sub(m_origin[2], Simd::Set1(triangle.v0.z));
+            u = Simd::Mul(Simd::Add(Simd::Add(Simd::Mul(tx, px), Simd::Mul(ty, py)), Simd::Mul(tz, pz)), inverseDet);
+
+            const Float qx = Simd::Sub(Simd::Mul(ty, e1z), Simd::Mul(tz, e1y));
+            const Float qy = Simd::Sub(Simd::Mul(tz, e1x), Simd::Mul(tx, e1z));
+            const Float qz = Simd::Sub(Simd::Mul(tx, e1y), Simd::Mul(ty, e1x));
+            v = Simd::Mul(Simd::Add(Simd::Add(Simd::Mul(d[0], qx), Simd::Mul(d[1], qy)), Simd::Mul(d[2], qz)), inverseDet);
+            t = Simd::Mul(Simd::Add(Simd::Add(Simd::Mul(e2x, qx), Simd::Mul(e2y, qy)), Simd::Mul(e2z, qz)), inverseDet);
+
+            const Float zero = Simd::Set1(0.0f);
+            Float valid = Simd::CmpNeq(det, zero);
+            valid = Simd::And(valid, Simd::CmpGe(u, zero));
+            valid = Simd::And(valid, Simd::CmpGe(v, zero));
+            valid = Simd::And(valid, Simd::CmpLe(Simd::Add(u, v), Simd::Set1(1.0f)));
+            valid = Simd::And(valid, Simd::CmpGt(t, m_tMin));
+            valid = Simd::And(valid, Simd::CmpLt(t, m_tMax));
+            return valid;
+        }
+
+        Float m_origin[3];
+        Float m_direction[3];
+        Float m_inverseDirection[3];
+        Float m_originTimesInverseDirection[3];
+        Float m_tMin;
+
+        // Shrinks as closer hits are found so later boxes and triangles get culled
+        Float m_tMax;
+        Float m_hitU;
+        Float m_hitV;
+        UINT m_primitiveIds[Width];
+
+        // All bits set for lanes still traversing, the float mask mirrors m_activeMask
+        Float m_activeLanes;
+        UINT m_activeMask;
+        UINT m_packetMask;
+        CpuTraversalQuery m_query;
+    };
+}
@@ -0,0 +1,453 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#include "pch.h"
+#include "CpuTraversalPackets.h"
+
+namespace FallbackLayer
+{
+    static
+        UINT GetNodeWidth(
+            UINT nodeFormat)
+    {
+        switch (nodeFormat)
+        {
+        case BVH_NODE_FORMAT_QUANTIZED_BVH4:
+            return 4;
+        case BVH_NODE_FORMAT_QUANTIZED_BVH8:
+            return 8;
+        default:
+            ThrowFailure(E_INVALIDARG, L"Only BVH4 and BVH8 node formats can be collapsed to");
+            return 0;
+        }
+    }
+
+    static
+        UINT GetNodeSize(
+            UINT nodeFormat)
+    {
+        return GetNodeWidth(nodeFormat) == 4 ? sizeof(QuantizedBVH4Node) : sizeof(QuantizedBVH8Node);
+    }
+
+    static
+        AABB GetBvh2NodeBox(
+            const AABBNode &node)
+    {
+        AABB box;
+        for (UINT axis = 0; axis < 3; axis++)
+        {
+            box.minArr[axis] = node.center[axis] - node.halfDim[axis];
+            box.maxArr[axis] = node.center[axis] + node.halfDim[axis];
+        }
+        return box;
+    }
+
+    static
+        float GetHalfSurfaceArea(
+            const AABB &box)
+    {
+        const float x = box.max.x - box.min.x;
+        const float y = box.max.y - box.min.y;
+        const float z = box.max.z - box.min.z;
+        return x * y + y * z + z * x;
+    }
+
+    // Subtrees this small become a single leaf reference, provided their
+    // primitives are contiguous
+    static const UINT kMaxPrimitivesInCollapsedLeaf = 4;
+
+    struct Bvh2SubtreeRange
+    {
+        UINT firstPrimitive;
+        UINT numPrimitives;
+        bool bContiguous;
+    };
+
+    //
+    // Primitive range covered by every BVH2 subtree. The CPU builder and
+    // LBVH keep subtrees contiguous but treelet reordering may not, so this is
+    // checked rather than assumed.
+    //
+    static
+        void ComputeSubtreeRanges(
+            const AABBNode *pNodes,
+            UINT numNodes,
+            std::vector<Bvh2SubtreeRange> &ranges)
+    {
+        ranges.resize(numNodes);
+
+        // Reverse of a pre-order walk visits children before their parents
+        std::vector<UINT> preOrder;
+        preOrder.reserve(numNodes);
+        std::vector<UINT> stack(1, 0);
+        while (!stack.empty())
+        {
+            const UINT nodeIndex = stack.back();
+            stack.pop_back();
+            preOrder.push_back(nodeIndex);
+            if (!pNodes[nodeIndex].leaf)
+            {
+                stack.push_back(pNodes[nodeIndex].internalNode.leftNodeIndex);
+                stack.push_back(pNodes[nodeIndex].rightNodeIndex);
+            }
+        }
+
+        for (auto it = preOrder.rbegin(); it != preOrder.rend(); it++)
+        {
+            const AABBNode &node = pNodes[*it];
+            Bvh2SubtreeRange &range = ranges[*it];
+            if (node.leaf)
+            {
+                range.firstPrimitive = node.leafNode.firstTriangleId;
+                range.numPrimitives = node.numTriangles;
+                range.bContiguous = true;
+            }
+            else
+            {
+                const Bvh2SubtreeRange &left = ranges[node.internalNode.leftNodeIndex];
+                const Bvh2SubtreeRange &right = ranges[node.rightNodeIndex];
+                range.firstPrimitive = std::min(left.firstPrimitive, right.firstPrimitive);
+                range.numPrimitives = left.numPrimitives + right.numPrimitives;
+                range.bContiguous = left.bContiguous && right.bContiguous &&
+                    (left.firstPrimitive + left.numPrimitives == right.firstPrimitive ||
+                     right.firstPrimitive + right.numPrimitives == left.firstPrimitive);
+            }
+        }
+    }
+
+    //
+    // Finds the smallest power of two step per axis for which 8 bits cover the
+    // node, then rounds each child plane outwards. The decode is rechecked
+    // with the exact expression traversal uses so float rounding can't leave a
+    // child poking out of its quantized box.
+    //
+    template<UINT Width>
+    static
+        void QuantizeChildBoxes(
+            const AABB *pChildBoxes,
+            UINT numChildren,
+            QuantizedBVHNode<Width> &node)
+    {
+        for (UINT axis = 0; axis < 3; axis++)
+        {
+            float nodeMin = FLT_MAX;
+            float nodeMax = -FLT_MAX;
+            for (UINT child = 0; child < numChildren; child++)
+            {
+                nodeMin = std::min(nodeMin, pChildBoxes[child].minArr[axis]);
+                nodeMax = std::max(nodeMax, pChildBoxes[child].maxArr[axis]);
+            }
+            const float origin = nodeMin;
+            node.origin[axis] = origin;
+
+            int exponent;
+            frexp((nodeMax - nodeMin) / 255.0f, &exponent);
+            exponent = std::max(exponent, -126);
+            for (;; exponent++)
+            {
+                assert(exponent <= 127);
+                const float scale = GetQuantizationScale((INT8)exponent);
+
+                bool bConservative = true;
+                for (UINT child = 0; child < numChildren && bConservative; child++)
+                {
+                    const float childMin = pChildBoxes[child].minArr[axis];
+                    const float childMax = pChildBoxes[child].maxArr[axis];
+
+                    UINT qMin = (UINT)std::min(std::max(floorf((childMin - origin) / scale), 0.0f), 255.0f);
+                    while (qMin > 0 && DequantizeBound(origin, scale, (BYTE)qMin) > childMin)
+                    {
+                        qMin--;
+                    }
+
+                    UINT qMax = (UINT)std::min(std::max(ceilf((childMax - origin) / scale), 0.0f), 255.0f);
+                    while (qMax < 255 && DequantizeBound(origin, scale, (BYTE)qMax) < childMax)
+                    {
+                        qMax++;
+                    }
+
+                    node.childMin[axis][child] = (BYTE)qMin;
+                    node.childMax[axis][child] = (BYTE)qMax;
+                    bConservative = DequantizeBound(origin, scale, (BYTE)qMin) <= childMin &&
+                        DequantizeBound(origin, scale, (BYTE)qMax) >= childMax;
+                }
+
+                if (bConservative)
+                {
+                    node.scaleExponent[axis] = (INT8)exponent;
+                    break;
+                }
+            }
+
+            for (UINT child = numChildren; child < Width; child++)
+            {
+                node.childMin[axis][child] = 0;
+                node.childMax[axis][child] = 0;
+            }
+        }
+    }
+
+    template<UINT Width>
+    static
+        UINT CollapseBvh2(
+            const BYTE *pBvh2,
+            UINT nodeFormat,
+            BYTE *pOutput)
+    {
+        const BVHOffsets &bvh2Offsets = *(const BVHOffsets *)pBvh2;
+        const AABBNode *pBvh2Nodes = (const AABBNode *)(pBvh2 + bvh2Offsets.offsetToBoxes);
+        const UINT primitivesSize = bvh2Offsets.offsetToPrimitiveMetaData - bvh2Offsets.offsetToVertices;
+        const UINT metadataSize = bvh2Offsets.totalSize - bvh2Offsets.offsetToPrimitiveMetaData;
+        const UINT numBvh2Nodes = (bvh2Offsets.offsetToVertices - bvh2Offsets.offsetToBoxes) / sizeof(AABBNode);
+
+        std::vector<Bvh2SubtreeRange> ranges;
+        ComputeSubtreeRanges(pBvh2Nodes, numBvh2Nodes, ranges);
+        auto BecomesLeaf = [&](UINT bvh2Index)
+        {
+            const Bvh2SubtreeRange &range = ranges[bvh2Index];
+            return pBvh2Nodes[bvh2Index].leaf || (range.bContiguous && range.numPrimitives <= kMaxPrimitivesInCollapsedLeaf);
+        };
+
+        QuantizedBVHNode<Width> *pNodes = (QuantizedBVHNode<Width> *)(pOutput + sizeof(BVHOffsets));
+        UINT numNodes = 1;
+
+        // Pairs of BVH2 node and the wide node it becomes. Wide nodes are
+        // allocated when their parent is written so indices are known up front.
+        std::vector<std::pair<UINT, UINT>> nodesToCollapse;
+        nodesToCollapse.push_back(std::make_pair(0u, 0u));
+        while (!nodesToCollapse.empty())
+        {
+            const UINT bvh2Index = nodesToCollapse.back().first;
+            const UINT nodeIndex = nodesToCollapse.back().second;
+            nodesToCollapse.pop_back();
+
+            // Open up the child with the largest surface area until the node is
+            // full, those are the children most likely to be hit
+            UINT children[Width];
+            UINT numChildren = 0;
+            const AABBNode &bvh2Node = pBvh2Nodes[bvh2Index];
+            if (bvh2Node.leaf)
+            {
+                // Only the root can get here, when the whole BVH2 is one leaf
+                children[numChildren++] = bvh2Index;
+            }
+            else
+            {
+                children[numChildren++] = bvh2Node.internalNode.leftNodeIndex;
+                children[numChildren++] = bvh2Node.rightNodeIndex;
+            }
+
+            while (numChildren < Width)
+            {
+                UINT childToOpen = numChildren;
+                float largestArea = -1.0f;
+                for (UINT child = 0; child < numChildren; child++)
+                {
+                    const float area = GetHalfSurfaceArea(GetBvh2NodeBox(pBvh2Nodes[children[child]]));
+                    if (!BecomesLeaf(children[child]) && area > largestArea)
+                    {
+                        largestArea = area;
+                        childToOpen = child;
+                    }
+                }
+
+                if (childToOpen == numChildren)
+                {
+                    break;
+                }
+
+                const AABBNode &openedNode = pBvh2Nodes[children[childToOpen]];
+                children[childToOpen] = openedNode.internalNode.leftNodeIndex;
+                children[numChildren++] = openedNode.rightNodeIndex;
+            }
+
+            QuantizedBVHNode<Width> &node = pNodes[nodeIndex];
+            AABB childBoxes[Width];
+            for (UINT child = 0; child < numChildren; child++)
+            {
+                const AABBNode &childNode = pBvh2Nodes[children[child]];
+                childBoxes[child] = GetBvh2NodeBox(childNode);
+                if (BecomesLeaf(children[child]))
+                {
+                    const Bvh2SubtreeRange &range = ranges[children[child]];
+                    node.childReferences[child] = CreateQuantizedBVHLeafReference(range.firstPrimitive, range.numPrimitives);
+                }
+                else
+                {
+                    node.childReferences[child] = numNodes;
+                    nodesToCollapse.push_back(std::make_pair(children[child], numNodes));
+                    numNodes++;
+                }
+            }
+            for (UINT child = numChildren; child < Width; child++)
+            {
+                node.childReferences[child] = 0;
+            }
+
+            node.numChildren = (BYTE)numChildren;
+            QuantizeChildBoxes(childBoxes, numChildren, node);
+        }
+
+        BVHOffsets offsets;
+        offsets.offsetToBoxes = sizeof(BVHOffsets);
+        offsets.nodeFormat = nodeFormat;
+        offsets.offsetToVertices = offsets.offsetToBoxes + numNodes * sizeof(QuantizedBVHNode<Width>);
+        offsets.offsetToPrimitiveMetaData = offsets.offsetToVertices + primitivesSize;
+        offsets.totalSize = offsets.offsetToPrimitiveMetaData + metadataSize;
+
+        memcpy(pOutput, &offsets, sizeof(offsets));
+        memcpy(pOutput + offsets.offsetToVertices, pBvh2 + bvh2Offsets.offsetToVertices, primitivesSize);
+        memcpy(pOutput + offsets.offsetToPrimitiveMetaData, pBvh2 + bvh2Offsets.offsetToPrimitiveMetaData, metadataSize);
+        return offsets.totalSize;
+    }
+
+    UINT GetCollapsedBvhMaxSize(const BYTE *pBvh2, UINT nodeFormat)
+    {
+        const BVHOffsets &bvh2Offsets = *(const BVHOffsets *)pBvh2;
+        assert(bvh2Offsets.nodeFormat == BVH_NODE_FORMAT_BVH2);
+
+        // Every wide node replaces at least one BVH2 internal node
+        const UINT numBvh2Nodes = (bvh2Offsets.offsetToVertices - bvh2Offsets.offsetToBoxes) / sizeof(AABBNode);
+        const UINT maxNodes = std::max(1u, numBvh2Nodes / 2);
+        return sizeof(BVHOffsets) + maxNodes * GetNodeSize(nodeFormat) + bvh2Offsets.totalSize - bvh2Offsets.offsetToVertices;
+    }
+
+    UINT CollapseBvh2(const BYTE *pBvh2, UINT nodeFormat, BYTE *pOutput)
+    {
+        assert(((const BVHOffsets *)pBvh2)->nodeFormat == BVH_NODE_FORMAT_BVH2);
+        if (GetNodeWidth(nodeFormat) == 4)
+        {
+            return CollapseBvh2<4>(pBvh2, nodeFormat, pOutput);
+        }
+        else
+        {
+            return CollapseBvh2<8>(pBvh2, nodeFormat, pOutput);
+        }
+    }
+
+    CpuWideBvhTraversal::CpuWideBvhTraversal(const BYTE *pBottomLevelAccelerationStructure)
+    {
+        const BVHOffsets &offsets = *(const BVHOffsets *)pBottomLevelAccelerationStructure;
+        m_nodeFormat = offsets.nodeFormat;
+        GetNodeWidth(m_nodeFormat);
+
+        m_pNodes = pBottomLevelAccelerationStructure + offsets.offsetToBoxes;
+        m_pPrimitives = (const Primitive *)(pBottomLevelAccelerationStructure + offsets.offsetToVertices);
+        m_pPrimitiveMetaData = (const PrimitiveMetaData *)(pBottomLevelAccelerationStructure + offsets.offsetToPrimitiveMetaData);
+    }
+
+    template<typename Simd, UINT NodeWidth>
+    void CpuWideBvhTraversal::TraceNodes(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query) const
+    {
+        typedef typename Simd::Float Float;
+        const QuantizedBVHNode<NodeWidth> *pNodes = (const QuantizedBVHNode<NodeWidth> *)m_pNodes;
+
+        PacketTraversalState<Simd> state(rays, query);
+        if (!state.GetActiveMask())
+        {
+            return;
+        }
+
+        TraversalStack stack;
+        stack.Push(0);
+        while (!stack.Empty() && state.GetActiveMask())
+        {
+            const UINT reference = stack.Pop();
+            if (IsQuantizedBVHLeaf(reference))
+            {
+                state.IntersectPrimitives(m_pPrimitives, GetQuantizedBVHLeafFirstPrimitive(reference), GetQuantizedBVHLeafPrimitiveCount(reference));
+                continue;
+            }
+
+            const QuantizedBVHNode<NodeWidth> &node = pNodes[reference];
+            float scale[3];
+            for (UINT axis = 0; axis < 3; axis++)
+            {
+                scale[axis] = GetQuantizationScale(node.scaleExponent[axis]);
+            }
+
+            // Children that any lane hits, keyed by the nearest entry distance
+            UINT hitReferences[NodeWidth];
+            float hitDistances[NodeWidth];
+            UINT numHits = 0;
+            for (UINT child = 0; child < node.numChildren; child++)
+            {
+                float boxMin[3], boxMax[3];
+                for (UINT axis = 0; axis < 3; axis++)
+                {
+                    boxMin[axis] = DequantizeBound(node.origin[axis], scale[axis], node.childMin[axis][child]);
+                    boxMax[axis] = DequantizeBound(node.origin[axis], scale[axis], node.childMax[axis][child]);
+                }
+
+                Float tNear;
+                const UINT childMask = state.IntersectBox(boxMin, boxMax, tNear);
+                if (!childMask)
+                {
+                    continue;
+                }
+
+                alignas(32) float laneDistances[Simd::Width];
+                Simd::Store(laneDistances, tNear);
+                float distance = FLT_MAX;
+                for (UINT lane = 0; lane < Simd::Width; lane++)
+                {
+                    if (childMask & (1u << lane))
+                    {
+                        distance = std::min(distance, laneDistances[lane]);
+                    }
+                }
+
+                // Insertion sort, furthest first so the nearest child is popped next
+                UINT insertAt = numHits;
+                while (insertAt > 0 && hitDistances[insertAt - 1] < distance)
+                {
+                    hitDistances[insertAt] = hitDistances[insertAt - 1];
+                    hitReferences[insertAt] = hitReferences[insertAt - 1];
+                    insertAt--;
+                }
+                hitDistances[insertAt] = distance;
+                hitReferences[insertAt] = node.childReferences[child];
+                numHits++;
+            }
+
+            for (UINT hit = 0; hit < numHits; hit++)
+            {
+                stack.Push(hitReferences[hit]);
+            }
+        }
+
+        state.WriteHits(hits);
+    }
+
+    template<typename Simd>
+    void CpuWideBvhTraversal::Trace(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query) const
+    {
+        if (m_nodeFormat == BVH_NODE_FORMAT_QUANTIZED_BVH4)
+        {
+            TraceNodes<Simd, 4>(rays, hits, query);
+        }
+        else
+        {
+            TraceNodes<Simd, 8>(rays, hits, query);
+        }
+    }
+
+    void CpuWideBvhTraversal::Trace4(const RayPacket4 &rays, HitPacket4 &hits, CpuTraversalQuery query) const
+    {
+        Trace<Sse>(rays, hits, query);
+    }
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+    void CpuWideBvhTraversal::Trace8(const RayPacket8 &rays, HitPacket8 &hits, CpuTraversalQuery query) const
+    {
+        Trace<Avx>(rays, hits, query);
+    }
+#endif
+}
@@ -0,0 +1,110 @@
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+#pragma once
+
+namespace FallbackLayer
+{
+    //
+    // BVH4/BVH8 node collapsed from a BVH2. Child boxes are stored relative to
+    // the node with 8 bits per plane and a power of two step per axis, rounded
+    // outwards so a child's decoded box always contains its real box. Leaves
+    // are folded into the child references of their parent rather than
+    // getting nodes of their own.
+    //
+    template<UINT Width>
+    struct QuantizedBVHNode
+    {
+        float origin[3];
+        INT8 scaleExponent[3];
+        BYTE numChildren;
+
+        BYTE childMin[3][Width];
+        BYTE childMax[3][Width];
+
+        // Node index of internal children, see CreateQuantizedBVHLeafReference for leaves
+        UINT childReferences[Width];
+    };
+    typedef QuantizedBVHNode<4> QuantizedBVH4Node;
+    typedef QuantizedBVHNode<8> QuantizedBVH8Node;
+    static_assert(sizeof(QuantizedBVH4Node) == 56, L"Incorrect sizeof for QuantizedBVH4Node");
+    static_assert(sizeof(QuantizedBVH8Node) == 96, L"Incorrect sizeof for QuantizedBVH8Node");
+
+    static const UINT QuantizedBVHLeafFlag = 0x80000000;
+
+    // Same limits as the leaf bitfields in AABBNode
+    inline UINT CreateQuantizedBVHLeafReference(UINT firstPrimitive, UINT numPrimitives)
+    {
+        assert(firstPrimitive < (1 << 24) && numPrimitives < (1 << 7));
+        return QuantizedBVHLeafFlag | numPrimitives << 24 | firstPrimitive;
+    }
+
+    inline bool IsQuantizedBVHLeaf(UINT childReference) { return (childReference & QuantizedBVHLeafFlag) != 0; }
+    inline UINT GetQuantizedBVHLeafFirstPrimitive(UINT childReference) { return childReference & 0x00ffffff; }
+    inline UINT GetQuantizedBVHLeafPrimitiveCount(UINT childReference) { return (childReference >> 24) & 0x7f; }
+
+    // 2^exponent, built directly so it's exact for every exponent the encoder writes
+    inline float GetQuantizationScale(INT8 exponent)
+    {
+        const UINT bits = (UINT)(exponent + 127) << 23;
+        float scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        return scale;
+    }
+
+    // q * scale is exact, so this rounds the same with or without FMA contraction
+    inline float DequantizeBound(float origin, float scale, BYTE q)
+    {
+        return origin + (float)q * scale;
+    }
+
+    // Size needed to collapse the given BVH2 into nodeFormat (BVH_NODE_FORMAT_QUANTIZED_*)
+    UINT GetCollapsedBvhMaxSize(const BYTE *pBvh2, UINT nodeFormat);
+
+    //
+    // Post-build pass that collapses a bottom-level BVH2, from either builder,
+    // into BVH4 or BVH8 nodes. Primitives and primitive metadata are copied
+    // unchanged so primitive ids match the source BVH2. Returns the number of
+    // bytes written, which is also recorded in BVHOffsets::totalSize.
+    //
+    UINT CollapseBvh2(const BYTE *pBvh2, UINT nodeFormat, BYTE *pOutput);
+
+    //
+    // CpuBvh2Traversal for the collapsed formats: same packets, same results,
+    // fewer and smaller node fetches.
+    //
+    class CpuWideBvhTraversal
+    {
+    public:
+        CpuWideBvhTraversal(const BYTE *pBottomLevelAccelerationStructure);
+
+        void Trace4(const RayPacket4 &rays, HitPacket4 &hits, CpuTraversalQuery query) const;
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+        // Callers must check CpuBvh2Traversal::IsAvxSupported() before using 8-wide packets
+        void Trace8(const RayPacket8 &rays, HitPacket8 &hits, CpuTraversalQuery query) const;
+#endif
+
+        const PrimitiveMetaData &GetPrimitiveMetaData(UINT primitiveId) const { return m_pPrimitiveMetaData[primitiveId]; }
+        const Primitive &GetPrimitive(UINT primitiveId) const { return m_pPrimitives[primitiveId]; }
+
+    private:
+        template<typename Simd, UINT NodeWidth>
+        void TraceNodes(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query) const;
+
+        template<typename Simd>
+        void Trace(const RayPacket<Simd::Width> &rays, HitPacket<Simd::Width> &hits, CpuTraversalQuery query) const;
+
+        UINT m_nodeFormat;
+        const BYTE *m_pNodes;
+        const Primitive *m_pPrimitives;
+        const PrimitiveMetaData *m_pPrimitiveMetaData;
+    };
+}
@@ -605,6 +605,111 @@ namespace FallbackLayerUnitTests
         0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17
     };
 
+    // Appends a quadsPerSide x quadsPerSide grid of triangle pairs in the XZ plane,
+    // jittered in Y so that the SAH has something to work with
+    void GenerateGridGeometry(
+        UINT quadsPerSide,
+        float offsetX,
+        std::vector<float> &vertices,
+        std::vector<UINT16> &indices)
+    {
+        const UINT verticesPerSide = quadsPerSide + 1;
+        assert(verticesPerSide * verticesPerSide <= USHRT_MAX + 1);
+
+        for (UINT z = 0; z < verticesPerSide; z++)
+        {
+            for (UINT x = 0; x < verticesPerSide; x++)
+            {
+                vertices.push_back(offsetX + x);
+                vertices.push_back((rand() / (float)RAND_MAX) * 2.0f);
+                vertices.push_back((float)z);
+            }
+        }
+
+        for (UINT z = 0; z < quadsPerSide; z++)
+        {
+            for (UINT x = 0; x < quadsPerSide; x++)
+            {
+                const UINT16 i0 = (UINT16)(z * verticesPerSide + x);
+                const UINT16 i1 = (UINT16)(i0 + 1);
+                const UINT16 i2 = (UINT16)(i0 + verticesPerSide);
+                const UINT16 i3 = (UINT16)(i2 + 1);
+
+                indices.insert(indices.end(), { i0, i2, i1 });
+                indices.insert(indices.end(), { i1, i2, i3 });
+            }
+        }
+    }
+
+    // Scalar ray/triangle test that CpuBvh2Traversal results are checked against
+    bool IntersectTriangleReference(
+        const float3 &origin,
+        const float3 &direction,
+        const Triangle &triangle,
+        float tMin,
+        float tMax,
+        float &t)
+    {
+        const float3 e1 = triangle.v1 - triangle.v0;
+        const float3 e2 = triangle.v2 - triangle.v0;
+        const float3 p = float3{
+            direction.y * e2.z - direction.z * e2.y,
+            direction.z * e2.x - direction.x * e2.z,
+            direction.x * e2.y - direction.y * e2.x };
+        const float det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+        if (det == 0.0f)
+        {
+            return false;
+        }
+
+        const float inverseDet = 1.0f / det;
+        const float3 s = origin - triangle.v0;
+        const float u = (s.x * p.x + s.y * p.y + s.z * p.z) * inverseDet;
+        const float3 q = float3{
+            s.y * e1.z - s.z * e1.y,
+            s.z * e1.x - s.x * e1.z,
+            s.x * e1.y - s.y * e1.x };
+        const float v = (direction.x * q.x + direction.y * q.y + direction.z * q.z) * inverseDet;
+        t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) * inverseDet;
+        return u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > tMin && t < tMax;
+    }
+
+    float RandomFloat(float min, float max)
+    {
+        return min + (rand() / (float)RAND_MAX) * (max - min);
+    }
+
+    //
+    // Appends long, thin triangles running diagonally across the XZ extent of the
+    // scene, like the beams and trims of architectural models. Their boxes overlap
+    // most of the scene, which is the case spatial splits exist for.
+    //
+    void GenerateSliverGeometry(
+        UINT numSlivers,
+        float sceneWidth,
+        float sceneDepth,
+        std::vector<float> &vertices,
+        std::vector<UINT16> &indices)
+    {
+        const UINT firstVertex = (UINT)(vertices.size() / 3);
+        assert(firstVertex + numSlivers * 3 <= USHRT_MAX + 1);
+
+        for (UINT i = 0; i < numSlivers; i++)
+        {
+            const float startX = RandomFloat(0.0f, sceneWidth);
+            const float startZ = RandomFloat(0.0f, sceneDepth);
+            const float endX = RandomFloat(0.0f, sceneWidth);
+            const float endZ = RandomFloat(0.0f, sceneDepth);
+            const float height = RandomFloat(2.0f, 4.0f);
+            vertices.insert(vertices.end(), { startX, height, startZ });
+            vertices.insert(vertices.end(), { endX, height, endZ });
+            vertices.insert(vertices.end(), { endX, height + 0.1f, endZ + 0.1f });
+
+            const UINT16 i0 = (UINT16)(firstVertex + i * 3);
+            indices.insert(indices.end(), { i0, (UINT16)(i0 + 1), (UINT16)(i0 + 2) });
+        }
+    }
+
     TEST_CLASS(AccelerationStructureUnitTests)
     {
     public:
@@ -630,6 +735,227 @@ namespace FallbackLayerUnitTests
             }
         }
 
+        TEST_METHOD(R32IndexBufferBottomLevelCpuBVHBuilder)
+        {
+            CpuGeometryDescriptor testCases[] =
+            {
+                CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0), ReferenceR32Indices0, ARRAYSIZE(ReferenceR32Indices0)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1), ReferenceR32Indices1, ARRAYSIZE(ReferenceR32Indices1))
+            };
+
+            for (UINT testIndex = 0; testIndex < ARRAYSIZE(testCases); testIndex++)
+            {
+                TestCpuBvh2Builder(testCases[testIndex]);
+            }
+        }
+
+        TEST_METHOD(NoIndexBufferBottomLevelCpuBVHBuilder)
+        {
+            CpuGeometryDescriptor testCases[] =
+            {
+                CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1))
+            };
+
+            for (UINT testIndex = 0; testIndex < ARRAYSIZE(testCases); testIndex++)
+            {
+                TestCpuBvh2Builder(testCases[testIndex]);
+            }
+        }
+
+        TEST_METHOD(BottomLevelCpuBVHBuilderWithTransforms)
+        {
+            const UINT numGeoms = 10;
+            float pMatrixStorage[numGeoms * 12];
+            std::vector<CpuGeometryDescriptor> testCases;
+            srand(10);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                float *pMatrix = pMatrixStorage + FloatsPerMatrix * i;
+                GenerateRandomTranformation(pMatrix);
+                testCases.push_back(
+                    CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0), ReferenceIndices0, ARRAYSIZE(ReferenceIndices0), DXGI_FORMAT_R16_UINT, pMatrix));
+            }
+            TestCpuBvh2Builder(testCases.data(), numGeoms);
+        }
+
+        TEST_METHOD(MultipleGeometrySingleBottomLevelCpuBVHBuilder_ArrayOfPointersLayout)
+        {
+            CpuGeometryDescriptor testCases[] =
+            {
+                CpuGeometryDescriptor(ReferenceVerticies0, VERTEX_COUNT(ReferenceVerticies0), ReferenceR32Indices0, ARRAYSIZE(ReferenceR32Indices0)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1), ReferenceIndices1, ARRAYSIZE(ReferenceIndices1)),
+                CpuGeometryDescriptor(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1))
+            };
+
+            TestCpuBvh2Builder(testCases, ARRAYSIZE(testCases), D3D12_ELEMENTS_LAYOUT_ARRAY_OF_POINTERS);
+        }
+
+        TEST_METHOD(HalfFloatStridedVertexBufferBottomLevelCpuBVHBuilder)
+        {
+            // Half precision positions padded out to 16 bytes, validated against
+            // the same positions widened back to floats
+            const UINT vertexCount = VERTEX_COUNT(ReferenceVerticies1);
+            const UINT halvesPerVertex = 8;
+            std::vector<DirectX::PackedVector::HALF> halfVertices(vertexCount * halvesPerVertex);
+            std::vector<float> roundedVertices(vertexCount * 3);
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    halfVertices[i * halvesPerVertex + k] = DirectX::PackedVector::XMConvertFloatToHalf(ReferenceVerticies1[i * 3 + k]);
+                    roundedVertices[i * 3 + k] = DirectX::PackedVector::XMConvertHalfToFloat(halfVertices[i * halvesPerVertex + k]);
+                }
+            }
+
+            CpuGeometryDescriptor testCase(roundedVertices.data(), vertexCount, ReferenceIndices1, ARRAYSIZE(ReferenceIndices1));
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(&testCase, 1, geomDescs);
+            geomDescs[0].Triangles.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)halfVertices.data();
+            geomDescs[0].Triangles.VertexBuffer.StrideInBytes = halvesPerVertex * sizeof(DirectX::PackedVector::HALF);
+            geomDescs[0].Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+            BuildAndVerifyCpuBvh2(geomDescs, &testCase, 1);
+        }
+
+        TEST_METHOD(ProceduralAABBsBottomLevelCpuBVHBuilder)
+        {
+            // AABBs with application data between them, next to a triangle geometry
+            struct ProceduralPrimitive
+            {
+                D3D12_RAYTRACING_AABB aabb;
+                UINT materialIndex;
+                UINT padding;
+            };
+
+            const UINT numAABBs = 256;
+            const float sceneSize = 16.0f;
+            std::vector<ProceduralPrimitive> proceduralPrimitives(numAABBs);
+            srand(10);
+            for (UINT i = 0; i < numAABBs; i++)
+            {
+                const float x = RandomFloat(0.0f, sceneSize);
+                const float y = RandomFloat(0.0f, 2.0f);
+                const float z = RandomFloat(0.0f, sceneSize);
+                const float size = RandomFloat(0.1f, 1.0f);
+                proceduralPrimitives[i].aabb = { x, y, z, x + size, y + size, z + size };
+                proceduralPrimitives[i].materialIndex = i;
+            }
+
+            CpuGeometryDescriptor triangleGeometry(ReferenceVerticies1, VERTEX_COUNT(ReferenceVerticies1), ReferenceR32Indices1, ARRAYSIZE(ReferenceR32Indices1));
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(&triangleGeometry, 1, geomDescs);
+
+            D3D12_RAYTRACING_GEOMETRY_DESC aabbGeometry = {};
+            aabbGeometry.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_PROCEDURAL_PRIMITIVE_AABBS;
+            aabbGeometry.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+            aabbGeometry.AABBs.AABBCount = numAABBs;
+            aabbGeometry.AABBs.AABBs.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)proceduralPrimitives.data();
+            aabbGeometry.AABBs.AABBs.StrideInBytes = sizeof(ProceduralPrimitive);
+            geomDescs.push_back(aabbGeometry);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = (UINT)geomDescs.size();
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+
+            std::unique_ptr<BYTE[]> pData(new BYTE[GetRaytracingAccelerationStructureOnCpuMaxSize(&desc)]);
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+
+            // Every AABB comes through once, unchanged, with its index within the geometry
+            const BVHOffsets &offsets = *(const BVHOffsets *)pData.get();
+            const UINT numPrimitives = (offsets.offsetToPrimitiveMetaData - offsets.offsetToVertices) / sizeof(Primitive);
+            Assert::AreEqual(numAABBs + ARRAYSIZE(ReferenceR32Indices1) / 3, numPrimitives, L"Unexpected primitive count");
+
+            CpuBvh2Traversal traversal(pData.get());
+            std::vector<bool> bFoundAABB(numAABBs);
+            for (UINT primitiveId = 0; primitiveId < numPrimitives; primitiveId++)
+            {
+                const Primitive &primitive = traversal.GetPrimitive(primitiveId);
+                const PrimitiveMetaData &metadata = traversal.GetPrimitiveMetaData(primitiveId);
+                if (metadata.GeometryContributionToHitGroupIndex == 0)
+                {
+                    Assert::AreEqual((UINT)TRIANGLE_TYPE, primitive.PrimitiveType, L"Triangle geometry produced a non-triangle primitive");
+                    continue;
+                }
+
+                Assert::AreEqual((UINT)PROCEDURAL_PRIMITIVE_TYPE, primitive.PrimitiveType, L"AABB geometry produced a non-procedural primitive");
+                Assert::AreEqual((UINT)D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE, metadata.GeometryFlags, L"Geometry flags were not carried through");
+                Assert::IsTrue(metadata.PrimitiveIndex < numAABBs && !bFoundAABB[metadata.PrimitiveIndex], L"AABB primitive index is out of range or repeated");
+                bFoundAABB[metadata.PrimitiveIndex] = true;
+
+                const D3D12_RAYTRACING_AABB &aabb = proceduralPrimitives[metadata.PrimitiveIndex].aabb;
+                const float expected[6] = { aabb.MinX, aabb.MinY, aabb.MinZ, aabb.MaxX, aabb.MaxY, aabb.MaxZ };
+                const float actual[6] = { primitive.aabb.min.x, primitive.aabb.min.y, primitive.aabb.min.z, primitive.aabb.max.x, primitive.aabb.max.y, primitive.aabb.max.z };
+                Assert::IsTrue(memcmp(expected, actual, sizeof(expected)) == 0, L"AABB was not copied unchanged");
+            }
+
+            // Closest hits against the boxes agree with a brute force slab test
+            for (UINT packetIndex = 0; packetIndex < 256; packetIndex++)
+            {
+                RayPacket4 rays;
+                rays.ActiveMask = 0xf;
+                for (UINT lane = 0; lane < 4; lane++)
+                {
+                    rays.OriginX[lane] = RandomFloat(-1.0f, sceneSize + 1.0f);
+                    rays.OriginY[lane] = RandomFloat(-1.0f, 4.0f);
+                    rays.OriginZ[lane] = RandomFloat(-1.0f, sceneSize + 1.0f);
+                    rays.DirectionX[lane] = RandomFloat(-1.0f, 1.0f);
+                    rays.DirectionY[lane] = RandomFloat(-1.0f, 1.0f);
+                    rays.DirectionZ[lane] = RandomFloat(-1.0f, 1.0f);
+                    rays.TMin[lane] = 0.0f;
+                    rays.TMax[lane] = 1000.0f;
+                }
+
+                HitPacket4 hits;
+                traversal.Trace4(rays, hits, CpuTraversalQuery::ClosestHit);
+                for (UINT lane = 0; lane < 4; lane++)
+                {
+                    const float origin[3] = { rays.OriginX[lane], rays.OriginY[lane], rays.OriginZ[lane] };
+                    const float direction[3] = { rays.DirectionX[lane], rays.DirectionY[lane], rays.DirectionZ[lane] };
+
+                    float closestT = rays.TMax[lane];
+                    for (UINT primitiveId = 0; primitiveId < numPrimitives; primitiveId++)
+                    {
+                        const Primitive &primitive = traversal.GetPrimitive(primitiveId);
+                        float t;
+                        if (primitive.PrimitiveType == TRIANGLE_TYPE)
+                        {
+                            const float3 rayOrigin = float3{ origin[0], origin[1], origin[2] };
+                            const float3 rayDirection = float3{ direction[0], direction[1], direction[2] };
+                            if (IntersectTriangleReference(rayOrigin, rayDirection, primitive.triangle, rays.TMin[lane], closestT, t))
+                            {
+                                closestT = t;
+                            }
+                            continue;
+                        }
+
+                        float tNear = rays.TMin[lane];
+                        float tFar = closestT;
+                        for (UINT axis = 0; axis < 3; axis++)
+                        {
+                            const float t0 = (primitive.aabb.minArr[axis] - origin[axis]) / direction[axis];
+                            const float t1 = (primitive.aabb.maxArr[axis] - origin[axis]) / direction[axis];
+                            tNear = std::max(tNear, std::min(t0, t1));
+                            tFar = std::min(tFar, std::max(t0, t1));
+                        }
+                        if (tNear <= tFar)
+                        {
+                            closestT = tNear;
+                        }
+                    }
+
+                    const bool bExpectedHit = closestT < rays.TMax[lane];
+                    Assert::AreEqual(bExpectedHit, hits.PrimitiveId[lane] != CpuBvh2Traversal::NoHit, L"Hit/miss does not match brute force traversal");
+                    if (bExpectedHit)
+                    {
+                        Assert::AreEqual(closestT, hits.T[lane], 1e-4f, L"Closest hit distance does not match brute force traversal");
+                    }
+                }
+            }
+        }
+
         TEST_METHOD(R16IndexBufferBottomLevelGpuBVHBuilder)
         {
             CpuGeometryDescriptor testCases[] =
@@ -777,6 +1103,568 @@ namespace FallbackLayerUnitTests
                 testCase);
         }
 
+        TEST_METHOD(ParallelStressBottomLevelCpuBVHBuilder)
+        {
+            // Large enough for the CPU builder to hand subtrees out to worker threads
+            const UINT numGeoms = 4;
+            std::vector<float> vertices[numGeoms];
+            std::vector<UINT16> indices[numGeoms];
+            std::vector<CpuGeometryDescriptor> testCases;
+            srand(10);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                GenerateGridGeometry(48, 50.0f * i, vertices[i], indices[i]);
+                testCases.push_back(CpuGeometryDescriptor(
+                    vertices[i].data(),
+                    (UINT)(vertices[i].size() / 3),
+                    indices[i].data(),
+                    (UINT)indices[i].size()));
+            }
+
+            TestCpuBvh2Builder(testCases.data(), numGeoms);
+        }
+
+        TEST_METHOD(BenchmarkBottomLevelCpuBVHBuilder)
+        {
+            // ~2M triangles split across R16 geometries
+            const UINT numGeoms = 64;
+            const UINT quadsPerSide = 127;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::vector<CpuGeometryDescriptor> cpuGeomDescs;
+            srand(10);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                GenerateGridGeometry(quadsPerSide, (float)(quadsPerSide * i), vertices[i], indices[i]);
+                cpuGeomDescs.push_back(CpuGeometryDescriptor(
+                    vertices[i].data(),
+                    (UINT)(vertices[i].size() / 3),
+                    indices[i].data(),
+                    (UINT)indices[i].size()));
+            }
+
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(cpuGeomDescs.data(), numGeoms, geomDescs);
+
+            const UINT numTriangles = numGeoms * quadsPerSide * quadsPerSide * 2;
+            std::unique_ptr<BYTE[]> pData(new BYTE[GetCpuBvh2MaxSize(numTriangles)]);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+
+            const UINT numIterations = 5;
+            double totalMilliseconds = 0.0;
+            for (UINT i = 0; i < numIterations; i++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+                auto end = std::chrono::high_resolution_clock::now();
+                totalMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+
+            wchar_t message[256];
+            swprintf_s(message, L"CPU BVH2 build: %u triangles, %.2f ms average over %u builds\n",
+                numTriangles, totalMilliseconds / numIterations, numIterations);
+            Logger::WriteMessage(message);
+        }
+
+        TEST_METHOD(SpatialSplitCpuBVHBuilderReducesSahCost)
+        {
+            const UINT numGeoms = 4;
+            const UINT quadsPerSide = 48;
+            const UINT numSlivers = 512;
+            const float sceneWidth = (float)(numGeoms * quadsPerSide);
+            const float sceneDepth = (float)quadsPerSide;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::vector<CpuGeometryDescriptor> cpuGeomDescs;
+            srand(10);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                GenerateGridGeometry(quadsPerSide, (float)(quadsPerSide * i), vertices[i], indices[i]);
+                GenerateSliverGeometry(numSlivers, sceneWidth, sceneDepth, vertices[i], indices[i]);
+                cpuGeomDescs.push_back(CpuGeometryDescriptor(
+                    vertices[i].data(),
+                    (UINT)(vertices[i].size() / 3),
+                    indices[i].data(),
+                    (UINT)indices[i].size()));
+            }
+
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(cpuGeomDescs.data(), numGeoms, geomDescs);
+            const UINT numTriangles = numGeoms * (quadsPerSide * quadsPerSide * 2 + numSlivers);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+
+            // Object splits only, then object and spatial splits
+            const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags[] =
+            {
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD,
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE
+            };
+            const wchar_t *buildNames[] = { L"PREFER_FAST_BUILD", L"PREFER_FAST_TRACE" };
+
+            std::unique_ptr<BYTE[]> pData[2];
+            CpuBvh2Statistics statistics[2];
+            double buildMilliseconds[2];
+            for (UINT i = 0; i < 2; i++)
+            {
+                desc.Flags = buildFlags[i];
+                const UINT maxSize = GetRaytracingAccelerationStructureOnCpuMaxSize(&desc);
+                pData[i].reset(new BYTE[maxSize]);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                BuildRaytracingAccelerationStructureOnCpu(&desc, pData[i].get());
+                auto end = std::chrono::high_resolution_clock::now();
+                buildMilliseconds[i] = std::chrono::duration<double, std::milli>(end - start).count();
+
+                Assert::IsTrue(((BVHOffsets *)pData[i].get())->totalSize <= maxSize, L"CPU BVH overran its maximum size");
+                ComputeCpuBvh2Statistics(pData[i].get(), statistics[i]);
+            }
+
+            const UINT maxReferences = numTriangles + (UINT)(numTriangles * DefaultCpuSpatialSplitSettings.ReferenceBudget);
+            Assert::AreEqual(numTriangles, statistics[0].NumPrimitiveReferences, L"Object split build duplicated primitives");
+            Assert::IsTrue(statistics[1].NumPrimitiveReferences >= numTriangles, L"Spatial split build lost primitives");
+            Assert::IsTrue(statistics[1].NumPrimitiveReferences <= maxReferences, L"Spatial split build exceeded its reference budget");
+            Assert::IsTrue(statistics[1].SahCost <= statistics[0].SahCost, L"Spatial splits increased the SAH cost");
+
+            std::vector<RayPacket4> primaryRays, secondaryRays;
+            GenerateBenchmarkRays(sceneWidth, sceneDepth, primaryRays, secondaryRays);
+            primaryRays.resize(16 * 1024);
+            secondaryRays.resize(16 * 1024);
+
+            CpuBvh2Traversal objectSplitTraversal(pData[0].get());
+            CpuBvh2Traversal spatialSplitTraversal(pData[1].get());
+            CpuTraversalStatistics traversalStatistics[2] = {};
+            for (auto *pPackets : { &primaryRays, &secondaryRays })
+            {
+                for (const RayPacket4 &rays : *pPackets)
+                {
+                    HitPacket4 objectSplitHits, spatialSplitHits;
+                    objectSplitTraversal.Trace4(rays, objectSplitHits, CpuTraversalQuery::ClosestHit, &traversalStatistics[0]);
+                    spatialSplitTraversal.Trace4(rays, spatialSplitHits, CpuTraversalQuery::ClosestHit, &traversalStatistics[1]);
+                    for (UINT lane = 0; lane < 4; lane++)
+                    {
+                        const bool bObjectSplitHit = objectSplitHits.PrimitiveId[lane] != CpuBvh2Traversal::NoHit;
+                        const bool bSpatialSplitHit = spatialSplitHits.PrimitiveId[lane] != CpuBvh2Traversal::NoHit;
+                        Assert::AreEqual(bObjectSplitHit, bSpatialSplitHit, L"Spatial split BVH disagrees on whether a ray hits");
+                        if (bObjectSplitHit)
+                        {
+                            Assert::AreEqual(objectSplitHits.T[lane], spatialSplitHits.T[lane], 1e-4f, L"Spatial split BVH hit distance does not match");
+                        }
+                    }
+                }
+            }
+
+            const double numPackets = (double)(primaryRays.size() + secondaryRays.size());
+            for (UINT i = 0; i < 2; i++)
+            {
+                wchar_t message[256];
+                swprintf_s(message, L"%s: built in %.2f ms, SAH cost %.2f, %u nodes, %u references, depth %u, %.2f nodes and %.2f primitives per packet\n",
+                    buildNames[i],
+                    buildMilliseconds[i],
+                    statistics[i].SahCost,
+                    statistics[i].NumNodes,
+                    statistics[i].NumPrimitiveReferences,
+                    statistics[i].MaxDepth,
+                    traversalStatistics[i].NodesVisited / numPackets,
+                    traversalStatistics[i].PrimitivesTested / numPackets);
+                Logger::WriteMessage(message);
+            }
+        }
+
+        TEST_METHOD(RefitBottomLevelCpuBVHMatchesRebuild)
+        {
+            const UINT numGeoms = 4;
+            const UINT quadsPerSide = 48;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            std::unique_ptr<BYTE[]> pRefit;
+            srand(10);
+            BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pRefit, &geomDescs);
+            CpuBvh2Statistics buildStatistics;
+            ComputeCpuBvh2Statistics(pRefit.get(), buildStatistics);
+
+            AnimateGridGeometry(vertices);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+            desc.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+
+            const UINT size = ((BVHOffsets *)pRefit.get())->totalSize;
+            std::unique_ptr<BYTE[]> pRebuild(new BYTE[GetRaytracingAccelerationStructureOnCpuMaxSize(&desc)]);
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pRebuild.get());
+
+            desc.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+            const float refitSahCost = RefitRaytracingAccelerationStructureOnCpu(&desc, pRefit.get());
+            Assert::AreEqual(size, ((BVHOffsets *)pRefit.get())->totalSize, L"Refit changed the size of the acceleration structure");
+
+            CpuBvh2Statistics refitStatistics;
+            ComputeCpuBvh2Statistics(pRefit.get(), refitStatistics);
+            Assert::AreEqual(refitStatistics.SahCost, refitSahCost, refitSahCost * 1e-3f, L"Refit SAH cost does not match the refit tree");
+            Assert::AreEqual(buildStatistics.NumNodes, refitStatistics.NumNodes, L"Refit changed the topology");
+
+            // Every node must still bound its children and its primitives
+            const BVHOffsets &offsets = *(BVHOffsets *)pRefit.get();
+            const AABBNode *pNodes = (AABBNode *)(pRefit.get() + offsets.offsetToBoxes);
+            const Primitive *pPrimitives = (Primitive *)(pRefit.get() + offsets.offsetToVertices);
+            auto IsInsideNode = [](const AABBNode &node, const float3 &point)
+            {
+                const float tolerance = 1e-4f;
+                return fabs(point.x - node.center[0]) <= node.halfDim[0] + tolerance &&
+                    fabs(point.y - node.center[1]) <= node.halfDim[1] + tolerance &&
+                    fabs(point.z - node.center[2]) <= node.halfDim[2] + tolerance;
+            };
+            for (UINT i = 0; i < refitStatistics.NumNodes; i++)
+            {
+                const AABBNode &node = pNodes[i];
+                if (node.leaf)
+                {
+                    for (UINT j = 0; j < node.numTriangles; j++)
+                    {
+                        const Triangle &triangle = pPrimitives[node.leafNode.firstTriangleId + j].triangle;
+                        Assert::IsTrue(IsInsideNode(node, triangle.v0) && IsInsideNode(node, triangle.v1) && IsInsideNode(node, triangle.v2),
+                            L"Refit leaf does not contain its triangles");
+                    }
+                }
+                else
+                {
+                    for (UINT childIndex : { (UINT)node.internalNode.leftNodeIndex, (UINT)node.rightNodeIndex })
+                    {
+                        const AABBNode &child = pNodes[childIndex];
+                        const float3 childMin = { child.center[0] - child.halfDim[0], child.center[1] - child.halfDim[1], child.center[2] - child.halfDim[2] };
+                        const float3 childMax = { child.center[0] + child.halfDim[0], child.center[1] + child.halfDim[1], child.center[2] + child.halfDim[2] };
+                        Assert::IsTrue(IsInsideNode(node, childMin) && IsInsideNode(node, childMax), L"Refit node does not contain its children");
+                    }
+                }
+            }
+
+            std::vector<RayPacket4> primaryRays, secondaryRays;
+            GenerateBenchmarkRays((float)(numGeoms * quadsPerSide), (float)quadsPerSide, primaryRays, secondaryRays);
+            primaryRays.resize(4096);
+            secondaryRays.resize(4096);
+
+            CpuBvh2Traversal refitTraversal(pRefit.get());
+            CpuBvh2Traversal rebuildTraversal(pRebuild.get());
+            for (auto *pPackets : { &primaryRays, &secondaryRays })
+            {
+                for (const RayPacket4 &rays : *pPackets)
+                {
+                    HitPacket4 refitHits, rebuildHits;
+                    refitTraversal.Trace4(rays, refitHits, CpuTraversalQuery::ClosestHit);
+                    rebuildTraversal.Trace4(rays, rebuildHits, CpuTraversalQuery::ClosestHit);
+                    for (UINT lane = 0; lane < 4; lane++)
+                    {
+                        const bool bRefitHit = refitHits.PrimitiveId[lane] != CpuBvh2Traversal::NoHit;
+                        Assert::AreEqual(bRefitHit, rebuildHits.PrimitiveId[lane] != CpuBvh2Traversal::NoHit, L"Refit BVH disagrees with a rebuild on whether a ray hits");
+                        if (bRefitHit)
+                        {
+                            Assert::AreEqual(rebuildHits.T[lane], refitHits.T[lane], 1e-4f, L"Refit BVH hit distance does not match a rebuild");
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(BenchmarkCpuBVHRefit)
+        {
+            // ~500K triangles
+            const UINT numGeoms = 16;
+            const UINT quadsPerSide = 127;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            std::unique_ptr<BYTE[]> pData;
+            srand(10);
+            const UINT numTriangles = BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pData, &geomDescs);
+            CpuBvh2Statistics buildStatistics;
+            ComputeCpuBvh2Statistics(pData.get(), buildStatistics);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+            desc.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE |
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+
+            const UINT numIterations = 10;
+            double totalMilliseconds = 0.0;
+            float sahCost = 0.0f;
+            for (UINT i = 0; i < numIterations; i++)
+            {
+                AnimateGridGeometry(vertices);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                sahCost = RefitRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+                auto end = std::chrono::high_resolution_clock::now();
+                totalMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+
+            wchar_t message[256];
+            swprintf_s(message, L"CPU BVH2 refit: %u triangles, %.2f ms average over %u refits, SAH cost %.2f after refitting vs %.2f when built\n",
+                numTriangles, totalMilliseconds / numIterations, numIterations, sahCost, buildStatistics.SahCost);
+            Logger::WriteMessage(message);
+        }
+
+        TEST_METHOD(CpuBvh2TraversalMatchesBruteForce)
+        {
+            const UINT numGeoms = 4;
+            const UINT quadsPerSide = 24;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::unique_ptr<BYTE[]> pData;
+            srand(10);
+            const UINT numTriangles = BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pData);
+            const float sceneWidth = (float)(numGeoms * quadsPerSide);
+
+            CpuBvh2Traversal traversal(pData.get());
+            for (UINT packetIndex = 0; packetIndex < 512; packetIndex++)
+            {
+                // Alternate between rays looking down on the grids and rays in random directions
+                const bool bIncoherent = (packetIndex % 2) == 1;
+                RayPacket4 rays;
+                rays.ActiveMask = 0xf;
+                for (UINT lane = 0; lane < 4; lane++)
+                {
+                    rays.OriginX[lane] = RandomFloat(-1.0f, sceneWidth + 1.0f);
+                    rays.OriginY[lane] = bIncoherent ? RandomFloat(-1.0f, 3.0f) : 5.0f;
+                    rays.OriginZ[lane] = RandomFloat(-1.0f, quadsPerSide + 1.0f);
+                    rays.DirectionX[lane] = bIncoherent ? RandomFloat(-1.0f, 1.0f) : 0.0f;
+                    rays.DirectionY[lane] = bIncoherent ? RandomFloat(-1.0f, 1.0f) : -1.0f;
+                    rays.DirectionZ[lane] = bIncoherent ? RandomFloat(-1.0f, 1.0f) : 0.0f;
+                    rays.TMin[lane] = 0.0f;
+                    rays.TMax[lane] = 1000.0f;
+                }
+
+                HitPacket4 closestHits, anyHits;
+                traversal.Trace4(rays, closestHits, CpuTraversalQuery::ClosestHit);
+                traversal.Trace4(rays, anyHits, CpuTraversalQuery::AnyHit);
+
+                for (UINT lane = 0; lane < 4; lane++)
+                {
+                    const float3 origin = float3{ rays.OriginX[lane], rays.OriginY[lane], rays.OriginZ[lane] };
+                    const float3 direction = float3{ rays.DirectionX[lane], rays.DirectionY[lane], rays.DirectionZ[lane] };
+
+                    float closestT = rays.TMax[lane];
+                    UINT closestPrimitiveId = CpuBvh2Traversal::NoHit;
+                    for (UINT primitiveId = 0; primitiveId < numTriangles; primitiveId++)
+                    {
+                        float t;
+                        if (IntersectTriangleReference(origin, direction, traversal.GetPrimitive(primitiveId).triangle, rays.TMin[lane], closestT, t))
+                        {
+                            closestT = t;
+                            closestPrimitiveId = primitiveId;
+                        }
+                    }
+
+                    Assert::AreEqual(closestPrimitiveId, closestHits.PrimitiveId[lane], L"Closest hit does not match brute force traversal");
+                    if (closestPrimitiveId != CpuBvh2Traversal::NoHit)
+                    {
+                        Assert::AreEqual(closestT, closestHits.T[lane], 1e-4f, L"Closest hit distance does not match brute force traversal");
+                    }
+                    Assert::AreEqual(closestPrimitiveId == CpuBvh2Traversal::NoHit, anyHits.PrimitiveId[lane] == CpuBvh2Traversal::NoHit,
+                        L"Any hit query disagrees with closest hit query on whether the ray hit");
+                }
+
+#if CPU_TRAVERSAL_SUPPORTS_AVX
+                if (CpuBvh2Traversal::IsAvxSupported())
+                {
+                    RayPacket8 widePacket;
+                    widePacket.ActiveMask = 0x0f;
+                    for (UINT lane = 0; lane < 4; lane++)
+                    {
+                        widePacket.OriginX[lane] = rays.OriginX[lane];
+                        widePacket.OriginY[lane] = rays.OriginY[lane];
+                        widePacket.OriginZ[lane] = rays.OriginZ[lane];
+                        widePacket.DirectionX[lane] = rays.DirectionX[lane];
+                        widePacket.DirectionY[lane] = rays.DirectionY[lane];
+                        widePacket.DirectionZ[lane] = rays.DirectionZ[lane];
+                        widePacket.TMin[lane] = rays.TMin[lane];
+                        widePacket.TMax[lane] = rays.TMax[lane];
+                    }
+
+                    HitPacket8 wideHits;
+                    traversal.Trace8(widePacket, wideHits, CpuTraversalQuery::ClosestHit);
+                    for (UINT lane = 0; lane < 4; lane++)
+                    {
+                        Assert::AreEqual(closestHits.PrimitiveId[lane], wideHits.PrimitiveId[lane], L"8-wide traversal does not match 4-wide traversal");
+                    }
+                }
+#endif
+            }
+        }
+
+        TEST_METHOD(BenchmarkCpuBvh2Traversal)
+        {
+            const UINT numGeoms = 64;
+            const UINT quadsPerSide = 127;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::unique_ptr<BYTE[]> pData;
+            srand(10);
+            const UINT numTriangles = BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pData);
+
+            std::vector<RayPacket4> primaryRays, secondaryRays;
+            GenerateBenchmarkRays((float)(numGeoms * quadsPerSide), (float)quadsPerSide, primaryRays, secondaryRays);
+
+            CpuBvh2Traversal traversal(pData.get());
+            wchar_t message[256];
+            swprintf_s(message, L"CPU BVH2 traversal: %u triangles, %.2f MRays/s primary closest hit, %.2f MRays/s secondary any hit\n",
+                numTriangles,
+                MeasureTraversalThroughput(traversal, primaryRays, CpuTraversalQuery::ClosestHit),
+                MeasureTraversalThroughput(traversal, secondaryRays, CpuTraversalQuery::AnyHit));
+            Logger::WriteMessage(message);
+        }
+
+        TEST_METHOD(CollapsedCpuBvhTraversalMatchesBvh2)
+        {
+            const UINT numGeoms = 4;
+            const UINT quadsPerSide = 48;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::unique_ptr<BYTE[]> pBvh2;
+            srand(10);
+            BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pBvh2);
+
+            std::vector<RayPacket4> primaryRays, secondaryRays;
+            GenerateBenchmarkRays((float)(numGeoms * quadsPerSide), (float)quadsPerSide, primaryRays, secondaryRays);
+            primaryRays.resize(4096);
+            secondaryRays.resize(4096);
+
+            CpuBvh2Traversal bvh2Traversal(pBvh2.get());
+            for (UINT nodeFormat : { BVH_NODE_FORMAT_QUANTIZED_BVH4, BVH_NODE_FORMAT_QUANTIZED_BVH8 })
+            {
+                std::unique_ptr<BYTE[]> pCollapsed(new BYTE[GetCollapsedBvhMaxSize(pBvh2.get(), nodeFormat)]);
+                const UINT collapsedSize = CollapseBvh2(pBvh2.get(), nodeFormat, pCollapsed.get());
+                Assert::IsTrue(collapsedSize <= GetCollapsedBvhMaxSize(pBvh2.get(), nodeFormat), L"Collapsed BVH overran its maximum size");
+                Assert::AreEqual((UINT)((BVHOffsets *)pCollapsed.get())->nodeFormat, nodeFormat, L"Collapsed BVH has the wrong node format");
+
+                CpuWideBvhTraversal wideTraversal(pCollapsed.get());
+                for (auto *pPackets : { &primaryRays, &secondaryRays })
+                {
+                    for (const RayPacket4 &rays : *pPackets)
+                    {
+                        HitPacket4 bvh2Hits, wideHits;
+                        bvh2Traversal.Trace4(rays, bvh2Hits, CpuTraversalQuery::ClosestHit);
+                        wideTraversal.Trace4(rays, wideHits, CpuTraversalQuery::ClosestHit);
+                        for (UINT lane = 0; lane < 4; lane++)
+                        {
+                            Assert::AreEqual(bvh2Hits.PrimitiveId[lane], wideHits.PrimitiveId[lane], L"Collapsed BVH traversal does not match BVH2 traversal");
+                            Assert::AreEqual(bvh2Hits.T[lane], wideHits.T[lane], L"Collapsed BVH hit distance does not match BVH2 traversal");
+                        }
+
+                        bvh2Traversal.Trace4(rays, bvh2Hits, CpuTraversalQuery::AnyHit);
+                        wideTraversal.Trace4(rays, wideHits, CpuTraversalQuery::AnyHit);
+                        for (UINT lane = 0; lane < 4; lane++)
+                        {
+                            Assert::AreEqual(bvh2Hits.PrimitiveId[lane] == CpuBvh2Traversal::NoHit, wideHits.PrimitiveId[lane] == CpuBvh2Traversal::NoHit,
+                                L"Collapsed BVH any hit query disagrees with BVH2 traversal");
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(CollapsedCpuBvhRejectsUpdate)
+        {
+            const UINT numGeoms = 2;
+            const UINT quadsPerSide = 16;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            std::unique_ptr<BYTE[]> pBvh2;
+            srand(10);
+            BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pBvh2, &geomDescs);
+
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            desc.pGeometryDescs = geomDescs.data();
+            desc.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE |
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+
+            for (UINT nodeFormat : { BVH_NODE_FORMAT_QUANTIZED_BVH4, BVH_NODE_FORMAT_QUANTIZED_BVH8 })
+            {
+                const UINT maxSize = GetCollapsedBvhMaxSize(pBvh2.get(), nodeFormat);
+                std::unique_ptr<BYTE[]> pCollapsed(new BYTE[maxSize]);
+                const UINT collapsedSize = CollapseBvh2(pBvh2.get(), nodeFormat, pCollapsed.get());
+                const std::vector<BYTE> original(pCollapsed.get(), pCollapsed.get() + collapsedSize);
+
+                // In place, through both entry points
+                desc.SourceAccelerationStructureData = 0;
+                Assert::ExpectException<_com_error>([&] { RefitRaytracingAccelerationStructureOnCpu(&desc, pCollapsed.get()); },
+                    L"Refitting a collapsed BVH in place did not fail");
+                Assert::ExpectException<_com_error>([&] { BuildRaytracingAccelerationStructureOnCpu(&desc, pCollapsed.get()); },
+                    L"Updating a collapsed BVH in place did not fail");
+                Assert::IsTrue(memcmp(original.data(), pCollapsed.get(), collapsedSize) == 0, L"A rejected update modified the collapsed BVH");
+
+                // From a collapsed source, before anything is copied to the destination
+                std::vector<BYTE> destination(maxSize, 0xCD);
+                desc.SourceAccelerationStructureData = (D3D12_GPU_VIRTUAL_ADDRESS)pCollapsed.get();
+                Assert::ExpectException<_com_error>([&] { RefitRaytracingAccelerationStructureOnCpu(&desc, destination.data()); },
+                    L"Refitting from a collapsed source BVH did not fail");
+                Assert::IsTrue(std::all_of(destination.begin(), destination.end(), [](BYTE value) { return value == 0xCD; }),
+                    L"A rejected update wrote to the destination");
+            }
+        }
+
+        TEST_METHOD(BenchmarkCollapsedCpuBvh)
+        {
+            const UINT numGeoms = 64;
+            const UINT quadsPerSide = 127;
+            std::vector<std::vector<float>> vertices(numGeoms);
+            std::vector<std::vector<UINT16>> indices(numGeoms);
+            std::unique_ptr<BYTE[]> pBvh2;
+            srand(10);
+            const UINT numTriangles = BuildGridBottomLevelOnCpu(numGeoms, quadsPerSide, vertices, indices, pBvh2);
+
+            std::vector<RayPacket4> primaryRays, secondaryRays;
+            GenerateBenchmarkRays((float)(numGeoms * quadsPerSide), (float)quadsPerSide, primaryRays, secondaryRays);
+
+            const BVHOffsets &bvh2Offsets = *(BVHOffsets *)pBvh2.get();
+            CpuBvh2Traversal bvh2Traversal(pBvh2.get());
+            wchar_t message[256];
+            swprintf_s(message, L"BVH2: %u triangles, %u bytes (%u in nodes), %.2f MRays/s primary, %.2f MRays/s secondary\n",
+                numTriangles,
+                bvh2Offsets.totalSize,
+                bvh2Offsets.offsetToVertices - bvh2Offsets.offsetToBoxes,
+                MeasureTraversalThroughput(bvh2Traversal, primaryRays, CpuTraversalQuery::ClosestHit),
+                MeasureTraversalThroughput(bvh2Traversal, secondaryRays, CpuTraversalQuery::AnyHit));
+            Logger::WriteMessage(message);
+
+            for (UINT nodeFormat : { BVH_NODE_FORMAT_QUANTIZED_BVH4, BVH_NODE_FORMAT_QUANTIZED_BVH8 })
+            {
+                std::unique_ptr<BYTE[]> pCollapsed(new BYTE[GetCollapsedBvhMaxSize(pBvh2.get(), nodeFormat)]);
+                auto start = std::chrono::high_resolution_clock::now();
+                CollapseBvh2(pBvh2.get(), nodeFormat, pCollapsed.get());
+                auto end = std::chrono::high_resolution_clock::now();
+
+                const BVHOffsets &offsets = *(BVHOffsets *)pCollapsed.get();
+                CpuWideBvhTraversal wideTraversal(pCollapsed.get());
+                swprintf_s(message, L"BVH%u: collapsed in %.2f ms, %u bytes (%u in nodes), %.2f MRays/s primary, %.2f MRays/s secondary\n",
+                    nodeFormat == BVH_NODE_FORMAT_QUANTIZED_BVH4 ? 4 : 8,
+                    std::chrono::duration<double, std::milli>(end - start).count(),
+                    offsets.totalSize,
+                    offsets.offsetToVertices - offsets.offsetToBoxes,
+                    MeasureTraversalThroughput(wideTraversal, primaryRays, CpuTraversalQuery::ClosestHit),
+                    MeasureTraversalThroughput(wideTraversal, secondaryRays, CpuTraversalQuery::AnyHit));
+                Logger::WriteMessage(message);
+            }
+        }
+
         template <UINT numBottomLevels>
         void SimpleTopLevelGpuBVHBuilder(
             D3D12_ELEMENTS_LAYOUT layoutToTest,
@@ -1348,43 +2236,189 @@ namespace FallbackLayerUnitTests
             }
         }
 
-        void TestCpuBvh2Builder(CpuGeometryDescriptor *pGeomDescs, UINT numGeoms, D3D12_ELEMENTS_LAYOUT layoutToTest = D3D12_ELEMENTS_LAYOUT_ARRAY)
+        // Descs that point the CPU builder straight at the host memory of the test geometry
+        void CreateTriangleGeometryDescs(CpuGeometryDescriptor *pGeomDescs, UINT numGeoms, std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> &geomDescs)
         {
-            ID3D12Device &device = m_d3d12Context.GetDevice();
-            std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder> pBuilder =
-                std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder>(
-                    new FallbackLayer::GpuBvh2Builder(&device, m_d3d12Context.GetTotalLaneCount(), 0));
-            InternalFallbackBuilder builderWrapper(pBuilder.get());
-
-            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs(numGeoms);
+            geomDescs.resize(numGeoms);
             for (UINT i = 0; i < numGeoms; i++)
             {
                 geomDescs[i].Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+                geomDescs[i].Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_NONE;
                 auto &triangleDesc = geomDescs[i].Triangles;
+                triangleDesc.Transform = 0;
                 triangleDesc.IndexBuffer = (D3D12_GPU_VIRTUAL_ADDRESS)pGeomDescs[i].m_pIndexBuffer;
                 triangleDesc.VertexBuffer.StartAddress = (D3D12_GPU_VIRTUAL_ADDRESS)pGeomDescs[i].m_pVertexData;
+                triangleDesc.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
                 triangleDesc.IndexFormat = pGeomDescs[i].m_indexBufferFormat;
                 triangleDesc.IndexCount = pGeomDescs[i].m_numIndicies;
                 triangleDesc.VertexCount = pGeomDescs[i].m_numVerticies;
                 triangleDesc.VertexBuffer.StrideInBytes = sizeof(float) * 3;
             }
+        }
 
-            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo;
-            builderWrapper.GetRaytracingAccelerationStructurePrebuildInfo(&device,
-                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL,
-                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD,
-                numGeoms,
-                geomDescs.data(),
-                &prebuildInfo);
-            std::unique_ptr<BYTE[]> pData = std::unique_ptr<BYTE[]>(new BYTE[prebuildInfo.ResultDataMaxSizeInBytes]);
+        // Upper bound on what BuildRaytracingAccelerationStructureOnCpu writes, for tests that skip the prebuild query
+        static UINT GetCpuBvh2MaxSize(UINT numTriangles)
+        {
+            const UINT numNodes = numTriangles ? 2 * numTriangles - 1 : 1;
+            return SizeOfBVHOffsets + numNodes * SizeOfAABBNode + numTriangles * (SizeOfPrimitive + SizeOfPrimitiveMetaData);
+        }
+
+        // Builds side by side grids into a single bottom level on the CPU, returns the triangle count. The geometry
+        // descriptors stay valid as long as vertices and indices, for refitting later.
+        UINT BuildGridBottomLevelOnCpu(
+            UINT numGeoms,
+            UINT quadsPerSide,
+            std::vector<std::vector<float>> &vertices,
+            std::vector<std::vector<UINT16>> &indices,
+            std::unique_ptr<BYTE[]> &pData,
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> *pGeomDescs = nullptr)
+        {
+            std::vector<CpuGeometryDescriptor> cpuGeomDescs;
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                GenerateGridGeometry(quadsPerSide, (float)(quadsPerSide * i), vertices[i], indices[i]);
+                cpuGeomDescs.push_back(CpuGeometryDescriptor(
+                    vertices[i].data(),
+                    (UINT)(vertices[i].size() / 3),
+                    indices[i].data(),
+                    (UINT)indices[i].size()));
+            }
 
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(cpuGeomDescs.data(), numGeoms, geomDescs);
+
+            const UINT numTriangles = numGeoms * quadsPerSide * quadsPerSide * 2;
+            pData.reset(new BYTE[GetCpuBvh2MaxSize(numTriangles)]);
 
             D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
             desc.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
             desc.NumDescs = numGeoms;
             desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
             desc.pGeometryDescs = geomDescs.data();
+            BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
+
+            if (pGeomDescs)
+            {
+                pGeomDescs->swap(geomDescs);
+            }
+            return numTriangles;
+        }
+
+        // Moves every grid vertex in place so that refits have something to do
+        static void AnimateGridGeometry(std::vector<std::vector<float>> &vertices)
+        {
+            for (std::vector<float> &geometryVertices : vertices)
+            {
+                for (size_t i = 0; i < geometryVertices.size(); i += 3)
+                {
+                    geometryVertices[i + 1] += 0.5f * sinf(geometryVertices[i] * 0.05f) + 0.25f * cosf(geometryVertices[i + 2] * 0.1f);
+                }
+            }
+        }
+
+        //
+        // Primary rays are 2x2 tiles of a 1024x1024 grid looking straight down on the
+        // XZ grids, secondary rays start on the surface and head off in random directions
+        //
+        void GenerateBenchmarkRays(
+            float sceneWidth,
+            float sceneDepth,
+            std::vector<RayPacket4> &primaryRays,
+            std::vector<RayPacket4> &secondaryRays)
+        {
+            const UINT raysPerSide = 1024;
+            const UINT numPackets = raysPerSide * raysPerSide / 4;
+            primaryRays.resize(numPackets);
+            secondaryRays.resize(numPackets);
+            for (UINT packetIndex = 0; packetIndex < numPackets; packetIndex++)
+            {
+                const UINT tileX = (packetIndex % (raysPerSide / 2)) * 2;
+                const UINT tileY = (packetIndex / (raysPerSide / 2)) * 2;
+                RayPacket4 &primary = primaryRays[packetIndex];
+                RayPacket4 &secondary = secondaryRays[packetIndex];
+                primary.ActiveMask = secondary.ActiveMask = 0xf;
+                for (UINT lane = 0; lane < 4; lane++)
+                {
+                    primary.OriginX[lane] = (tileX + (lane % 2) + 0.5f) * sceneWidth / raysPerSide;
+                    primary.OriginY[lane] = 5.0f;
+                    primary.OriginZ[lane] = (tileY + (lane / 2) + 0.5f) * sceneDepth / raysPerSide;
+                    primary.DirectionX[lane] = 0.0f;
+                    primary.DirectionY[lane] = -1.0f;
+                    primary.DirectionZ[lane] = 0.0f;
+                    primary.TMin[lane] = 0.0f;
+                    primary.TMax[lane] = 1000.0f;
+
+                    secondary.OriginX[lane] = RandomFloat(0.0f, sceneWidth);
+                    secondary.OriginY[lane] = RandomFloat(0.0f, 2.0f);
+                    secondary.OriginZ[lane] = RandomFloat(0.0f, sceneDepth);
+                    secondary.DirectionX[lane] = RandomFloat(-1.0f, 1.0f);
+                    secondary.DirectionY[lane] = RandomFloat(0.0f, 1.0f);
+                    secondary.DirectionZ[lane] = RandomFloat(-1.0f, 1.0f);
+                    secondary.TMin[lane] = 0.001f;
+                    secondary.TMax[lane] = 1000.0f;
+                }
+            }
+        }
+
+        // Millions of rays per second tracing every packet across all cores
+        template<typename Traversal>
+        double MeasureTraversalThroughput(const Traversal &traversal, const std::vector<RayPacket4> &packets, CpuTraversalQuery query)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            concurrency::parallel_for(size_t(0), packets.size(), [&](size_t packetIndex)
+            {
+                HitPacket4 hits;
+                traversal.Trace4(packets[packetIndex], hits, query);
+            });
+            auto end = std::chrono::high_resolution_clock::now();
+            return packets.size() * 4 / std::chrono::duration<double>(end - start).count() / 1e6;
+        }
+
+        void TestCpuBvh2Builder(CpuGeometryDescriptor *pGeomDescs, UINT numGeoms, D3D12_ELEMENTS_LAYOUT layoutToTest = D3D12_ELEMENTS_LAYOUT_ARRAY)
+        {
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geomDescs;
+            CreateTriangleGeometryDescs(pGeomDescs, numGeoms, geomDescs);
+            for (UINT i = 0; i < numGeoms; i++)
+            {
+                // The CPU builder reads transforms from CPU memory like everything else
+                geomDescs[i].Triangles.Transform = (D3D12_GPU_VIRTUAL_ADDRESS)pGeomDescs[i].transform.data();
+            }
+
+            BuildAndVerifyCpuBvh2(geomDescs, pGeomDescs, numGeoms, layoutToTest);
+        }
+
+        // Builds geomDescs on the CPU and validates the result against pGeomDescs, which
+        // describe the same triangles as packed float3 vertices
+        void BuildAndVerifyCpuBvh2(
+            std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> &geomDescs,
+            CpuGeometryDescriptor *pGeomDescs,
+            UINT numGeoms,
+            D3D12_ELEMENTS_LAYOUT layoutToTest = D3D12_ELEMENTS_LAYOUT_ARRAY)
+        {
+            ID3D12Device &device = m_d3d12Context.GetDevice();
+            std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder> pBuilder =
+                std::unique_ptr<FallbackLayer::IAccelerationStructureBuilder>(
+                    new FallbackLayer::GpuBvh2Builder(&device, m_d3d12Context.GetTotalLaneCount(), 0));
+
+            std::vector<const D3D12_RAYTRACING_GEOMETRY_DESC *> geomDescPointers(numGeoms);
+            D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC desc{};
+            desc.NumDescs = numGeoms;
+            desc.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+            if (layoutToTest == D3D12_ELEMENTS_LAYOUT_ARRAY)
+            {
+                desc.pGeometryDescs = geomDescs.data();
+            }
+            else
+            {
+                for (UINT i = 0; i < numGeoms; i++)
+                {
+                    geomDescPointers[i] = &geomDescs[i];
+                }
+                desc.ppGeometryDescs = geomDescPointers.data();
+            }
+            desc.DescsLayout = layoutToTest;
 
+            std::unique_ptr<BYTE[]> pData = std::unique_ptr<BYTE[]>(new BYTE[GetRaytracingAccelerationStructureOnCpuMaxSize(&desc)]);
             BuildRaytracingAccelerationStructureOnCpu(&desc, pData.get());
             std::wstring errorMessage;
             auto &validator = FallbackLayer::GetAccelerationStructureValidator(pBuilder->GetAccelerationStructureType());
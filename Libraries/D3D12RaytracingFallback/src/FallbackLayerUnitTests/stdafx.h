@@ -11,7 +11,10 @@
 #include "CppUnitTest.h"
 
 #include "..\pch.h"
+#include <DirectXPackedVector.h>
 #include "DXGI1_4.h"
 
 #include "D3DTestHelper.h"
 #include "D3D12Context.h"
+
+#include <chrono>
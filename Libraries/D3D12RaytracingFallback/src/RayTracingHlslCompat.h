@@ -400,10 +400,24 @@ struct AABBNode
 static_assert(sizeof(AABBNode) == SizeOfAABBNode, L"Incorrect sizeof for AABB");
 #endif
 
+// Layout of the boxes following BVHOffsets. The GPU builder and traversal
+// shader only produce and consume BVH2, the wider formats are collapsed from
+// it on the CPU
+#define BVH_NODE_FORMAT_BVH2            0
+#define BVH_NODE_FORMAT_QUANTIZED_BVH4  1
+#define BVH_NODE_FORMAT_QUANTIZED_BVH8  2
+
 // BVH description for the traversal shader
 struct BVHOffsets
 {
+#ifdef HLSL
     uint    offsetToBoxes;
+#else
+    // Boxes always directly follow this header, so the top byte is free to
+    // record their format (BVH_NODE_FORMAT_*)
+    uint    offsetToBoxes : 24;
+    uint    nodeFormat    : 8;
+#endif
     uint    offsetToVertices;
     uint    offsetToPrimitiveMetaData;
     uint    totalSize;
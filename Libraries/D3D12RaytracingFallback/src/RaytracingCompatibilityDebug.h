@@ -19,6 +19,50 @@ void OutputDebugLog(ID3D12RaytracingFallbackDevice *pDevice);
 void VisualizeAccelerationStructureLevel(ID3D12RaytracingFallbackDevice *pDevice, UINT level);
 #endif
 
+//
+// Tuning for the spatial split (SBVH) path the CPU builder takes for
+// PREFER_FAST_TRACE builds. Builds that also ask for PREFER_FAST_BUILD, or
+// for neither, never split primitives.
+//
+struct CpuSpatialSplitSettings
+{
+    // Spatial splits are only tried where the children of the best object
+    // split overlap by more than this fraction of the root's surface area
+    float OverlapThreshold;
+
+    // Extra primitive references the build may create, as a fraction of the
+    // primitive count. This also bounds the growth of the output.
+    float ReferenceBudget;
+};
+
+static const CpuSpatialSplitSettings DefaultCpuSpatialSplitSettings = { 1e-5f, 0.3f };
+
+// Upper bound on the bytes BuildRaytracingAccelerationStructureOnCpu writes for pDesc
+UINT GetRaytracingAccelerationStructureOnCpuMaxSize(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _In_  const CpuSpatialSplitSettings &spatialSplitSettings = DefaultCpuSpatialSplitSettings);
+
+// Bottom level builds of triangles and procedural AABBs. Geometry is read from
+// CPU memory, every GPU virtual address in pDesc is used as a pointer.
 void BuildRaytracingAccelerationStructureOnCpu(
     _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
-    _Out_ void *pData);
+    _Out_ void *pData,
+    _In_  const CpuSpatialSplitSettings &spatialSplitSettings = DefaultCpuSpatialSplitSettings);
+
+//
+// PERFORM_UPDATE for BuildRaytracingAccelerationStructureOnCpu, which calls
+// this when the flag is set. Reloads the primitives from pDesc's geometry and
+// refits the node boxes without changing the tree, so the geometry must have
+// the same primitive counts as the original build. Refitting is in place
+// unless SourceAccelerationStructureData points elsewhere, in which case the
+// source is copied to pData first. Only BVH2 structures can be refit; a
+// collapsed BVH4/BVH8 throws E_INVALIDARG before anything is written.
+//
+// Returns the SAH cost of the refit tree in the same units as
+// CpuBvh2Statistics::SahCost. Refit trees only get worse as geometry moves
+// away from the pose they were built for; rebuild once this grows well past
+// the cost measured after the last full build.
+//
+float RefitRaytracingAccelerationStructureOnCpu(
+    _In_  const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC *pDesc,
+    _Inout_ void *pData);
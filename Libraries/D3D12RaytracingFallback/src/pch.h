@@ -24,6 +24,8 @@
 #include <unordered_map>
 #include <map>
 #include <deque>
+#include <atomic>
+#include <ppl.h>
 #include <string>
 #include <strsafe.h>
 #include "d3d12_1.h"
@@ -57,10 +59,15 @@
 // Validators
 #include "BVHValidator.h"
 
+// Traversal
+#include "CpuBvh2Traversal.h"
+#include "CpuWideBvh.h"
+
 // Traversal Builders
 #include "BVHTraversalShaderBuilder.h"
 
 // Acceleration Structure Builders
+#include "CpuGeometryInput.h"
 #include "GetBVHCompactedSizeBindings.h"
 #include "ShaderPass.h"
 #include "BitonicSort.h"
@@ -16,27 +16,20 @@
 // When a block is de-allocated an attempt is made to merge it with it's 
 // neighbour (buddy) if it is contiguous and free.
 // Based on reference implementation by Bill Kristiansen
+//
+// The free blocks are tracked by a BuddyRangeAllocator, which works in units of the minimum block
+// size and keeps no heap or resource state.
 //  
 
 #pragma once
 
 #include "GpuBuffer.h"
-#include <vector>
+#include "BuddyRangeAllocator.h"
 #include <queue>
-#include <mutex>
-#include <set>
 
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
 
-#if defined(PROFILE) || defined(_DEBUG)
-#define INCREASE_BUDDY_COUNTER(A, B) (A = A + B);
-#define DECREASE_BUDDY_COUNTER(A, B) (A = A - B);
-#else
-#define INCREASE_BUDDY_COUNTER(A, B)
-#define DECREASE_BUDDY_COUNTER(A, B)
-#endif
-
 enum kBuddyAllocationStrategy
 {
     // This strategy uses Placed Resources to sub-allocate a buffer out of an underlying ID3D12Heap.
@@ -75,6 +68,18 @@ struct BuddyBlock
     void Destroy();
 };
 
+// Occupancy of a buddy allocator, in bytes.  Internal fragmentation is the padding inside allocated
+// blocks.  External fragmentation shows as a largest free block smaller than the free space.
+struct BuddyAllocatorStats
+{
+    size_t SpaceUsed;
+    size_t InternalFragmentation;
+    size_t FreeSpace;
+    size_t LargestFreeBlock;
+    size_t AllocatedBlocks;
+    size_t FreeBlocks;
+};
+
 class BuddyAllocator
 {
 public:
@@ -96,16 +101,17 @@ public:
 
     inline void Reset()
     {
-        // Clear the free blocks collection  
-        m_freeBlocks.clear();
-
         // Initialize the pool with a free inner block of max inner block size  
-        m_freeBlocks.resize(m_maxOrder + 1);
-        m_freeBlocks[m_maxOrder].insert((size_t)0);
+        m_freeBlocks.Reset();
+        m_SpaceUsed = 0;
+        m_InternalFragmentation = 0;
+        m_AllocatedBlocks = 0;
     }
 
     void CleanUpAllocations();
 
+    BuddyAllocatorStats GetStats() const;
+
 private:
     ID3D12Heap* m_pBackingHeap;
     ByteAddressBuffer m_BackingResource;
@@ -113,7 +119,7 @@ private:
     const D3D12_HEAP_TYPE m_heapType;
 
     std::queue<BuddyBlock*> m_deferredDeletionQueue;
-    std::vector<std::set<size_t>> m_freeBlocks;
+    BuddyRangeAllocator m_freeBlocks;
     UINT m_maxOrder;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
@@ -131,19 +137,11 @@ private:
         return Math::Log2(size); // Log2 rounds up fractions to next whole value
     }
 
-    inline size_t GetBuddyOffset(const size_t &offset, const size_t &size)
-    {
-        return offset ^ size;
-    }
-
     void DeallocateInternal(BuddyBlock* pBlock);
 
     size_t OrderToUnitSize(UINT order) const { return ((size_t)1) << order; }
-    size_t AllocateBlock(UINT order);
-    void DeallocateBlock(size_t offset, UINT order);
 
-#if defined(PROFILE) || defined(_DEBUG)
     size_t m_SpaceUsed;
     size_t m_InternalFragmentation;
-#endif
+    size_t m_AllocatedBlocks;
 };
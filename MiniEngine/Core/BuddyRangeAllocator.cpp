@@ -0,0 +1,194 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/BuddyRangeAllocatorTest.cpp)
+#include "BuddyRangeAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+namespace
+{
+    inline uint32_t FirstSetBit( uint64_t Bits )
+    {
+#ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanForward64(&Index, Bits);
+        return Index;
+#else
+        return (uint32_t)__builtin_ctzll(Bits);
+#endif
+    }
+
+    inline uint32_t LastSetBit( uint64_t Bits )
+    {
+#ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanReverse64(&Index, Bits);
+        return Index;
+#else
+        return 63 - (uint32_t)__builtin_clzll(Bits);
+#endif
+    }
+}
+
+void BuddyRangeAllocator::Create( uint32_t MaxOrder )
+{
+    // Five levels of 64-bit words cover 2^30 blocks
+    ASSERT(MaxOrder <= 30, "Buddy allocator range is too large");
+
+    m_MaxOrder = MaxOrder;
+    m_Orders.resize(MaxOrder + 1);
+
+    for (uint32_t Order = 0; Order <= MaxOrder; ++Order)
+    {
+        OrderBitmap& Bitmap = m_Orders[Order];
+
+        size_t Bits = (size_t)1 << (MaxOrder - Order);
+        Bitmap.LevelCount = 0;
+        do
+        {
+            const size_t Words = (Bits + 63) / 64;
+            Bitmap.Levels[Bitmap.LevelCount++].assign(Words, 0);
+            Bits = Words;
+        }
+        while (Bits > 1);
+    }
+
+    Reset();
+}
+
+void BuddyRangeAllocator::Reset( void )
+{
+    for (OrderBitmap& Bitmap : m_Orders)
+    {
+        for (uint32_t Level = 0; Level < Bitmap.LevelCount; ++Level)
+            std::fill(Bitmap.Levels[Level].begin(), Bitmap.Levels[Level].end(), 0);
+        Bitmap.FreeCount = 0;
+    }
+    m_NonEmptyOrders = 0;
+
+    if (!m_Orders.empty())
+        MarkFree(m_MaxOrder, 0);
+}
+
+void BuddyRangeAllocator::MarkFree( uint32_t Order, size_t Index )
+{
+    OrderBitmap& Bitmap = m_Orders[Order];
+    ASSERT(!IsFree(Order, Index), "Block is already free");
+
+    // Set the bit on each level until reaching a word that already had bits set
+    for (uint32_t Level = 0; Level < Bitmap.LevelCount; ++Level)
+    {
+        uint64_t& Word = Bitmap.Levels[Level][Index >> 6];
+        const bool WasEmpty = Word == 0;
+        Word |= (uint64_t)1 << (Index & 63);
+        if (!WasEmpty)
+            break;
+        Index >>= 6;
+    }
+
+    ++Bitmap.FreeCount;
+    m_NonEmptyOrders |= (uint64_t)1 << Order;
+}
+
+void BuddyRangeAllocator::MarkUsed( uint32_t Order, size_t Index )
+{
+    OrderBitmap& Bitmap = m_Orders[Order];
+    ASSERT(IsFree(Order, Index), "Block is not free");
+
+    // Clear the bit on each level for as long as it leaves the word empty
+    for (uint32_t Level = 0; Level < Bitmap.LevelCount; ++Level)
+    {
+        uint64_t& Word = Bitmap.Levels[Level][Index >> 6];
+        Word &= ~((uint64_t)1 << (Index & 63));
+        if (Word != 0)
+            break;
+        Index >>= 6;
+    }
+
+    if (--Bitmap.FreeCount == 0)
+        m_NonEmptyOrders &= ~((uint64_t)1 << Order);
+}
+
+size_t BuddyRangeAllocator::FindFirstFree( uint32_t Order ) const
+{
+    const OrderBitmap& Bitmap = m_Orders[Order];
+
+    size_t Index = 0;
+    for (uint32_t Level = Bitmap.LevelCount; Level-- > 0; )
+        Index = (Index << 6) + FirstSetBit(Bitmap.Levels[Level][Index]);
+    return Index;
+}
+
+size_t BuddyRangeAllocator::Allocate( uint32_t Order )
+{
+    if (Order > m_MaxOrder)
+        return kInvalidOffset;
+
+    const uint64_t Candidates = m_NonEmptyOrders >> Order;
+    if (Candidates == 0)
+        return kInvalidOffset;
+
+    // Take the smallest free block that fits and split it down, freeing each right half
+    uint32_t FoundOrder = Order + FirstSetBit(Candidates);
+    size_t Index = FindFirstFree(FoundOrder);
+    MarkUsed(FoundOrder, Index);
+
+    while (FoundOrder > Order)
+    {
+        --FoundOrder;
+        Index <<= 1;
+        MarkFree(FoundOrder, Index + 1);
+    }
+
+    return Index << Order;
+}
+
+void BuddyRangeAllocator::Free( size_t Offset, uint32_t Order )
+{
+    ASSERT(Order <= m_MaxOrder && (Offset & (((size_t)1 << Order) - 1)) == 0, "Invalid buddy block");
+
+    size_t Index = Offset >> Order;
+    while (Order < m_MaxOrder && IsFree(Order, Index ^ 1))
+    {
+        MarkUsed(Order, Index ^ 1);
+        Index >>= 1;
+        ++Order;
+    }
+    MarkFree(Order, Index);
+}
+
+size_t BuddyRangeAllocator::GetFreeUnits( void ) const
+{
+    size_t Units = 0;
+    for (size_t Order = 0; Order < m_Orders.size(); ++Order)
+        Units += m_Orders[Order].FreeCount << Order;
+    return Units;
+}
+
+size_t BuddyRangeAllocator::GetFreeBlockCount( void ) const
+{
+    size_t Count = 0;
+    for (const OrderBitmap& Bitmap : m_Orders)
+        Count += Bitmap.FreeCount;
+    return Count;
+}
+
+size_t BuddyRangeAllocator::GetLargestFreeBlock( void ) const
+{
+    return m_NonEmptyOrders == 0 ? 0 : (size_t)1 << LastSetBit(m_NonEmptyOrders);
+}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// The bookkeeping half of BuddyAllocator.  It hands out power of two sized blocks of abstract
+// units from a range of 2^MaxOrder units and knows nothing about heaps or resources.
+//
+// The free blocks of each order are kept in a bitmap, one bit per block, with summary levels on
+// top where each bit says whether a 64-bit word below it has any free block.  Finding the first
+// free block of an order reads one word per level, and a mask of the orders that have free blocks
+// finds the order to split from, so allocate and free never search and never allocate memory.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BuddyRangeAllocator
+{
+public:
+    static const size_t kInvalidOffset = ~(size_t)0;
+
+    BuddyRangeAllocator() : m_MaxOrder(0), m_NonEmptyOrders(0) {}
+
+    // Manages 2^MaxOrder units, all free
+    void Create( uint32_t MaxOrder );
+
+    // Frees every block
+    void Reset( void );
+
+    // Returns the unit offset of a free block of 2^Order units, or kInvalidOffset when there is none
+    size_t Allocate( uint32_t Order );
+
+    // Returns a block and merges it with its buddy for as long as the buddy is free
+    void Free( size_t Offset, uint32_t Order );
+
+    uint32_t GetMaxOrder( void ) const { return m_MaxOrder; }
+    size_t GetFreeUnits( void ) const;
+    size_t GetFreeBlockCount( void ) const;
+
+    // Size in units of the largest free block, or 0 when full
+    size_t GetLargestFreeBlock( void ) const;
+
+private:
+
+    // Free blocks of one order.  Levels[0] has a bit per block, and each level above has a bit per
+    // word of the one below.  The top level is a single word.
+    struct OrderBitmap
+    {
+        std::vector<uint64_t> Levels[5];
+        uint32_t LevelCount;
+        size_t FreeCount;
+    };
+
+    bool IsFree( uint32_t Order, size_t Index ) const
+    {
+        return (m_Orders[Order].Levels[0][Index >> 6] >> (Index & 63)) & 1;
+    }
+
+    void MarkFree( uint32_t Order, size_t Index );
+    void MarkUsed( uint32_t Order, size_t Index );
+    size_t FindFirstFree( uint32_t Order ) const;
+
+    uint32_t m_MaxOrder;
+    uint64_t m_NonEmptyOrders;    // bit n set when order n has a free block
+    std::vector<OrderBitmap> m_Orders;
+};
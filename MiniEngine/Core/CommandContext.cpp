@@ -56,16 +56,38 @@ CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
 
     ASSERT(ret->m_Type == Type);
 
+    std::lock_guard<std::mutex> SerialGuard(sm_SerialMutex);
+    ret->m_OpenSerial = sm_NextSerial++;
+    sm_OpenSerials.insert(ret->m_OpenSerial);
+
     return ret;
 }
 
 void ContextManager::FreeContext(CommandContext* UsedContext)
 {
     ASSERT(UsedContext != nullptr);
+
+    {
+        std::lock_guard<std::mutex> SerialGuard(sm_SerialMutex);
+        sm_OpenSerials.erase(UsedContext->m_OpenSerial);
+    }
+
     std::lock_guard<std::mutex> LockGuard(sm_ContextAllocationMutex);
     sm_AvailableContexts[UsedContext->m_Type].push(UsedContext);
 }
 
+uint64_t ContextManager::GetNextSerial(void)
+{
+    std::lock_guard<std::mutex> SerialGuard(sm_SerialMutex);
+    return sm_NextSerial;
+}
+
+uint64_t ContextManager::GetOldestOpenSerial(void)
+{
+    std::lock_guard<std::mutex> SerialGuard(sm_SerialMutex);
+    return sm_OpenSerials.empty() ? sm_NextSerial : *sm_OpenSerials.begin();
+}
+
 void CommandContext::DestroyAllContexts(void)
 {
     LinearAllocator::DestroyAll();
@@ -172,6 +194,7 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
     m_NumBarriersToFlush = 0;
+    m_OpenSerial = 0;
 }
 
 CommandContext::~CommandContext( void )
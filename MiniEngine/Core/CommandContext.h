@@ -25,6 +25,7 @@
 #include "LinearAllocator.h"
 #include "CommandSignature.h"
 #include "GraphicsCore.h"
+#include <set>
 #include <vector>
 
 class ColorBuffer;
@@ -60,16 +61,27 @@ struct DWParam
 class ContextManager
 {
 public:
-    ContextManager(void) {}
+    ContextManager(void) : sm_NextSerial(0) {}
 
     CommandContext* AllocateContext(D3D12_COMMAND_LIST_TYPE Type);
     void FreeContext(CommandContext*);
     void DestroyAllContexts();
 
+    // Every context gets the next serial number when it is opened.  Anything a context might still be
+    // recording with is safe to overwrite once GetOldestOpenSerial() has reached GetNextSerial() as it
+    // was at the time.
+    uint64_t GetNextSerial(void);
+    uint64_t GetOldestOpenSerial(void);
+
 private:
     std::vector<std::unique_ptr<CommandContext> > sm_ContextPool[4];
     std::queue<CommandContext*> sm_AvailableContexts[4];
     std::mutex sm_ContextAllocationMutex;
+
+    // Kept under their own lock, which is never held while calling out
+    std::set<uint64_t> sm_OpenSerials;
+    uint64_t sm_NextSerial;
+    std::mutex sm_SerialMutex;
 };
 
 struct NonCopyable
@@ -182,6 +194,7 @@ protected:
     void SetID(const std::wstring& ID) { m_ID = ID; }
 
     D3D12_COMMAND_LIST_TYPE m_Type;
+    uint64_t m_OpenSerial;
 };
 
 class GraphicsContext : public CommandContext
@@ -0,0 +1,594 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/CpuProfilerTest.cpp)
+#include "CpuProfiler.h"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+using namespace CpuProfiler;
+using namespace std;
+
+namespace
+{
+    const uint32_t kMaxThreads = 64;		// threads past this many aren't profiled
+    const uint32_t kRingSize = 16384;		// events a thread can record between collections
+    const uint32_t kMaxDepth = 64;
+    const uint32_t kMaxNames = 4096;
+    const uint32_t kNameCacheSize = 256;
+    const uint32_t kMaxDetached = 1024;
+
+    // The top two bits of an event's name say what it is
+    const uint32_t kTypeShift = 30;
+    const uint32_t kNameMask = (1u << kTypeShift) - 1;
+
+    enum EventType
+    {
+        kBeginEvent,
+        kEndEvent,
+        kDetachEvent,		// the scope moved off this thread, and UserData is its instance
+        kEndDetachedEvent	// a detached scope closed, and UserData is its instance
+    };
+
+    struct Event
+    {
+        int64_t Tick;
+        uint32_t TypeAndName;
+        uint32_t UserData;
+    };
+
+    // Single producer, single consumer:  the owning thread writes, CollectEvents() reads
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : WriteIndex(0), ReadIndex(0), Name(0) {}
+
+        atomic<uint32_t> WriteIndex;
+        atomic<uint32_t> ReadIndex;
+        atomic<NameId> Name;
+        Event Events[kRingSize];
+    };
+
+    struct OpenScope
+    {
+        NameId Name;
+        uint32_t UserData;
+        uint64_t Key;
+        const void* Owner;
+        bool Recorded;
+    };
+
+    // Plain data, so the thread_local needs no constructor or guard
+    struct ThreadState
+    {
+        ThreadBuffer* Buffer;
+        bool Registered;
+        uint32_t Depth;
+        uint32_t RecordedDepth;
+        OpenScope Stack[kMaxDepth];
+        struct { uint32_t Hash; NameId Id; } NameCache[kNameCacheSize];
+    };
+
+    thread_local ThreadState t_State;
+
+    mutex s_RegistryMutex;
+    ThreadBuffer* s_Threads[kMaxThreads];
+    atomic<uint32_t> s_NumThreads(0);
+    atomic<uint64_t> s_DroppedEvents(0);
+
+    // Name 0 stands in for names past the limit
+    deque<wstring> s_NameStorage;
+    unordered_map<wstring, NameId> s_NameIds;
+    const wchar_t* s_Names[kMaxNames] = { L"(too many names)" };
+    uint32_t s_NumNames = 1;
+
+    // Owned scopes left open by a finished job, waiting for their owner to close them
+    struct DetachedScope
+    {
+        uint32_t Instance;
+        uint32_t UserData;
+        bool Recorded;
+    };
+    unordered_map<const void*, DetachedScope> s_DetachedScopes;
+    uint32_t s_NextInstance = 0;
+
+    uint32_t HashName( const wchar_t* Name )
+    {
+        uint32_t Hash = 2166136261u;
+        while (*Name)
+            Hash = (Hash ^ (uint32_t)*Name++) * 16777619u;
+        return Hash;
+    }
+
+    uint64_t ScopeKey( uint64_t ParentKey, NameId Name )
+    {
+        uint64_t Key = ParentKey ^ ((Name + 1) * 0x9E3779B97F4A7C15ull);
+        Key = (Key ^ (Key >> 30)) * 0xBF58476D1CE4E5B9ull;
+        Key = (Key ^ (Key >> 27)) * 0x94D049BB133111EBull;
+        return Key ^ (Key >> 31);
+    }
+
+    ThreadBuffer* GetBuffer( ThreadState& T )
+    {
+        if (T.Registered)
+            return T.Buffer;
+
+        lock_guard<mutex> LockGuard(s_RegistryMutex);
+        T.Registered = true;
+
+        const uint32_t ThreadIndex = s_NumThreads.load(memory_order_relaxed);
+        if (ThreadIndex == kMaxThreads)
+            return nullptr;
+
+        T.Buffer = new ThreadBuffer;
+        s_Threads[ThreadIndex] = T.Buffer;
+        s_NumThreads.store(ThreadIndex + 1, memory_order_release);
+        return T.Buffer;
+    }
+
+    // Fails rather than leave fewer than Reserve free slots, which keeps room for the ends of open scopes
+    bool Push( ThreadState& T, EventType Type, NameId Name, uint32_t UserData, uint32_t Reserve )
+    {
+        ThreadBuffer* Buffer = GetBuffer(T);
+        if (Buffer == nullptr)
+            return false;
+
+        const uint32_t Write = Buffer->WriteIndex.load(memory_order_relaxed);
+        const uint32_t Read = Buffer->ReadIndex.load(memory_order_acquire);
+        if (kRingSize - (Write - Read) < Reserve)
+        {
+            s_DroppedEvents.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+
+        Event& E = Buffer->Events[Write % kRingSize];
+        E.Tick = GetTick();
+        E.TypeAndName = (uint32_t)Type << kTypeShift | Name;
+        E.UserData = UserData;
+        Buffer->WriteIndex.store(Write + 1, memory_order_release);
+        return true;
+    }
+
+    // Appends Str to a JSON string as UTF-8
+    void AppendJsonString( string& Out, const wchar_t* Str )
+    {
+        while (*Str)
+        {
+            uint32_t C = (uint32_t)*Str++;
+            if (C >= 0xD800 && C < 0xDC00 && *Str >= 0xDC00 && *Str < 0xE000)
+                C = 0x10000 + ((C - 0xD800) << 10) + ((uint32_t)*Str++ - 0xDC00);
+
+            if (C == '"' || C == '\\')
+            {
+                Out += '\\';
+                Out += (char)C;
+            }
+            else if (C < 0x20)
+            {
+                char Escaped[8];
+                snprintf(Escaped, sizeof(Escaped), "\\u%04x", C);
+                Out += Escaped;
+            }
+            else if (C < 0x80)
+            {
+                Out += (char)C;
+            }
+            else if (C < 0x800)
+            {
+                Out += (char)(0xC0 | C >> 6);
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+            else if (C < 0x10000)
+            {
+                Out += (char)(0xE0 | C >> 12);
+                Out += (char)(0x80 | (C >> 6 & 0x3F));
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+            else
+            {
+                Out += (char)(0xF0 | C >> 18);
+                Out += (char)(0x80 | (C >> 12 & 0x3F));
+                Out += (char)(0x80 | (C >> 6 & 0x3F));
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+        }
+    }
+
+    // Chrome's trace event format, with begin and end events per thread
+    class TraceWriter
+    {
+    public:
+        TraceWriter() : m_FramesLeft(0), m_StartTick(0), m_LastTick(0) {}
+
+        void Start( const string& FilePath, uint32_t NumFrames )
+        {
+            if (m_File.is_open())
+            {
+                printf("A profile trace is already being captured\n");
+                return;
+            }
+
+            m_File.open(FilePath, ios::out | ios::trunc);
+            if (!m_File)
+            {
+                printf("Unable to write profile trace %s\n", FilePath.c_str());
+                return;
+            }
+
+            m_FilePath = FilePath;
+            m_FramesLeft = NumFrames > 0 ? NumFrames : 1;
+            m_StartTick = GetTick();
+            m_LastTick = m_StartTick;
+            for (uint32_t& Depth : m_Depth)
+                Depth = 0;
+            m_Buffer = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            m_Separator = "\n";
+        }
+
+        // Scopes that began before the capture are left out
+        void Begin( uint32_t ThreadIndex, NameId Name, int64_t Tick )
+        {
+            if (!m_File.is_open() || Tick < m_StartTick)
+                return;
+
+            ++m_Depth[ThreadIndex];
+            WriteEvent('B', ThreadIndex, Tick, GetName(Name));
+        }
+
+        void End( uint32_t ThreadIndex, int64_t Tick )
+        {
+            if (!m_File.is_open() || m_Depth[ThreadIndex] == 0)
+                return;
+
+            --m_Depth[ThreadIndex];
+            WriteEvent('E', ThreadIndex, Tick, nullptr);
+        }
+
+        void EndFrame( void )
+        {
+            if (!m_File.is_open())
+                return;
+
+            m_File << m_Buffer;
+            m_Buffer.clear();
+
+            if (--m_FramesLeft == 0)
+                Finish();
+        }
+
+    private:
+
+        void WriteEvent( char Phase, uint32_t ThreadIndex, int64_t Tick, const wchar_t* Name )
+        {
+            char Fields[96];
+            snprintf(Fields, sizeof(Fields), "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                Phase, (double)(Tick - m_StartTick) * 1e-3, ThreadIndex);
+
+            m_Buffer += m_Separator;
+            m_Buffer += "{\"name\":\"";
+            if (Name != nullptr)
+                AppendJsonString(m_Buffer, Name);
+            m_Buffer += Fields;
+            m_Separator = ",\n";
+
+            if (Tick > m_LastTick)
+                m_LastTick = Tick;
+        }
+
+        void Finish( void )
+        {
+            const uint32_t NumThreads = s_NumThreads.load(memory_order_acquire);
+            for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+            {
+                while (m_Depth[ThreadIndex] > 0)
+                    End(ThreadIndex, m_LastTick);
+
+                wchar_t DefaultName[32];
+                const NameId ThreadName = s_Threads[ThreadIndex]->Name.load(memory_order_relaxed);
+                if (ThreadName == 0)
+                    swprintf(DefaultName, 32, L"Thread %u", ThreadIndex);
+
+                m_Buffer += m_Separator;
+                m_Buffer += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+                m_Buffer += to_string(ThreadIndex);
+                m_Buffer += ",\"args\":{\"name\":\"";
+                AppendJsonString(m_Buffer, ThreadName == 0 ? DefaultName : GetName(ThreadName));
+                m_Buffer += "\"}}";
+            }
+            m_Buffer += "\n]}\n";
+
+            m_File << m_Buffer;
+            m_File.close();
+            m_Buffer.clear();
+            printf("Wrote profile trace %s\n", m_FilePath.c_str());
+        }
+
+        ofstream m_File;
+        string m_FilePath;
+        string m_Buffer;
+        const char* m_Separator;
+        uint32_t m_FramesLeft;
+        int64_t m_StartTick;
+        int64_t m_LastTick;
+        uint32_t m_Depth[kMaxThreads];
+    };
+
+    // Replay state, only touched by CollectEvents()
+    struct ReplayScope
+    {
+        void* Handle;
+        int64_t BeginTick;
+    };
+    vector<ReplayScope> s_ReplayStacks[kMaxThreads];
+    unordered_map<uint32_t, ReplayScope> s_DetachedReplays;
+    unordered_map<uint32_t, int64_t> s_EarlyEnds;	// the end was collected before the detach
+    TraceWriter s_Trace;
+}
+
+int64_t CpuProfiler::GetTick( void )
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+NameId CpuProfiler::FindName( const wchar_t* Name )
+{
+    ThreadState& T = t_State;
+
+    const uint32_t Hash = HashName(Name);
+    auto& Cached = T.NameCache[Hash % kNameCacheSize];
+    if (Cached.Id != 0 && Cached.Hash == Hash && wcscmp(s_Names[Cached.Id], Name) == 0)
+        return Cached.Id;
+
+    NameId Id = 0;
+    {
+        lock_guard<mutex> LockGuard(s_RegistryMutex);
+
+        auto Iter = s_NameIds.find(Name);
+        if (Iter != s_NameIds.end())
+        {
+            Id = Iter->second;
+        }
+        else if (s_NumNames < kMaxNames)
+        {
+            Id = s_NumNames++;
+            s_NameStorage.emplace_back(Name);
+            s_Names[Id] = s_NameStorage.back().c_str();
+            s_NameIds.emplace(s_NameStorage.back(), Id);
+        }
+    }
+
+    Cached.Hash = Hash;
+    Cached.Id = Id;
+    return Id;
+}
+
+const wchar_t* CpuProfiler::GetName( NameId Id )
+{
+    ASSERT(Id < kMaxNames, "Invalid profiler name");
+    return s_Names[Id];
+}
+
+uint64_t CpuProfiler::GetScopeKey( NameId Name )
+{
+    const ThreadState& T = t_State;
+    const uint32_t Depth = T.Depth < kMaxDepth ? T.Depth : kMaxDepth;
+    return ScopeKey(Depth == 0 ? 0 : T.Stack[Depth - 1].Key, Name);
+}
+
+void CpuProfiler::BeginScope( NameId Name, uint32_t UserData, const void* Owner )
+{
+    ThreadState& T = t_State;
+
+    const uint32_t Depth = T.Depth++;
+    if (Depth >= kMaxDepth)
+    {
+        s_DroppedEvents.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    OpenScope& Scope = T.Stack[Depth];
+    Scope.Name = Name;
+    Scope.UserData = UserData;
+    Scope.Key = ScopeKey(Depth == 0 ? 0 : T.Stack[Depth - 1].Key, Name);
+    Scope.Owner = Owner;
+
+    // A scope inside one that wasn't recorded would show up under the wrong parent.  Room is kept for
+    // the end of every recorded scope, so an end is never lost.
+    Scope.Recorded = (Depth == 0 || T.Stack[Depth - 1].Recorded) &&
+        Push(T, kBeginEvent, Name, UserData, T.RecordedDepth + 2);
+    if (Scope.Recorded)
+        ++T.RecordedDepth;
+}
+
+uint32_t CpuProfiler::EndScope( const void* Owner )
+{
+    ThreadState& T = t_State;
+
+    if (T.Depth > kMaxDepth)
+    {
+        --T.Depth;
+        return kNoUserData;
+    }
+
+    if (T.Depth > 0 && T.Stack[T.Depth - 1].Owner == Owner)
+    {
+        const OpenScope& Scope = T.Stack[--T.Depth];
+        if (Scope.Recorded)
+        {
+            --T.RecordedDepth;
+            Push(T, kEndEvent, Scope.Name, Scope.UserData, 1);
+        }
+        return Scope.UserData;
+    }
+
+    // Not opened on this thread, so a job must have opened it and detached it
+    ASSERT(Owner != nullptr, "Profiler scopes aren't balanced");
+
+    DetachedScope Detached;
+    {
+        lock_guard<mutex> LockGuard(s_RegistryMutex);
+        auto Iter = s_DetachedScopes.find(Owner);
+        if (Iter == s_DetachedScopes.end())
+        {
+            ASSERT(false, "Closing a profiler scope that isn't open");
+            return kNoUserData;
+        }
+        Detached = Iter->second;
+        s_DetachedScopes.erase(Iter);
+    }
+
+    if (Detached.Recorded)
+        Push(T, kEndDetachedEvent, 0, Detached.Instance, T.RecordedDepth + 1);
+
+    return Detached.UserData;
+}
+
+uint32_t CpuProfiler::GetDepth( void )
+{
+    return t_State.Depth;
+}
+
+void CpuProfiler::DetachScopes( uint32_t Depth )
+{
+    ThreadState& T = t_State;
+
+    while (T.Depth > Depth)
+    {
+        if (T.Depth > kMaxDepth || T.Stack[T.Depth - 1].Owner == nullptr)
+        {
+            EndScope(nullptr);
+            continue;
+        }
+
+        const OpenScope& Scope = T.Stack[--T.Depth];
+        DetachedScope Detached = { 0, Scope.UserData, Scope.Recorded };
+        {
+            lock_guard<mutex> LockGuard(s_RegistryMutex);
+            Detached.Instance = s_NextInstance++;
+            s_DetachedScopes[Scope.Owner] = Detached;
+        }
+
+        if (Scope.Recorded)
+        {
+            --T.RecordedDepth;
+            Push(T, kDetachEvent, Scope.Name, Detached.Instance, 1);
+        }
+    }
+}
+
+void CpuProfiler::SetThreadName( const wchar_t* Name )
+{
+    ThreadBuffer* Buffer = GetBuffer(t_State);
+    if (Buffer != nullptr)
+        Buffer->Name.store(FindName(Name), memory_order_relaxed);
+}
+
+void CpuProfiler::CollectEvents( ScopeVisitor& Visitor )
+{
+    const uint32_t NumThreads = s_NumThreads.load(memory_order_acquire);
+    for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+    {
+        ThreadBuffer& Buffer = *s_Threads[ThreadIndex];
+        vector<ReplayScope>& Stack = s_ReplayStacks[ThreadIndex];
+
+        const uint32_t Write = Buffer.WriteIndex.load(memory_order_acquire);
+        uint32_t Read = Buffer.ReadIndex.load(memory_order_relaxed);
+        for (; Read != Write; ++Read)
+        {
+            const Event& E = Buffer.Events[Read % kRingSize];
+            const NameId Name = E.TypeAndName & kNameMask;
+
+            switch (E.TypeAndName >> kTypeShift)
+            {
+            case kBeginEvent:
+            {
+                void* Parent = Stack.empty() ? nullptr : Stack.back().Handle;
+                ReplayScope Scope = { Visitor.OpenScope(Parent, Name, E.UserData), E.Tick };
+                Stack.push_back(Scope);
+                s_Trace.Begin(ThreadIndex, Name, E.Tick);
+                break;
+            }
+
+            case kEndEvent:
+                if (Stack.empty())
+                    break;
+                Visitor.CloseScope(Stack.back().Handle, E.Tick - Stack.back().BeginTick);
+                Stack.pop_back();
+                s_Trace.End(ThreadIndex, E.Tick);
+                break;
+
+            // In the trace, a detached scope ends on the thread that began it
+            case kDetachEvent:
+            {
+                if (Stack.empty())
+                    break;
+                auto Early = s_EarlyEnds.find(E.UserData);
+                if (Early != s_EarlyEnds.end())
+                {
+                    Visitor.CloseScope(Stack.back().Handle, Early->second - Stack.back().BeginTick);
+                    s_EarlyEnds.erase(Early);
+                }
+                else
+                {
+                    s_DetachedReplays[E.UserData] = Stack.back();
+                }
+                Stack.pop_back();
+                s_Trace.End(ThreadIndex, E.Tick);
+                break;
+            }
+
+            case kEndDetachedEvent:
+            {
+                auto Detached = s_DetachedReplays.find(E.UserData);
+                if (Detached != s_DetachedReplays.end())
+                {
+                    Visitor.CloseScope(Detached->second.Handle, E.Tick - Detached->second.BeginTick);
+                    s_DetachedReplays.erase(Detached);
+                }
+                else
+                {
+                    s_EarlyEnds[E.UserData] = E.Tick;
+                }
+                break;
+            }
+            }
+        }
+
+        Buffer.ReadIndex.store(Read, memory_order_release);
+    }
+
+    // Only dropped events leave entries behind
+    if (s_DetachedReplays.size() > kMaxDetached)
+        s_DetachedReplays.clear();
+    if (s_EarlyEnds.size() > kMaxDetached)
+        s_EarlyEnds.clear();
+
+    s_Trace.EndFrame();
+}
+
+void CpuProfiler::CaptureTrace( const string& FilePath, uint32_t NumFrames )
+{
+    s_Trace.Start(FilePath, NumFrames);
+}
+
+const atomic<uint64_t>& CpuProfiler::GetDroppedEvents( void )
+{
+    return s_DroppedEvents;
+}
@@ -0,0 +1,76 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The CPU half of the engine profiler.  Every thread writes the begin and end of its scopes,
+// as an interned name and a timestamp, to a ring buffer of its own, so recording a scope takes no lock and
+// allocates nothing.  Once per frame one thread collects the events of every ring, replays each thread's
+// nesting, and hands the scopes to a visitor; EngineProfiling builds its timing tree that way.  The same
+// events can be written out over several frames as a Chrome trace, for chrome://tracing or Perfetto.
+// Only the standard library is used here, and time comes from std::chrono::steady_clock.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace CpuProfiler
+{
+    typedef uint32_t NameId;
+
+    // Passed as UserData when a scope has none
+    static const uint32_t kNoUserData = 0xFFFFFFFF;
+
+    // Nanoseconds
+    int64_t GetTick( void );
+    inline double TicksToMilliseconds( int64_t Ticks ) { return (double)Ticks * 1e-6; }
+
+    // Interns a name.  After a thread has seen a string once, looking it up again takes no lock.
+    NameId FindName( const wchar_t* Name );
+    const wchar_t* GetName( NameId Id );
+
+    // Identifies a scope called Name opened at this point on this thread, by its name and those of the
+    // scopes it would be nested in.
+    uint64_t GetScopeKey( NameId Name );
+
+    // Scopes nest per thread.  UserData is returned by the EndScope() that closes the scope.  A scope with
+    // an Owner, such as a command context, may be closed from another thread by passing the same Owner,
+    // but only after the job that opened it has finished (see DetachScopes).
+    void BeginScope( NameId Name, uint32_t UserData = kNoUserData, const void* Owner = nullptr );
+    uint32_t EndScope( const void* Owner = nullptr );
+
+    // The number of scopes open on this thread
+    uint32_t GetDepth( void );
+
+    // Called at the end of each job with the depth it started at.  Owned scopes the job left open are
+    // handed over to whichever thread closes them; others are closed.
+    void DetachScopes( uint32_t Depth );
+
+    // Labels this thread in traces
+    void SetThreadName( const wchar_t* Name );
+
+    class ScopeVisitor
+    {
+    public:
+        // Returns a handle for a scope nested in Parent, which is null for a thread's outermost scopes
+        virtual void* OpenScope( void* Parent, NameId Name, uint32_t UserData ) = 0;
+        virtual void CloseScope( void* Scope, int64_t Ticks ) = 0;
+    };
+
+    // Drains the events recorded on all threads since the last call.  Call once per frame from one thread.
+    void CollectEvents( ScopeVisitor& Visitor );
+
+    // Writes the events collected over the next NumFrames calls to CollectEvents() to FilePath
+    void CaptureTrace( const std::string& FilePath, uint32_t NumFrames );
+
+    // Events that were lost because a thread's ring was full
+    const std::atomic<uint64_t>& GetDroppedEvents( void );
+}
@@ -973,7 +973,8 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
                                      _In_ size_t maxsize,
                                      _In_ bool forceSRGB,
                                      _Outptr_opt_ ID3D12Resource** texture,
-                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+                                     _Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* deferredInitData = nullptr )
 {
     HRESULT hr = S_OK;
 
@@ -1182,7 +1183,12 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
             }
         }
 
-        if (SUCCEEDED(hr))
+        if (SUCCEEDED(hr) && deferredInitData != nullptr)
+        {
+            // Only the mips that were kept were filled in
+            deferredInitData->assign(initData.get(), initData.get() + (mipCount - skipMip) * arraySize);
+        }
+        else if (SUCCEEDED(hr))
         {
             GpuResource DestTexture(*texture, D3D12_RESOURCE_STATE_COPY_DEST);
             CommandContext::InitializeTexture(DestTexture, subresourceCount, initData.get());
@@ -1222,16 +1228,16 @@ static DDS_ALPHA_MODE GetAlphaMode( _In_ const DDS_HEADER* header )
 }
 
 
-_Use_decl_annotations_
-HRESULT CreateDDSTextureFromMemory(
-    ID3D12Device* d3dDevice,
-    const uint8_t* ddsData,
-    size_t ddsDataSize,
-    size_t maxsize,
-    bool forceSRGB,
-    ID3D12Resource** texture,
-    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
-    DDS_ALPHA_MODE* alphaMode )
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromMemory( _In_ ID3D12Device* d3dDevice,
+                                        _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                        _In_ size_t ddsDataSize,
+                                        _In_ size_t maxsize,
+                                        _In_ bool forceSRGB,
+                                        _Outptr_opt_ ID3D12Resource** texture,
+                                        _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+                                        _Out_opt_ DDS_ALPHA_MODE* alphaMode,
+                                        _Out_opt_ std::vector<D3D12_SUBRESOURCE_DATA>* deferredInitData )
 {
     if ( texture )
     {
@@ -1284,7 +1290,7 @@ HRESULT CreateDDSTextureFromMemory(
 
     HRESULT hr = CreateTextureFromDDS( d3dDevice,
                                        header, ddsData + offset, ddsDataSize - offset, maxsize,
-                                       forceSRGB, texture, textureView );
+                                       forceSRGB, texture, textureView, deferredInitData );
     if ( SUCCEEDED(hr) )
     {
         if (texture != nullptr && *texture != nullptr)
@@ -1300,6 +1306,40 @@ HRESULT CreateDDSTextureFromMemory(
 }
 
 
+_Use_decl_annotations_
+HRESULT CreateDDSTextureFromMemory(
+    ID3D12Device* d3dDevice,
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    size_t maxsize,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+    DDS_ALPHA_MODE* alphaMode )
+{
+    return CreateTextureFromMemory( d3dDevice, ddsData, ddsDataSize, maxsize, forceSRGB, texture, textureView,
+                                    alphaMode, nullptr );
+}
+
+
+_Use_decl_annotations_
+HRESULT CreateDDSTextureFromMemoryDeferred(
+    ID3D12Device* d3dDevice,
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    size_t maxsize,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+    std::vector<D3D12_SUBRESOURCE_DATA>& initData,
+    DDS_ALPHA_MODE* alphaMode )
+{
+    initData.clear();
+    return CreateTextureFromMemory( d3dDevice, ddsData, ddsDataSize, maxsize, forceSRGB, texture, textureView,
+                                    alphaMode, &initData );
+}
+
+
 _Use_decl_annotations_
 HRESULT CreateDDSTextureFromFile(
     ID3D12Device* d3dDevice,
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <d3d12.h>
+#include <vector>
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -46,6 +47,19 @@ HRESULT __cdecl CreateDDSTextureFromMemory( _In_ ID3D12Device* d3dDevice,
                                                 _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                             );
 
+// Creates the texture, in the COPY_DEST state, and its view without uploading the texels.  initData receives
+// one entry per subresource, pointing into ddsData, for the caller to copy in.
+HRESULT __cdecl CreateDDSTextureFromMemoryDeferred( _In_ ID3D12Device* d3dDevice,
+                                                _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                                _In_ size_t ddsDataSize,
+                                                _In_ size_t maxsize,
+                                                _In_ bool forceSRGB,
+                                                _Outptr_opt_ ID3D12Resource** texture,
+                                                _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+                                                _Out_ std::vector<D3D12_SUBRESOURCE_DATA>& initData,
+                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+                                            );
+
 HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             _In_z_ const wchar_t* szFileName,
                                             _In_ size_t maxsize,
@@ -15,6 +15,7 @@
 #include "DescriptorHeap.h"
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
+#include "CommandContext.h"
 
 using namespace Graphics;
 
@@ -26,6 +27,11 @@ std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::s
 
 void DescriptorAllocator::DestroyAll(void)
 {
+    for (uint32_t i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; ++i)
+    {
+        g_DescriptorAllocator[i].m_Slots.Destroy();
+        g_DescriptorAllocator[i].m_HeapCount = 0;
+    }
     sm_DescriptorHeapPool.clear();
 }
 
@@ -45,22 +51,54 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
     return pHeap.Get();
 }
 
+void DescriptorAllocator::CreateHeap( uint32_t HeapIndex )
+{
+    ASSERT(HeapIndex < sm_MaxHeapsPerType, "Out of descriptor heaps");
+
+    if (m_DescriptorSize == 0)
+        m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+
+    m_HeapStarts[HeapIndex] = RequestNewHeap(m_Type)->GetCPUDescriptorHandleForHeapStart();
+    m_HeapCount.store(HeapIndex + 1, std::memory_order_release);
+}
+
+// The "fence" for a freed run is the context serial current at the free, not a GPU fence.  See Free().
+bool DescriptorAllocator::IsFenceComplete( uint64_t FenceValue )
+{
+    return g_ContextManager.GetOldestOpenSerial() >= FenceValue;
+}
+
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
-    {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
-        m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+    const uint32_t Slot = m_Slots.Allocate(Count);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_HeapStarts[Slot / sm_NumDescriptorsPerHeap];
+    ret.ptr += (Slot % sm_NumDescriptorsPerHeap) * m_DescriptorSize;
+    return ret;
+}
 
-        if (m_DescriptorSize == 0)
-            m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    const uint32_t HeapCount = m_HeapCount.load(std::memory_order_acquire);
+    const SIZE_T HeapSize = (SIZE_T)sm_NumDescriptorsPerHeap * m_DescriptorSize;
+
+    for (uint32_t HeapIndex = 0; HeapIndex < HeapCount; ++HeapIndex)
+    {
+        const SIZE_T Start = m_HeapStarts[HeapIndex].ptr;
+        if (Handle.ptr < Start || Handle.ptr >= Start + HeapSize)
+            continue;
+
+        // Descriptors are only read on the CPU, when they're copied into a shader-visible heap or bound
+        // as a render target while recording, so the GPU never sees them.  A context that is still open
+        // may have them staged though, and the dynamic heap's table cache assumes they aren't rewritten
+        // under it.  GPU fences can't tell when that ends (another thread's Finish can complete the next
+        // fence while this context records), so the slots wait until every context open now has closed.
+        const uint32_t Slot = HeapIndex * sm_NumDescriptorsPerHeap + (uint32_t)((Handle.ptr - Start) / m_DescriptorSize);
+        m_Slots.Free(Slot, Count, g_ContextManager.GetNextSerial());
+        return;
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
-    m_CurrentHandle.ptr += Count * m_DescriptorSize;
-    m_RemainingFreeHandles -= Count;
-    return ret;
+    ASSERT(false, "Freeing a descriptor that wasn't allocated here");
 }
 
 //
@@ -13,36 +13,49 @@
 
 #pragma once
 
+#include "DescriptorSlotAllocator.h"
 #include <mutex>
 #include <vector>
 #include <queue>
 #include <string>
+#include <atomic>
 
 
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible resource descriptors
 // as resources are created.  For those that need to be made shader-visible, they will need to be copied to a UserDescriptorHeap
-// or a DynamicDescriptorHeap.
-class DescriptorAllocator
+// or a DynamicDescriptorHeap.  Freed descriptors are reused once every context that was open at the free has closed.
+class DescriptorAllocator : public DescriptorHeapSource
 {
 public:
-    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_CurrentHeap(nullptr) {}
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_DescriptorSize(0), m_HeapCount(0),
+        m_Slots(*this, sm_NumDescriptorsPerHeap) {}
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
 
     static void DestroyAll(void);
 
 protected:
 
-    static const uint32_t sm_NumDescriptorsPerHeap = 256;
+    // DescriptorHeapSource
+    virtual void CreateHeap( uint32_t HeapIndex ) override;
+    virtual bool IsFenceComplete( uint64_t FenceValue ) override;
+
+    static const uint32_t sm_NumDescriptorsPerHeap = 1024;
+    static const uint32_t sm_MaxHeapsPerType = 1024;
     static std::mutex sm_AllocationMutex;
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
-    uint32_t m_RemainingFreeHandles;
+
+    // Heap starts by heap index.  A heap is published by bumping the count after its start is written,
+    // so Free() can look handles up without taking the slot allocator's lock.
+    D3D12_CPU_DESCRIPTOR_HANDLE m_HeapStarts[sm_MaxHeapsPerType];
+    std::atomic<uint32_t> m_HeapCount;
+
+    DescriptorSlotAllocator m_Slots;
 };
 
 
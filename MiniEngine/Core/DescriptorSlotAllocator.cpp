@@ -0,0 +1,292 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/DescriptorSlotAllocatorTest.cpp)
+#include "DescriptorSlotAllocator.h"
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+using namespace std;
+
+namespace
+{
+    inline uint32_t FirstSetBit( uint32_t Bits )
+    {
+#ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanForward(&Index, Bits);
+        return Index;
+#else
+        return (uint32_t)__builtin_ctz(Bits);
+#endif
+    }
+
+    inline uint32_t LastSetBit( uint32_t Bits )
+    {
+#ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanReverse(&Index, Bits);
+        return Index;
+#else
+        return 31 - (uint32_t)__builtin_clz(Bits);
+#endif
+    }
+
+    // A thread hands its cache index back when it exits, and the next thread to arrive takes over that
+    // cache along with the slots still in it.  Without this, every short-lived thread would strand an
+    // index and the slots it cached.
+    mutex s_ThreadSlotMutex;
+    vector<uint32_t> s_FreeThreadSlots;
+    uint32_t s_NextThreadSlot = 0;
+
+    struct ThreadSlotOwner
+    {
+        uint32_t Slot;
+
+        ThreadSlotOwner()
+        {
+            lock_guard<mutex> LockGuard(s_ThreadSlotMutex);
+            if (!s_FreeThreadSlots.empty())
+            {
+                Slot = s_FreeThreadSlots.back();
+                s_FreeThreadSlots.pop_back();
+            }
+            else if (s_NextThreadSlot < DescriptorSlotAllocator::kMaxThreads)
+                Slot = s_NextThreadSlot++;
+            else
+                Slot = DescriptorSlotAllocator::kMaxThreads;
+        }
+
+        ~ThreadSlotOwner()
+        {
+            if (Slot < DescriptorSlotAllocator::kMaxThreads)
+            {
+                lock_guard<mutex> LockGuard(s_ThreadSlotMutex);
+                s_FreeThreadSlots.push_back(Slot);
+            }
+        }
+    };
+}
+
+DescriptorSlotAllocator::DescriptorSlotAllocator( DescriptorHeapSource& Source, uint32_t DescriptorsPerHeap )
+    : m_Source(Source), m_DescriptorsPerHeap(DescriptorsPerHeap), m_NonEmptyClasses(0),
+    m_HeapCount(0), m_AllocatedCount(0), m_PendingCount(0)
+{
+    // Keeps the largest run within the last size class
+    ASSERT(DescriptorsPerHeap > 0 && DescriptorsPerHeap < (1u << 20), "Unsupported descriptor heap size");
+
+    for (uint32_t i = 0; i < kNumSizeClasses; ++i)
+        m_ListHeads[i] = kNoSlot;
+}
+
+uint32_t DescriptorSlotAllocator::GetThreadSlot( void )
+{
+    static thread_local ThreadSlotOwner t_Owner;
+    return t_Owner.Slot;
+}
+
+uint32_t DescriptorSlotAllocator::GetSizeClass( uint32_t Count )
+{
+    if (Count < kNumExactClasses)
+        return Count;
+
+    return kNumExactClasses + LastSetBit(Count) - 4;
+}
+
+void DescriptorSlotAllocator::InsertRun( uint32_t Slot, uint32_t Count )
+{
+    const uint32_t SizeClass = GetSizeClass(Count);
+
+    m_RunLength[Slot] = Count;
+    m_RunLength[Slot + Count - 1] = Count;
+    m_RunPrev[Slot] = kNoSlot;
+    m_RunNext[Slot] = m_ListHeads[SizeClass];
+    if (m_ListHeads[SizeClass] != kNoSlot)
+        m_RunPrev[m_ListHeads[SizeClass]] = Slot;
+    m_ListHeads[SizeClass] = Slot;
+    m_NonEmptyClasses |= 1u << SizeClass;
+}
+
+void DescriptorSlotAllocator::RemoveRun( uint32_t Slot )
+{
+    const uint32_t Count = m_RunLength[Slot];
+    const uint32_t SizeClass = GetSizeClass(Count);
+
+    const uint32_t Next = m_RunNext[Slot];
+    const uint32_t Prev = m_RunPrev[Slot];
+    if (Next != kNoSlot)
+        m_RunPrev[Next] = Prev;
+    if (Prev != kNoSlot)
+        m_RunNext[Prev] = Next;
+    else
+        m_ListHeads[SizeClass] = Next;
+
+    if (m_ListHeads[SizeClass] == kNoSlot)
+        m_NonEmptyClasses &= ~(1u << SizeClass);
+
+    m_RunLength[Slot] = 0;
+    m_RunLength[Slot + Count - 1] = 0;
+}
+
+void DescriptorSlotAllocator::ReleaseRun( uint32_t Slot, uint32_t Count )
+{
+    // Merge with a free run ending just before, and one starting just after, unless that crosses
+    // into another heap
+    if (Slot % m_DescriptorsPerHeap != 0 && m_RunLength[Slot - 1] != 0)
+    {
+        const uint32_t PrevCount = m_RunLength[Slot - 1];
+        Slot -= PrevCount;
+        Count += PrevCount;
+        RemoveRun(Slot);
+    }
+
+    const uint32_t End = Slot + Count;
+    if (End % m_DescriptorsPerHeap != 0 && m_RunLength[End] != 0)
+    {
+        Count += m_RunLength[End];
+        RemoveRun(End);
+    }
+
+    InsertRun(Slot, Count);
+}
+
+uint32_t DescriptorSlotAllocator::AllocateLocked( uint32_t Count )
+{
+    // Every run in a class above the request's class fits.  Runs in the request's own class only fit
+    // for sure when it's an exact length class.
+    const uint32_t SizeClass = GetSizeClass(Count);
+    uint32_t Slot = kNoSlot;
+
+    if (SizeClass < kNumExactClasses && m_ListHeads[SizeClass] != kNoSlot)
+    {
+        Slot = m_ListHeads[SizeClass];
+    }
+    else
+    {
+        const uint32_t Larger = SizeClass + 1 < kNumSizeClasses ? m_NonEmptyClasses & ~((2u << SizeClass) - 1) : 0;
+        if (Larger != 0)
+        {
+            Slot = m_ListHeads[FirstSetBit(Larger)];
+        }
+        else
+        {
+            for (uint32_t Run = m_ListHeads[SizeClass]; Run != kNoSlot; Run = m_RunNext[Run])
+            {
+                if (m_RunLength[Run] >= Count)
+                {
+                    Slot = Run;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (Slot == kNoSlot)
+    {
+        // Nothing fits, add a heap
+        const uint32_t HeapIndex = m_HeapCount++;
+        m_Source.CreateHeap(HeapIndex);
+
+        const size_t SlotCount = (size_t)m_HeapCount * m_DescriptorsPerHeap;
+        m_RunNext.resize(SlotCount, (uint32_t)kNoSlot);
+        m_RunPrev.resize(SlotCount, (uint32_t)kNoSlot);
+        m_RunLength.resize(SlotCount, 0);
+
+        Slot = HeapIndex * m_DescriptorsPerHeap;
+        InsertRun(Slot, m_DescriptorsPerHeap);
+    }
+
+    // Take the front of the run and put the rest back
+    const uint32_t RunCount = m_RunLength[Slot];
+    RemoveRun(Slot);
+    if (RunCount > Count)
+        InsertRun(Slot + Count, RunCount - Count);
+
+    m_AllocatedCount += Count;
+    return Slot;
+}
+
+void DescriptorSlotAllocator::RetireCompletedRuns( void )
+{
+    while (!m_PendingRuns.empty() && m_Source.IsFenceComplete(m_PendingRuns.front().FenceValue))
+    {
+        const PendingRun& Retired = m_PendingRuns.front();
+        ReleaseRun(Retired.Slot, Retired.Count);
+        m_PendingCount -= Retired.Count;
+        m_PendingRuns.pop_front();
+    }
+}
+
+uint32_t DescriptorSlotAllocator::Allocate( uint32_t Count )
+{
+    ASSERT(Count > 0 && Count <= m_DescriptorsPerHeap, "Descriptor range doesn't fit in a heap");
+
+    const uint32_t ThreadSlot = GetThreadSlot();
+    if (Count == 1 && ThreadSlot < kMaxThreads)
+    {
+        vector<uint32_t>& Cache = m_ThreadCaches[ThreadSlot].Slots;
+        if (Cache.empty())
+        {
+            lock_guard<mutex> LockGuard(m_Mutex);
+            RetireCompletedRuns();
+            for (uint32_t i = 0; i < kThreadCacheRefill; ++i)
+                Cache.push_back(AllocateLocked(1));
+        }
+
+        const uint32_t Slot = Cache.back();
+        Cache.pop_back();
+        return Slot;
+    }
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    RetireCompletedRuns();
+    return AllocateLocked(Count);
+}
+
+void DescriptorSlotAllocator::Free( uint32_t Slot, uint32_t Count, uint64_t FenceValue )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    ASSERT(Count <= m_AllocatedCount, "Freeing more descriptors than were allocated");
+    m_AllocatedCount -= Count;
+    m_PendingCount += Count;
+
+    PendingRun Pending;
+    Pending.FenceValue = FenceValue;
+    Pending.Slot = Slot;
+    Pending.Count = Count;
+    m_PendingRuns.push_back(Pending);
+}
+
+void DescriptorSlotAllocator::Destroy( void )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    for (ThreadCache& Cache : m_ThreadCaches)
+        Cache.Slots.clear();
+
+    for (uint32_t i = 0; i < kNumSizeClasses; ++i)
+        m_ListHeads[i] = kNoSlot;
+    m_NonEmptyClasses = 0;
+    m_RunNext.clear();
+    m_RunPrev.clear();
+    m_RunLength.clear();
+    m_PendingRuns.clear();
+
+    m_HeapCount = 0;
+    m_AllocatedCount = 0;
+    m_PendingCount = 0;
+}
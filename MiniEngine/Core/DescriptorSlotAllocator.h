@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The bookkeeping behind DescriptorAllocator.  Descriptors are numbered slots, heap after
+// heap, and the allocator hands out runs of contiguous slots that never cross a heap.  It is a TLSF-style
+// range allocator:  free runs sit on segregated lists, one per length up to 15 and one per power of two
+// above that, and a mask of the non-empty lists finds a run that fits with a single bit scan.  Freed
+// runs wait for a fence, then merge with free neighbours in the same heap.  Single slots, which are
+// most requests, come from a small per-thread cache that refills in bunches.  A thread's cache passes to
+// a later thread when it exits.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class DescriptorHeapSource
+{
+public:
+    virtual ~DescriptorHeapSource() {}
+
+    // Heaps are created in order, so heap N holds slots [N * DescriptorsPerHeap, (N + 1) * DescriptorsPerHeap)
+    virtual void CreateHeap( uint32_t HeapIndex ) = 0;
+    virtual bool IsFenceComplete( uint64_t FenceValue ) = 0;
+};
+
+class DescriptorSlotAllocator
+{
+public:
+    enum
+    {
+        kMaxThreads = 64,       // threads running at once past this go straight to the shared lists
+        kThreadCacheRefill = 16,
+        kNumExactClasses = 16,  // runs of 1-15 slots have a list per length
+        kNumSizeClasses = 32    // then one list per power of two
+    };
+
+    DescriptorSlotAllocator( DescriptorHeapSource& Source, uint32_t DescriptorsPerHeap );
+
+    // Returns the first of Count contiguous slots
+    uint32_t Allocate( uint32_t Count );
+
+    // The slots are handed out again once the fence has completed
+    void Free( uint32_t Slot, uint32_t Count, uint64_t FenceValue );
+
+    // Forgets every slot and heap
+    void Destroy( void );
+
+    uint32_t GetDescriptorsPerHeap( void ) const { return m_DescriptorsPerHeap; }
+    uint32_t GetHeapCount( void ) const { return m_HeapCount; }
+
+    // Slots held by callers or thread caches, and slots waiting for their fence
+    uint32_t GetAllocatedCount( void ) const { return m_AllocatedCount; }
+    uint32_t GetPendingCount( void ) const { return m_PendingCount; }
+
+private:
+
+    static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+    struct PendingRun
+    {
+        uint64_t FenceValue;
+        uint32_t Slot;
+        uint32_t Count;
+    };
+
+    struct alignas(64) ThreadCache
+    {
+        std::vector<uint32_t> Slots;
+    };
+
+    static uint32_t GetThreadSlot( void );
+    static uint32_t GetSizeClass( uint32_t Count );
+
+    // These expect m_Mutex to be held
+    uint32_t AllocateLocked( uint32_t Count );
+    void InsertRun( uint32_t Slot, uint32_t Count );
+    void RemoveRun( uint32_t Slot );
+    void ReleaseRun( uint32_t Slot, uint32_t Count );
+    void RetireCompletedRuns( void );
+
+    DescriptorHeapSource& m_Source;
+    const uint32_t m_DescriptorsPerHeap;
+
+    std::mutex m_Mutex;
+
+    // Free runs are doubly linked through their first slot.  The run length is stored at both its
+    // first and its last slot, so a run being freed can find the free runs on either side.
+    uint32_t m_ListHeads[kNumSizeClasses];
+    uint32_t m_NonEmptyClasses;
+    std::vector<uint32_t> m_RunNext;
+    std::vector<uint32_t> m_RunPrev;
+    std::vector<uint32_t> m_RunLength;      // 0 unless the slot starts or ends a free run
+
+    std::deque<PendingRun> m_PendingRuns;
+    uint32_t m_HeapCount;
+    uint32_t m_AllocatedCount;
+    uint32_t m_PendingCount;
+
+    ThreadCache m_ThreadCaches[kMaxThreads];
+};
@@ -17,6 +17,8 @@
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
 #include "RootSignature.h"
+#include "EngineProfiling.h"
+#include "Hash.h"
 
 using namespace Graphics;
 
@@ -29,6 +31,22 @@ std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap:
 std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
 std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
 
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TablesCommitted(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TableCacheHits(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_DescriptorsCopied(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_CopyCallsSaved(0);
+
+bool DynamicDescriptorHeap::RegisterCounters( void )
+{
+    EngineProfiling::RegisterCounter("Descriptor Tables Committed", sm_TablesCommitted);
+    EngineProfiling::RegisterRatio("Descriptor Table Hit Rate", sm_TableCacheHits, sm_TablesCommitted);
+    EngineProfiling::RegisterCounter("Descriptors Copied", sm_DescriptorsCopied);
+    EngineProfiling::RegisterCounter("CopyDescriptors Calls Saved", sm_CopyCallsSaved);
+    return true;
+}
+
+const bool DynamicDescriptorHeap::sm_CountersRegistered = DynamicDescriptorHeap::RegisterCounters();
+
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 {
     std::lock_guard<std::mutex> LockGuard(sm_Mutex);
@@ -82,6 +100,7 @@ void DynamicDescriptorHeap::RetireCurrentHeap( void )
     m_RetiredHeaps.push_back(m_CurrentHeapPtr);
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+    ClearCommittedTables();
 }
 
 void DynamicDescriptorHeap::RetireUsedHeaps( uint64_t fenceValue )
@@ -96,6 +115,7 @@ DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D1
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
     m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(HeapType);
+    ClearCommittedTables();
 }
 
 DynamicDescriptorHeap::~DynamicDescriptorHeap()
@@ -143,7 +163,7 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
     return NeededSpace;
 }
 
-void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize,
     DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
@@ -177,6 +197,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     m_StaleRootParamsBitMap = 0;
 
     static const uint32_t kMaxDescriptorsPerCopy = 16;
+    uint32_t NumCopied = 0;
     UINT NumDestDescriptorRanges = 0;
     D3D12_CPU_DESCRIPTOR_HANDLE pDestDescriptorRangeStarts[kMaxDescriptorsPerCopy];
     UINT pDestDescriptorRangeSizes[kMaxDescriptorsPerCopy];
@@ -237,6 +258,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
             // Move the destination pointer forward by the number of descriptors we will copy
             SrcHandles += DescriptorCount;
             CurDest.ptr += DescriptorCount * DescriptorSize;
+            NumCopied += DescriptorCount;
         }
     }
 
@@ -244,11 +266,126 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
         NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
         NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
         Type);
+
+    return NumCopied;
 }
     
+size_t DynamicDescriptorHeap::HashTable( const DescriptorTableCache& Table )
+{
+    // Only assigned handles get copied, so they and their positions are the whole key
+    size_t Hash = Utility::HashState(&Table.AssignedHandlesBitMap);
+
+    uint64_t SetHandles = Table.AssignedHandlesBitMap;
+    unsigned long First;
+    while (_BitScanForward64(&First, SetHandles))
+    {
+        unsigned long Count;
+        _BitScanForward64(&Count, ~(SetHandles >> First));
+        Hash = Utility::HashState(Table.TableStart + First, Count, Hash);
+        SetHandles &= ~(((1ull << Count) - 1) << First);
+    }
+    return Hash;
+}
+
+uint32_t DynamicDescriptorHeap::FindCommittedTable( const DescriptorTableCache& Table, size_t Hash ) const
+{
+    for (uint32_t Slot = (uint32_t)Hash % kNumCommittedTableSlots; m_CommittedTables[Slot].Offset != kNotCommitted;
+        Slot = (Slot + 1) % kNumCommittedTableSlots)
+    {
+        const CommittedTable& Entry = m_CommittedTables[Slot];
+        if (Entry.Hash != Hash || Entry.AssignedHandlesBitMap != Table.AssignedHandlesBitMap)
+            continue;
+
+        // The hash might be as narrow as 32 bits, so compare the handles themselves
+        unsigned long Index;
+        uint32_t SetHandles = Table.AssignedHandlesBitMap;
+        while (_BitScanForward(&Index, SetHandles))
+        {
+            if (m_HeapContents[Entry.Offset + Index].ptr != Table.TableStart[Index].ptr)
+                break;
+            SetHandles ^= (1 << Index);
+        }
+
+        if (SetHandles == 0)
+            return Entry.Offset;
+    }
+
+    return kNotCommitted;
+}
+
+void DynamicDescriptorHeap::AddCommittedTable( const DescriptorTableCache& Table, size_t Hash, uint32_t Offset )
+{
+    // Once full, tables are still copied but no longer remembered until the next heap
+    if (m_NumCommittedTables == kMaxCommittedTables)
+        return;
+
+    uint32_t Slot = (uint32_t)Hash % kNumCommittedTableSlots;
+    while (m_CommittedTables[Slot].Offset != kNotCommitted)
+        Slot = (Slot + 1) % kNumCommittedTableSlots;
+
+    CommittedTable& Entry = m_CommittedTables[Slot];
+    Entry.Hash = Hash;
+    Entry.Offset = Offset;
+    Entry.AssignedHandlesBitMap = Table.AssignedHandlesBitMap;
+    ++m_NumCommittedTables;
+
+    unsigned long MaxSetHandle;
+    _BitScanReverse(&MaxSetHandle, Table.AssignedHandlesBitMap);
+    for (uint32_t i = 0; i <= MaxSetHandle; ++i)
+        m_HeapContents[Offset + i] = Table.TableStart[i];
+}
+
+void DynamicDescriptorHeap::ClearCommittedTables( void )
+{
+    for (uint32_t i = 0; i < kNumCommittedTableSlots; ++i)
+        m_CommittedTables[i].Offset = kNotCommitted;
+    m_NumCommittedTables = 0;
+}
+
 void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
+    size_t TableHashes[DescriptorHandleCache::kMaxNumDescriptorTables];
+    uint32_t HashedParams = 0;
+    uint32_t NumTables = 0;
+    uint32_t NumHits = 0;
+    unsigned long RootIndex;
+
+    // Rebind tables whose handles are already in the current heap
+    if (m_CurrentHeapPtr != nullptr)
+        m_OwningContext.SetDescriptorHeap(m_DescriptorType, m_CurrentHeapPtr);
+
+    uint32_t StaleParams = HandleCache.m_StaleRootParamsBitMap;
+    while (_BitScanForward(&RootIndex, StaleParams))
+    {
+        StaleParams ^= (1 << RootIndex);
+        ++NumTables;
+
+        if (m_CurrentHeapPtr == nullptr)
+            continue;
+
+        const DescriptorTableCache& Table = HandleCache.m_RootDescriptorTable[RootIndex];
+        TableHashes[RootIndex] = HashTable(Table);
+        HashedParams |= (1 << RootIndex);
+
+        const uint32_t Offset = FindCommittedTable(Table, TableHashes[RootIndex]);
+        if (Offset != kNotCommitted)
+        {
+            (CmdList->*SetFunc)(RootIndex, (m_FirstDescriptor + Offset * m_DescriptorSize).GetGpuHandle());
+            HandleCache.m_StaleRootParamsBitMap ^= (1 << RootIndex);
+            ++NumHits;
+        }
+    }
+
+    sm_TablesCommitted.fetch_add(NumTables, std::memory_order_relaxed);
+    sm_TableCacheHits.fetch_add(NumHits, std::memory_order_relaxed);
+
+    if (HandleCache.m_StaleRootParamsBitMap == 0)
+    {
+        sm_CopyCallsSaved.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
     uint32_t NeededSize = HandleCache.ComputeStagedSize();
     if (!HasSpace(NeededSize))
     {
@@ -259,7 +396,25 @@ void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& Hand
 
     // This can trigger the creation of a new heap
     m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
-    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+    DescriptorHandle DestHandleStart = Allocate(NeededSize);
+
+    // Remember where each table lands.  CopyAndBindStaleTables lays them out in root index order.
+    uint32_t Offset = m_CurrentOffset - NeededSize;
+    StaleParams = HandleCache.m_StaleRootParamsBitMap;
+    while (_BitScanForward(&RootIndex, StaleParams))
+    {
+        StaleParams ^= (1 << RootIndex);
+
+        const DescriptorTableCache& Table = HandleCache.m_RootDescriptorTable[RootIndex];
+        AddCommittedTable(Table, (HashedParams & (1 << RootIndex)) ? TableHashes[RootIndex] : HashTable(Table), Offset);
+
+        unsigned long MaxSetHandle;
+        _BitScanReverse(&MaxSetHandle, Table.AssignedHandlesBitMap);
+        Offset += MaxSetHandle + 1;
+    }
+
+    const uint32_t NumCopied = HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, DestHandleStart, CmdList, SetFunc);
+    sm_DescriptorsCopied.fetch_add(NumCopied, std::memory_order_relaxed);
 }
 
 void DynamicDescriptorHeap::UnbindAllValid( void )
@@ -15,6 +15,7 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include <atomic>
 #include <vector>
 #include <queue>
 
@@ -26,6 +27,10 @@ namespace Graphics
 // This class is a linear allocation system for dynamically generated descriptor tables.  It internally caches
 // CPU descriptor handles so that when not enough space is available in the current heap, necessary descriptors
 // can be re-copied to the new heap.
+//
+// Tables copied to the current heap are remembered by the handles they hold, so committing the same handles
+// again (as consecutive draws with one material do) rebinds the copy instead of making another.  That assumes
+// the CPU descriptors behind a handle aren't rewritten while a context is recording.
 class DynamicDescriptorHeap
 {
 public:
@@ -87,8 +92,16 @@ private:
     static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
     static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
 
+    // Running totals for the profiler
+    static std::atomic<uint64_t> sm_TablesCommitted;
+    static std::atomic<uint64_t> sm_TableCacheHits;
+    static std::atomic<uint64_t> sm_DescriptorsCopied;
+    static std::atomic<uint64_t> sm_CopyCallsSaved;
+    static const bool sm_CountersRegistered;
+
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
+    static bool RegisterCounters( void );
     static void DiscardDescriptorHeaps( D3D12_DESCRIPTOR_HEAP_TYPE HeapType, uint64_t FenceValueForReset, const std::vector<ID3D12DescriptorHeap*>& UsedHeaps );
 
     // Non-static members
@@ -130,7 +143,7 @@ private:
         static const uint32_t kMaxNumDescriptorTables = 16;
 
         uint32_t ComputeStagedSize();
-        void CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
+        uint32_t CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
             void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
 
         DescriptorTableCache m_RootDescriptorTable[kMaxNumDescriptorTables];
@@ -144,6 +157,28 @@ private:
     DescriptorHandleCache m_GraphicsHandleCache;
     DescriptorHandleCache m_ComputeHandleCache;
 
+    // A table copied to the current heap.  The slots are open addressed by hash, and an entry is only trusted
+    // once the handles recorded in m_HeapContents match.
+    struct CommittedTable
+    {
+        size_t Hash;
+        uint32_t Offset;
+        uint32_t AssignedHandlesBitMap;
+    };
+
+    static const uint32_t kNotCommitted = 0xFFFFFFFF;
+    static const uint32_t kNumCommittedTableSlots = 512;
+    static const uint32_t kMaxCommittedTables = kNumCommittedTableSlots * 3 / 4;
+
+    CommittedTable m_CommittedTables[kNumCommittedTableSlots];
+    uint32_t m_NumCommittedTables;
+    D3D12_CPU_DESCRIPTOR_HANDLE m_HeapContents[kNumDescriptorsPerHeap];	// source handle of each copied descriptor
+
+    static size_t HashTable( const DescriptorTableCache& Table );
+    uint32_t FindCommittedTable( const DescriptorTableCache& Table, size_t Hash ) const;
+    void AddCommittedTable( const DescriptorTableCache& Table, size_t Hash, uint32_t Offset );
+    void ClearCommittedTables( void );
+
     bool HasSpace( uint32_t Count )
     {
         return (m_CurrentHeapPtr != nullptr && m_CurrentOffset + Count <= kNumDescriptorsPerHeap);
@@ -12,7 +12,7 @@
 //
 
 #include "pch.h"
-#include "SystemTime.h"
+#include "CpuProfiler.h"
 #include "GraphicsCore.h"
 #include "TextRenderer.h"
 #include "GraphRenderer.h"
@@ -22,6 +22,7 @@
 #include <vector>
 #include <unordered_map>
 #include <array>
+#include <mutex>
 
 using namespace Graphics;
 using namespace GraphRenderer;
@@ -95,6 +96,69 @@ private:
     float m_Maximum;
 };
 
+class EventCounter
+{
+public:
+    EventCounter( const char* Name, const atomic<uint64_t>& Total, const atomic<uint64_t>* Whole = nullptr ) :
+        m_Name(Name), m_Total(Total), m_Whole(Whole), m_LastTotal(Total.load(memory_order_relaxed)),
+        m_LastWhole(Whole ? Whole->load(memory_order_relaxed) : 0), m_Average(0.0f)
+    {
+        for (uint32_t i = 0; i < kHistorySize; ++i)
+        {
+            m_History[i] = 0;
+            m_WholeHistory[i] = 0;
+        }
+    }
+
+    void Update( uint32_t FrameIndex )
+    {
+        const uint64_t Total = m_Total.load(memory_order_relaxed);
+        m_History[FrameIndex % kHistorySize] = (uint32_t)(Total - m_LastTotal);
+        m_LastTotal = Total;
+
+        uint64_t Sum = 0;
+        for (uint32_t Count : m_History)
+            Sum += Count;
+
+        if (m_Whole == nullptr)
+        {
+            m_Average = (float)Sum / kHistorySize;
+            return;
+        }
+
+        const uint64_t Whole = m_Whole->load(memory_order_relaxed);
+        m_WholeHistory[FrameIndex % kHistorySize] = (uint32_t)(Whole - m_LastWhole);
+        m_LastWhole = Whole;
+
+        uint64_t WholeSum = 0;
+        for (uint32_t Count : m_WholeHistory)
+            WholeSum += Count;
+        m_Average = WholeSum == 0 ? 0.0f : 100.0f * (float)Sum / (float)WholeSum;
+    }
+
+    const char* GetName( void ) const { return m_Name; }
+    float GetAvg( void ) const { return m_Average; }
+    bool IsRatio( void ) const { return m_Whole != nullptr; }
+
+private:
+    static const uint32_t kHistorySize = 64;
+    const char* m_Name;
+    const atomic<uint64_t>& m_Total;
+    const atomic<uint64_t>* m_Whole;
+    uint64_t m_LastTotal;
+    uint64_t m_LastWhole;
+    uint32_t m_History[kHistorySize];
+    uint32_t m_WholeHistory[kHistorySize];
+    float m_Average;
+};
+
+// Counters register themselves during static initialization, so the list can't be a global
+static vector<EventCounter>& GetEventCounters( void )
+{
+    static vector<EventCounter> s_Counters(1, EventCounter("Profiler Events Dropped", CpuProfiler::GetDroppedEvents()));
+    return s_Counters;
+}
+
 class StatPlot
 {
 public:
@@ -158,52 +222,20 @@ private:
     vector<StatGraph> m_Graphs;
 };
 
-class GpuTimer
-{
-public:
-
-    GpuTimer::GpuTimer()
-    {
-        m_TimerIndex = GpuTimeManager::NewTimer();
-    }
-
-    void Start(CommandContext& Context)
-    {
-        GpuTimeManager::StartTimer(Context, m_TimerIndex);
-    }
-
-    void Stop(CommandContext& Context)
-    {
-        GpuTimeManager::StopTimer(Context, m_TimerIndex);
-    }
-
-    float GpuTimer::GetTime(void)
-    {
-        return GpuTimeManager::GetTime(m_TimerIndex);
-    }
-
-    uint32_t GetTimerIndex(void)
-    {
-        return m_TimerIndex;
-    }
-private:
-
-    uint32_t m_TimerIndex;
-};
-
 class NestedTimingTree
 {
 public:
     NestedTimingTree( const wstring& name, NestedTimingTree* parent = nullptr )
-        : m_Name(name), m_Parent(parent), m_IsExpanded(false), m_IsGraphed(false), m_GraphHandle(PERF_GRAPH_ERROR) {}
+        : m_Name(name), m_Parent(parent), m_CpuTicks(0), m_GpuTimerIndex(CpuProfiler::kNoUserData),
+        m_IsExpanded(false), m_IsGraphed(false), m_GraphHandle(PERF_GRAPH_ERROR) {}
 
-    NestedTimingTree* GetChild( const wstring& name )
+    NestedTimingTree* GetChild( CpuProfiler::NameId name )
     {
         auto iter = m_LUT.find(name);
         if (iter != m_LUT.end())
             return iter->second;
 
-        NestedTimingTree* node = new NestedTimingTree(name, this);
+        NestedTimingTree* node = new NestedTimingTree(CpuProfiler::GetName(name), this);
         m_Children.push_back(node);
         m_LUT[name] = node;
         return node;
@@ -281,48 +313,27 @@ public:
         return nullptr;
     }
 
-    void StartTiming( CommandContext* Context )
-    {
-        m_StartTick = SystemTime::GetCurrentTick();
-        if (Context == nullptr)
-            return;
-
-        m_GpuTimer.Start(*Context);
-
-        Context->PIXBeginEvent(m_Name.c_str());
-    }
-
-    void StopTiming( CommandContext* Context )
-    {
-        m_EndTick = SystemTime::GetCurrentTick();
-        if (Context == nullptr)
-            return;
-
-        m_GpuTimer.Stop(*Context);
-
-        Context->PIXEndEvent();
-    }
-
     void GatherTimes(uint32_t FrameIndex)
     {
-        if (sm_SelectedScope == this)
+        if (sm_SelectedScope == this && m_GpuTimerIndex != CpuProfiler::kNoUserData)
         {
-            GraphRenderer::SetSelectedIndex(m_GpuTimer.GetTimerIndex());
+            GraphRenderer::SetSelectedIndex(m_GpuTimerIndex);
         }
         if (EngineProfiling::Paused)
         {
             for (auto node : m_Children)
                 node->GatherTimes(FrameIndex);
+            m_CpuTicks = 0;
             return;
         }
-        m_CpuTime.RecordStat(FrameIndex, 1000.0f * (float)SystemTime::TimeBetweenTicks(m_StartTick, m_EndTick));
-        m_GpuTime.RecordStat(FrameIndex, 1000.0f * m_GpuTimer.GetTime());
+        m_CpuTime.RecordStat(FrameIndex, (float)CpuProfiler::TicksToMilliseconds(m_CpuTicks));
+        m_GpuTime.RecordStat(FrameIndex, m_GpuTimerIndex == CpuProfiler::kNoUserData ? 0.0f :
+            1000.0f * GpuTimeManager::GetTime(m_GpuTimerIndex));
 
         for (auto node : m_Children)
             node->GatherTimes(FrameIndex);
 
-        m_StartTick = 0;
-        m_EndTick = 0;
+        m_CpuTicks = 0;
     }
 
     void SumInclusiveTimes(float& cpuTime, float& gpuTime)
@@ -336,13 +347,15 @@ public:
         }
     }
 
-    static void PushProfilingMarker( const wstring& name, CommandContext* Context );
-    static void PopProfilingMarker( CommandContext* Context );
     static void Update( void );
     static void UpdateTimes( void )
     {
         uint32_t FrameIndex = (uint32_t)Graphics::GetFrameCount();
 
+        // Every thread's scopes since the last frame, added to the nodes they were timed under
+        TreeBuilder Builder;
+        CpuProfiler::CollectEvents(Builder);
+
         GpuTimeManager::BeginReadBack();
         sm_RootScope.GatherTimes(FrameIndex);
         s_FrameDelta.RecordStat(FrameIndex, GpuTimeManager::GetTime(0));
@@ -380,6 +393,23 @@ public:
 
 private:
 
+    class TreeBuilder : public CpuProfiler::ScopeVisitor
+    {
+    public:
+        virtual void* OpenScope( void* Parent, CpuProfiler::NameId Name, uint32_t GpuTimerIndex ) override
+        {
+            NestedTimingTree* node = (Parent ? (NestedTimingTree*)Parent : &sm_RootScope)->GetChild(Name);
+            if (GpuTimerIndex != CpuProfiler::kNoUserData)
+                node->m_GpuTimerIndex = GpuTimerIndex;
+            return node;
+        }
+
+        virtual void CloseScope( void* Scope, int64_t Ticks ) override
+        {
+            ((NestedTimingTree*)Scope)->m_CpuTicks += Ticks;
+        }
+    };
+
     void DisplayNode( TextContext& Text, float x, float indent );
     void StoreToGraph(void);
     void DeleteChildren( void )
@@ -392,20 +422,18 @@ private:
     wstring m_Name;
     NestedTimingTree* m_Parent;
     vector<NestedTimingTree*> m_Children;
-    unordered_map<wstring, NestedTimingTree*> m_LUT;
-    int64_t m_StartTick;
-    int64_t m_EndTick;
+    unordered_map<CpuProfiler::NameId, NestedTimingTree*> m_LUT;
+    int64_t m_CpuTicks;			// every instance of the scope this frame
+    uint32_t m_GpuTimerIndex;
     StatHistory m_CpuTime;
     StatHistory m_GpuTime;
     bool m_IsExpanded;
-    GpuTimer m_GpuTimer;
     bool m_IsGraphed;
     GraphHandle m_GraphHandle;
     static StatHistory s_TotalCpuTime;
     static StatHistory s_TotalGpuTime;
     static StatHistory s_FrameDelta;
     static NestedTimingTree sm_RootScope;
-    static NestedTimingTree* sm_CurrentNode;
     static NestedTimingTree* sm_SelectedScope;
 
     static bool sm_CursorOnGraph;
@@ -416,16 +444,39 @@ StatHistory NestedTimingTree::s_TotalCpuTime;
 StatHistory NestedTimingTree::s_TotalGpuTime;
 StatHistory NestedTimingTree::s_FrameDelta;
 NestedTimingTree NestedTimingTree::sm_RootScope(L"");
-NestedTimingTree* NestedTimingTree::sm_CurrentNode = &NestedTimingTree::sm_RootScope;
 NestedTimingTree* NestedTimingTree::sm_SelectedScope = &NestedTimingTree::sm_RootScope;
 bool NestedTimingTree::sm_CursorOnGraph = false;
 namespace EngineProfiling
 {
     BoolVar DrawFrameRate("Display Frame Rate", true);
     BoolVar DrawProfiler("Display Profiler", false);
+    BoolVar CaptureTrace("Capture Profile Trace", false);
     //BoolVar DrawPerfGraph("Display Performance Graph", false);
     const bool DrawPerfGraph = false;
-    
+
+    // GPU timers are given out per scope path, so the same scope reached by different routes is timed apart.
+    // Each thread remembers the ones it has used so it doesn't take the lock again.
+    mutex s_GpuTimerMutex;
+    unordered_map<uint64_t, uint32_t> s_GpuTimers;
+    struct CachedGpuTimer { uint64_t ScopeKey; uint32_t TimerIndex; };
+    thread_local CachedGpuTimer t_GpuTimerCache[64];
+
+    uint32_t FindGpuTimer( uint64_t ScopeKey )
+    {
+        CachedGpuTimer& Cached = t_GpuTimerCache[ScopeKey % 64];
+        if (Cached.ScopeKey == ScopeKey && Cached.TimerIndex != 0)
+            return Cached.TimerIndex;
+
+        lock_guard<mutex> LockGuard(s_GpuTimerMutex);
+        uint32_t& TimerIndex = s_GpuTimers[ScopeKey];
+        if (TimerIndex == 0)
+            TimerIndex = GpuTimeManager::NewTimer();
+
+        Cached.ScopeKey = ScopeKey;
+        Cached.TimerIndex = TimerIndex;
+        return TimerIndex;
+    }
+
     void Update( void )
     {
         if (GameInput::IsFirstPressed( GameInput::kStartButton ) 
@@ -434,16 +485,57 @@ namespace EngineProfiling
             Paused = !Paused;
         }
         NestedTimingTree::UpdateTimes();
+
+        if (CaptureTrace)
+        {
+            CaptureTrace = false;
+            CpuProfiler::CaptureTrace("ProfileTrace.json", 60);
+        }
+
+        const uint32_t FrameIndex = (uint32_t)Graphics::GetFrameCount();
+        for (EventCounter& Counter : GetEventCounters())
+            Counter.Update(FrameIndex);
+    }
+
+    void RegisterCounter(const char* name, const atomic<uint64_t>& Total)
+    {
+        GetEventCounters().emplace_back(name, Total);
+    }
+
+    void RegisterRatio(const char* name, const atomic<uint64_t>& Part, const atomic<uint64_t>& Whole)
+    {
+        GetEventCounters().emplace_back(name, Part, &Whole);
+    }
+
+    void BeginBlock(const wchar_t* name, CommandContext* Context)
+    {
+        const CpuProfiler::NameId Name = CpuProfiler::FindName(name);
+        if (Context == nullptr)
+        {
+            CpuProfiler::BeginScope(Name);
+            return;
+        }
+
+        // Blocks on a context belong to it, so a job can begin a context that another thread finishes
+        const uint32_t TimerIndex = FindGpuTimer(CpuProfiler::GetScopeKey(Name));
+        CpuProfiler::BeginScope(Name, TimerIndex, Context);
+        GpuTimeManager::StartTimer(*Context, TimerIndex);
+        Context->PIXBeginEvent(name);
     }
 
     void BeginBlock(const wstring& name, CommandContext* Context)
     {
-        NestedTimingTree::PushProfilingMarker(name, Context);
+        BeginBlock(name.c_str(), Context);
     }
 
     void EndBlock(CommandContext* Context)
     {
-        NestedTimingTree::PopProfilingMarker(Context);
+        const uint32_t TimerIndex = CpuProfiler::EndScope(Context);
+        if (Context == nullptr)
+            return;
+
+        GpuTimeManager::StopTimer(*Context, TimerIndex);
+        Context->PIXEndEvent();
     }
 
     bool IsPaused()
@@ -491,6 +583,24 @@ namespace EngineProfiling
             Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
 
             NestedTimingTree::Display( Text, x );
+
+            if (!GetEventCounters().empty())
+            {
+                Text.NewLine();
+                Text.SetColor( Color(0.5f, 1.0f, 1.0f) );
+                Text.DrawString("Counters (per frame)\n");
+                Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
+                for (const EventCounter& Counter : GetEventCounters())
+                {
+                    Text.SetCursorX(x);
+                    Text.DrawString(Counter.GetName());
+                    Text.SetCursorX(x + 300.0f);
+                    if (Counter.IsRatio())
+                        Text.DrawFormattedString("%7.1f%%\n", Counter.GetAvg());
+                    else
+                        Text.DrawFormattedString("%8.2f\n", Counter.GetAvg());
+                }
+            }
         }
 
         Text.GetCommandContext().SetScissor(0, 0, g_DisplayWidth, g_DisplayHeight);
@@ -498,18 +608,6 @@ namespace EngineProfiling
 
 } // EngineProfiling
 
-void NestedTimingTree::PushProfilingMarker( const wstring& name, CommandContext* Context )
-{
-    sm_CurrentNode = sm_CurrentNode->GetChild(name);
-    sm_CurrentNode->StartTiming(Context);
-}
-
-void NestedTimingTree::PopProfilingMarker( CommandContext* Context )
-{
-    sm_CurrentNode->StopTiming(Context);
-    sm_CurrentNode = sm_CurrentNode->m_Parent;
-}
-
 void NestedTimingTree::Update( void )
 {
     ASSERT(sm_SelectedScope != nullptr, "Corrupted profiling data structure");
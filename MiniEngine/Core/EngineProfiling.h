@@ -14,6 +14,7 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include "TextRenderer.h"
 
 class CommandContext;
@@ -22,9 +23,19 @@ namespace EngineProfiling
 {
     void Update();
 
+    // Blocks nest on each thread, and cost a few tens of nanoseconds on the CPU.  A block on a context is
+    // also timed on the GPU, and may be ended on another thread if the context was begun in a job.
+    void BeginBlock(const wchar_t* name, CommandContext* Context = nullptr);
     void BeginBlock(const std::wstring& name, CommandContext* Context = nullptr);
     void EndBlock(CommandContext* Context = nullptr);
 
+    // Shows how much a running total grows per frame, averaged over recent frames, below the
+    // timing tree.  The total may be bumped from any thread and must outlive the profiler.
+    void RegisterCounter(const char* name, const std::atomic<uint64_t>& Total);
+
+    // Shows how much Part grows as a percentage of how much Whole grows, over the same frames
+    void RegisterRatio(const char* name, const std::atomic<uint64_t>& Part, const std::atomic<uint64_t>& Whole);
+
     void DisplayFrameRate(TextContext& Text);
     void DisplayPerfGraph(GraphicsContext& Text);
     void Display(TextContext& Text, float x, float y, float w, float h);
@@ -35,6 +46,8 @@ namespace EngineProfiling
 class ScopedTimer
 {
 public:
+    ScopedTimer(const wchar_t*) {}
+    ScopedTimer(const wchar_t*, CommandContext&) {}
     ScopedTimer(const std::wstring&) {}
     ScopedTimer(const std::wstring&, CommandContext&) {}
 };
@@ -42,6 +55,14 @@ public:
 class ScopedTimer
 {
 public:
+    ScopedTimer( const wchar_t* name ) : m_Context(nullptr)
+    {
+        EngineProfiling::BeginBlock(name);
+    }
+    ScopedTimer( const wchar_t* name, CommandContext& Context ) : m_Context(&Context)
+    {
+        EngineProfiling::BeginBlock(name, m_Context);
+    }
     ScopedTimer( const std::wstring& name ) : m_Context(nullptr)
     {
         EngineProfiling::BeginBlock(name);
@@ -13,8 +13,16 @@
 
 #include "pch.h"
 #include "FileUtility.h"
+#include "PackFile.h"
+#include "GzipMembers.h"
 #include <fstream>
 #include <mutex>
+#include <map>
+#include <set>
+#include <atomic>
+#include <algorithm>
+#include <cwctype>
+#include <ppl.h>
 #include <zlib.h> // From NuGet package 
 
 using namespace std;
@@ -26,14 +34,60 @@ namespace Utility
 }
 
 ByteArray DecompressZippedFile( wstring& fileName );
+ByteArray Inflate( const byte* CompressedSource, size_t CompressedSize, int& err );
 
-ByteArray ReadFileHelper(const wstring& fileName)
+namespace
 {
-    struct _stat64 fileStat;
-    int fileExists = _wstat64(fileName.c_str(), &fileStat);
-    if (fileExists == -1)
-        return NullFile;
+    // The ".gz" files found in each directory the first time a file was read from it, lower case
+    mutex s_ZippedFileMutex;
+    map<wstring, set<wstring> > s_ZippedFilesByDirectory;
+
+    // Searched newest first
+    mutex s_PackFileMutex;
+    vector<unique_ptr<PackFile> > s_PackFiles;
 
+    wstring ToLower( wstring str )
+    {
+        transform(str.begin(), str.end(), str.begin(), towlower);
+        return str;
+    }
+}
+
+// Replaces a failed stat and open per uncompressed read with one directory listing per directory.  A
+// ".gz" file created after its directory was listed is not seen.
+bool ZippedFileExists( const wstring& zippedFileName )
+{
+    size_t NameStart = zippedFileName.find_last_of(L"/\\");
+    NameStart = NameStart == wstring::npos ? 0 : NameStart + 1;
+    wstring Directory = ToLower(zippedFileName.substr(0, NameStart));
+
+    lock_guard<mutex> CS(s_ZippedFileMutex);
+
+    auto iter = s_ZippedFilesByDirectory.find(Directory);
+    if (iter == s_ZippedFilesByDirectory.end())
+    {
+        iter = s_ZippedFilesByDirectory.emplace(Directory, set<wstring>()).first;
+
+        WIN32_FIND_DATAW FindData;
+        HANDLE Find = FindFirstFileExW((zippedFileName.substr(0, NameStart) + L"*.gz").c_str(), FindExInfoBasic,
+            &FindData, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (Find != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+                    iter->second.insert(ToLower(FindData.cFileName));
+            }
+            while (FindNextFileW(Find, &FindData));
+            FindClose(Find);
+        }
+    }
+
+    return iter->second.count(ToLower(zippedFileName.substr(NameStart))) > 0;
+}
+
+ByteArray ReadFileHelper(const wstring& fileName)
+{
     ifstream file( fileName, ios::in | ios::binary );
     if (!file)
         return NullFile;
@@ -42,70 +96,132 @@ ByteArray ReadFileHelper(const wstring& fileName)
     file.seekg(0, ios::beg).read( (char*)byteArray->data(), byteArray->size() );
     file.close();
 
-    ASSERT(byteArray->size() == (size_t)fileStat.st_size);
-
     return byteArray;
 }
 
-ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
+bool FindPackedFile( const wstring& fileName, PackFile::Entry& entry )
 {
-    std::wstring zippedFileName = *fileName + L".gz";
-    ByteArray firstTry = DecompressZippedFile(zippedFileName);
-    if (firstTry != NullFile)
-        return firstTry;
+    lock_guard<mutex> CS(s_PackFileMutex);
 
-    return ReadFileHelper(*fileName);
+    for (auto iter = s_PackFiles.rbegin(); iter != s_PackFiles.rend(); ++iter)
+    {
+        if ((*iter)->Find(fileName, entry))
+            return true;
+    }
+
+    return false;
 }
 
-ByteArray Inflate(ByteArray CompressedSource, int& err, uint32_t ChunkSize = 0x100000 ) 
+ByteArray ReadPackedFile( const wstring& fileName, const PackFile::Entry& entry )
 {
-    // Create a dynamic buffer to hold compressed blocks
-    vector<unique_ptr<byte> > blocks;
+    if ((entry.Flags & PackFile::kGzip) == 0)
+        return make_shared<vector<byte> >( entry.Data, entry.Data + entry.Size );
 
-    z_stream strm  = {};
-    strm.data_type = Z_BINARY;
-    strm.total_in  = strm.avail_in  = (uInt)CompressedSource->size();
-    strm.next_in   = CompressedSource->data();
+    int error;
+    ByteArray DecompressedFile = Inflate(entry.Data, (size_t)entry.StoredSize, error);
+    if (DecompressedFile->size() != entry.Size)
+    {
+        Utility::Printf(L"Couldn't unzip packed file %s:  Error = %d\n", fileName.c_str(), error);
+        return NullFile;
+    }
 
-    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+    return DecompressedFile;
+}
 
-    while (err == Z_OK || err == Z_BUF_ERROR)
+ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
+{
+    PackFile::Entry entry;
+    if (FindPackedFile(*fileName, entry))
     {
-        strm.avail_out = ChunkSize;
-        strm.next_out = (byte*)malloc(ChunkSize);
-        blocks.emplace_back(strm.next_out);
-        err = inflate(&strm, Z_NO_FLUSH);
+        ByteArray packedFile = ReadPackedFile(*fileName, entry);
+        if (packedFile != NullFile)
+            return packedFile;
     }
 
-    if (err != Z_STREAM_END) 
+    std::wstring zippedFileName = *fileName + L".gz";
+    if (ZippedFileExists(zippedFileName))
     {
-        inflateEnd(&strm);
-        return NullFile;
+        ByteArray firstTry = DecompressZippedFile(zippedFileName);
+        if (firstTry != NullFile)
+            return firstTry;
     }
 
-    ASSERT(strm.total_out > 0, "Nothing to decompress");
+    return ReadFileHelper(*fileName);
+}
+
+static ByteArray InflateMembers( const byte* CompressedSource, const vector<GzipMember>& Members, int& err )
+{
+    const GzipMember& Last = Members.back();
+    Utility::ByteArray byteArray = make_shared<vector<byte> >( Last.OutputOffset + Last.OutputSize );
+
+    atomic<int> FirstError(Z_OK);
+    concurrency::parallel_for(size_t(0), Members.size(), [&](size_t i)
+    {
+        int MemberErr = InflateGzipMember(CompressedSource, Members[i], byteArray->data());
+
+        int NoError = Z_OK;
+        if (MemberErr != Z_STREAM_END)
+            FirstError.compare_exchange_strong(NoError, MemberErr);
+    });
 
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( strm.total_out );
+    err = FirstError.load();
+    if (err != Z_OK)
+        return NullFile;
+
+    err = Z_STREAM_END;
+    return byteArray;
+}
+
+ByteArray Inflate( const byte* CompressedSource, size_t CompressedSize, int& err )
+{
+    vector<GzipMember> Members;
+    if (IsGzip(CompressedSource, CompressedSize) && FindGzipMembers(CompressedSource, CompressedSize, Members))
+        return InflateMembers(CompressedSource, Members, err);
 
-    // Allocate actual memory for this.
-    // copy the bits into that RAM.
-    // Free everything else up!!
-    void* curDest = byteArray->data();
-    size_t remaining = byteArray->size();
+    // Decompress straight into the output, sized from the gzip trailer when there is one.  That is exact
+    // unless the file has several members or is over 4 GB, in which case the output grows as needed.
+    size_t OutputSize = CompressedSize * 4;
+    if (IsGzip(CompressedSource, CompressedSize))
+        OutputSize = min((size_t)ReadLittleEndian(CompressedSource + CompressedSize - 4, 4), CompressedSize * kMaxDeflateRatio);
 
-    for (size_t i = 0; i < blocks.size(); ++i)
+    Utility::ByteArray byteArray = make_shared<vector<byte> >( max(OutputSize, (size_t)1) );
+
+    z_stream strm  = {};
+    strm.data_type = Z_BINARY;
+    strm.total_in  = strm.avail_in  = (uInt)CompressedSize;
+    strm.next_in   = const_cast<byte*>(CompressedSource);
+
+    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+
+    size_t Produced = 0;
+    while (err == Z_OK)
     {
-        ASSERT(remaining > 0);
+        if (Produced == byteArray->size())
+            byteArray->resize(byteArray->size() * 2);
+
+        strm.avail_out = (uInt)min(byteArray->size() - Produced, (size_t)UINT32_MAX);
+        strm.next_out = byteArray->data() + Produced;
+        const uInt AvailableOut = strm.avail_out;
+        err = inflate(&strm, Z_NO_FLUSH);
+        Produced += AvailableOut - strm.avail_out;
 
-        size_t CopySize = min(remaining, (size_t)ChunkSize);
+        // Only a full output stops inflate() short; with room left it means the source is truncated
+        if (err == Z_BUF_ERROR && strm.avail_out == 0)
+            err = Z_OK;
 
-        memcpy(curDest, blocks[i].get(), CopySize);
-        curDest = (byte*)curDest + CopySize;
-        remaining -= CopySize;
+        // Concatenated gzip members.  Anything else after the stream is ignored, as gzip does.
+        if (err == Z_STREAM_END && strm.avail_in >= 2 && strm.next_in[0] == 0x1F && strm.next_in[1] == 0x8B)
+            err = inflateReset(&strm);
     }
 
     inflateEnd(&strm);
 
+    if (err != Z_STREAM_END) 
+        return NullFile;
+
+    ASSERT(Produced > 0, "Nothing to decompress");
+
+    byteArray->resize(Produced);
     return byteArray;
 }
 
@@ -116,7 +232,7 @@ ByteArray DecompressZippedFile( wstring& fileName )
         return NullFile;
 
     int error;
-    ByteArray DecompressedFile = Inflate(CompressedFile, error);
+    ByteArray DecompressedFile = Inflate(CompressedFile->data(), CompressedFile->size(), error);
     if (DecompressedFile->size() == 0)
     {
         Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
@@ -136,3 +252,49 @@ task<ByteArray> Utility::ReadFileAsync(const wstring& fileName)
     shared_ptr<wstring> SharedPtr = make_shared<wstring>(fileName);
     return create_task( [=] { return ReadFileHelperEx(SharedPtr); } );
 }
+
+ByteSpan Utility::ReadFileSpan( const wstring& fileName )
+{
+    PackFile::Entry entry;
+    if (FindPackedFile(fileName, entry))
+    {
+        if ((entry.Flags & PackFile::kGzip) == 0)
+            return ByteSpan(entry.Data, (size_t)entry.Size);
+    }
+    else if (!ZippedFileExists(fileName + L".gz"))
+    {
+        shared_ptr<MappedFile> File = make_shared<MappedFile>();
+        if (File->Open(fileName.c_str()))
+            return ByteSpan(File->GetData(), (size_t)File->GetSize(), File);
+    }
+
+    return ByteSpan(ReadFileSync(fileName));
+}
+
+bool Utility::FileExists( const wstring& fileName )
+{
+    PackFile::Entry entry;
+    if (FindPackedFile(fileName, entry) || ZippedFileExists(fileName + L".gz"))
+        return true;
+
+    WIN32_FILE_ATTRIBUTE_DATA FileData;
+    return GetFileAttributesExW(fileName.c_str(), GetFileExInfoStandard, &FileData) != FALSE &&
+        (FileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
+
+bool Utility::MountPackFile( const wstring& packFileName )
+{
+    unique_ptr<PackFile> Pack(new PackFile);
+    if (!Pack->Open(packFileName))
+        return false;
+
+    lock_guard<mutex> CS(s_PackFileMutex);
+    s_PackFiles.push_back(move(Pack));
+    return true;
+}
+
+void Utility::UnmountPackFiles( void )
+{
+    lock_guard<mutex> CS(s_PackFileMutex);
+    s_PackFiles.clear();
+}
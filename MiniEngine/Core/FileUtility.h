@@ -27,11 +27,37 @@ namespace Utility
     extern ByteArray NullFile;
 
     // Reads the entire contents of a binary file.  If the file with the same name except with an additional
-    // ".gz" suffix exists, it will be loaded and decompressed instead.
+    // ".gz" suffix exists, it will be loaded and decompressed instead.  Gzip files written in chunks by
+    // Tools/Scripts/ChunkedGzip.py are decompressed in parallel.  Mounted pack files are searched first.
     // This operation blocks until the entire file is read.
     ByteArray ReadFileSync(const wstring& fileName);
 
     // Same as previous except that it does not block but instead returns a task.
     task<ByteArray> ReadFileAsync(const wstring& fileName);
 
+    // A file's contents, either held or mapped by Owner or pointing into a mounted pack file
+    struct ByteSpan
+    {
+        ByteSpan( const byte* data = nullptr, size_t size = 0 ) : Data(data), Size(size) {}
+        explicit ByteSpan( const ByteArray& owner ) : Data(owner->data()), Size(owner->size()), Owner(owner) {}
+        ByteSpan( const byte* data, size_t size, shared_ptr<const void> owner ) : Data(data), Size(size), Owner(owner) {}
+
+        const byte* Data;
+        size_t Size;
+        shared_ptr<const void> Owner;
+    };
+
+    // Same as ReadFileSync() except that an uncompressed file is memory-mapped instead of copied.  A span
+    // into a pack file is valid until the pack file is unmounted.
+    ByteSpan ReadFileSpan(const wstring& fileName);
+
+    // Whether ReadFileSync() would find the file, without reading it
+    bool FileExists(const wstring& fileName);
+
+    // Files in a mounted pack file are read from it instead of from loose files with the same path
+    // relative to the working directory, and the most recently mounted pack is searched first.  Other
+    // files are still read from disk.  Mount before loading anything and unmount after loading is done.
+    bool MountPackFile(const wstring& packFileName);
+    void UnmountPackFiles(void);
+
 } // namespace Utility
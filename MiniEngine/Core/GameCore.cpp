@@ -19,6 +19,8 @@
 #include "BufferManager.h"
 #include "CommandContext.h"
 #include "PostEffects.h"
+#include "JobSystem.h"
+#include "TextureStreamer.h"
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     #pragma comment(lib, "runtimeobject.lib")
@@ -49,6 +51,7 @@ namespace GameCore
         SystemTime::Initialize();
         GameInput::Initialize();
         EngineTuning::Initialize();
+        JobSystem::Initialize();
 
         game.Startup();
     }
@@ -57,12 +60,14 @@ namespace GameCore
     {
         game.Cleanup();
 
+        JobSystem::Shutdown();
         GameInput::Shutdown();
     }
 
     bool UpdateApplication( IGameApp& game )
     {
         EngineProfiling::Update();
+        TextureStreamer::Update();
 
         float DeltaTime = Graphics::GetFrameTime();
     
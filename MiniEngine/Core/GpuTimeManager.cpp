@@ -16,92 +16,143 @@
 #include "GraphicsCore.h"
 #include "CommandContext.h"
 #include "CommandListManager.h"
+#include "ReadbackRing.h"
+#include <atomic>
 
 namespace
 {
+    // One readback buffer for the frame being read, one for the GPU to resolve into, and one spare so that
+    // a resolve can start before the previous one has landed
+    const uint32_t kNumReadBackBuffers = 3;
+
     ID3D12QueryHeap* sm_QueryHeap = nullptr;
-    ID3D12Resource* sm_ReadBackBuffer = nullptr;
+    ID3D12Resource* sm_ReadBackBuffers[kNumReadBackBuffers] = {};
+    uint32_t sm_ResolvedTimers[kNumReadBackBuffers] = {};
+    ReadbackRing<kNumReadBackBuffers> sm_ReadBackRing;
     uint64_t* sm_TimeStampBuffer = nullptr;
-    uint64_t sm_Fence = 0;
+    uint32_t sm_MappedTimers = 0;
     uint32_t sm_MaxNumTimers = 0;
-    uint32_t sm_NumTimers = 1;
+    bool sm_QueryHeapIsNew = false;
+    std::atomic<uint32_t> sm_NumTimers(1);
     uint64_t sm_ValidTimeStart = 0;
     uint64_t sm_ValidTimeEnd = 0;
     double sm_GpuTickDelta = 0.0;
+
+    bool IsFenceComplete( uint64_t Fence )
+    {
+        return Graphics::g_CommandManager.IsFenceComplete(Fence);
+    }
+
+    void CreateQueryResources( uint32_t MaxNumTimers )
+    {
+        D3D12_HEAP_PROPERTIES HeapProps;
+        HeapProps.Type = D3D12_HEAP_TYPE_READBACK;
+        HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        HeapProps.CreationNodeMask = 1;
+        HeapProps.VisibleNodeMask = 1;
+
+        D3D12_RESOURCE_DESC BufferDesc;
+        BufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        BufferDesc.Alignment = 0;
+        BufferDesc.Width = sizeof(uint64_t) * MaxNumTimers * 2;
+        BufferDesc.Height = 1;
+        BufferDesc.DepthOrArraySize = 1;
+        BufferDesc.MipLevels = 1;
+        BufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+        BufferDesc.SampleDesc.Count = 1;
+        BufferDesc.SampleDesc.Quality = 0;
+        BufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        BufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+        for (uint32_t i = 0; i < kNumReadBackBuffers; ++i)
+        {
+            ASSERT_SUCCEEDED(Graphics::g_Device->CreateCommittedResource( &HeapProps, D3D12_HEAP_FLAG_NONE, &BufferDesc,
+                D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(&sm_ReadBackBuffers[i]) ));
+            sm_ReadBackBuffers[i]->SetName(L"GpuTimeStamp Buffer");
+            sm_ResolvedTimers[i] = 0;
+        }
+
+        D3D12_QUERY_HEAP_DESC QueryHeapDesc;
+        QueryHeapDesc.Count = MaxNumTimers * 2;
+        QueryHeapDesc.NodeMask = 1;
+        QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        ASSERT_SUCCEEDED(Graphics::g_Device->CreateQueryHeap(&QueryHeapDesc, MY_IID_PPV_ARGS(&sm_QueryHeap)));
+        sm_QueryHeap->SetName(L"GpuTimeStamp QueryHeap");
+
+        sm_MaxNumTimers = MaxNumTimers;
+        sm_QueryHeapIsNew = true;
+        sm_ReadBackRing.Reset();
+    }
+
+    void DestroyQueryResources( void )
+    {
+        for (uint32_t i = 0; i < kNumReadBackBuffers; ++i)
+        {
+            if (sm_ReadBackBuffers[i] != nullptr)
+                sm_ReadBackBuffers[i]->Release();
+            sm_ReadBackBuffers[i] = nullptr;
+        }
+
+        if (sm_QueryHeap != nullptr)
+            sm_QueryHeap->Release();
+        sm_QueryHeap = nullptr;
+
+        sm_MaxNumTimers = 0;
+    }
 }
 
-void GpuTimeManager::Initialize(uint32_t MaxNumTimers)
+void GpuTimeManager::Initialize(uint32_t InitialNumTimers)
 {
     uint64_t GpuFrequency;
     Graphics::g_CommandManager.GetCommandQueue()->GetTimestampFrequency(&GpuFrequency);
     sm_GpuTickDelta = 1.0 / static_cast<double>(GpuFrequency);
 
-    D3D12_HEAP_PROPERTIES HeapProps;
-    HeapProps.Type = D3D12_HEAP_TYPE_READBACK;
-    HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-    HeapProps.CreationNodeMask = 1;
-    HeapProps.VisibleNodeMask = 1;
-
-    D3D12_RESOURCE_DESC BufferDesc;
-    BufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    BufferDesc.Alignment = 0;
-    BufferDesc.Width = sizeof(uint64_t) * MaxNumTimers * 2;
-    BufferDesc.Height = 1;
-    BufferDesc.DepthOrArraySize = 1;
-    BufferDesc.MipLevels = 1;
-    BufferDesc.Format = DXGI_FORMAT_UNKNOWN;
-    BufferDesc.SampleDesc.Count = 1;
-    BufferDesc.SampleDesc.Quality = 0;
-    BufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    BufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-    ASSERT_SUCCEEDED(Graphics::g_Device->CreateCommittedResource( &HeapProps, D3D12_HEAP_FLAG_NONE, &BufferDesc,
-        D3D12_RESOURCE_STATE_COPY_DEST, nullptr, MY_IID_PPV_ARGS(&sm_ReadBackBuffer) ));
-    sm_ReadBackBuffer->SetName(L"GpuTimeStamp Buffer");
-
-    D3D12_QUERY_HEAP_DESC QueryHeapDesc;
-    QueryHeapDesc.Count = MaxNumTimers * 2;
-    QueryHeapDesc.NodeMask = 1;
-    QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
-    ASSERT_SUCCEEDED(Graphics::g_Device->CreateQueryHeap(&QueryHeapDesc, MY_IID_PPV_ARGS(&sm_QueryHeap)));
-    sm_QueryHeap->SetName(L"GpuTimeStamp QueryHeap");
-
-    sm_MaxNumTimers = (uint32_t)MaxNumTimers;
+    CreateQueryResources(InitialNumTimers > 1 ? InitialNumTimers : 2);
 }
 
 void GpuTimeManager::Shutdown()
 {
-    if (sm_ReadBackBuffer != nullptr)
-        sm_ReadBackBuffer->Release();
-
-    if (sm_QueryHeap != nullptr)
-        sm_QueryHeap->Release();
+    DestroyQueryResources();
 }
 
 uint32_t GpuTimeManager::NewTimer(void)
 {
-    return sm_NumTimers++;
+    return sm_NumTimers.fetch_add(1);
 }
 
 void GpuTimeManager::StartTimer(CommandContext& Context, uint32_t TimerIdx)
 {
-    Context.InsertTimeStamp(sm_QueryHeap, TimerIdx * 2);
+    // Timers made after the query heap last grew aren't recorded until it grows again at the end of the frame
+    if (TimerIdx < sm_MaxNumTimers)
+        Context.InsertTimeStamp(sm_QueryHeap, TimerIdx * 2);
 }
 
 void GpuTimeManager::StopTimer(CommandContext& Context, uint32_t TimerIdx)
 {
-    Context.InsertTimeStamp(sm_QueryHeap, TimerIdx * 2 + 1);
+    if (TimerIdx < sm_MaxNumTimers)
+        Context.InsertTimeStamp(sm_QueryHeap, TimerIdx * 2 + 1);
 }
 
 void GpuTimeManager::BeginReadBack(void)
 {
-    Graphics::g_CommandManager.WaitForFence(sm_Fence);
+    sm_TimeStampBuffer = nullptr;
+    sm_MappedTimers = 0;
+    sm_ValidTimeStart = 0ull;
+    sm_ValidTimeEnd = 0ull;
+
+    // The newest frame the GPU has finished resolving, which is usually one or two frames old.  Until the
+    // first one lands there is nothing to read and every time is zero.
+    uint32_t Slot = sm_ReadBackRing.AcquireRead(IsFenceComplete);
+    if (Slot == sm_ReadBackRing.kNoSlot)
+        return;
+
+    sm_MappedTimers = sm_ResolvedTimers[Slot];
 
     D3D12_RANGE Range;
     Range.Begin = 0;
-    Range.End = (sm_NumTimers * 2) * sizeof(uint64_t);
-    ASSERT_SUCCEEDED(sm_ReadBackBuffer->Map(0, &Range, reinterpret_cast<void**>(&sm_TimeStampBuffer)));
+    Range.End = (sm_MappedTimers * 2) * sizeof(uint64_t);
+    ASSERT_SUCCEEDED(sm_ReadBackBuffers[Slot]->Map(0, &Range, reinterpret_cast<void**>(&sm_TimeStampBuffer)));
 
     sm_ValidTimeStart = sm_TimeStampBuffer[0];
     sm_ValidTimeEnd = sm_TimeStampBuffer[1];
@@ -117,22 +168,57 @@ void GpuTimeManager::BeginReadBack(void)
 void GpuTimeManager::EndReadBack(void)
 {
     // Unmap with an empty range to indicate nothing was written by the CPU
-    D3D12_RANGE EmptyRange = {};
-    sm_ReadBackBuffer->Unmap(0, &EmptyRange);
-    sm_TimeStampBuffer = nullptr;
+    if (sm_TimeStampBuffer != nullptr)
+    {
+        D3D12_RANGE EmptyRange = {};
+        sm_ReadBackBuffers[sm_ReadBackRing.GetReadSlot()]->Unmap(0, &EmptyRange);
+        sm_TimeStampBuffer = nullptr;
+        sm_MappedTimers = 0;
+    }
+
+    uint32_t NumTimers = sm_NumTimers.load();
+    if (NumTimers > sm_MaxNumTimers)
+    {
+        // Only happens the first few times new scopes appear, so it's simplest to let the GPU finish with
+        // the old heap and buffers.  Timings from frames in flight are lost.
+        uint32_t NewMaxNumTimers = sm_MaxNumTimers;
+        while (NewMaxNumTimers < NumTimers)
+            NewMaxNumTimers *= 2;
+
+        Graphics::g_CommandManager.IdleGPU();
+        DestroyQueryResources();
+        CreateQueryResources(NewMaxNumTimers);
+    }
+
+    // When every other buffer is still waiting on the GPU, this frame's times are dropped rather than
+    // waiting.  The bracketing time stamps are still written so the next frame's window is right.  A new
+    // query heap isn't resolved at all, since the time stamp opening this frame's window (query 0) was
+    // never written to it, and nor were any of this frame's timers.
+    uint32_t Slot = sm_QueryHeapIsNew ? sm_ReadBackRing.kNoSlot : sm_ReadBackRing.AcquireWrite(IsFenceComplete);
+    sm_QueryHeapIsNew = false;
 
     CommandContext& Context = CommandContext::Begin();
     Context.InsertTimeStamp(sm_QueryHeap, 1);
-    Context.ResolveTimeStamps(sm_ReadBackBuffer, sm_QueryHeap, sm_NumTimers * 2);
+    if (Slot != sm_ReadBackRing.kNoSlot)
+        Context.ResolveTimeStamps(sm_ReadBackBuffers[Slot], sm_QueryHeap, NumTimers * 2);
     Context.InsertTimeStamp(sm_QueryHeap, 0);
-    sm_Fence = Context.Finish();
+    uint64_t Fence = Context.Finish();
+
+    if (Slot != sm_ReadBackRing.kNoSlot)
+    {
+        sm_ReadBackRing.Submit(Slot, Fence);
+        sm_ResolvedTimers[Slot] = NumTimers;
+    }
 }
 
 float GpuTimeManager::GetTime(uint32_t TimerIdx)
 {
-    ASSERT(sm_TimeStampBuffer != nullptr, "Time stamp readback buffer is not mapped");
     ASSERT(TimerIdx < sm_NumTimers, "Invalid GPU timer index");
 
+    // Nothing has been read back yet, or the timer is newer than the frame that was
+    if (sm_TimeStampBuffer == nullptr || TimerIdx >= sm_MappedTimers)
+        return 0.0f;
+
     uint64_t TimeStamp1 = sm_TimeStampBuffer[TimerIdx * 2];
     uint64_t TimeStamp2 = sm_TimeStampBuffer[TimerIdx * 2 + 1];
 
@@ -19,7 +19,8 @@ class CommandContext;
 
 namespace GpuTimeManager
 {
-    void Initialize( uint32_t MaxNumTimers = 4096 );
+    // The query heap starts with room for InitialNumTimers and doubles whenever NewTimer() outgrows it
+    void Initialize( uint32_t InitialNumTimers = 256 );
     void Shutdown();
 
     // Reserve a unique timer index
@@ -30,7 +31,8 @@ namespace GpuTimeManager
     void StopTimer(CommandContext& Context, uint32_t TimerIdx);
 
     // Bookend all calls to GetTime() with Begin/End which correspond to Map/Unmap.  This
-    // needs to happen either at the very start or very end of a frame.
+    // needs to happen either at the very start or very end of a frame.  Neither waits on the
+    // GPU:  the times read are from the newest frame it has finished, a frame or two behind.
     void BeginReadBack(void);
     void EndReadBack(void);
 
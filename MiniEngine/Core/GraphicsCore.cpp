@@ -30,6 +30,7 @@
 #include "ParticleEffectManager.h"
 #include "GraphRenderer.h"
 #include "TemporalEffects.h"
+#include "TextureStreamer.h"
 
 // This macro determines whether to detect if there is an HDR display and enable HDR10 output.
 // Currently, with HDR display enabled, the pixel magnfication functionality is broken.
@@ -189,10 +190,10 @@ namespace Graphics
 
     DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES] =
     {
-        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
-        D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+        { D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_RTV },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_DSV },
     };
 
     RootSignature s_PresentRS;
@@ -453,6 +454,9 @@ void Graphics::Initialize(void)
 
     g_CommandManager.Create(g_Device);
 
+    // Before any pipeline state is finalized
+    PSO::LoadCache(L"PSOCache.bin");
+
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.Width = g_DisplayWidth;
     swapChainDesc.Height = g_DisplayHeight;
@@ -575,7 +579,7 @@ void Graphics::Initialize(void)
 
     g_PreDisplayBuffer.Create(L"PreDisplay Buffer", g_DisplayWidth, g_DisplayHeight, 1, SwapChainFormat);
 
-    GpuTimeManager::Initialize(4096);
+    GpuTimeManager::Initialize();
     SetNativeResolution();
     TemporalEffects::Initialize();
     PostEffects::Initialize();
@@ -587,6 +591,7 @@ void Graphics::Initialize(void)
 
 void Graphics::Terminate( void )
 {
+    TextureStreamer::Shutdown();
     g_CommandManager.IdleGPU();
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     s_SwapChain1->SetFullscreenState(FALSE, nullptr);
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/GzipMembersTest.cpp)
+#include "GzipMembers.h"
+#include <zlib.h> // From NuGet package
+
+namespace Utility
+{
+    uint32_t ReadLittleEndian( const uint8_t* Ptr, uint32_t NumBytes )
+    {
+        uint32_t Value = 0;
+        for (uint32_t i = 0; i < NumBytes; ++i)
+            Value |= (uint32_t)Ptr[i] << (8 * i);
+        return Value;
+    }
+
+    bool IsGzip( const uint8_t* Source, size_t SourceSize )
+    {
+        return SourceSize >= 18 && Source[0] == 0x1F && Source[1] == 0x8B && Source[2] == 8;
+    }
+
+    size_t ReadGzipMemberSize( const uint8_t* Source, size_t SourceSize, size_t Offset )
+    {
+        const uint8_t* Header = Source + Offset;
+        const size_t Available = SourceSize - Offset;
+
+        const uint8_t FEXTRA = 4;
+        if (Available < 12 || Header[0] != 0x1F || Header[1] != 0x8B || Header[2] != 8 || (Header[3] & FEXTRA) == 0)
+            return 0;
+
+        const size_t ExtraLength = ReadLittleEndian(Header + 10, 2);
+        if (Available < 12 + ExtraLength)
+            return 0;
+
+        // Subfields are an ID, a length, and that many bytes, which must all lie within the extra field
+        const uint8_t* Extra = Header + 12;
+        for (size_t Field = 0; Field + 4 <= ExtraLength; )
+        {
+            const size_t FieldLength = ReadLittleEndian(Extra + Field + 2, 2);
+            if (FieldLength > ExtraLength - Field - 4)
+                return 0;
+
+            if (Extra[Field] == 'M' && Extra[Field + 1] == 'C' && FieldLength == 4)
+                return ReadLittleEndian(Extra + Field + 4, 4);
+
+            Field += 4 + FieldLength;
+        }
+
+        return 0;
+    }
+
+    bool FindGzipMembers( const uint8_t* Source, size_t SourceSize, std::vector<GzipMember>& Members )
+    {
+        size_t OutputSize = 0;
+        for (size_t Offset = 0; Offset < SourceSize; )
+        {
+            const size_t MemberSize = ReadGzipMemberSize(Source, SourceSize, Offset);
+            if (MemberSize < 18 || MemberSize > SourceSize - Offset)
+                return false;
+
+            // ISIZE, the last four bytes of the member
+            const size_t MemberOutput = ReadLittleEndian(Source + Offset + MemberSize - 4, 4);
+            if (MemberOutput > MemberSize * kMaxDeflateRatio)
+                return false;
+
+            Members.push_back({ Offset, MemberSize, OutputSize, MemberOutput });
+            Offset += MemberSize;
+            OutputSize += MemberOutput;
+        }
+
+        return Members.size() > 1;
+    }
+
+    int InflateGzipMember( const uint8_t* Source, const GzipMember& Member, uint8_t* Output )
+    {
+        z_stream strm  = {};
+        strm.data_type = Z_BINARY;
+        strm.avail_in  = (uInt)Member.Size;
+        strm.next_in   = const_cast<uint8_t*>(Source) + Member.Offset;
+        strm.avail_out = (uInt)Member.OutputSize;
+        strm.next_out  = Output + Member.OutputOffset;
+
+        int err = inflateInit2(&strm, 15 + 16); // gzip only
+        if (err == Z_OK)
+        {
+            err = inflate(&strm, Z_FINISH);
+            if (err == Z_STREAM_END && (strm.avail_in != 0 || strm.avail_out != 0))
+                err = Z_DATA_ERROR;
+            inflateEnd(&strm);
+        }
+        return err;
+    }
+}
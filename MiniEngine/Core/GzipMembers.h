@@ -0,0 +1,50 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A chunked gzip file is a series of complete gzip members, so any gzip reader can decompress
+// it.  Every member's header carries an extra field, 'M' 'C' followed by the size of the whole member,
+// which lets the members be found without inflating them and inflated in parallel straight into their
+// place in the output.  Tools/Scripts/ChunkedGzip.py writes them.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Utility
+{
+    struct GzipMember
+    {
+        size_t Offset;
+        size_t Size;
+        size_t OutputOffset;
+        size_t OutputSize;
+    };
+
+    // Deflate can't compress by more than about 1032:1, so a larger ISIZE means the file is corrupt
+    const size_t kMaxDeflateRatio = 1032;
+
+    uint32_t ReadLittleEndian( const uint8_t* Ptr, uint32_t NumBytes );
+
+    bool IsGzip( const uint8_t* Source, size_t SourceSize );
+
+    // Returns the size of the member recorded in the header at Offset, or 0 if it has none
+    size_t ReadGzipMemberSize( const uint8_t* Source, size_t SourceSize, size_t Offset );
+
+    // Lists the members of a chunked gzip file, and returns false unless there are several and every one
+    // records its size
+    bool FindGzipMembers( const uint8_t* Source, size_t SourceSize, std::vector<GzipMember>& Members );
+
+    // Inflates one member into its place in Output, which holds the whole file.  Returns the zlib error,
+    // which is Z_STREAM_END when the member inflated to exactly its recorded size.
+    int InflateGzipMember( const uint8_t* Source, const GzipMember& Member, uint8_t* Output );
+}
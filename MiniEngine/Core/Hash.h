@@ -63,4 +63,80 @@ namespace Utility
         return HashRange((uint32_t*)StateDesc, (uint32_t*)(StateDesc + Count), Hash);
     }
 
+    // A 128-bit hash for keys that have to stay unique across runs, such as the pipeline state cache on disk.
+    // This is MurmurHash3 (x64, 128-bit) with the seed widened to 128 bits so that calls can be chained.
+    struct Hash128
+    {
+        uint64_t Lo;
+        uint64_t Hi;
+
+        bool operator== ( const Hash128& Other ) const { return Lo == Other.Lo && Hi == Other.Hi; }
+        bool operator!= ( const Hash128& Other ) const { return !(*this == Other); }
+    };
+
+    inline uint64_t Rotate64( uint64_t Value, int Bits )
+    {
+        return (Value << Bits) | (Value >> (64 - Bits));
+    }
+
+    inline uint64_t Mix64( uint64_t Value )
+    {
+        Value ^= Value >> 33;
+        Value *= 0xFF51AFD7ED558CCDull;
+        Value ^= Value >> 33;
+        Value *= 0xC4CEB9FE1A85EC53ull;
+        Value ^= Value >> 33;
+        return Value;
+    }
+
+    inline Hash128 HashBytes128( const void* Data, size_t Size, Hash128 Seed = Hash128() )
+    {
+        const uint64_t C1 = 0x87C37B91114253D5ull;
+        const uint64_t C2 = 0x4CF5AD432745937Full;
+        const uint8_t* Bytes = (const uint8_t*)Data;
+        const size_t NumBlocks = Size / 16;
+
+        uint64_t H1 = Seed.Lo;
+        uint64_t H2 = Seed.Hi;
+        uint64_t K1, K2;
+
+        for (size_t i = 0; i < NumBlocks; ++i)
+        {
+            memcpy(&K1, Bytes + i * 16, 8);
+            memcpy(&K2, Bytes + i * 16 + 8, 8);
+
+            K1 *= C1; K1 = Rotate64(K1, 31); K1 *= C2; H1 ^= K1;
+            H1 = Rotate64(H1, 27); H1 += H2; H1 = H1 * 5 + 0x52DCE729;
+            K2 *= C2; K2 = Rotate64(K2, 33); K2 *= C1; H2 ^= K2;
+            H2 = Rotate64(H2, 31); H2 += H1; H2 = H2 * 5 + 0x38495AB5;
+        }
+
+        const size_t TailSize = Size & 15;
+        if (TailSize > 0)
+        {
+            uint8_t Tail[16] = {};
+            memcpy(Tail, Bytes + NumBlocks * 16, TailSize);
+            memcpy(&K1, Tail, 8);
+            memcpy(&K2, Tail + 8, 8);
+
+            if (TailSize > 8)
+            {
+                K2 *= C2; K2 = Rotate64(K2, 33); K2 *= C1; H2 ^= K2;
+            }
+            K1 *= C1; K1 = Rotate64(K1, 31); K1 *= C2; H1 ^= K1;
+        }
+
+        H1 ^= Size;
+        H2 ^= Size;
+        H1 += H2;
+        H2 += H1;
+        H1 = Mix64(H1);
+        H2 = Mix64(H2);
+        H1 += H2;
+        H2 += H1;
+
+        Hash128 Result = { H1, H2 };
+        return Result;
+    }
+
 } // namespace Utility
@@ -0,0 +1,310 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/JobSystemTest.cpp)
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include <cassert>
+#include <cwchar>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+namespace JobSystem
+{
+    struct Job
+    {
+        std::function<void()> Function;
+        JobCounter* Counter;
+
+        void Execute( void )
+        {
+            const uint32_t ProfileDepth = CpuProfiler::GetDepth();
+            Function();
+
+            // A context begun by the job may be finished by whoever waits on it, so hand off its
+            // profiling scope before the wait can return
+            CpuProfiler::DetachScopes(ProfileDepth);
+            Counter->m_Pending.fetch_sub(1, std::memory_order_release);
+        }
+    };
+}
+
+using namespace JobSystem;
+
+namespace
+{
+    //
+    // Chase-Lev deque with the memory orderings of Le et al., "Correct and Efficient
+    // Work-Stealing for Weak Memory Models".  The owner pushes and pops at the bottom;
+    // thieves take from the top.  Only a single job can be contended, the last one,
+    // and the top index compare-exchange settles who gets it.
+    //
+    class WorkStealingQueue
+    {
+    public:
+        static const int64_t kCapacity = 4096;
+
+        WorkStealingQueue() : m_Top(0), m_Bottom(0)
+        {
+            for (int64_t i = 0; i < kCapacity; ++i)
+                m_Jobs[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        // Owner only.  Returns false when the deque is full.
+        bool Push( Job* NewJob )
+        {
+            const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed);
+            const int64_t Top = m_Top.load(std::memory_order_acquire);
+            if (Bottom - Top >= kCapacity)
+                return false;
+
+            m_Jobs[Bottom & (kCapacity - 1)].store(NewJob, std::memory_order_relaxed);
+            m_Bottom.store(Bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Owner only
+        Job* Pop( void )
+        {
+            const int64_t Bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+            m_Bottom.store(Bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t Top = m_Top.load(std::memory_order_relaxed);
+
+            if (Top > Bottom)
+            {
+                m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* PoppedJob = m_Jobs[Bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if (Top == Bottom)
+            {
+                // Last job, race the thieves for it
+                if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    PoppedJob = nullptr;
+                m_Bottom.store(Bottom + 1, std::memory_order_relaxed);
+            }
+            return PoppedJob;
+        }
+
+        // Any thread
+        Job* Steal( void )
+        {
+            int64_t Top = m_Top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t Bottom = m_Bottom.load(std::memory_order_acquire);
+            if (Top >= Bottom)
+                return nullptr;
+
+            Job* StolenJob = m_Jobs[Top & (kCapacity - 1)].load(std::memory_order_relaxed);
+            if (!m_Top.compare_exchange_strong(Top, Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return StolenJob;
+        }
+
+    private:
+        // Keep the thieves' index and the owner's index on separate cache lines.  Padded rather than
+        // aligned, since new[] only guarantees 16-byte alignment before C++17.
+        std::atomic<int64_t> m_Top;
+        char m_Padding[64];
+        std::atomic<int64_t> m_Bottom;
+        std::atomic<Job*> m_Jobs[kCapacity];
+    };
+
+    const uint32_t kNotAWorker = 0xFFFFFFFF;
+    thread_local uint32_t s_WorkerIndex = kNotAWorker;
+    thread_local uint32_t s_StealSeed = 0;
+
+    uint32_t s_ThreadCount = 0;
+    WorkStealingQueue* s_Queues = nullptr;
+    std::vector<std::thread> s_Workers;
+
+    // Idle workers sleep until a job is queued
+    std::atomic<uint32_t> s_QueuedJobs(0);
+    std::atomic<uint32_t> s_SleepingWorkers(0);
+    std::atomic<bool> s_Quit(false);
+    std::mutex s_SleepMutex;
+    std::condition_variable s_WakeCondition;
+
+    Job* FindJob( void )
+    {
+        Job* FoundJob = s_Queues[s_WorkerIndex].Pop();
+        if (FoundJob == nullptr)
+        {
+            // Steal from the other workers, starting at a random one so thieves spread out
+            s_StealSeed = s_StealSeed * 1664525u + 1013904223u;
+            const uint32_t Start = (s_StealSeed >> 16) % s_ThreadCount;
+            for (uint32_t i = 0; i < s_ThreadCount && FoundJob == nullptr; ++i)
+            {
+                const uint32_t Victim = (Start + i) % s_ThreadCount;
+                if (Victim != s_WorkerIndex)
+                    FoundJob = s_Queues[Victim].Steal();
+            }
+        }
+
+        if (FoundJob != nullptr)
+            s_QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return FoundJob;
+    }
+
+    void RunJob( Job* FoundJob )
+    {
+        FoundJob->Execute();
+        delete FoundJob;
+    }
+
+    void WorkerMain( uint32_t WorkerIndex )
+    {
+        s_WorkerIndex = WorkerIndex;
+        s_StealSeed = WorkerIndex * 2654435761u;
+
+        wchar_t ThreadName[32];
+        swprintf(ThreadName, 32, L"Job Worker %u", WorkerIndex);
+        CpuProfiler::SetThreadName(ThreadName);
+
+        while (!s_Quit.load(std::memory_order_acquire))
+        {
+            Job* FoundJob = FindJob();
+            if (FoundJob != nullptr)
+            {
+                RunJob(FoundJob);
+                continue;
+            }
+
+            // The sleeper count is raised before the queue is checked, and Run() raises the
+            // queued count before it checks for sleepers, so a wake up can't be missed.
+            std::unique_lock<std::mutex> Lock(s_SleepMutex);
+            s_SleepingWorkers.fetch_add(1);
+            s_WakeCondition.wait(Lock, []{ return s_QueuedJobs.load() > 0 || s_Quit.load(); });
+            s_SleepingWorkers.fetch_sub(1);
+        }
+    }
+}
+
+void JobSystem::Initialize( uint32_t WorkerCount )
+{
+    ASSERT(s_Queues == nullptr, "Job system is already initialized");
+
+    if (WorkerCount == 0)
+    {
+        const uint32_t HardwareThreads = std::thread::hardware_concurrency();
+        WorkerCount = HardwareThreads > 1 ? HardwareThreads - 1 : 1;
+    }
+
+    s_ThreadCount = WorkerCount + 1;
+    s_Queues = new WorkStealingQueue[s_ThreadCount];
+    s_Quit = false;
+
+    s_WorkerIndex = 0;
+    s_StealSeed = 1;
+    CpuProfiler::SetThreadName(L"Main Thread");
+    for (uint32_t i = 1; i < s_ThreadCount; ++i)
+        s_Workers.emplace_back(WorkerMain, i);
+}
+
+void JobSystem::Shutdown( void )
+{
+    if (s_Queues == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> Lock(s_SleepMutex);
+        s_Quit = true;
+    }
+    s_WakeCondition.notify_all();
+
+    for (auto& Worker : s_Workers)
+        Worker.join();
+    s_Workers.clear();
+
+    delete[] s_Queues;
+    s_Queues = nullptr;
+    s_ThreadCount = 0;
+    s_WorkerIndex = kNotAWorker;
+}
+
+uint32_t JobSystem::GetThreadCount( void )
+{
+    return s_ThreadCount;
+}
+
+void JobSystem::Run( std::function<void()> Function, JobCounter& Counter )
+{
+    ASSERT(s_WorkerIndex != kNotAWorker, "Jobs can only be queued by the main thread or by other jobs");
+
+    Job* NewJob = new Job;
+    NewJob->Function = std::move(Function);
+    NewJob->Counter = &Counter;
+    Counter.m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+    // Counted before it's visible to thieves, so the count never drops below zero
+    s_QueuedJobs.fetch_add(1);
+
+    // A full deque means plenty of queued work already; just run the job here
+    if (!s_Queues[s_WorkerIndex].Push(NewJob))
+    {
+        s_QueuedJobs.fetch_sub(1);
+        RunJob(NewJob);
+        return;
+    }
+
+    if (s_SleepingWorkers.load() > 0)
+    {
+        std::lock_guard<std::mutex> Lock(s_SleepMutex);
+        s_WakeCondition.notify_one();
+    }
+}
+
+void JobSystem::Wait( JobCounter& Counter )
+{
+    ASSERT(s_WorkerIndex != kNotAWorker, "Only the main thread and jobs may wait on jobs");
+
+    while (!Counter.IsDone())
+    {
+        Job* FoundJob = FindJob();
+        if (FoundJob != nullptr)
+            RunJob(FoundJob);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor( uint32_t Begin, uint32_t End, uint32_t Grain, const std::function<void(uint32_t, uint32_t)>& Body )
+{
+    if (Begin >= End)
+        return;
+
+    if (Grain == 0)
+        Grain = 1;
+
+    if (End - Begin <= Grain)
+    {
+        Body(Begin, End);
+        return;
+    }
+
+    // Queue every chunk but the first, which this thread runs before helping with the rest.
+    // Chunks are measured from the end so a range ending near UINT32_MAX can't wrap.
+    JobCounter Counter;
+    for (uint32_t ChunkBegin = Begin + Grain; ChunkBegin < End; )
+    {
+        const uint32_t ChunkEnd = End - ChunkBegin > Grain ? ChunkBegin + Grain : End;
+        Run([&Body, ChunkBegin, ChunkEnd]{ Body(ChunkBegin, ChunkEnd); }, Counter);
+        ChunkBegin = ChunkEnd;
+    }
+    Body(Begin, Begin + Grain);
+    Wait(Counter);
+}
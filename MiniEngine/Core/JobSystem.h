@@ -0,0 +1,60 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+//
+// A work-stealing job system.  Every worker, including the thread that called Initialize(),
+// owns a Chase-Lev deque:  it pushes and pops jobs at the bottom while idle workers steal
+// from the top.  Jobs may be queued from the main thread or from inside other jobs.
+//
+namespace JobSystem
+{
+    // Tracks a group of jobs.  Wait() on it returns after all of them have run.
+    class JobCounter
+    {
+    public:
+        JobCounter() : m_Pending(0) {}
+
+        bool IsDone( void ) const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend void Run( std::function<void()>, JobCounter& );
+        friend struct Job;
+
+        JobCounter( const JobCounter& ) = delete;
+        JobCounter& operator=( const JobCounter& ) = delete;
+
+        std::atomic<uint32_t> m_Pending;
+    };
+
+    // Starts WorkerCount threads in addition to the calling thread, which becomes worker 0.
+    // A count of 0 uses one thread per remaining hardware thread.
+    void Initialize( uint32_t WorkerCount = 0 );
+    void Shutdown( void );
+
+    // Worker threads plus the main thread
+    uint32_t GetThreadCount( void );
+
+    // Queues a job on the calling worker's deque.  Only the main thread and jobs may call this.
+    void Run( std::function<void()> Function, JobCounter& Counter );
+
+    // Runs queued jobs, this thread's and stolen ones, until the counter reaches zero
+    void Wait( JobCounter& Counter );
+
+    // Splits [Begin, End) into chunks of at most Grain elements, runs Body(ChunkBegin, ChunkEnd)
+    // on each, and returns when all are done.
+    void ParallelFor( uint32_t Begin, uint32_t End, uint32_t Grain, const std::function<void(uint32_t, uint32_t)>& Body );
+}
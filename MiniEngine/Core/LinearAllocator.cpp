@@ -16,73 +16,41 @@
 #include "LinearAllocator.h"
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
-#include <thread>
+#include "EngineProfiling.h"
 
 using namespace Graphics;
 using namespace std;
 
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
 
-LinearAllocatorPageManager::LinearAllocatorPageManager()
+LinearAllocatorPageManager::LinearAllocatorPageManager() : m_PagePool(*this)
 {
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
     ASSERT(sm_AutoType <= kNumAllocatorTypes);
-}
-
-LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
-LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
-{
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
-    {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
-    }
-
-    LinearAllocationPage* PagePtr = nullptr;
-
-    if (!m_AvailablePages.empty())
+    const LinearPagePoolStats& Stats = m_PagePool.GetStats();
+    if (m_AllocationType == kGpuExclusive)
     {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
+        EngineProfiling::RegisterCounter("GPU Pages Requested", Stats.PagesRequested);
+        EngineProfiling::RegisterCounter("GPU Pages Created", Stats.PagesCreated);
+        EngineProfiling::RegisterCounter("GPU Large Pages Requested", Stats.LargePagesRequested);
+        EngineProfiling::RegisterCounter("GPU Large Pages Created", Stats.LargePagesCreated);
+        EngineProfiling::RegisterCounter("GPU Page Lock Contention", Stats.LockContention);
     }
     else
     {
-        PagePtr = CreateNewPage();
-        m_PagePool.emplace_back(PagePtr);
+        EngineProfiling::RegisterCounter("Upload Pages Requested", Stats.PagesRequested);
+        EngineProfiling::RegisterCounter("Upload Pages Created", Stats.PagesCreated);
+        EngineProfiling::RegisterCounter("Upload Large Pages Requested", Stats.LargePagesRequested);
+        EngineProfiling::RegisterCounter("Upload Large Pages Created", Stats.LargePagesCreated);
+        EngineProfiling::RegisterCounter("Upload Page Lock Contention", Stats.LockContention);
     }
-
-    return PagePtr;
-}
-
-void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
-{
-    lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
 }
 
-void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
-{
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
-    {
-        delete m_DeletionQueue.front().second;
-        m_DeletionQueue.pop();
-    }
-
-    for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
-    {
-        (*iter)->Unmap();
-        m_DeletionQueue.push(make_pair(FenceValue, *iter));
-    }
-}
+LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
-LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
+LinearAllocationPage* LinearAllocatorPageManager::CreatePage( size_t PageSize )
 {
     D3D12_HEAP_PROPERTIES HeapProps;
     HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
@@ -127,6 +95,11 @@ LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize
     return new LinearAllocationPage(pBuffer, DefaultUsage);
 }
 
+bool LinearAllocatorPageManager::IsFenceComplete( uint64_t FenceValue )
+{
+    return g_CommandManager.IsFenceComplete(FenceValue);
+}
+
 void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
 {
     if (m_CurPage == nullptr)
@@ -139,13 +112,13 @@ void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
     sm_PageManager[m_AllocationType].DiscardPages(FenceID, m_RetiredPages);
     m_RetiredPages.clear();
 
-    sm_PageManager[m_AllocationType].FreeLargePages(FenceID, m_LargePageList);
+    sm_PageManager[m_AllocationType].DiscardLargePages(FenceID, m_LargePageList);
     m_LargePageList.clear();
 }
 
 DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes)
 {
-    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].CreateNewPage(SizeInBytes);
+    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].RequestLargePage(SizeInBytes);
     m_LargePageList.push_back(OneOff);
 
     DynAlloc ret(*OneOff, 0, SizeInBytes);
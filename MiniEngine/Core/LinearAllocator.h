@@ -13,8 +13,8 @@
 // Description:  This is a dynamic graphics memory allocator for DX12.  It's designed to work in concert
 // with the CommandContext class and to do so in a thread-safe manner.  There may be many command contexts,
 // each with its own linear allocators.  They act as windows into a global memory pool by reserving a
-// context-local memory page.  Requesting a new page is done in a thread-safe manner by guarding accesses
-// with a mutex lock.
+// context-local memory page.  Pages are recycled through a LinearPagePool, which keeps a cache of them
+// for each thread so that contexts recording in parallel rarely meet on a lock.
 //
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
@@ -23,9 +23,8 @@
 #pragma once
 
 #include "GpuResource.h"
+#include "LinearPagePool.h"
 #include <vector>
-#include <queue>
-#include <mutex>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
 #define DEFAULT_ALIGN 256
@@ -51,6 +50,7 @@ public:
         m_pResource.Attach(pResource);
         m_UsageState = Usage;
         m_GpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
+        m_PageSize = (size_t)m_pResource->GetDesc().Width;
         m_pResource->Map(0, nullptr, &m_CpuVirtualAddress);
     }
 
@@ -78,6 +78,7 @@ public:
 
     void* m_CpuVirtualAddress;
     D3D12_GPU_VIRTUAL_ADDRESS m_GpuVirtualAddress;
+    size_t m_PageSize;
 };
 
 enum LinearAllocatorType
@@ -96,33 +97,41 @@ enum
     kCpuAllocatorPageSize = 0x200000	// 2MB
 };
 
-class LinearAllocatorPageManager
+class LinearAllocatorPageManager : public LinearPageSource<LinearAllocationPage>
 {
 public:
 
     LinearAllocatorPageManager();
-    LinearAllocationPage* RequestPage( void );
-    LinearAllocationPage* CreateNewPage( size_t PageSize = 0 );
+    LinearAllocationPage* RequestPage( void ) { return m_PagePool.RequestPage(); }
+
+    // Discarded pages will get recycled once their fence has passed.  This is for fixed size pages.
+    void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages )
+    {
+        m_PagePool.DiscardPages(FenceID, Pages);
+    }
 
-    // Discarded pages will get recycled.  This is for fixed size pages.
-    void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    // Single-use, "large" pages are kept by size class and handed out again for allocations that
+    // round up to the same size.
+    LinearAllocationPage* RequestLargePage( size_t SizeInBytes ) { return m_PagePool.RequestLargePage(SizeInBytes); }
+    void DiscardLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages )
+    {
+        m_PagePool.DiscardLargePages(FenceID, Pages);
+    }
 
-    // Freed pages will be destroyed once their fence has passed.  This is for single-use,
-    // "large" pages.
-    void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    void Destroy( void ) { m_PagePool.Destroy(); }
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    // LinearPageSource
+    virtual LinearAllocationPage* CreatePage( size_t PageSize ) override;
+    virtual void DestroyPage( LinearAllocationPage* Page ) override { delete Page; }
+    virtual size_t GetPageSize( const LinearAllocationPage* Page ) override { return Page->m_PageSize; }
+    virtual bool IsFenceComplete( uint64_t FenceValue ) override;
 
 private:
 
     static LinearAllocatorType sm_AutoType;
 
     LinearAllocatorType m_AllocationType;
-    std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
-    std::mutex m_Mutex;
+    LinearPagePool<LinearAllocationPage> m_PagePool;
 };
 
 class LinearAllocator
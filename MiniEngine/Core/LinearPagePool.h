@@ -0,0 +1,324 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The page recycling behind LinearAllocator, kept free of D3D so that it can be driven
+// by any page source.  Fixed size pages are cached per thread:  a thread retires the pages of a finished
+// context as one batch tagged with its fence, and takes pages back from its own cache without locking.
+// Only when a thread's cache runs dry or overflows does it trade pages with the shared pool, and then
+// in bunches.  "Large" pages are rounded up to a size class and recycled instead of being destroyed.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Creates and destroys pages and knows when the GPU is done with them
+template <typename PageType>
+class LinearPageSource
+{
+public:
+    virtual ~LinearPageSource() {}
+
+    // A size of 0 asks for a default sized page
+    virtual PageType* CreatePage( size_t PageSize ) = 0;
+    virtual void DestroyPage( PageType* Page ) = 0;
+    virtual size_t GetPageSize( const PageType* Page ) = 0;
+    virtual bool IsFenceComplete( uint64_t FenceValue ) = 0;
+};
+
+// Running totals, readable from any thread
+struct LinearPagePoolStats
+{
+    std::atomic<uint64_t> PagesRequested;
+    std::atomic<uint64_t> PagesCreated;
+    std::atomic<uint64_t> LargePagesRequested;
+    std::atomic<uint64_t> LargePagesCreated;
+    std::atomic<uint64_t> LockContention;	// times a thread had to wait for the shared pool
+};
+
+template <typename PageType>
+class LinearPagePool
+{
+public:
+    enum
+    {
+        kMaxThreads = 64,		// threads past this share the locked pool
+        kMaxCachedPages = 8,	// a thread keeps half this many when it overflows
+        kMaxCachedLargeBytes = 64 << 20
+    };
+
+    LinearPagePool( LinearPageSource<PageType>& Source ) : m_Source(Source), m_CachedLargeBytes(0)
+    {
+        m_Stats.PagesRequested = 0;
+        m_Stats.PagesCreated = 0;
+        m_Stats.LargePagesRequested = 0;
+        m_Stats.LargePagesCreated = 0;
+        m_Stats.LockContention = 0;
+    }
+
+    ~LinearPagePool() { Destroy(); }
+
+    PageType* RequestPage( void );
+    void DiscardPages( uint64_t FenceValue, const std::vector<PageType*>& Pages );
+
+    // Large pages are at least SizeInBytes, rounded up so that similar sizes share pages
+    PageType* RequestLargePage( size_t SizeInBytes );
+    void DiscardLargePages( uint64_t FenceValue, const std::vector<PageType*>& Pages );
+
+    static size_t GetLargePageSize( size_t SizeInBytes );
+
+    // Destroys every page.  No other thread may be using the pool.
+    void Destroy( void );
+
+    const LinearPagePoolStats& GetStats( void ) const { return m_Stats; }
+
+private:
+
+    struct RetiredBatch
+    {
+        uint64_t FenceValue;
+        std::vector<PageType*> Pages;
+    };
+
+    struct alignas(64) ThreadCache
+    {
+        std::vector<PageType*> Available;
+        std::deque<RetiredBatch> Retired;
+    };
+
+    static uint32_t GetThreadSlot( void )
+    {
+        static std::atomic<uint32_t> s_NextSlot(0);
+        static thread_local uint32_t t_Slot = s_NextSlot.fetch_add(1);
+        return t_Slot;
+    }
+
+    ThreadCache* GetThreadCache( void )
+    {
+        const uint32_t Slot = GetThreadSlot();
+        return Slot < kMaxThreads ? &m_ThreadCaches[Slot] : nullptr;
+    }
+
+    std::unique_lock<std::mutex> Lock( std::mutex& Mutex )
+    {
+        std::unique_lock<std::mutex> Guard(Mutex, std::try_to_lock);
+        if (!Guard.owns_lock())
+        {
+            m_Stats.LockContention.fetch_add(1, std::memory_order_relaxed);
+            Guard.lock();
+        }
+        return Guard;
+    }
+
+    // Moves the pages of every leading batch whose fence has passed to Available
+    void RetireCompletedBatches( std::deque<RetiredBatch>& Retired, std::vector<PageType*>& Available )
+    {
+        while (!Retired.empty() && m_Source.IsFenceComplete(Retired.front().FenceValue))
+        {
+            const std::vector<PageType*>& Pages = Retired.front().Pages;
+            Available.insert(Available.end(), Pages.begin(), Pages.end());
+            Retired.pop_front();
+        }
+    }
+
+    PageType* CreatePage( void );
+
+    LinearPageSource<PageType>& m_Source;
+    LinearPagePoolStats m_Stats;
+
+    ThreadCache m_ThreadCaches[kMaxThreads];
+
+    // Shared pool of fixed size pages
+    std::mutex m_Mutex;
+    std::vector<PageType*> m_AvailablePages;
+    std::deque<RetiredBatch> m_RetiredPages;	// from threads without a cache
+    std::vector<PageType*> m_PagePool;			// every fixed size page, for Destroy()
+
+    // Large pages by size class
+    std::mutex m_LargeMutex;
+    std::map<size_t, std::vector<PageType*> > m_AvailableLargePages;
+    std::deque<std::pair<uint64_t, PageType*> > m_RetiredLargePages;
+    std::unordered_set<PageType*> m_LargePagePool;
+    size_t m_CachedLargeBytes;
+};
+
+template <typename PageType>
+PageType* LinearPagePool<PageType>::CreatePage( void )
+{
+    PageType* NewPage = m_Source.CreatePage(0);
+    m_Stats.PagesCreated.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex> Guard = Lock(m_Mutex);
+    m_PagePool.push_back(NewPage);
+    return NewPage;
+}
+
+template <typename PageType>
+PageType* LinearPagePool<PageType>::RequestPage( void )
+{
+    m_Stats.PagesRequested.fetch_add(1, std::memory_order_relaxed);
+
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache == nullptr)
+    {
+        std::unique_lock<std::mutex> Guard = Lock(m_Mutex);
+        RetireCompletedBatches(m_RetiredPages, m_AvailablePages);
+        if (!m_AvailablePages.empty())
+        {
+            PageType* PagePtr = m_AvailablePages.back();
+            m_AvailablePages.pop_back();
+            return PagePtr;
+        }
+        Guard.unlock();
+        return CreatePage();
+    }
+
+    RetireCompletedBatches(Cache->Retired, Cache->Available);
+
+    if (Cache->Available.empty())
+    {
+        // Refill half the cache from the shared pool
+        std::unique_lock<std::mutex> Guard = Lock(m_Mutex);
+        RetireCompletedBatches(m_RetiredPages, m_AvailablePages);
+        const size_t Count = m_AvailablePages.size() < kMaxCachedPages / 2 ? m_AvailablePages.size() : kMaxCachedPages / 2;
+        Cache->Available.insert(Cache->Available.end(), m_AvailablePages.end() - Count, m_AvailablePages.end());
+        m_AvailablePages.resize(m_AvailablePages.size() - Count);
+    }
+
+    if (Cache->Available.empty())
+        return CreatePage();
+
+    PageType* PagePtr = Cache->Available.back();
+    Cache->Available.pop_back();
+    return PagePtr;
+}
+
+template <typename PageType>
+void LinearPagePool<PageType>::DiscardPages( uint64_t FenceValue, const std::vector<PageType*>& Pages )
+{
+    if (Pages.empty())
+        return;
+
+    ThreadCache* Cache = GetThreadCache();
+    if (Cache == nullptr)
+    {
+        std::unique_lock<std::mutex> Guard = Lock(m_Mutex);
+        m_RetiredPages.push_back(RetiredBatch{ FenceValue, Pages });
+        return;
+    }
+
+    Cache->Retired.push_back(RetiredBatch{ FenceValue, Pages });
+
+    // A thread that mostly finishes contexts recorded elsewhere collects more pages than it uses.
+    // Hand the extras to the shared pool for the threads that record.
+    RetireCompletedBatches(Cache->Retired, Cache->Available);
+    if (Cache->Available.size() > kMaxCachedPages)
+    {
+        std::unique_lock<std::mutex> Guard = Lock(m_Mutex);
+        m_AvailablePages.insert(m_AvailablePages.end(), Cache->Available.begin() + kMaxCachedPages / 2, Cache->Available.end());
+        Cache->Available.resize(kMaxCachedPages / 2);
+    }
+}
+
+template <typename PageType>
+size_t LinearPagePool<PageType>::GetLargePageSize( size_t SizeInBytes )
+{
+    // Four size classes per power of two, so no more than a quarter of a page goes unused
+    size_t Step = 1;
+    while (Step * 8 <= SizeInBytes)
+        Step *= 2;
+    return (SizeInBytes + Step - 1) & ~(Step - 1);
+}
+
+template <typename PageType>
+PageType* LinearPagePool<PageType>::RequestLargePage( size_t SizeInBytes )
+{
+    m_Stats.LargePagesRequested.fetch_add(1, std::memory_order_relaxed);
+
+    const size_t PageSize = GetLargePageSize(SizeInBytes);
+
+    std::unique_lock<std::mutex> Guard = Lock(m_LargeMutex);
+
+    while (!m_RetiredLargePages.empty() && m_Source.IsFenceComplete(m_RetiredLargePages.front().first))
+    {
+        PageType* Retired = m_RetiredLargePages.front().second;
+        m_RetiredLargePages.pop_front();
+
+        const size_t RetiredSize = m_Source.GetPageSize(Retired);
+        if (m_CachedLargeBytes + RetiredSize > kMaxCachedLargeBytes)
+        {
+            m_LargePagePool.erase(Retired);
+            m_Source.DestroyPage(Retired);
+        }
+        else
+        {
+            m_AvailableLargePages[RetiredSize].push_back(Retired);
+            m_CachedLargeBytes += RetiredSize;
+        }
+    }
+
+    auto Bucket = m_AvailableLargePages.find(PageSize);
+    if (Bucket != m_AvailableLargePages.end() && !Bucket->second.empty())
+    {
+        PageType* PagePtr = Bucket->second.back();
+        Bucket->second.pop_back();
+        m_CachedLargeBytes -= PageSize;
+        return PagePtr;
+    }
+
+    Guard.unlock();
+
+    PageType* NewPage = m_Source.CreatePage(PageSize);
+    m_Stats.LargePagesCreated.fetch_add(1, std::memory_order_relaxed);
+
+    Guard.lock();
+    m_LargePagePool.insert(NewPage);
+    return NewPage;
+}
+
+template <typename PageType>
+void LinearPagePool<PageType>::DiscardLargePages( uint64_t FenceValue, const std::vector<PageType*>& Pages )
+{
+    if (Pages.empty())
+        return;
+
+    std::unique_lock<std::mutex> Guard = Lock(m_LargeMutex);
+    for (PageType* PagePtr : Pages)
+        m_RetiredLargePages.push_back(std::make_pair(FenceValue, PagePtr));
+}
+
+template <typename PageType>
+void LinearPagePool<PageType>::Destroy( void )
+{
+    for (ThreadCache& Cache : m_ThreadCaches)
+    {
+        Cache.Available.clear();
+        Cache.Retired.clear();
+    }
+
+    for (PageType* PagePtr : m_PagePool)
+        m_Source.DestroyPage(PagePtr);
+    m_PagePool.clear();
+    m_AvailablePages.clear();
+    m_RetiredPages.clear();
+
+    for (PageType* PagePtr : m_LargePagePool)
+        m_Source.DestroyPage(PagePtr);
+    m_LargePagePool.clear();
+    m_AvailableLargePages.clear();
+    m_RetiredLargePages.clear();
+    m_CachedLargeBytes = 0;
+}
@@ -0,0 +1,161 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/MappedFileTest.cpp)
+#include "MappedFile.h"
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+    #define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using Utility::MappedFile;
+
+MappedFile::MappedFile() : m_Data(nullptr), m_Size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open( const char* FileName )
+{
+    std::string NarrowName(FileName);
+    return Open(std::wstring(NarrowName.begin(), NarrowName.end()).c_str());
+}
+
+bool MappedFile::Open( const wchar_t* FileName )
+{
+    Close();
+
+    HANDLE File = CreateFileW(FileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize;
+    HANDLE Mapping = nullptr;
+    if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0)
+        Mapping = CreateFileMappingA(File, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+
+    // The view keeps the file open
+    CloseHandle(File);
+    if (Mapping == nullptr)
+        return false;
+
+    m_Data = (uint8_t*)MapViewOfFile(Mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(Mapping);
+    if (m_Data == nullptr)
+        return false;
+
+    m_Size = (uint64_t)FileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::Close( void )
+{
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+void MappedFile::Prefetch( const void* Ptr, size_t Size ) const
+{
+    if (Size == 0)
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY Range = { const_cast<void*>(Ptr), Size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+}
+
+void MappedFile::Evict( const void* Ptr, size_t Size ) const
+{
+    // Unlocking pages that aren't locked takes them out of the working set
+    if (Size > 0)
+        VirtualUnlock(const_cast<void*>(Ptr), Size);
+}
+
+#else
+
+bool MappedFile::Open( const char* FileName )
+{
+    Close();
+
+    int File = open(FileName, O_RDONLY);
+    if (File < 0)
+        return false;
+
+    struct stat Stat;
+    void* Data = MAP_FAILED;
+    if (fstat(File, &Stat) == 0 && Stat.st_size > 0)
+        Data = mmap(nullptr, (size_t)Stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, File, 0);
+
+    // The mapping keeps the file open
+    close(File);
+    if (Data == MAP_FAILED)
+        return false;
+
+    m_Data = (uint8_t*)Data;
+    m_Size = (uint64_t)Stat.st_size;
+    return true;
+}
+
+bool MappedFile::Open( const wchar_t* FileName )
+{
+    std::wstring WideName(FileName);
+    return Open(std::string(WideName.begin(), WideName.end()).c_str());
+}
+
+void MappedFile::Close( void )
+{
+    if (m_Data != nullptr)
+        munmap(m_Data, (size_t)m_Size);
+
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+void MappedFile::Prefetch( const void* Ptr, size_t Size ) const
+{
+    const uintptr_t PageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t Begin = (uintptr_t)Ptr & ~(PageSize - 1);
+    const uintptr_t End = (uintptr_t)Ptr + Size;
+    if (End > Begin)
+        madvise((void*)Begin, End - Begin, MADV_WILLNEED);
+}
+
+void MappedFile::Evict( const void* Ptr, size_t Size ) const
+{
+    // Only pages entirely inside the range, since the rest of a page may still be in use
+    const uintptr_t PageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t Begin = ((uintptr_t)Ptr + PageSize - 1) & ~(PageSize - 1);
+    const uintptr_t End = ((uintptr_t)Ptr + Size) & ~(PageSize - 1);
+    if (End > Begin)
+        madvise((void*)Begin, End - Begin, MADV_DONTNEED);
+}
+
+#endif
@@ -0,0 +1,56 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A whole file mapped into memory copy-on-write.  Pages are read from the file the first time
+// they are touched, and writes go to private copies that never reach the file.  Uses MapViewOfFile on
+// Windows and mmap elsewhere.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Utility
+{
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        bool Open( const char* FileName );
+        bool Open( const wchar_t* FileName );
+        void Close( void );
+
+        bool IsOpen( void ) const { return m_Data != nullptr; }
+        uint8_t* GetData( void ) const { return m_Data; }
+        uint64_t GetSize( void ) const { return m_Size; }
+
+        bool Contains( const void* Ptr ) const
+        {
+            return Ptr >= m_Data && Ptr < m_Data + m_Size;
+        }
+
+        // Starts reading a range from the file in the background
+        void Prefetch( const void* Ptr, size_t Size ) const;
+
+        // Gives back the memory of a range that won't be needed soon.  It is read from the file again if it
+        // is touched, so only evict ranges that haven't been written.
+        void Evict( const void* Ptr, size_t Size ) const;
+
+    private:
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator=( const MappedFile& ) = delete;
+
+        uint8_t* m_Data;
+        uint64_t m_Size;
+    };
+}
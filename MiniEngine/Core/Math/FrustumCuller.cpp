@@ -0,0 +1,258 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/FrustumCullerTest.cpp)
+#include "FrustumCuller.h"
+#include <cassert>
+#include <cmath>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX_FUNCTION
+#else
+#include <cpuid.h>
+#define AVX_FUNCTION __attribute__((target("avx")))
+#endif
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+using namespace Math;
+
+namespace
+{
+    bool IsAVXSupported( void )
+    {
+        int CpuInfo[4];
+#ifdef _MSC_VER
+        __cpuid(CpuInfo, 1);
+#else
+        __cpuid(1, CpuInfo[0], CpuInfo[1], CpuInfo[2], CpuInfo[3]);
+#endif
+
+        // The OS has to save the YMM registers as well
+        const int kOSXSAVE = 1 << 27, kAVX = 1 << 28;
+        if ((CpuInfo[2] & (kOSXSAVE | kAVX)) != (kOSXSAVE | kAVX))
+            return false;
+
+#ifdef _MSC_VER
+        const uint64_t EnabledState = _xgetbv(0);
+#else
+        uint32_t Low, High;
+        __asm__("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+        const uint64_t EnabledState = ((uint64_t)High << 32) | Low;
+#endif
+        return (EnabledState & 6) == 6;
+    }
+
+    const bool s_HasAVX = IsAVXSupported();
+
+    uint32_t FirstSetBit( uint32_t Mask )
+    {
+#ifdef _MSC_VER
+        unsigned long Index;
+        _BitScanForward(&Index, Mask);
+        return Index;
+#else
+        return (uint32_t)__builtin_ctz(Mask);
+#endif
+    }
+}
+
+void FrustumCuller::ClearBoxes( void )
+{
+    m_BoxCount = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        m_Center[i].clear();
+        m_Extent[i].clear();
+    }
+}
+
+void FrustumCuller::AddBox( const float minBound[3], const float maxBound[3] )
+{
+    // Padding boxes are never reported, their lanes are masked off
+    const uint32_t PaddedCount = (m_BoxCount + 8) & ~7u;
+    for (int i = 0; i < 3; ++i)
+    {
+        m_Center[i].resize(PaddedCount, 0.0f);
+        m_Extent[i].resize(PaddedCount, 0.0f);
+        m_Center[i][m_BoxCount] = (maxBound[i] + minBound[i]) * 0.5f;
+        m_Extent[i][m_BoxCount] = (maxBound[i] - minBound[i]) * 0.5f;
+    }
+    ++m_BoxCount;
+}
+
+uint32_t FrustumCuller::AddView( const float ViewProj[4][4] )
+{
+    ASSERT(m_ViewCount < kMaxViews, "Too many culling views");
+
+    // Clip space is -w <= x <= w, -w <= y <= w, 0 <= z <= w.  Each inequality is a plane
+    // built from rows of the matrix.  The planes aren't normalized; the box test only
+    // needs the sign of the distance.
+    auto Row = [ViewProj]( int i, float* Plane )
+    {
+        for (int j = 0; j < 4; ++j)
+            Plane[j] = ViewProj[j][i];
+    };
+
+    float X[4], Y[4], Z[4], W[4];
+    Row(0, X);
+    Row(1, Y);
+    Row(2, Z);
+    Row(3, W);
+
+    float Planes[6][4];
+    for (int j = 0; j < 4; ++j)
+    {
+        Planes[0][j] = W[j] + X[j];
+        Planes[1][j] = W[j] - X[j];
+        Planes[2][j] = W[j] + Y[j];
+        Planes[3][j] = W[j] - Y[j];
+        Planes[4][j] = Z[j];
+        Planes[5][j] = W[j] - Z[j];
+    }
+
+    ViewPlanes& View = m_Views[m_ViewCount];
+    for (int p = 0; p < 6; ++p)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            View.n[p][j] = Planes[p][j];
+            View.a[p][j] = fabsf(Planes[p][j]);
+        }
+        View.d[p] = Planes[p][3];
+    }
+
+    return m_ViewCount++;
+}
+
+void FrustumCuller::Cull( void )
+{
+    for (uint32_t v = 0; v < m_ViewCount; ++v)
+    {
+        m_Visible[v].resize(m_BoxCount);
+        m_VisibleCount[v] = 0;
+    }
+
+    if (m_BoxCount == 0 || m_ViewCount == 0)
+        return;
+
+    if (s_HasAVX)
+        CullAVX();
+    else
+        CullSSE();
+}
+
+//
+// A box is outside a plane when its center is further behind it than the box's
+// projected half size, dot(n, c) + d + dot(|n|, e) < 0.
+//
+AVX_FUNCTION void FrustumCuller::CullAVX( void )
+{
+    const float* CX = m_Center[0].data();
+    const float* CY = m_Center[1].data();
+    const float* CZ = m_Center[2].data();
+    const float* EX = m_Extent[0].data();
+    const float* EY = m_Extent[1].data();
+    const float* EZ = m_Extent[2].data();
+
+    for (uint32_t Base = 0; Base < m_BoxCount; Base += 8)
+    {
+        const __m256 cx = _mm256_loadu_ps(CX + Base);
+        const __m256 cy = _mm256_loadu_ps(CY + Base);
+        const __m256 cz = _mm256_loadu_ps(CZ + Base);
+        const __m256 ex = _mm256_loadu_ps(EX + Base);
+        const __m256 ey = _mm256_loadu_ps(EY + Base);
+        const __m256 ez = _mm256_loadu_ps(EZ + Base);
+
+        const uint32_t Remaining = m_BoxCount - Base;
+        const uint32_t ValidMask = Remaining >= 8 ? 0xFF : (1u << Remaining) - 1;
+
+        for (uint32_t v = 0; v < m_ViewCount; ++v)
+        {
+            const ViewPlanes& View = m_Views[v];
+
+            __m256 Inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m256 Dist = _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(View.n[p][0])), _mm256_set1_ps(View.d[p]));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(cy, _mm256_set1_ps(View.n[p][1])));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(cz, _mm256_set1_ps(View.n[p][2])));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(ex, _mm256_set1_ps(View.a[p][0])));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(ey, _mm256_set1_ps(View.a[p][1])));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(ez, _mm256_set1_ps(View.a[p][2])));
+                Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+
+            uint32_t Mask = (uint32_t)_mm256_movemask_ps(Inside) & ValidMask;
+            uint32_t* Out = m_Visible[v].data();
+            uint32_t Count = m_VisibleCount[v];
+            while (Mask != 0)
+            {
+                Out[Count++] = Base + FirstSetBit(Mask);
+                Mask &= Mask - 1;
+            }
+            m_VisibleCount[v] = Count;
+        }
+    }
+
+    _mm256_zeroupper();
+}
+
+void FrustumCuller::CullSSE( void )
+{
+    const float* CX = m_Center[0].data();
+    const float* CY = m_Center[1].data();
+    const float* CZ = m_Center[2].data();
+    const float* EX = m_Extent[0].data();
+    const float* EY = m_Extent[1].data();
+    const float* EZ = m_Extent[2].data();
+
+    for (uint32_t Base = 0; Base < m_BoxCount; Base += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(CX + Base);
+        const __m128 cy = _mm_loadu_ps(CY + Base);
+        const __m128 cz = _mm_loadu_ps(CZ + Base);
+        const __m128 ex = _mm_loadu_ps(EX + Base);
+        const __m128 ey = _mm_loadu_ps(EY + Base);
+        const __m128 ez = _mm_loadu_ps(EZ + Base);
+
+        const uint32_t Remaining = m_BoxCount - Base;
+        const uint32_t ValidMask = Remaining >= 4 ? 0xF : (1u << Remaining) - 1;
+
+        for (uint32_t v = 0; v < m_ViewCount; ++v)
+        {
+            const ViewPlanes& View = m_Views[v];
+
+            __m128 Inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 Dist = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(View.n[p][0])), _mm_set1_ps(View.d[p]));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(cy, _mm_set1_ps(View.n[p][1])));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(cz, _mm_set1_ps(View.n[p][2])));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(ex, _mm_set1_ps(View.a[p][0])));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(ey, _mm_set1_ps(View.a[p][1])));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(ez, _mm_set1_ps(View.a[p][2])));
+                Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Dist, _mm_setzero_ps()));
+            }
+
+            uint32_t Mask = (uint32_t)_mm_movemask_ps(Inside) & ValidMask;
+            uint32_t* Out = m_Visible[v].data();
+            uint32_t Count = m_VisibleCount[v];
+            while (Mask != 0)
+            {
+                Out[Count++] = Base + FirstSetBit(Mask);
+                Mask &= Mask - 1;
+            }
+            m_VisibleCount[v] = Count;
+        }
+    }
+}
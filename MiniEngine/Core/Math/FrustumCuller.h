@@ -0,0 +1,71 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace Math
+{
+    //
+    // Culls a static set of axis-aligned boxes against several views at once.  Boxes are
+    // kept as structure-of-arrays center/extent streams and tested eight at a time with
+    // AVX (four at a time with SSE on older CPUs), so each box is loaded once per frame
+    // no matter how many views there are.  It takes plain floats rather than Vector3 and
+    // Matrix4 so that it builds on its own (see Tests/FrustumCullerTest.cpp).
+    //
+    class FrustumCuller
+    {
+    public:
+        enum { kMaxViews = 32 };
+
+        void ClearBoxes( void );
+        void AddBox( const float minBound[3], const float maxBound[3] );
+        uint32_t GetBoxCount( void ) const { return m_BoxCount; }
+
+        // Views are rebuilt every frame.  The planes are extracted from the view-projection
+        // matrix, so any perspective or orthographic camera works.  The matrix is laid out as
+        // XMFLOAT4X4, ViewProj[row][column] for row vectors.  Returns the view index.
+        void ClearViews( void ) { m_ViewCount = 0; }
+        uint32_t AddView( const float ViewProj[4][4] );
+        uint32_t GetViewCount( void ) const { return m_ViewCount; }
+
+        void Cull( void );
+
+        // Ascending indices of the boxes intersecting a view after the last Cull()
+        const uint32_t* GetVisibleBoxes( uint32_t view ) const { return m_Visible[view].data(); }
+        uint32_t GetVisibleCount( uint32_t view ) const { return m_VisibleCount[view]; }
+
+    private:
+
+        void CullAVX( void );
+        void CullSSE( void );
+
+        // plane normal, distance, and absolute normal, one per frustum plane
+        struct ViewPlanes
+        {
+            float n[6][3];
+            float d[6];
+            float a[6][3];
+        };
+
+        uint32_t m_BoxCount = 0;
+        std::vector<float> m_Center[3];	// padded to a multiple of eight
+        std::vector<float> m_Extent[3];
+
+        uint32_t m_ViewCount = 0;
+        ViewPlanes m_Views[kMaxViews];
+        std::vector<uint32_t> m_Visible[kMaxViews];
+        uint32_t m_VisibleCount[kMaxViews];
+    };
+
+} // namespace Math
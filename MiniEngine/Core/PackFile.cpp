@@ -0,0 +1,143 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/PackFileTest.cpp)
+#include "PackFile.h"
+#include <algorithm>
+#include <cwctype>
+#include <cstring>
+
+using Utility::PackFile;
+
+PackFile::PackFile() : m_Toc(nullptr), m_NumEntries(0)
+{
+}
+
+bool PackFile::Open( const std::wstring& FileName )
+{
+    Close();
+
+    if (!m_File.Open(FileName.c_str()))
+        return false;
+
+    const uint8_t* Data = m_File.GetData();
+    const uint64_t FileSize = m_File.GetSize();
+    const Header& header = *(const Header*)Data;
+
+    if (FileSize < sizeof(Header) || header.Magic != kMagic || header.Version != kVersion ||
+        header.NumEntries > (FileSize - sizeof(Header)) / sizeof(TocEntry))
+    {
+        Close();
+        return false;
+    }
+
+    // Check every entry once so that lookups can trust them
+    const TocEntry* Toc = (const TocEntry*)(Data + sizeof(Header));
+    for (uint32_t i = 0; i < header.NumEntries; ++i)
+    {
+        const TocEntry& Entry = Toc[i];
+        if (Entry.Offset > FileSize || Entry.StoredSize > FileSize - Entry.Offset ||
+            (uint64_t)Entry.PathOffset + Entry.PathLength > FileSize ||
+            ((Entry.Flags & kGzip) == 0 && Entry.StoredSize != Entry.Size))
+        {
+            Close();
+            return false;
+        }
+    }
+
+    m_Toc = Toc;
+    m_NumEntries = header.NumEntries;
+    return true;
+}
+
+void PackFile::Close( void )
+{
+    m_File.Close();
+    m_Toc = nullptr;
+    m_NumEntries = 0;
+}
+
+bool PackFile::Find( const std::wstring& FileName, Entry& Result ) const
+{
+    if (m_NumEntries == 0)
+        return false;
+
+    const std::string Path = NormalizePath(FileName);
+    const uint64_t Hash = HashPath(Path);
+
+    const TocEntry* End = m_Toc + m_NumEntries;
+    const TocEntry* Iter = std::lower_bound(m_Toc, End, Hash,
+        [](const TocEntry& Entry, uint64_t Hash) { return Entry.PathHash < Hash; });
+
+    for (; Iter != End && Iter->PathHash == Hash; ++Iter)
+    {
+        if (Iter->PathLength != Path.size() || memcmp(m_File.GetData() + Iter->PathOffset, Path.data(), Path.size()) != 0)
+            continue;
+
+        Result.Data = m_File.GetData() + Iter->Offset;
+        Result.StoredSize = Iter->StoredSize;
+        Result.Size = Iter->Size;
+        Result.Flags = Iter->Flags;
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t PackFile::HashPath( const std::string& NormalizedPath )
+{
+    uint64_t Hash = 14695981039346656037ull;
+    for (char c : NormalizedPath)
+        Hash = (Hash ^ (uint8_t)c) * 1099511628211ull;
+    return Hash;
+}
+
+std::string PackFile::NormalizePath( const std::wstring& FileName )
+{
+    size_t Start = 0;
+    while (FileName.compare(Start, 2, L"./") == 0 || FileName.compare(Start, 2, L".\\") == 0)
+        Start += 2;
+
+    std::string Path;
+    Path.reserve(FileName.size() - Start);
+
+    for (size_t i = Start; i < FileName.size(); ++i)
+    {
+        uint32_t c = FileName[i] == L'\\' ? L'/' : (uint32_t)towlower(FileName[i]);
+
+        // Surrogate pairs, where wchar_t is UTF-16
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < FileName.size())
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)FileName[++i] - 0xDC00);
+
+        if (c < 0x80)
+            Path += (char)c;
+        else if (c < 0x800)
+        {
+            Path += (char)(0xC0 | (c >> 6));
+            Path += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            Path += (char)(0xE0 | (c >> 12));
+            Path += (char)(0x80 | ((c >> 6) & 0x3F));
+            Path += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            Path += (char)(0xF0 | (c >> 18));
+            Path += (char)(0x80 | ((c >> 12) & 0x3F));
+            Path += (char)(0x80 | ((c >> 6) & 0x3F));
+            Path += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    return Path;
+}
@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  An archive of many asset files, memory-mapped so that reading one is a table lookup and
+// page faults instead of an open, a stat and reads.  The table of contents is sorted by a hash of each
+// normalized path, and every file starts on a 4 KB boundary.  Files may be stored as gzip, usually in
+// chunks that inflate in parallel.  Tools/Scripts/BuildPackFile.py writes them.
+//
+// Layout, little-endian:
+//     Header
+//     TocEntry[NumEntries], sorted by PathHash then path
+//     Paths, UTF-8 and not terminated
+//     File data, each starting on a 4 KB boundary
+//
+
+#pragma once
+
+#include "MappedFile.h"
+#include <string>
+
+namespace Utility
+{
+    class PackFile
+    {
+    public:
+        static const uint32_t kMagic = 0x4B41504D;    // "MPAK"
+        static const uint32_t kVersion = 1;
+        static const uint32_t kAlignment = 4096;
+
+        enum EntryFlags : uint32_t
+        {
+            kGzip = 1,
+        };
+
+        struct Header
+        {
+            uint32_t Magic;
+            uint32_t Version;
+            uint32_t NumEntries;
+            uint32_t Reserved;
+        };
+
+        struct TocEntry
+        {
+            uint64_t PathHash;
+            uint64_t Offset;
+            uint64_t StoredSize;
+            uint64_t Size;
+            uint32_t PathOffset;
+            uint32_t PathLength;
+            uint32_t Flags;
+            uint32_t Reserved;
+        };
+
+        struct Entry
+        {
+            const uint8_t* Data;
+            uint64_t StoredSize;
+            uint64_t Size;
+            uint32_t Flags;
+        };
+
+        PackFile();
+
+        bool Open( const std::wstring& FileName );
+        void Close( void );
+
+        // Finds a file by its path relative to the directory the pack was built from.  Paths match without
+        // regard to case, slash direction, or a leading "./".
+        bool Find( const std::wstring& FileName, Entry& Result ) const;
+
+        // FNV-1a over the normalized UTF-8 path
+        static uint64_t HashPath( const std::string& NormalizedPath );
+        static std::string NormalizePath( const std::wstring& FileName );
+
+    private:
+        MappedFile m_File;
+        const TocEntry* m_Toc;
+        uint32_t m_NumEntries;
+    };
+}
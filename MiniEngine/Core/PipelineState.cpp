@@ -14,23 +14,30 @@
 #include "GraphicsCore.h"
 #include "PipelineState.h"
 #include "RootSignature.h"
+#include "PipelineStateCache.h"
 #include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static PipelineStateCache s_PSOCache;
+
+void PSO::LoadCache( const std::wstring& FilePath )
+{
+    s_PSOCache.Load(FilePath);
+}
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_PSOCache.Save();
+    s_PSOCache.Destroy();
+}
+
+static Utility::Hash128 HashShader( const D3D12_SHADER_BYTECODE& Shader, const Utility::Hash128& Hash )
+{
+    return Utility::HashBytes128(Shader.pShaderBytecode, Shader.BytecodeLength, Hash);
 }
 
 
@@ -112,39 +119,41 @@ void GraphicsPSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    m_PSODesc.InputLayout.pInputElementDescs = nullptr;
-    size_t HashCode = Utility::HashState(&m_PSODesc);
-    HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    // The key has to mean the same thing in the next run, so hash what the pointers point to instead
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC KeyDesc;
+    memcpy(&KeyDesc, &m_PSODesc, sizeof(KeyDesc));
+    KeyDesc.pRootSignature = nullptr;
+    KeyDesc.VS.pShaderBytecode = nullptr;
+    KeyDesc.PS.pShaderBytecode = nullptr;
+    KeyDesc.DS.pShaderBytecode = nullptr;
+    KeyDesc.HS.pShaderBytecode = nullptr;
+    KeyDesc.GS.pShaderBytecode = nullptr;
+    KeyDesc.InputLayout.pInputElementDescs = nullptr;
+    ZeroMemory(&KeyDesc.StreamOutput, sizeof(KeyDesc.StreamOutput));
+    ZeroMemory(&KeyDesc.CachedPSO, sizeof(KeyDesc.CachedPSO));
+
+    Utility::Hash128 Key = Utility::HashBytes128(&KeyDesc, sizeof(KeyDesc), m_RootSignature->GetContentHash());
+    Key = HashShader(m_PSODesc.VS, Key);
+    Key = HashShader(m_PSODesc.PS, Key);
+    Key = HashShader(m_PSODesc.DS, Key);
+    Key = HashShader(m_PSODesc.HS, Key);
+    Key = HashShader(m_PSODesc.GS, Key);
+
+    for (UINT i = 0; i < m_PSODesc.InputLayout.NumElements; ++i)
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
+        const D3D12_INPUT_ELEMENT_DESC& Element = m_InputLayouts.get()[i];
+        Key = Utility::HashBytes128(Element.SemanticName, strlen(Element.SemanticName) + 1, Key);
+        Key = Utility::HashBytes128(&Element.SemanticIndex, sizeof(Element) - offsetof(D3D12_INPUT_ELEMENT_DESC, SemanticIndex), Key);
     }
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
+    m_PSO = s_PSOCache.FindOrCreate(Key, [this]( const D3D12_CACHED_PIPELINE_STATE& CachedBlob, ID3D12PipelineState** PSO )
     {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+        Desc.CachedPSO = CachedBlob;
+        return g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(PSO));
+    });
 }
 
 void ComputePSO::Finalize()
@@ -153,36 +162,21 @@ void ComputePSO::Finalize()
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
-    size_t HashCode = Utility::HashState(&m_PSODesc);
+    D3D12_COMPUTE_PIPELINE_STATE_DESC KeyDesc;
+    memcpy(&KeyDesc, &m_PSODesc, sizeof(KeyDesc));
+    KeyDesc.pRootSignature = nullptr;
+    KeyDesc.CS.pShaderBytecode = nullptr;
+    ZeroMemory(&KeyDesc.CachedPSO, sizeof(KeyDesc.CachedPSO));
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
-    {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
-
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
-        {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-        }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
+    Utility::Hash128 Key = Utility::HashBytes128(&KeyDesc, sizeof(KeyDesc), m_RootSignature->GetContentHash());
+    Key = HashShader(m_PSODesc.CS, Key);
 
-    if (firstCompile)
+    m_PSO = s_PSOCache.FindOrCreate(Key, [this]( const D3D12_CACHED_PIPELINE_STATE& CachedBlob, ID3D12PipelineState** PSO )
     {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = m_PSODesc;
+        Desc.CachedPSO = CachedBlob;
+        return g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(PSO));
+    });
 }
 
 ComputePSO::ComputePSO()
@@ -30,6 +30,8 @@ public:
 
     PSO() : m_RootSignature(nullptr) {}
 
+    // Pipeline states compiled in an earlier run are read from FilePath, and new ones written back by DestroyAll()
+    static void LoadCache( const std::wstring& FilePath );
     static void DestroyAll( void );
 
     void SetRootSignature( const RootSignature& BindMappings )
@@ -0,0 +1,190 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "PipelineStateCache.h"
+#include <fstream>
+
+using Microsoft::WRL::ComPtr;
+using Utility::Hash128;
+using namespace std;
+
+namespace
+{
+    // File layout:  a header, then for each blob its key, its size, and its bytes
+    const uint32_t kFileMagic = 0x434F5350;	// "PSOC"
+    const uint32_t kFileVersion = 1;
+
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t NumBlobs;
+    };
+
+    struct BlobHeader
+    {
+        Hash128 Key;
+        uint64_t Size;
+    };
+}
+
+PipelineStateCache::PipelineStateCache() : m_BlobsChanged(false), m_NumRequested(0), m_NumCompiled(0), m_NumCreatedFromBlob(0)
+{
+}
+
+void PipelineStateCache::Load( const wstring& FilePath )
+{
+    lock_guard<mutex> LockGuard(m_BlobMutex);
+
+    m_FilePath = FilePath;
+
+    ifstream InFile(FilePath, ios::in | ios::binary);
+    if (!InFile)
+        return;
+
+    FileHeader Header;
+    if (!InFile.read((char*)&Header, sizeof(Header)) || Header.Magic != kFileMagic || Header.Version != kFileVersion)
+    {
+        Utility::Printf(L"Ignoring pipeline state cache %s from another version\n", FilePath.c_str());
+        return;
+    }
+
+    for (uint32_t i = 0; i < Header.NumBlobs; ++i)
+    {
+        BlobHeader Blob;
+        if (!InFile.read((char*)&Blob, sizeof(Blob)) || Blob.Size > (64 << 20))
+            break;
+
+        vector<uint8_t>& Bytes = m_Blobs[Blob.Key];
+        Bytes.resize((size_t)Blob.Size);
+        if (!InFile.read((char*)Bytes.data(), Bytes.size()))
+        {
+            m_Blobs.erase(Blob.Key);
+            break;
+        }
+    }
+
+    Utility::Printf("Loaded %u cached pipeline states\n", (uint32_t)m_Blobs.size());
+}
+
+void PipelineStateCache::Save( void )
+{
+    lock_guard<mutex> LockGuard(m_BlobMutex);
+
+    Utility::Printf("Pipeline states:  %u requested, %u created from cached blobs, %u compiled\n",
+        (uint32_t)m_NumRequested, (uint32_t)m_NumCreatedFromBlob, (uint32_t)m_NumCompiled);
+
+    if (!m_BlobsChanged || m_FilePath.empty())
+        return;
+
+    ofstream OutFile(m_FilePath, ios::out | ios::binary);
+    if (!OutFile)
+    {
+        Utility::Printf(L"Unable to write pipeline state cache %s\n", m_FilePath.c_str());
+        return;
+    }
+
+    FileHeader Header = { kFileMagic, kFileVersion, (uint32_t)m_Blobs.size() };
+    OutFile.write((const char*)&Header, sizeof(Header));
+
+    for (auto& Iter : m_Blobs)
+    {
+        BlobHeader Blob = { Iter.first, Iter.second.size() };
+        OutFile.write((const char*)&Blob, sizeof(Blob));
+        OutFile.write((const char*)Iter.second.data(), Iter.second.size());
+    }
+
+    m_BlobsChanged = false;
+}
+
+void PipelineStateCache::Destroy( void )
+{
+    for (Shard& S : m_Shards)
+    {
+        lock_guard<mutex> LockGuard(S.Mutex);
+        S.PSOs.clear();
+        S.Owned.clear();
+    }
+
+    lock_guard<mutex> LockGuard(m_BlobMutex);
+    m_Blobs.clear();
+    m_BlobsChanged = false;
+}
+
+ComPtr<ID3D12PipelineState> PipelineStateCache::CreatePSO( const Hash128& Key, const CreateFunc& Create )
+{
+    D3D12_CACHED_PIPELINE_STATE CachedBlob = {};
+    {
+        lock_guard<mutex> LockGuard(m_BlobMutex);
+        auto Iter = m_Blobs.find(Key);
+        if (Iter != m_Blobs.end())
+        {
+            CachedBlob.pCachedBlob = Iter->second.data();
+            CachedBlob.CachedBlobSizeInBytes = Iter->second.size();
+        }
+    }
+
+    ComPtr<ID3D12PipelineState> PSO;
+
+    // A blob from another driver or adapter fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH or
+    // D3D12_ERROR_ADAPTER_NOT_FOUND.  Either way, compile from scratch and replace it.
+    if (CachedBlob.CachedBlobSizeInBytes > 0 && SUCCEEDED(Create(CachedBlob, PSO.GetAddressOf())))
+    {
+        ++m_NumCreatedFromBlob;
+        return PSO;
+    }
+
+    ASSERT_SUCCEEDED( Create(D3D12_CACHED_PIPELINE_STATE(), PSO.ReleaseAndGetAddressOf()) );
+    ++m_NumCompiled;
+
+    ComPtr<ID3DBlob> NewBlob;
+    if (SUCCEEDED(PSO->GetCachedBlob(NewBlob.GetAddressOf())))
+    {
+        const uint8_t* Bytes = (const uint8_t*)NewBlob->GetBufferPointer();
+
+        lock_guard<mutex> LockGuard(m_BlobMutex);
+        m_Blobs[Key].assign(Bytes, Bytes + NewBlob->GetBufferSize());
+        m_BlobsChanged = true;
+    }
+
+    return PSO;
+}
+
+ID3D12PipelineState* PipelineStateCache::FindOrCreate( const Hash128& Key, const CreateFunc& Create )
+{
+    ++m_NumRequested;
+
+    Shard& S = m_Shards[Key.Hi % kNumShards];
+    promise<ID3D12PipelineState*> Promise;
+    shared_future<ID3D12PipelineState*> Existing;
+    {
+        lock_guard<mutex> LockGuard(S.Mutex);
+        auto Iter = S.PSOs.find(Key);
+        if (Iter != S.PSOs.end())
+            Existing = Iter->second;
+        else
+            S.PSOs.emplace(Key, Promise.get_future().share());
+    }
+
+    // Someone got here first.  Wait for them to finish compiling.
+    if (Existing.valid())
+        return Existing.get();
+
+    ComPtr<ID3D12PipelineState> PSO = CreatePSO(Key, Create);
+    {
+        lock_guard<mutex> LockGuard(S.Mutex);
+        S.Owned.push_back(PSO);
+    }
+    Promise.set_value(PSO.Get());
+
+    return PSO.Get();
+}
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The pipeline state objects behind GraphicsPSO and ComputePSO, keyed by a 128-bit hash of
+// everything that goes into them.  The map is split into shards with a lock each, and the first thread to
+// ask for a key compiles it while later ones wait on a future.  The driver's cached blob of every compiled
+// PSO is written to disk on shutdown and handed back at creation in the next run, which skips most of the
+// compile.  Blobs that the driver rejects (after a driver update, or on another GPU) are just recompiled.
+//
+
+#pragma once
+
+#include "Hash.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PipelineStateCache
+{
+public:
+    enum { kNumShards = 16 };
+
+    // Creates the PSO, passing CachedBlob on to the device
+    typedef std::function<HRESULT (const D3D12_CACHED_PIPELINE_STATE& CachedBlob, ID3D12PipelineState** PSO)> CreateFunc;
+
+    PipelineStateCache();
+
+    // Reads the blobs saved by an earlier run.  A missing or unreadable file leaves the cache empty.
+    void Load( const std::wstring& FilePath );
+
+    // Writes the blobs back to the file they were loaded from, if any PSO had to be compiled
+    void Save( void );
+
+    // Releases every PSO and blob
+    void Destroy( void );
+
+    // Returns the PSO for Key, creating it on first use
+    ID3D12PipelineState* FindOrCreate( const Utility::Hash128& Key, const CreateFunc& Create );
+
+    uint32_t GetNumRequested( void ) const { return m_NumRequested; }
+    uint32_t GetNumCompiled( void ) const { return m_NumCompiled; }
+    uint32_t GetNumCreatedFromBlob( void ) const { return m_NumCreatedFromBlob; }
+
+private:
+
+    struct KeyHash
+    {
+        size_t operator()( const Utility::Hash128& Key ) const { return (size_t)Key.Lo; }
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex Mutex;
+        std::unordered_map<Utility::Hash128, std::shared_future<ID3D12PipelineState*>, KeyHash> PSOs;
+        std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> Owned;
+    };
+
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePSO( const Utility::Hash128& Key, const CreateFunc& Create );
+
+    Shard m_Shards[kNumShards];
+
+    // Blobs are only added, so a blob's bytes stay put while the map grows
+    std::mutex m_BlobMutex;
+    std::unordered_map<Utility::Hash128, std::vector<uint8_t>, KeyHash> m_Blobs;
+    std::wstring m_FilePath;
+    bool m_BlobsChanged;
+
+    std::atomic<uint32_t> m_NumRequested;
+    std::atomic<uint32_t> m_NumCompiled;
+    std::atomic<uint32_t> m_NumCreatedFromBlob;
+};
@@ -0,0 +1,73 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace Utility
+{
+    // Sorts 64-bit keys in ascending order with a stable LSD radix sort, one byte per pass.
+    // Scratch must hold Count keys.  All eight histograms are built in a single read of the
+    // keys, and passes whose byte is the same for every key are skipped, so keys that only
+    // use a few of their bits (or are nearly sorted in their high bits) cost fewer passes.
+    inline void RadixSort64( uint64_t* Keys, uint64_t* Scratch, size_t Count )
+    {
+        if (Count < 2)
+            return;
+
+        uint32_t Histogram[8][256];
+        memset(Histogram, 0, sizeof(Histogram));
+
+        for (size_t i = 0; i < Count; ++i)
+        {
+            const uint64_t Key = Keys[i];
+            for (int Pass = 0; Pass < 8; ++Pass)
+                ++Histogram[Pass][(Key >> (Pass * 8)) & 0xFF];
+        }
+
+        uint64_t* Src = Keys;
+        uint64_t* Dst = Scratch;
+
+        for (int Pass = 0; Pass < 8; ++Pass)
+        {
+            uint32_t* Offsets = Histogram[Pass];
+
+            // Every key lands in the same bucket, nothing would move
+            if (Offsets[(Src[0] >> (Pass * 8)) & 0xFF] == Count)
+                continue;
+
+            uint32_t Sum = 0;
+            for (int Digit = 0; Digit < 256; ++Digit)
+            {
+                const uint32_t DigitCount = Offsets[Digit];
+                Offsets[Digit] = Sum;
+                Sum += DigitCount;
+            }
+
+            for (size_t i = 0; i < Count; ++i)
+            {
+                const uint64_t Key = Src[i];
+                Dst[Offsets[(Key >> (Pass * 8)) & 0xFF]++] = Key;
+            }
+
+            uint64_t* Temp = Src;
+            Src = Dst;
+            Dst = Temp;
+        }
+
+        if (Src != Keys)
+            memcpy(Keys, Src, Count * sizeof(uint64_t));
+    }
+
+} // namespace Utility
@@ -0,0 +1,82 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Decides which of several readback slots the GPU writes each frame and which one the CPU
+// reads, so that neither waits on the other.  Each slot remembers the fence of the last copy into it.
+// The CPU reads the newest slot whose fence has completed, and the GPU is given the oldest completed slot
+// that isn't being read.  When the GPU has every other slot in flight the frame's copy is skipped.
+// Fences are only compared through the IsComplete predicate, so this can be driven by a simulated fence.
+//
+
+#pragma once
+
+#include <cstdint>
+
+template <uint32_t NumSlots>
+class ReadbackRing
+{
+public:
+    static_assert(NumSlots >= 2, "Reading and writing need a slot each");
+
+    static const uint32_t kNoSlot = ~0u;
+
+    ReadbackRing() { Reset(); }
+
+    // Forgets every slot's contents
+    void Reset( void )
+    {
+        for (uint32_t i = 0; i < NumSlots; ++i)
+            m_Fences[i] = 0;
+        m_ReadSlot = kNoSlot;
+    }
+
+    // Picks the slot with the newest completed copy for the CPU to read, or kNoSlot if none has completed.
+    // Fence values must increase with each Submit().
+    template <typename IsCompleteFunc>
+    uint32_t AcquireRead( IsCompleteFunc IsComplete )
+    {
+        m_ReadSlot = kNoSlot;
+        for (uint32_t i = 0; i < NumSlots; ++i)
+        {
+            if (m_Fences[i] != 0 && IsComplete(m_Fences[i]) &&
+                (m_ReadSlot == kNoSlot || m_Fences[i] > m_Fences[m_ReadSlot]))
+                m_ReadSlot = i;
+        }
+        return m_ReadSlot;
+    }
+
+    // Picks a slot the GPU may copy into, or kNoSlot if all but the one being read are still in flight
+    template <typename IsCompleteFunc>
+    uint32_t AcquireWrite( IsCompleteFunc IsComplete ) const
+    {
+        uint32_t WriteSlot = kNoSlot;
+        for (uint32_t i = 0; i < NumSlots; ++i)
+        {
+            if (i == m_ReadSlot || (m_Fences[i] != 0 && !IsComplete(m_Fences[i])))
+                continue;
+
+            if (WriteSlot == kNoSlot || m_Fences[i] < m_Fences[WriteSlot])
+                WriteSlot = i;
+        }
+        return WriteSlot;
+    }
+
+    // Records the fence that signals the copy into Slot is done
+    void Submit( uint32_t Slot, uint64_t Fence )
+    {
+        m_Fences[Slot] = Fence;
+    }
+
+    uint32_t GetReadSlot( void ) const { return m_ReadSlot; }
+
+private:
+    uint64_t m_Fences[NumSlots];    // zero until the slot is first written
+    uint32_t m_ReadSlot;
+};
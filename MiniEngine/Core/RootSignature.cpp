@@ -106,17 +106,26 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
     size_t HashCode = Utility::HashState(&RootDesc.Flags);
     HashCode = Utility::HashState( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
 
+    // Unlike HashCode, this skips the bytes of a parameter's union that its type leaves unset
+    m_ContentHash = Utility::HashBytes128(&RootDesc.Flags, sizeof(RootDesc.Flags));
+    m_ContentHash = Utility::HashBytes128(RootDesc.pStaticSamplers, m_NumSamplers * sizeof(D3D12_STATIC_SAMPLER_DESC), m_ContentHash);
+
     for (UINT Param = 0; Param < m_NumParameters; ++Param)
     {
         const D3D12_ROOT_PARAMETER& RootParam = RootDesc.pParameters[Param];
         m_DescriptorTableSize[Param] = 0;
 
+        m_ContentHash = Utility::HashBytes128(&RootParam.ParameterType, sizeof(RootParam.ParameterType), m_ContentHash);
+        m_ContentHash = Utility::HashBytes128(&RootParam.ShaderVisibility, sizeof(RootParam.ShaderVisibility), m_ContentHash);
+
         if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
         {
             ASSERT(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
             HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
                 RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
+            m_ContentHash = Utility::HashBytes128( RootParam.DescriptorTable.pDescriptorRanges,
+                RootParam.DescriptorTable.NumDescriptorRanges * sizeof(D3D12_DESCRIPTOR_RANGE), m_ContentHash );
 
             // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
             if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
@@ -128,7 +137,14 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
                 m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
         }
         else
+        {
             HashCode = Utility::HashState( &RootParam, 1, HashCode );
+
+            if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+                m_ContentHash = Utility::HashBytes128(&RootParam.Constants, sizeof(RootParam.Constants), m_ContentHash);
+            else
+                m_ContentHash = Utility::HashBytes128(&RootParam.Descriptor, sizeof(RootParam.Descriptor), m_ContentHash);
+        }
     }
 
     ID3D12RootSignature** RSRef = nullptr;
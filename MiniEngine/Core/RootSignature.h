@@ -14,6 +14,7 @@
 #pragma once
 
 #include "pch.h"
+#include "Hash.h"
 
 class DescriptorCache;
 
@@ -162,6 +163,9 @@ public:
 
     ID3D12RootSignature* GetSignature() const { return m_Signature; }
 
+    // Identifies the layout by its contents, so it is the same in every run
+    const Utility::Hash128& GetContentHash() const { return m_ContentHash; }
+
 protected:
 
     BOOL m_Finalized;
@@ -174,4 +178,5 @@ protected:
     std::unique_ptr<RootParameter[]> m_ParamArray;
     std::unique_ptr<D3D12_STATIC_SAMPLER_DESC[]> m_SamplerArray;
     ID3D12RootSignature* m_Signature;
+    Utility::Hash128 m_ContentHash;
 };
@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+// Builds without pch.h so that it can be tested on its own (see Tests/SIMDMemCopyRowsTest.cpp)
+#include "SIMDMemCopyRows.h"
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+
+#define ASSERT( isTrue, msg ) assert((isTrue) && msg)
+
+namespace
+{
+    bool IsAligned16( size_t Value )
+    {
+        return (Value & 15) == 0;
+    }
+}
+
+void SIMDMemCopyRows( void* __restrict _Dest, size_t DestPitch, const void* __restrict _Source, size_t SourcePitch,
+    size_t RowSize, size_t NumRows )
+{
+    ASSERT(IsAligned16((size_t)_Dest), "Destination rows must be 16-byte aligned");
+    ASSERT(NumRows == 1 || (IsAligned16(DestPitch) && DestPitch >= RowSize), "Invalid destination pitch");
+
+    // Tightly packed rows are one long row
+    if (DestPitch == RowSize && SourcePitch == RowSize)
+    {
+        RowSize *= NumRows;
+        NumRows = 1;
+    }
+
+    const size_t WholeQuadwords = RowSize >> 4;
+    const size_t TrailingBytes = RowSize & 15;
+
+    for (size_t Row = 0; Row < NumRows; ++Row)
+    {
+        __m128i* __restrict Dest = (__m128i* __restrict)((uint8_t*)_Dest + Row * DestPitch);
+        const __m128i* __restrict Source = (const __m128i* __restrict)((const uint8_t*)_Source + Row * SourcePitch);
+
+        size_t i = 0;
+
+        // Do four quadwords per loop to minimize stalls.
+        for (; i + 4 <= WholeQuadwords; i += 4)
+        {
+            _mm_stream_si128(Dest + i + 0, _mm_loadu_si128(Source + i + 0));
+            _mm_stream_si128(Dest + i + 1, _mm_loadu_si128(Source + i + 1));
+            _mm_stream_si128(Dest + i + 2, _mm_loadu_si128(Source + i + 2));
+            _mm_stream_si128(Dest + i + 3, _mm_loadu_si128(Source + i + 3));
+        }
+
+        for (; i < WholeQuadwords; ++i)
+            _mm_stream_si128(Dest + i, _mm_loadu_si128(Source + i));
+
+        // Reading a whole quadword could run past the end of the source
+        if (TrailingBytes > 0)
+        {
+            __m128i Last = _mm_setzero_si128();
+            memcpy(&Last, Source + i, TrailingBytes);
+            _mm_stream_si128(Dest + i, Last);
+        }
+    }
+
+    _mm_sfence();
+}
@@ -0,0 +1,19 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include <cstddef>
+
+// Copies rows from a source of any alignment into 16-byte aligned rows with streaming stores, for filling
+// upload memory.  Each destination row is written up to RowSize rounded up to 16 bytes.
+void SIMDMemCopyRows( void* __restrict Dest, size_t DestPitch, const void* __restrict Source, size_t SourcePitch,
+    size_t RowSize, size_t NumRows );
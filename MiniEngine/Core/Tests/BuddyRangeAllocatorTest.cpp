@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Fuzzes BuddyRangeAllocator against a buddy allocator built on std::set free lists, which must hand
+// out the same blocks, then times both.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. BuddyRangeAllocatorTest.cpp ../BuddyRangeAllocator.cpp -o BuddyRangeAllocatorTest
+//
+
+#include "BuddyRangeAllocator.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // The textbook version, one sorted free list per order, lowest address first
+    class ReferenceBuddy
+    {
+    public:
+        void Create( uint32_t MaxOrder )
+        {
+            m_MaxOrder = MaxOrder;
+            m_Free.assign(MaxOrder + 1, std::set<size_t>());
+            m_Free[MaxOrder].insert(0);
+        }
+
+        size_t Allocate( uint32_t Order )
+        {
+            uint32_t Found = Order;
+            while (Found <= m_MaxOrder && m_Free[Found].empty())
+                ++Found;
+            if (Found > m_MaxOrder)
+                return BuddyRangeAllocator::kInvalidOffset;
+
+            size_t Offset = *m_Free[Found].begin();
+            m_Free[Found].erase(m_Free[Found].begin());
+            while (Found > Order)
+            {
+                --Found;
+                m_Free[Found].insert(Offset + ((size_t)1 << Found));
+            }
+            return Offset;
+        }
+
+        void Free( size_t Offset, uint32_t Order )
+        {
+            while (Order < m_MaxOrder && m_Free[Order].erase(Offset ^ ((size_t)1 << Order)) > 0)
+            {
+                Offset &= ~((size_t)1 << Order);
+                ++Order;
+            }
+            m_Free[Order].insert(Offset);
+        }
+
+        size_t GetFreeUnits( void ) const
+        {
+            size_t Units = 0;
+            for (size_t Order = 0; Order < m_Free.size(); ++Order)
+                Units += m_Free[Order].size() << Order;
+            return Units;
+        }
+
+        size_t GetFreeBlockCount( void ) const
+        {
+            size_t Count = 0;
+            for (const auto& List : m_Free)
+                Count += List.size();
+            return Count;
+        }
+
+        size_t GetLargestFreeBlock( void ) const
+        {
+            for (size_t Order = m_Free.size(); Order-- > 0; )
+            {
+                if (!m_Free[Order].empty())
+                    return (size_t)1 << Order;
+            }
+            return 0;
+        }
+
+    private:
+        uint32_t m_MaxOrder;
+        std::vector<std::set<size_t> > m_Free;
+    };
+
+    typedef std::pair<size_t, uint32_t> Block;
+
+    int Fuzz( uint32_t MaxOrder, uint32_t Steps, uint32_t Seed )
+    {
+        BuddyRangeAllocator Allocator;
+        ReferenceBuddy Reference;
+        Allocator.Create(MaxOrder);
+        Reference.Create(MaxOrder);
+
+        std::mt19937 Random(Seed);
+        std::vector<Block> Live;
+        int Failures = 0;
+
+        for (uint32_t Step = 0; Step < Steps && Failures < 10; ++Step)
+        {
+            // Lean towards allocating early and freeing late, so the range fills and drains
+            const bool Allocate = Live.empty() || Random() % Steps >= Step;
+            if (Allocate)
+            {
+                const uint32_t Order = std::min<uint32_t>(MaxOrder, Random() % 100 < 80 ? Random() % 4 : Random() % (MaxOrder + 2));
+                const size_t Offset = Allocator.Allocate(Order);
+                const size_t Expected = Reference.Allocate(Order);
+                if (Offset != Expected)
+                {
+                    printf("seed %u step %u: allocated order %u at %zu, expected %zu\n", Seed, Step, Order, Offset, Expected);
+                    ++Failures;
+                }
+                if (Expected != BuddyRangeAllocator::kInvalidOffset)
+                    Live.push_back(Block(Expected, Order));
+            }
+            else
+            {
+                const size_t Index = Random() % Live.size();
+                Allocator.Free(Live[Index].first, Live[Index].second);
+                Reference.Free(Live[Index].first, Live[Index].second);
+                Live[Index] = Live.back();
+                Live.pop_back();
+            }
+
+            if (Allocator.GetFreeUnits() != Reference.GetFreeUnits() ||
+                Allocator.GetFreeBlockCount() != Reference.GetFreeBlockCount() ||
+                Allocator.GetLargestFreeBlock() != Reference.GetLargestFreeBlock())
+            {
+                printf("seed %u step %u: free units %zu/%zu, blocks %zu/%zu, largest %zu/%zu\n", Seed, Step,
+                    Allocator.GetFreeUnits(), Reference.GetFreeUnits(), Allocator.GetFreeBlockCount(),
+                    Reference.GetFreeBlockCount(), Allocator.GetLargestFreeBlock(), Reference.GetLargestFreeBlock());
+                ++Failures;
+            }
+        }
+
+        // Everything merges back into one block
+        for (const Block& Live : Live)
+            Allocator.Free(Live.first, Live.second);
+        if (Failures == 0 && Allocator.GetLargestFreeBlock() != (size_t)1 << MaxOrder)
+        {
+            printf("seed %u: blocks did not merge after freeing everything\n", Seed);
+            ++Failures;
+        }
+
+        return Failures;
+    }
+
+    template <typename Allocator>
+    double TimeChurn( uint32_t MaxOrder, uint32_t Operations )
+    {
+        Allocator A;
+        A.Create(MaxOrder);
+
+        std::mt19937 Random(1);
+        std::vector<Block> Live;
+        Live.reserve(Operations);
+
+        const auto Start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < Operations; ++i)
+        {
+            if (Live.size() < 4096 || (Random() & 1))
+            {
+                const uint32_t Order = Random() % 6;
+                const size_t Offset = A.Allocate(Order);
+                if (Offset != BuddyRangeAllocator::kInvalidOffset)
+                    Live.push_back(Block(Offset, Order));
+            }
+            else
+            {
+                const size_t Index = Random() % Live.size();
+                A.Free(Live[Index].first, Live[Index].second);
+                Live[Index] = Live.back();
+                Live.pop_back();
+            }
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / Operations;
+    }
+}
+
+int main( void )
+{
+    int Failures = 0;
+    const uint32_t MaxOrders[] = { 0, 1, 6, 7, 12, 13, 20 };
+    for (uint32_t MaxOrder : MaxOrders)
+    {
+        for (uint32_t Seed = 1; Seed <= 20; ++Seed)
+            Failures += Fuzz(MaxOrder, 20000, Seed);
+    }
+    printf("fuzz: %s\n", Failures == 0 ? "passed" : "FAILED");
+
+    const uint32_t Operations = 2000000;
+    printf("churn, ns per operation:  bitmap %.1f, std::set %.1f\n",
+        TimeChurn<BuddyRangeAllocator>(20, Operations), TimeChurn<ReferenceBuddy>(20, Operations));
+
+    return Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,693 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks CpuProfiler the way EngineProfiling uses it:
+//
+//     nesting:   scopes nested on two threads replay as the same tree, with their user data and times
+//     detached:  a scope opened by a job and closed by its owner on another thread, collected either side
+//                of the close
+//     overflow:  a thread that fills its ring without a collection drops whole scopes, and the scopes
+//                still open when it fills are closed; scopes nested too deep are dropped the same way
+//     wrap:      many frames of events wrap the ring without losing any
+//     trace:     a Chrome trace captured over two frames parses as JSON, every thread's begins and ends
+//                balance in time order, and names with quotes, control characters and non-ASCII
+//                characters come back intact
+//
+// Then prints how long recording a scope takes.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. CpuProfilerTest.cpp ../CpuProfiler.cpp -o CpuProfilerTest -pthread
+//
+
+#include "CpuProfiler.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace CpuProfiler;
+
+namespace
+{
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s\n", What);
+    }
+
+    struct Node
+    {
+        NameId Name;
+        uint32_t UserData;
+        Node* Parent;
+        std::vector<Node*> Children;
+        int64_t Ticks;
+        bool Closed;
+    };
+
+    // Builds the tree of scopes collected, as EngineProfiling does
+    class TreeVisitor : public ScopeVisitor
+    {
+    public:
+        void* OpenScope( void* Parent, NameId Name, uint32_t UserData ) override
+        {
+            Node NewNode = { Name, UserData, (Node*)Parent, {}, 0, false };
+            m_Nodes.push_back(NewNode);
+            Node* Scope = &m_Nodes.back();
+            if (Parent != nullptr)
+                ((Node*)Parent)->Children.push_back(Scope);
+            else
+                m_Roots.push_back(Scope);
+            return Scope;
+        }
+
+        void CloseScope( void* Scope, int64_t Ticks ) override
+        {
+            Node* Closing = (Node*)Scope;
+            Check(!Closing->Closed, "a scope is closed once");
+            Closing->Closed = true;
+            Closing->Ticks = Ticks;
+        }
+
+        size_t GetScopeCount( void ) const { return m_Nodes.size(); }
+        const std::vector<Node*>& GetRoots( void ) const { return m_Roots; }
+
+        bool AllClosed( void ) const
+        {
+            for (const Node& Scope : m_Nodes)
+            {
+                if (!Scope.Closed)
+                    return false;
+            }
+            return true;
+        }
+
+        const Node* FindRoot( NameId Name ) const
+        {
+            for (const Node* Root : m_Roots)
+            {
+                if (Root->Name == Name)
+                    return Root;
+            }
+            return nullptr;
+        }
+
+    private:
+        std::deque<Node> m_Nodes;
+        std::vector<Node*> m_Roots;
+    };
+
+    // Starts each test from empty rings
+    void Drain( void )
+    {
+        TreeVisitor Visitor;
+        CollectEvents(Visitor);
+    }
+
+    // A { B { C } D }, with C holding for a little while so the times are worth comparing
+    void RecordNesting( uint32_t UserDataBase )
+    {
+        BeginScope(FindName(L"A"), UserDataBase);
+        BeginScope(FindName(L"B"), UserDataBase + 1);
+        BeginScope(FindName(L"C"));
+        const auto Start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - Start < std::chrono::microseconds(200))
+            ;
+        Check(GetDepth() == 3, "depth counts open scopes");
+        Check(EndScope() == kNoUserData, "a scope without user data returns none");
+        Check(EndScope() == UserDataBase + 1, "end returns the user data of the scope it closes");
+        BeginScope(FindName(L"D"), UserDataBase + 2);
+        Check(EndScope() == UserDataBase + 2, "end returns the user data of the scope it closes");
+        Check(EndScope() == UserDataBase, "end returns the user data of the scope it closes");
+    }
+
+    void CheckNesting( const Node* A, uint32_t UserDataBase )
+    {
+        Check(A != nullptr && A->UserData == UserDataBase, "outer scope is a root");
+        if (A == nullptr || A->Children.size() != 2)
+        {
+            Check(false, "outer scope has two children");
+            return;
+        }
+
+        const Node* B = A->Children[0];
+        const Node* D = A->Children[1];
+        Check(B->Name == FindName(L"B") && B->UserData == UserDataBase + 1, "first child replayed in order");
+        Check(D->Name == FindName(L"D") && D->UserData == UserDataBase + 2, "second child replayed in order");
+        Check(B->Children.size() == 1 && B->Children[0]->Name == FindName(L"C") && B->Children[0]->Parent == B,
+            "grandchild replayed under its parent");
+        Check(D->Children.empty(), "second child has no children");
+        if (B->Children.size() == 1)
+        {
+            const Node* C = B->Children[0];
+            Check(C->UserData == kNoUserData, "scope without user data replays without it");
+            Check(C->Ticks >= 200000, "scope time covers the work inside it");
+            Check(B->Ticks >= C->Ticks && A->Ticks >= B->Ticks + D->Ticks, "a scope outlasts its children");
+        }
+    }
+
+    void TestNesting( void )
+    {
+        Drain();
+
+        RecordNesting(100);
+        std::thread Worker([]
+        {
+            SetThreadName(L"Nesting Worker");
+            RecordNesting(200);
+        });
+        Worker.join();
+
+        TreeVisitor Visitor;
+        CollectEvents(Visitor);
+        Check(Visitor.GetScopeCount() == 8 && Visitor.GetRoots().size() == 2, "both threads' scopes are collected");
+        Check(Visitor.AllClosed(), "every collected scope is closed");
+
+        for (uint32_t i = 0; i < Visitor.GetRoots().size(); ++i)
+            CheckNesting(Visitor.GetRoots()[i], Visitor.GetRoots()[i]->UserData == 100 ? 100 : 200);
+        Check(Visitor.GetRoots().size() == 2 && Visitor.GetRoots()[0]->UserData != Visitor.GetRoots()[1]->UserData,
+            "each thread's scopes are their own root");
+        Check(GetDepth() == 0, "no scopes left open");
+
+        // Nothing new was recorded
+        TreeVisitor Empty;
+        CollectEvents(Empty);
+        Check(Empty.GetScopeCount() == 0, "events are collected once");
+
+        printf("nesting: %s\n", s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    // A job opens a scope owned by a context, then hands it to the thread that finishes the context
+    void TestDetached( void )
+    {
+        Drain();
+
+        for (int CollectBeforeEnd = 0; CollectBeforeEnd < 2; ++CollectBeforeEnd)
+        {
+            const int Context = 0;
+            BeginScope(FindName(L"Frame"));
+
+            std::thread Job([&Context]
+            {
+                BeginScope(FindName(L"Job"));
+                const uint32_t Depth = GetDepth();
+                BeginScope(FindName(L"Context"), 7, &Context);
+                BeginScope(FindName(L"Left open"));
+                DetachScopes(Depth);
+                Check(GetDepth() == Depth, "detaching leaves the job's depth");
+                EndScope();
+            });
+            Job.join();
+
+            TreeVisitor Visitor;
+            if (CollectBeforeEnd)
+                CollectEvents(Visitor);
+
+            Check(EndScope(&Context) == 7, "the owner closes a detached scope and gets its user data");
+            EndScope();
+            CollectEvents(Visitor);
+
+            const Node* JobRoot = Visitor.FindRoot(FindName(L"Job"));
+            Check(Visitor.AllClosed(), "detached scopes are closed");
+            Check(JobRoot != nullptr && JobRoot->Children.size() == 1 && JobRoot->Children[0]->Name == FindName(L"Context") &&
+                JobRoot->Children[0]->UserData == 7, "a detached scope stays under the job that opened it");
+            if (JobRoot != nullptr && JobRoot->Children.size() == 1)
+            {
+                const Node* Context = JobRoot->Children[0];
+                Check(Context->Children.size() == 1 && Context->Children[0]->Name == FindName(L"Left open"),
+                    "a scope the job left open is closed with it");
+            }
+        }
+
+        printf("detached: %s\n", s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void TestOverflow( void )
+    {
+        Drain();
+
+        // Recorded on a thread of its own so its ring starts empty
+        const uint64_t DroppedBefore = GetDroppedEvents().load();
+        const uint32_t kOuterScopes = 10, kInnerScopes = 20000;
+        std::thread Worker([]
+        {
+            for (uint32_t i = 0; i < kOuterScopes; ++i)
+                BeginScope(FindName(L"Outer"), i);
+            for (uint32_t i = 0; i < kInnerScopes; ++i)
+            {
+                BeginScope(FindName(L"Inner"), i);
+                EndScope();
+            }
+            for (uint32_t i = 0; i < kOuterScopes; ++i)
+                EndScope();
+        });
+        Worker.join();
+
+        TreeVisitor Visitor;
+        CollectEvents(Visitor);
+        const uint64_t Dropped = GetDroppedEvents().load() - DroppedBefore;
+        Check(Dropped > 0, "a full ring drops events");
+        Check(Visitor.GetScopeCount() < kOuterScopes + kInnerScopes, "a full ring holds fewer scopes");
+        Check(Visitor.GetScopeCount() + Dropped == kOuterScopes + kInnerScopes, "each scope is recorded or dropped whole");
+        Check(Visitor.AllClosed(), "scopes open when the ring fills are still closed");
+
+        uint32_t Depth = 0;
+        for (const Node* Scope = Visitor.FindRoot(FindName(L"Outer")); Scope != nullptr;
+            Scope = Scope->Children.empty() || Scope->Children[0]->Name != FindName(L"Outer") ? nullptr : Scope->Children[0])
+        {
+            Check(Scope->UserData == Depth, "outer scopes nest in order");
+            ++Depth;
+        }
+        Check(Depth == kOuterScopes, "every outer scope is recorded");
+
+        // Scopes nested deeper than the profiler tracks are dropped, and the rest still balance
+        const uint32_t kTooDeep = 80;
+        const uint64_t DroppedBeforeDeep = GetDroppedEvents().load();
+        for (uint32_t i = 0; i < kTooDeep; ++i)
+            BeginScope(FindName(L"Deep"), i);
+        for (uint32_t i = kTooDeep; i-- > 0; )
+            Check(EndScope() == (i < 64 ? i : kNoUserData), "deep scopes return their user data while tracked");
+
+        TreeVisitor DeepVisitor;
+        CollectEvents(DeepVisitor);
+        Check(DeepVisitor.GetScopeCount() + (GetDroppedEvents().load() - DroppedBeforeDeep) == kTooDeep,
+            "scopes past the depth limit are dropped");
+        Check(DeepVisitor.AllClosed() && GetDepth() == 0, "deep scopes balance");
+
+        printf("overflow: %u of %u scopes kept, %llu dropped, %s\n", (uint32_t)Visitor.GetScopeCount(),
+            kOuterScopes + kInnerScopes, (unsigned long long)Dropped, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void TestWrap( void )
+    {
+        Drain();
+
+        const uint64_t DroppedBefore = GetDroppedEvents().load();
+        const uint32_t kFrames = 40, kScopesPerFrame = 5000;
+        size_t Collected = 0;
+        bool Ordered = true;
+        for (uint32_t Frame = 0; Frame < kFrames; ++Frame)
+        {
+            BeginScope(FindName(L"Frame"), Frame);
+            for (uint32_t i = 0; i < kScopesPerFrame; ++i)
+            {
+                BeginScope(FindName(L"Work"), i);
+                EndScope();
+            }
+            EndScope();
+
+            TreeVisitor Visitor;
+            CollectEvents(Visitor);
+            Collected += Visitor.GetScopeCount();
+
+            const Node* Root = Visitor.GetRoots().empty() ? nullptr : Visitor.GetRoots()[0];
+            Ordered &= Root != nullptr && Root->UserData == Frame && Root->Children.size() == kScopesPerFrame;
+            for (uint32_t i = 0; Root != nullptr && i < Root->Children.size(); ++i)
+                Ordered &= Root->Children[i]->UserData == i;
+        }
+
+        Check(GetDroppedEvents().load() == DroppedBefore, "collecting every frame drops nothing");
+        Check(Collected == kFrames * (kScopesPerFrame + 1), "every scope survives the ring wrapping");
+        Check(Ordered, "scopes keep their order across the wrap");
+
+        printf("wrap: %u frames of %u scopes, %s\n", kFrames, kScopesPerFrame, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    //
+    // Just enough JSON to check the trace:  the whole grammar is validated, strings are decoded to UTF-8
+    //
+    struct JsonValue
+    {
+        enum Type { kNull, kBool, kNumber, kString, kArray, kObject } ValueType;
+        double Number;
+        std::string String;
+        std::vector<JsonValue> Items;
+        std::vector<std::pair<std::string, JsonValue>> Members;
+
+        const JsonValue* Find( const char* Key ) const
+        {
+            for (const auto& Member : Members)
+            {
+                if (Member.first == Key)
+                    return &Member.second;
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        explicit JsonParser( const std::string& Text ) : m_Next(Text.c_str()), m_End(Text.c_str() + Text.size()) {}
+
+        bool Parse( JsonValue& Value )
+        {
+            if (!ParseValue(Value))
+                return false;
+            SkipSpace();
+            return m_Next == m_End;
+        }
+
+    private:
+        void SkipSpace( void )
+        {
+            while (m_Next < m_End && (*m_Next == ' ' || *m_Next == '\t' || *m_Next == '\n' || *m_Next == '\r'))
+                ++m_Next;
+        }
+
+        bool Expect( char C )
+        {
+            SkipSpace();
+            if (m_Next == m_End || *m_Next != C)
+                return false;
+            ++m_Next;
+            return true;
+        }
+
+        bool Literal( const char* Word )
+        {
+            const size_t Length = strlen(Word);
+            if ((size_t)(m_End - m_Next) < Length || strncmp(m_Next, Word, Length) != 0)
+                return false;
+            m_Next += Length;
+            return true;
+        }
+
+        static void AppendUtf8( std::string& Out, uint32_t C )
+        {
+            if (C < 0x80)
+                Out += (char)C;
+            else if (C < 0x800)
+            {
+                Out += (char)(0xC0 | C >> 6);
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+            else if (C < 0x10000)
+            {
+                Out += (char)(0xE0 | C >> 12);
+                Out += (char)(0x80 | (C >> 6 & 0x3F));
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+            else
+            {
+                Out += (char)(0xF0 | C >> 18);
+                Out += (char)(0x80 | (C >> 12 & 0x3F));
+                Out += (char)(0x80 | (C >> 6 & 0x3F));
+                Out += (char)(0x80 | (C & 0x3F));
+            }
+        }
+
+        bool ParseString( std::string& Out )
+        {
+            if (!Expect('"'))
+                return false;
+            while (m_Next < m_End && *m_Next != '"')
+            {
+                const unsigned char C = (unsigned char)*m_Next++;
+                if (C < 0x20)
+                    return false;
+                if (C != '\\')
+                {
+                    Out += (char)C;
+                    continue;
+                }
+                if (m_Next == m_End)
+                    return false;
+
+                const char Escape = *m_Next++;
+                const char* Simple = strchr("\"\\/bfnrt", Escape);
+                if (Escape != 0 && Simple != nullptr)
+                {
+                    Out += "\"\\/\b\f\n\r\t"[Simple - "\"\\/bfnrt"];
+                }
+                else if (Escape == 'u' && m_End - m_Next >= 4)
+                {
+                    char Hex[5] = { m_Next[0], m_Next[1], m_Next[2], m_Next[3], 0 };
+                    char* HexEnd;
+                    const uint32_t Code = (uint32_t)strtoul(Hex, &HexEnd, 16);
+                    if (HexEnd != Hex + 4)
+                        return false;
+                    m_Next += 4;
+                    AppendUtf8(Out, Code);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            return Expect('"');
+        }
+
+        bool ParseValue( JsonValue& Value )
+        {
+            SkipSpace();
+            if (m_Next == m_End)
+                return false;
+
+            switch (*m_Next)
+            {
+            case '{':
+                Value.ValueType = JsonValue::kObject;
+                ++m_Next;
+                if (Expect('}'))
+                    return true;
+                do
+                {
+                    std::pair<std::string, JsonValue> Member;
+                    if (!ParseString(Member.first) || !Expect(':') || !ParseValue(Member.second))
+                        return false;
+                    Value.Members.push_back(std::move(Member));
+                } while (Expect(','));
+                return Expect('}');
+
+            case '[':
+                Value.ValueType = JsonValue::kArray;
+                ++m_Next;
+                if (Expect(']'))
+                    return true;
+                do
+                {
+                    Value.Items.emplace_back();
+                    if (!ParseValue(Value.Items.back()))
+                        return false;
+                } while (Expect(','));
+                return Expect(']');
+
+            case '"':
+                Value.ValueType = JsonValue::kString;
+                return ParseString(Value.String);
+
+            case 't':
+            case 'f':
+                Value.ValueType = JsonValue::kBool;
+                return Literal("true") || Literal("false");
+
+            case 'n':
+                Value.ValueType = JsonValue::kNull;
+                return Literal("null");
+
+            default:
+            {
+                // JSON numbers are a subset of what strtod reads, so check the characters first
+                const char* Start = m_Next;
+                while (m_Next < m_End && strchr("+-0123456789.eE", *m_Next) != nullptr && *m_Next != 0)
+                    ++m_Next;
+                if (m_Next == Start || (*Start != '-' && (*Start < '0' || *Start > '9')))
+                    return false;
+                const std::string Number(Start, m_Next);
+                char* NumberEnd;
+                Value.ValueType = JsonValue::kNumber;
+                Value.Number = strtod(Number.c_str(), &NumberEnd);
+                return NumberEnd == Number.c_str() + Number.size();
+            }
+            }
+        }
+
+        const char* m_Next;
+        const char* m_End;
+    };
+
+    void TestTrace( void )
+    {
+        Drain();
+
+        const char* const kTracePath = "CpuProfilerTest.json";
+        remove(kTracePath);
+
+        // Names the trace has to escape or encode
+        const wchar_t* const kThreadName = L"Trace \"Worker\" \\ café 中";
+        const char* const kThreadNameUtf8 = "Trace \"Worker\" \\ caf\xC3\xA9 \xE4\xB8\xAD";
+        const wchar_t* const kScopeName = L"Line\nbreak\ttab";
+
+        // Scopes open when the capture starts are left out, and ones open when it ends are closed
+        BeginScope(FindName(L"Before capture"));
+        CaptureTrace(kTracePath, 2);
+        CaptureTrace(kTracePath, 2);
+
+        for (int Frame = 0; Frame < 2; ++Frame)
+        {
+            BeginScope(FindName(L"Frame"));
+            std::thread Worker([Frame, kThreadName, kScopeName]
+            {
+                SetThreadName(kThreadName);
+                BeginScope(FindName(kScopeName));
+                BeginScope(FindName(L"Inner"));
+                EndScope();
+                EndScope();
+                if (Frame == 1)
+                    BeginScope(FindName(L"Still open"));
+            });
+            Worker.join();
+            EndScope();
+            if (Frame == 0)
+                EndScope();
+
+            TreeVisitor Visitor;
+            CollectEvents(Visitor);
+        }
+
+        std::ifstream File(kTracePath);
+        std::stringstream Text;
+        Text << File.rdbuf();
+
+        JsonValue Trace;
+        const bool Parsed = JsonParser(Text.str()).Parse(Trace);
+        Check(Parsed, "the trace parses as JSON");
+        const JsonValue* Events = Parsed ? Trace.Find("traceEvents") : nullptr;
+        Check(Events != nullptr && Events->ValueType == JsonValue::kArray, "the trace has an event array");
+        if (Events == nullptr)
+            return;
+
+        std::map<double, std::vector<std::string>> Stacks;
+        std::map<double, double> LastTimes;
+        std::map<std::string, int> Begins;
+        bool Balanced = true, InOrder = true, FoundThreadName = false;
+        for (const JsonValue& Event : Events->Items)
+        {
+            const JsonValue* Name = Event.Find("name");
+            const JsonValue* Phase = Event.Find("ph");
+            const JsonValue* Thread = Event.Find("tid");
+            if (Name == nullptr || Phase == nullptr || Thread == nullptr || Event.Find("pid") == nullptr)
+            {
+                Check(false, "every event has a name, phase, process and thread");
+                continue;
+            }
+
+            if (Phase->String == "M")
+            {
+                const JsonValue* Args = Event.Find("args");
+                const JsonValue* ThreadName = Args != nullptr ? Args->Find("name") : nullptr;
+                FoundThreadName |= ThreadName != nullptr && ThreadName->String == kThreadNameUtf8;
+                continue;
+            }
+
+            const JsonValue* Time = Event.Find("ts");
+            if (Time == nullptr || Time->ValueType != JsonValue::kNumber)
+            {
+                Check(false, "begins and ends have a time");
+                continue;
+            }
+            InOrder &= Time->Number >= 0.0 && (LastTimes.count(Thread->Number) == 0 || Time->Number >= LastTimes[Thread->Number]);
+            LastTimes[Thread->Number] = Time->Number;
+
+            std::vector<std::string>& Stack = Stacks[Thread->Number];
+            if (Phase->String == "B")
+            {
+                Stack.push_back(Name->String);
+                ++Begins[Name->String];
+            }
+            else if (Phase->String == "E")
+            {
+                Balanced &= !Stack.empty();
+                if (!Stack.empty())
+                    Stack.pop_back();
+            }
+            else
+            {
+                Check(false, "events are begins, ends or thread names");
+            }
+        }
+        for (const auto& Stack : Stacks)
+            Balanced &= Stack.second.empty();
+
+        Check(Balanced, "every thread's begins and ends balance");
+        Check(InOrder, "every thread's events are in time order");
+        Check(FoundThreadName, "the thread name comes back intact");
+        Check(Begins["Line\nbreak\ttab"] == 2 && Begins["Inner"] == 2 && Begins["Frame"] == 2,
+            "every scope in the captured frames is written");
+        Check(Begins["Before capture"] == 0, "scopes from before the capture are left out");
+        Check(Begins["Still open"] == 1, "scopes open at the end of the capture are written and closed");
+
+        // The capture is over, so later frames add nothing
+        BeginScope(FindName(L"After capture"));
+        EndScope();
+        Drain();
+        std::ifstream After(kTracePath);
+        std::stringstream AfterText;
+        AfterText << After.rdbuf();
+        Check(AfterText.str() == Text.str(), "the capture stops after its frames");
+
+        remove(kTracePath);
+        printf("trace: %u events, %s\n", (uint32_t)Events->Items.size(), s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void Benchmark( void )
+    {
+        Drain();
+
+        const NameId Name = FindName(L"Benchmark");
+        const uint32_t kScopes = 4000;
+        double Best = 1e30;
+        for (int Run = 0; Run < 50; ++Run)
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < kScopes; ++i)
+            {
+                BeginScope(Name, i);
+                EndScope();
+            }
+            Best = std::min(Best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count());
+            Drain();
+        }
+
+        double FindBest = 1e30;
+        for (int Run = 0; Run < 50; ++Run)
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < kScopes; ++i)
+                FindName(L"Benchmark");
+            FindBest = std::min(FindBest, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count());
+        }
+
+        printf("a scope takes %.1f ns to record, a cached name %.1f ns to find\n", Best / kScopes, FindBest / kScopes);
+    }
+}
+
+int main( void )
+{
+    TestNesting();
+    TestDetached();
+    TestOverflow();
+    TestWrap();
+    TestTrace();
+    Benchmark();
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
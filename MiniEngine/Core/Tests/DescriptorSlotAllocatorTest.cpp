@@ -0,0 +1,260 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Runs DescriptorSlotAllocator against a mock heap source whose fence the test advances by hand.  A long
+// churn checks that no slot is handed out twice, that runs stay inside one heap, that nothing is reused
+// before its fence, and that freed runs merge back; short-lived threads check that thread caches are
+// passed on rather than stranded.  Then it times allocate/free.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -pthread -I.. DescriptorSlotAllocatorTest.cpp ../DescriptorSlotAllocator.cpp -o DescriptorSlotAllocatorTest
+//
+
+#include "DescriptorSlotAllocator.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint32_t kDescriptorsPerHeap = 1024;
+    const uint32_t kMaxHeaps = 1024;
+
+    class MockHeapSource : public DescriptorHeapSource
+    {
+    public:
+        MockHeapSource() : m_HeapCount(0), m_CompletedFence(0), m_Slots(kMaxHeaps * kDescriptorsPerHeap)
+        {
+            for (std::atomic<uint64_t>& State : m_Slots)
+                State = kFree;
+        }
+
+        virtual void CreateHeap( uint32_t HeapIndex ) override
+        {
+            if (HeapIndex != m_HeapCount || HeapIndex >= kMaxHeaps)
+                Fail("heap %u created out of order\n", HeapIndex);
+            ++m_HeapCount;
+        }
+
+        virtual bool IsFenceComplete( uint64_t FenceValue ) override
+        {
+            return FenceValue <= m_CompletedFence;
+        }
+
+        uint64_t GetNextFence( void ) const { return m_CompletedFence + 1; }
+        void CompleteFence( void ) { ++m_CompletedFence; }
+
+        // Marks a run as held by Owner, failing if any slot of it is held by anyone else or was freed
+        // with a fence that hasn't completed
+        void Claim( uint32_t Slot, uint32_t Count, uint32_t Owner )
+        {
+            if (Slot / kDescriptorsPerHeap != (Slot + Count - 1) / kDescriptorsPerHeap)
+                return Fail("run %u+%u crosses a heap\n", Slot, Count);
+            if ((Slot + Count - 1) / kDescriptorsPerHeap >= m_HeapCount)
+                return Fail("run %u+%u is past the last heap\n", Slot, Count);
+
+            for (uint32_t i = Slot; i < Slot + Count; ++i)
+            {
+                const uint64_t Previous = m_Slots[i].exchange(Owner);
+                if (Previous & kFreedAtFence)
+                {
+                    if ((Previous & ~kFreedAtFence) > m_CompletedFence)
+                        Fail("slot %u reused before its fence\n", i);
+                }
+                else if (Previous != kFree)
+                    Fail("slot %u handed to %u while %u holds it\n", i, Owner, (uint32_t)Previous);
+            }
+        }
+
+        void Release( uint32_t Slot, uint32_t Count, uint64_t FenceValue )
+        {
+            for (uint32_t i = Slot; i < Slot + Count; ++i)
+                m_Slots[i] = kFreedAtFence | FenceValue;
+        }
+
+        static std::atomic<int> sm_Failures;
+
+        template <typename... Args>
+        static void Fail( const char* Format, Args... Arguments )
+        {
+            if (sm_Failures++ < 10)
+                printf(Format, Arguments...);
+        }
+
+    private:
+        static const uint64_t kFree = 0;
+        static const uint64_t kFreedAtFence = 1ull << 63;
+
+        std::atomic<uint32_t> m_HeapCount;
+        std::atomic<uint64_t> m_CompletedFence;
+        std::vector<std::atomic<uint64_t>> m_Slots;     // kFree, an owner, or kFreedAtFence | fence
+    };
+
+    std::atomic<int> MockHeapSource::sm_Failures(0);
+
+    struct Run
+    {
+        uint32_t Slot;
+        uint32_t Count;
+    };
+
+    // Mostly single slots, some small tables, the odd large one, with the number held drifting up and
+    // down.  Runs are freed with the next fence, which completes every few steps.
+    void Churn( DescriptorSlotAllocator& Slots, MockHeapSource& Source, uint32_t Steps, uint32_t Seed, uint32_t Owner )
+    {
+        std::mt19937 Random(Seed);
+        std::vector<Run> Live;
+
+        auto Free = [&]( const Run& Held )
+        {
+            const uint64_t Fence = Source.GetNextFence();
+            Source.Release(Held.Slot, Held.Count, Fence);
+            Slots.Free(Held.Slot, Held.Count, Fence);
+        };
+
+        for (uint32_t Step = 0; Step < Steps; ++Step)
+        {
+            const uint32_t Target = 1000 + (Step / 50000 % 4) * 2000;
+
+            if (Live.empty() || (Random() % 100 < 55 && Live.size() < Target))
+            {
+                const uint32_t Kind = Random() % 1000;
+                Run New;
+                New.Count = Kind < 700 ? 1 : Kind < 990 ? 2 + Random() % 30 : 32 + Random() % (kDescriptorsPerHeap - 31);
+                New.Slot = Slots.Allocate(New.Count);
+                Source.Claim(New.Slot, New.Count, Owner);
+                Live.push_back(New);
+            }
+            else
+            {
+                const size_t Index = Random() % Live.size();
+                Free(Live[Index]);
+                Live[Index] = Live.back();
+                Live.pop_back();
+            }
+
+            if (Random() % 8 == 0)
+                Source.CompleteFence();
+        }
+
+        for (const Run& Held : Live)
+            Free(Held);
+        Source.CompleteFence();
+    }
+
+    int TestChurn( uint32_t Steps, uint32_t Seed )
+    {
+        const int FailuresBefore = MockHeapSource::sm_Failures;
+
+        MockHeapSource Source;
+        DescriptorSlotAllocator Slots(Source, kDescriptorsPerHeap);
+        Churn(Slots, Source, Steps, Seed, 1);
+
+        // Everything is free apart from this thread's cache, and once the last fence retires, every
+        // heap without a cached slot must merge back into one run.  Take whole heaps until a new one is
+        // needed to prove it.
+        const uint32_t Cached = Slots.GetAllocatedCount();
+        if (Cached > DescriptorSlotAllocator::kThreadCacheRefill)
+            MockHeapSource::Fail("%u slots still allocated\n", Cached);
+
+        const uint32_t HeapCount = Slots.GetHeapCount();
+        uint32_t WholeHeaps = 0;
+        while (Slots.Allocate(kDescriptorsPerHeap) < HeapCount * kDescriptorsPerHeap)
+            ++WholeHeaps;
+        if (Slots.GetPendingCount() != 0 || WholeHeaps + Cached < HeapCount)
+            MockHeapSource::Fail("only %u of %u heaps merged back\n", WholeHeaps, HeapCount);
+
+        printf("churn seed %u: %u heaps, %s\n", Seed, HeapCount, MockHeapSource::sm_Failures == FailuresBefore ? "passed" : "FAILED");
+        return MockHeapSource::sm_Failures - FailuresBefore;
+    }
+
+    int TestThreads( void )
+    {
+        const int FailuresBefore = MockHeapSource::sm_Failures;
+
+        MockHeapSource Source;
+        DescriptorSlotAllocator Slots(Source, kDescriptorsPerHeap);
+
+        // Several threads churning at once against shared fences
+        std::vector<std::thread> Threads;
+        for (uint32_t i = 0; i < 4; ++i)
+            Threads.emplace_back([&, i]() { Churn(Slots, Source, 200000, 100 + i, 2 + i); });
+        for (std::thread& Thread : Threads)
+            Thread.join();
+
+        // A thousand threads that each take one slot and exit.  Each fills a cache, so unless exiting
+        // threads pass theirs on, the allocated count grows by a refill per thread.
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            std::thread([&]()
+            {
+                const uint32_t Slot = Slots.Allocate(1);
+                Source.Claim(Slot, 1, 10);
+                Source.Release(Slot, 1, Source.GetNextFence());
+                Slots.Free(Slot, 1, Source.GetNextFence());
+                Source.CompleteFence();
+            }).join();
+        }
+
+        const uint32_t MaxCached = DescriptorSlotAllocator::kThreadCacheRefill * 6;
+        if (Slots.GetAllocatedCount() > MaxCached)
+            MockHeapSource::Fail("%u slots stranded in thread caches\n", Slots.GetAllocatedCount());
+
+        printf("threads: %u heaps, %u slots cached, %s\n", Slots.GetHeapCount(), Slots.GetAllocatedCount(),
+            MockHeapSource::sm_Failures == FailuresBefore ? "passed" : "FAILED");
+        return MockHeapSource::sm_Failures - FailuresBefore;
+    }
+
+    // Allocates Batch runs of Count slots, frees them, and retires their fence, over and over
+    double TimeAllocateFree( uint32_t ThreadCount, uint32_t Count, uint32_t Operations )
+    {
+        MockHeapSource Source;
+        DescriptorSlotAllocator Slots(Source, kDescriptorsPerHeap);
+        const uint32_t Batch = 256;
+
+        auto Work = [&]()
+        {
+            uint32_t Held[Batch];
+            for (uint32_t Done = 0; Done < Operations; Done += Batch)
+            {
+                for (uint32_t i = 0; i < Batch; ++i)
+                    Held[i] = Slots.Allocate(Count);
+                const uint64_t Fence = Source.GetNextFence();
+                for (uint32_t i = 0; i < Batch; ++i)
+                    Slots.Free(Held[i], Count, Fence);
+                Source.CompleteFence();
+            }
+        };
+
+        const auto Start = std::chrono::steady_clock::now();
+        std::vector<std::thread> Threads;
+        for (uint32_t i = 0; i < ThreadCount; ++i)
+            Threads.emplace_back(Work);
+        for (std::thread& Thread : Threads)
+            Thread.join();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / ((double)Operations * ThreadCount);
+    }
+}
+
+int main( void )
+{
+    int Failures = 0;
+    for (uint32_t Seed = 1; Seed <= 5; ++Seed)
+        Failures += TestChurn(1000000, Seed);
+    Failures += TestThreads();
+
+    const uint32_t Operations = 2000000;
+    printf("allocate + free, ns per pair:  1 slot %.1f, 8 slots %.1f, 1 slot on 4 threads %.1f\n",
+        TimeAllocateFree(1, 1, Operations), TimeAllocateFree(1, 8, Operations), TimeAllocateFree(4, 1, Operations / 4));
+
+    return Failures == 0 ? 0 : 1;
+}
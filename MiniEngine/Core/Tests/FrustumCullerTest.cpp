@@ -0,0 +1,324 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks FrustumCuller against a reference culler that transforms all eight corners of each box, on random
+// boxes seen from perspective and orthographic cameras at once.  A box is culled by the reference when every
+// corner is behind the same plane.  Boxes that touch a plane to within rounding are not compared, since the
+// two tests may round differently there.  Box counts that are not a multiple of the SIMD width check that the
+// padding lanes are never reported.
+//
+// Then times culling the number of boxes a large scene has against the three views ModelViewer uses, and
+// prints boxes/sec for both culler and reference.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. FrustumCullerTest.cpp ../Math/FrustumCuller.cpp -o FrustumCullerTest
+//
+
+#include "Math/FrustumCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Math::FrustumCuller;
+
+namespace
+{
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s\n", What);
+    }
+
+    struct Box
+    {
+        float Min[3];
+        float Max[3];
+    };
+
+    struct Matrix
+    {
+        float m[4][4];
+    };
+
+    // Row vectors, as XMFLOAT4X4 and the culler expect
+    Matrix Multiply( const Matrix& A, const Matrix& B )
+    {
+        Matrix R;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                R.m[i][j] = 0.0f;
+                for (int k = 0; k < 4; ++k)
+                    R.m[i][j] += A.m[i][k] * B.m[k][j];
+            }
+        }
+        return R;
+    }
+
+    // Looks from Eye with the given yaw and pitch, left-handed like XMMatrixLookToLH
+    Matrix View( float EyeX, float EyeY, float EyeZ, float Yaw, float Pitch )
+    {
+        const float Forward[3] = { sinf(Yaw) * cosf(Pitch), sinf(Pitch), cosf(Yaw) * cosf(Pitch) };
+        const float Right[3] = { cosf(Yaw), 0.0f, -sinf(Yaw) };
+        const float Up[3] =
+        {
+            Forward[1] * Right[2] - Forward[2] * Right[1],
+            Forward[2] * Right[0] - Forward[0] * Right[2],
+            Forward[0] * Right[1] - Forward[1] * Right[0]
+        };
+        const float Eye[3] = { EyeX, EyeY, EyeZ };
+
+        Matrix R = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            R.m[i][0] = Right[i];
+            R.m[i][1] = Up[i];
+            R.m[i][2] = Forward[i];
+            R.m[3][0] -= Eye[i] * Right[i];
+            R.m[3][1] -= Eye[i] * Up[i];
+            R.m[3][2] -= Eye[i] * Forward[i];
+        }
+        R.m[3][3] = 1.0f;
+        return R;
+    }
+
+    // As XMMatrixPerspectiveFovLH, 0 <= z <= w
+    Matrix Perspective( float FovY, float Aspect, float NearZ, float FarZ )
+    {
+        const float Height = 1.0f / tanf(FovY * 0.5f);
+        Matrix R = {};
+        R.m[0][0] = Height / Aspect;
+        R.m[1][1] = Height;
+        R.m[2][2] = FarZ / (FarZ - NearZ);
+        R.m[2][3] = 1.0f;
+        R.m[3][2] = -NearZ * FarZ / (FarZ - NearZ);
+        return R;
+    }
+
+    // As XMMatrixOrthographicLH
+    Matrix Orthographic( float Width, float Height, float NearZ, float FarZ )
+    {
+        Matrix R = {};
+        R.m[0][0] = 2.0f / Width;
+        R.m[1][1] = 2.0f / Height;
+        R.m[2][2] = 1.0f / (FarZ - NearZ);
+        R.m[3][2] = -NearZ / (FarZ - NearZ);
+        R.m[3][3] = 1.0f;
+        return R;
+    }
+
+    // The smallest, over the six clip planes, of the largest distance of any corner in front of the plane.
+    // Negative means every corner is behind one plane.  Scale is what rounding is relative to.
+    double ReferenceDistance( const Box& B, const Matrix& M, double& Scale )
+    {
+        double Furthest[6] = { -1e300, -1e300, -1e300, -1e300, -1e300, -1e300 };
+        Scale = 0.0;
+        for (int Corner = 0; Corner < 8; ++Corner)
+        {
+            const double P[4] =
+            {
+                (Corner & 1) ? B.Max[0] : B.Min[0],
+                (Corner & 2) ? B.Max[1] : B.Min[1],
+                (Corner & 4) ? B.Max[2] : B.Min[2],
+                1.0
+            };
+
+            double Clip[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                Clip[j] = 0.0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    Clip[j] += P[i] * M.m[i][j];
+                    Scale = std::max(Scale, fabs(P[i] * M.m[i][j]));
+                }
+            }
+
+            // W+X, W-X, W+Y, W-Y, Z, W-Z
+            const double Distance[6] =
+            {
+                Clip[3] + Clip[0], Clip[3] - Clip[0], Clip[3] + Clip[1], Clip[3] - Clip[1], Clip[2], Clip[3] - Clip[2]
+            };
+            for (int Plane = 0; Plane < 6; ++Plane)
+                Furthest[Plane] = std::max(Furthest[Plane], Distance[Plane]);
+        }
+        return *std::min_element(Furthest, Furthest + 6);
+    }
+
+    std::vector<Box> RandomBoxes( std::mt19937& Random, uint32_t Count )
+    {
+        std::uniform_real_distribution<float> Position(-300.0f, 300.0f);
+        std::uniform_real_distribution<float> Size(0.0f, 40.0f);
+
+        std::vector<Box> Boxes(Count);
+        for (Box& B : Boxes)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                B.Min[i] = Position(Random);
+                // Some boxes are flat, as a mesh of a single quad is
+                B.Max[i] = B.Min[i] + (Random() % 8 == 0 ? 0.0f : Size(Random));
+            }
+        }
+        return Boxes;
+    }
+
+    std::vector<Matrix> Views( std::mt19937& Random )
+    {
+        std::uniform_real_distribution<float> Position(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> Angle(-3.14159f, 3.14159f);
+
+        std::vector<Matrix> Result;
+        Result.push_back(Multiply(View(Position(Random), Position(Random), Position(Random), Angle(Random), Angle(Random) * 0.5f),
+            Perspective(1.0f, 16.0f / 9.0f, 1.0f, 1000.0f)));
+        Result.push_back(Multiply(View(Position(Random), 400.0f, Position(Random), Angle(Random), -1.2f),
+            Orthographic(500.0f, 500.0f, 0.0f, 1000.0f)));
+        Result.push_back(Multiply(View(Position(Random), Position(Random), Position(Random), Angle(Random), Angle(Random) * 0.5f),
+            Perspective(1.5f, 1.0f, 0.5f, 250.0f)));
+        return Result;
+    }
+
+    void TestCull( std::mt19937& Random, uint32_t BoxCount, uint32_t& Compared, uint32_t& Skipped )
+    {
+        const std::vector<Box> Boxes = RandomBoxes(Random, BoxCount);
+        const std::vector<Matrix> Matrices = Views(Random);
+
+        FrustumCuller Culler;
+        for (const Box& B : Boxes)
+            Culler.AddBox(B.Min, B.Max);
+        for (const Matrix& M : Matrices)
+            Culler.AddView(M.m);
+        Culler.Cull();
+
+        Check(Culler.GetBoxCount() == BoxCount, "box count");
+        Check(Culler.GetViewCount() == Matrices.size(), "view count");
+
+        for (uint32_t v = 0; v < Matrices.size(); ++v)
+        {
+            std::vector<int> Visible(BoxCount, 0);
+            const uint32_t* VisibleBoxes = Culler.GetVisibleBoxes(v);
+            bool InRange = true, Ascending = true;
+            for (uint32_t i = 0; i < Culler.GetVisibleCount(v); ++i)
+            {
+                InRange &= VisibleBoxes[i] < BoxCount;
+                Ascending &= i == 0 || VisibleBoxes[i] > VisibleBoxes[i - 1];
+                if (VisibleBoxes[i] < BoxCount)
+                    Visible[VisibleBoxes[i]] = 1;
+            }
+            Check(InRange, "visible boxes are real boxes, not padding");
+            Check(Ascending, "visible boxes are listed once, in order");
+
+            for (uint32_t b = 0; b < BoxCount; ++b)
+            {
+                double Scale;
+                const double Distance = ReferenceDistance(Boxes[b], Matrices[v], Scale);
+                if (fabs(Distance) <= Scale * 1e-5)
+                {
+                    ++Skipped;
+                    continue;
+                }
+                Check(Visible[b] == (Distance >= 0.0 ? 1 : 0), "visibility matches the per-corner reference");
+                ++Compared;
+            }
+        }
+
+        // Culling again with fewer boxes must not report stale ones
+        Culler.ClearBoxes();
+        Culler.AddBox(Boxes.empty() ? Box().Min : Boxes[0].Min, Boxes.empty() ? Box().Max : Boxes[0].Max);
+        Culler.Cull();
+        for (uint32_t v = 0; v < Matrices.size(); ++v)
+            Check(Culler.GetVisibleCount(v) <= 1, "reused culler only reports current boxes");
+    }
+
+    void TestCulling( void )
+    {
+        std::mt19937 Random(12345);
+        uint32_t Compared = 0, Skipped = 0, Visible = 0;
+
+        const uint32_t BoxCounts[] = { 0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 100, 1000, 5003 };
+        for (int Round = 0; Round < 20; ++Round)
+        {
+            for (uint32_t BoxCount : BoxCounts)
+                TestCull(Random, BoxCount, Compared, Skipped);
+        }
+
+        // A box around the camera is always visible, one behind it never is
+        FrustumCuller Culler;
+        const float AroundMin[3] = { -1.0f, -1.0f, -1.0f }, AroundMax[3] = { 1.0f, 1.0f, 1.0f };
+        const float BehindMin[3] = { -1.0f, -1.0f, -20.0f }, BehindMax[3] = { 1.0f, 1.0f, -10.0f };
+        Culler.AddBox(AroundMin, AroundMax);
+        Culler.AddBox(BehindMin, BehindMax);
+        Culler.AddView(Multiply(View(0.0f, 0.0f, 0.0f, 0.0f, 0.0f), Perspective(1.0f, 1.0f, 0.1f, 100.0f)).m);
+        Culler.Cull();
+        Visible = Culler.GetVisibleCount(0);
+        Check(Visible == 1 && Culler.GetVisibleBoxes(0)[0] == 0, "box around the camera is the only one visible");
+
+        printf("culling: %u box-views compared, %u on a plane skipped, %s\n", Compared, Skipped,
+            s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void Benchmark( uint32_t BoxCount )
+    {
+        std::mt19937 Random(678);
+        const std::vector<Box> Boxes = RandomBoxes(Random, BoxCount);
+        const std::vector<Matrix> Matrices = Views(Random);
+
+        FrustumCuller Culler;
+        for (const Box& B : Boxes)
+            Culler.AddBox(B.Min, B.Max);
+        for (const Matrix& M : Matrices)
+            Culler.AddView(M.m);
+
+        const int kRuns = 200;
+        double Best = 1e30;
+        for (int Run = 0; Run < kRuns; ++Run)
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            Culler.Cull();
+            Best = std::min(Best, std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+        }
+
+        uint32_t ReferenceVisible = 0;
+        double Scale;
+        const auto Start = std::chrono::steady_clock::now();
+        for (const Matrix& M : Matrices)
+        {
+            for (const Box& B : Boxes)
+                ReferenceVisible += ReferenceDistance(B, M, Scale) >= 0.0 ? 1 : 0;
+        }
+        const double ReferenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+        uint32_t Visible = 0;
+        for (uint32_t v = 0; v < Culler.GetViewCount(); ++v)
+            Visible += Culler.GetVisibleCount(v);
+
+        printf("%u boxes x %u views, %u visible: culler %.3f ms, %.1f M boxes/sec; per-corner reference %.1f M boxes/sec\n",
+            BoxCount, (uint32_t)Matrices.size(), Visible, Best * 1000.0, BoxCount / Best / 1e6,
+            BoxCount / ReferenceSeconds / 1e6);
+        Check(Visible > 0 && ReferenceVisible > 0, "benchmark views see some boxes");
+    }
+}
+
+int main( void )
+{
+    TestCulling();
+
+    Benchmark(1000);
+    Benchmark(100000);
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks the job system with three worker threads besides the main one:
+//
+//     nested:       a tree of jobs where every job queues and waits on its children runs each job once
+//     contention:   small batches queued by the main thread, so the owner's pop and the thieves' steals
+//                   race for the last job over and over; every job must run exactly once
+//     overflow:     more jobs than a deque holds are queued at once, and the ones that don't fit run inline
+//     ParallelFor:  empty, reversed, single-chunk and uneven ranges, a grain of 0, and a range ending at
+//                   UINT32_MAX are each covered exactly once, in chunks no larger than the grain
+//
+// Then prints how many empty jobs per second the main thread can queue and wait on, and how fast
+// ParallelFor gets through fine-grained work.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. JobSystemTest.cpp ../JobSystem.cpp ../CpuProfiler.cpp -o JobSystemTest -pthread
+//
+
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<int> s_Failures(0);
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s\n", What);
+    }
+
+    const uint32_t kWorkerCount = 3;
+
+    // Each job queues FanOut children and waits on them before it finishes
+    void NestedJob( uint32_t Depth, uint32_t FanOut, std::atomic<uint32_t>& Executed )
+    {
+        Executed.fetch_add(1, std::memory_order_relaxed);
+        if (Depth == 0)
+            return;
+
+        JobSystem::JobCounter Children;
+        for (uint32_t i = 0; i < FanOut; ++i)
+            JobSystem::Run([Depth, FanOut, &Executed]{ NestedJob(Depth - 1, FanOut, Executed); }, Children);
+        JobSystem::Wait(Children);
+        Check(Children.IsDone(), "a job's wait returns after its children are done");
+    }
+
+    void TestNested( void )
+    {
+        const uint32_t kDepth = 4, kFanOut = 8;
+        uint32_t Expected = 0;
+        for (uint32_t Level = 0, Jobs = 1; Level <= kDepth; ++Level, Jobs *= kFanOut)
+            Expected += Jobs;
+
+        for (int Round = 0; Round < 5; ++Round)
+        {
+            std::atomic<uint32_t> Executed(0);
+            JobSystem::JobCounter Root;
+            JobSystem::Run([&Executed]{ NestedJob(kDepth, kFanOut, Executed); }, Root);
+            JobSystem::Wait(Root);
+            Check(Executed.load() == Expected, "every nested job runs once");
+        }
+
+        printf("nested: 5 trees of %u jobs, %s\n", Expected, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void TestContention( void )
+    {
+        const uint32_t kRounds = 20000;
+        std::unique_ptr<std::atomic<uint32_t>[]> RunCounts(new std::atomic<uint32_t>[4]);
+        std::mutex ThreadsMutex;
+        std::set<std::thread::id> Threads;
+        uint32_t Jobs = 0, Stolen = 0;
+        bool RanOnce = true;
+
+        const std::thread::id MainThread = std::this_thread::get_id();
+        for (uint32_t Round = 0; Round < kRounds; ++Round)
+        {
+            // One to four jobs, so the deque is often down to its last job while thieves are at it
+            const uint32_t BatchSize = 1 + Round % 4;
+            std::atomic<uint32_t> RanElsewhere(0);
+            for (uint32_t i = 0; i < BatchSize; ++i)
+                RunCounts[i] = 0;
+
+            JobSystem::JobCounter Counter;
+            for (uint32_t i = 0; i < BatchSize; ++i)
+            {
+                JobSystem::Run([&, i]
+                {
+                    RunCounts[i].fetch_add(1, std::memory_order_relaxed);
+                    if (std::this_thread::get_id() != MainThread)
+                    {
+                        RanElsewhere.fetch_add(1, std::memory_order_relaxed);
+                        std::lock_guard<std::mutex> Lock(ThreadsMutex);
+                        Threads.insert(std::this_thread::get_id());
+                    }
+                }, Counter);
+            }
+            JobSystem::Wait(Counter);
+
+            for (uint32_t i = 0; i < BatchSize; ++i)
+                RanOnce &= RunCounts[i].load() == 1;
+            Jobs += BatchSize;
+            Stolen += RanElsewhere.load();
+        }
+
+        Check(RanOnce, "a contended job runs exactly once");
+        printf("contention: %u jobs in batches of 1-4, %u stolen by %u workers, %s\n", Jobs, Stolen,
+            (uint32_t)Threads.size(), s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void TestOverflow( void )
+    {
+        // Past the 4096 a deque holds
+        const uint32_t kJobs = 10000;
+        std::unique_ptr<std::atomic<uint32_t>[]> RunCounts(new std::atomic<uint32_t>[kJobs]);
+        for (uint32_t i = 0; i < kJobs; ++i)
+            RunCounts[i] = 0;
+
+        JobSystem::JobCounter Counter;
+        for (uint32_t i = 0; i < kJobs; ++i)
+            JobSystem::Run([&RunCounts, i]{ RunCounts[i].fetch_add(1, std::memory_order_relaxed); }, Counter);
+        JobSystem::Wait(Counter);
+
+        bool RanOnce = true;
+        for (uint32_t i = 0; i < kJobs; ++i)
+            RanOnce &= RunCounts[i].load() == 1;
+        Check(RanOnce, "jobs past a full deque run exactly once");
+
+        printf("overflow: %u jobs at once, %s\n", kJobs, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    // Covers [Begin, End) and checks every element is visited once, in chunks of at most Grain
+    void TestRange( uint32_t Begin, uint32_t End, uint32_t Grain )
+    {
+        const uint32_t Count = End > Begin ? End - Begin : 0;
+        std::unique_ptr<std::atomic<uint32_t>[]> Visits(new std::atomic<uint32_t>[Count + 1]);
+        for (uint32_t i = 0; i < Count; ++i)
+            Visits[i] = 0;
+
+        std::atomic<uint32_t> Calls(0);
+        std::atomic<bool> ChunksValid(true);
+        JobSystem::ParallelFor(Begin, End, Grain, [&]( uint32_t ChunkBegin, uint32_t ChunkEnd )
+        {
+            Calls.fetch_add(1, std::memory_order_relaxed);
+            if (ChunkBegin < Begin || ChunkEnd > End || ChunkBegin >= ChunkEnd || ChunkEnd - ChunkBegin > std::max(Grain, 1u))
+            {
+                ChunksValid = false;
+                return;
+            }
+            for (uint32_t i = ChunkBegin; i < ChunkEnd; ++i)
+                Visits[i - Begin].fetch_add(1, std::memory_order_relaxed);
+        });
+
+        bool VisitedOnce = true;
+        for (uint32_t i = 0; i < Count; ++i)
+            VisitedOnce &= Visits[i].load() == 1;
+
+        Check(ChunksValid.load(), "chunks are non-empty, inside the range and no larger than the grain");
+        Check(VisitedOnce, "every element is visited exactly once");
+        Check(Count > 0 || Calls.load() == 0, "an empty range calls nothing");
+    }
+
+    void TestParallelFor( void )
+    {
+        TestRange(0, 0, 16);
+        TestRange(5, 5, 16);
+        TestRange(10, 5, 4);
+        TestRange(100, 3, 1000);
+        TestRange(0, 1, 16);
+        TestRange(0, 16, 16);
+        TestRange(0, 17, 16);
+        TestRange(3, 1000, 0);
+        TestRange(7, 100003, 64);
+        TestRange(0, 100000, 100000);
+        TestRange(0xFFFFFFFFu - 1000, 0xFFFFFFFFu, 7);
+        TestRange(0xFFFFFFFFu - 1000, 0xFFFFFFFFu, 999);
+
+        // From inside a job as well as from the main thread
+        JobSystem::JobCounter Counter;
+        JobSystem::Run([]{ TestRange(1, 50000, 100); }, Counter);
+        JobSystem::Wait(Counter);
+
+        printf("ParallelFor: %s\n", s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    template <typename Function>
+    double BestSeconds( Function Work )
+    {
+        double Best = 1e30;
+        for (int Run = 0; Run < 5; ++Run)
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            Work();
+            Best = std::min(Best, std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+        }
+        return Best;
+    }
+
+    void Benchmark( void )
+    {
+        const uint32_t kJobs = 100000;
+        std::atomic<uint32_t> Executed(0);
+        const double JobSeconds = BestSeconds([&]
+        {
+            JobSystem::JobCounter Counter;
+            for (uint32_t i = 0; i < kJobs; ++i)
+                JobSystem::Run([&Executed]{ Executed.fetch_add(1, std::memory_order_relaxed); }, Counter);
+            JobSystem::Wait(Counter);
+        });
+        Check(Executed.load() == kJobs * 5, "benchmark jobs all run");
+
+        const uint32_t kElements = 1 << 22, kGrain = 1024;
+        std::vector<float> Values(kElements, 1.0f);
+        const double ForSeconds = BestSeconds([&]
+        {
+            JobSystem::ParallelFor(0, kElements, kGrain, [&Values]( uint32_t Begin, uint32_t End )
+            {
+                for (uint32_t i = Begin; i < End; ++i)
+                    Values[i] = Values[i] * 0.5f + 1.0f;
+            });
+        });
+
+        printf("%u threads: %.2f M empty jobs/sec queued and waited on by one thread, "
+            "ParallelFor %.1f M elements/sec in chunks of %u\n", JobSystem::GetThreadCount(), kJobs / JobSeconds / 1e6,
+            kElements / ForSeconds / 1e6, kGrain);
+    }
+}
+
+int main( void )
+{
+    JobSystem::Initialize(kWorkerCount);
+    Check(JobSystem::GetThreadCount() == kWorkerCount + 1, "thread count includes the main thread");
+
+    TestNested();
+    TestContention();
+    TestOverflow();
+    TestParallelFor();
+    Benchmark();
+
+    JobSystem::Shutdown();
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Drives LinearPagePool with pages from malloc and a fake GPU fence that lags a few frames behind the
+// contexts retiring pages, the way LinearAllocator uses it:
+//
+//     single thread:  frames of contexts that request and discard pages.  No page may come back before
+//                     the fence it was discarded with completes, and once the pool warms up it stops
+//                     creating pages.
+//     threads:        several threads record contexts while others finish them, so pages move between
+//                     thread caches and the shared pool, and a separate thread plays the GPU.  No page is
+//                     handed out early or to two contexts at once.
+//     large pages:    sizes are rounded into classes, recycled after their fence, and past the cache
+//                     limit destroyed instead
+//
+// Every page is freed by Destroy() exactly once.  Prints the pool's counters for each run, including how
+// often a thread waited for the shared pool.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. LinearPagePoolTest.cpp -o LinearPagePoolTest -pthread
+//
+
+#include "LinearPagePool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<int> s_Failures(0);
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s\n", What);
+    }
+
+    const size_t kDefaultPageSize = 4096;
+
+    struct TestPage
+    {
+        size_t Size;
+        uint8_t* Memory;
+        std::atomic<uint64_t> RetiredFence;	// the fence it was last discarded with
+        std::atomic<bool> InUse;
+    };
+
+    // Pages from malloc, and a fence the test completes by hand, or a GPU thread completes a few frames late
+    class MallocPageSource : public LinearPageSource<TestPage>
+    {
+    public:
+        MallocPageSource() : m_CompletedFence(0), m_Created(0) {}
+
+        TestPage* CreatePage( size_t PageSize ) override
+        {
+            TestPage* Page = new TestPage;
+            Page->Size = PageSize == 0 ? kDefaultPageSize : PageSize;
+            Page->Memory = (uint8_t*)malloc(Page->Size);
+            Page->RetiredFence = 0;
+            Page->InUse = false;
+
+            std::lock_guard<std::mutex> Guard(m_Mutex);
+            m_LivePages.insert(Page);
+            ++m_Created;
+            return Page;
+        }
+
+        void DestroyPage( TestPage* Page ) override
+        {
+            std::lock_guard<std::mutex> Guard(m_Mutex);
+            Check(m_LivePages.erase(Page) == 1, "a page is destroyed once");
+            Check(!Page->InUse, "a page in use is not destroyed");
+            Check(m_CompletedFence.load() >= Page->RetiredFence.load(), "a page is not destroyed before its fence");
+            free(Page->Memory);
+            delete Page;
+        }
+
+        size_t GetPageSize( const TestPage* Page ) override
+        {
+            return Page->Size;
+        }
+
+        bool IsFenceComplete( uint64_t FenceValue ) override
+        {
+            return FenceValue <= m_CompletedFence.load(std::memory_order_acquire);
+        }
+
+        void CompleteFence( uint64_t FenceValue )
+        {
+            m_CompletedFence.store(FenceValue, std::memory_order_release);
+        }
+
+        uint64_t GetCompletedFence( void ) const { return m_CompletedFence.load(std::memory_order_acquire); }
+        size_t GetLivePageCount( void ) { std::lock_guard<std::mutex> Guard(m_Mutex); return m_LivePages.size(); }
+        uint64_t GetCreatedCount( void ) { std::lock_guard<std::mutex> Guard(m_Mutex); return m_Created; }
+
+    private:
+        std::atomic<uint64_t> m_CompletedFence;
+        std::mutex m_Mutex;
+        std::set<TestPage*> m_LivePages;
+        uint64_t m_Created;
+    };
+
+    // What a context does with a page it's given:  check it may be used, then write all of it
+    void UsePage( MallocPageSource& Source, TestPage* Page, size_t MinSize )
+    {
+        Check(Source.IsFenceComplete(Page->RetiredFence.load()), "a page is only recycled after its fence completes");
+        Check(!Page->InUse.exchange(true), "a page is only given to one context at a time");
+        Check(Page->Size >= MinSize, "a page is at least the size requested");
+        memset(Page->Memory, 0x5A, Page->Size);
+    }
+
+    void Retire( std::vector<TestPage*>& Pages, uint64_t FenceValue )
+    {
+        for (TestPage* Page : Pages)
+        {
+            Page->RetiredFence = FenceValue;
+            Page->InUse = false;
+        }
+    }
+
+    void PrintStats( const char* Run, const LinearPagePoolStats& Stats )
+    {
+        printf("%s: %llu pages requested, %llu created; %llu large requested, %llu created; %llu lock contentions; %s\n",
+            Run, (unsigned long long)Stats.PagesRequested.load(), (unsigned long long)Stats.PagesCreated.load(),
+            (unsigned long long)Stats.LargePagesRequested.load(), (unsigned long long)Stats.LargePagesCreated.load(),
+            (unsigned long long)Stats.LockContention.load(), s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    void TestSingleThread( void )
+    {
+        const uint64_t kFenceLag = 3;
+        const uint32_t kFrames = 2000, kMaxPagesPerContext = 6;
+
+        MallocPageSource Source;
+        {
+            LinearPagePool<TestPage> Pool(Source);
+            uint64_t NextFence = 1, CreatedAfterWarmUp = 0;
+            for (uint32_t Frame = 0; Frame < kFrames; ++Frame)
+            {
+                // A few contexts per frame, each finishing with a fence of its own and using a varying
+                // number of pages, so that pages move between contexts of different sizes
+                for (uint32_t Context = 0; Context < 3; ++Context)
+                {
+                    std::vector<TestPage*> Pages(1 + (Frame * 3 + Context) % kMaxPagesPerContext);
+                    for (TestPage*& Page : Pages)
+                    {
+                        Page = Pool.RequestPage();
+                        UsePage(Source, Page, kDefaultPageSize);
+                    }
+                    Retire(Pages, NextFence);
+                    Pool.DiscardPages(NextFence++, Pages);
+                }
+
+                // The GPU is kFenceLag frames behind
+                if (NextFence > 3 * kFenceLag)
+                    Source.CompleteFence(NextFence - 1 - 3 * kFenceLag);
+
+                if (Frame == kFrames / 2)
+                    CreatedAfterWarmUp = Source.GetCreatedCount();
+            }
+
+            // Pages in flight are never more than the lagging frames can hold, so the pool stops growing
+            Check(Source.GetCreatedCount() == CreatedAfterWarmUp, "a warmed up pool creates no pages");
+            Check(Source.GetCreatedCount() <= (kFenceLag + 1) * 3 * kMaxPagesPerContext + LinearPagePool<TestPage>::kMaxCachedPages,
+                "the pool holds no more pages than are in flight");
+
+            // Nothing retired after the last completed fence comes back before it completes
+            const uint64_t Completed = Source.GetCompletedFence();
+            std::vector<TestPage*> Drained;
+            for (uint32_t i = 0; i < 64; ++i)
+            {
+                Drained.push_back(Pool.RequestPage());
+                UsePage(Source, Drained.back(), kDefaultPageSize);
+            }
+            Source.CompleteFence(NextFence);
+            Retire(Drained, NextFence);
+            Pool.DiscardPages(NextFence, Drained);
+            Check(Completed < NextFence, "the fence lagged");
+
+            PrintStats("single thread", Pool.GetStats());
+        }
+        Check(Source.GetLivePageCount() == 0, "Destroy() frees every page");
+    }
+
+    void TestThreads( void )
+    {
+        const uint32_t kRecorders = 4, kContextsPerThread = 20000;
+        MallocPageSource Source;
+        {
+            LinearPagePool<TestPage> Pool(Source);
+            std::atomic<uint64_t> NextFence(1);
+            std::atomic<uint32_t> RecordersLeft(kRecorders);
+
+            // Contexts recorded on one thread are often finished on another, as command lists are
+            std::mutex FinishMutex;
+            std::vector<std::vector<TestPage*>> ToFinish;
+
+            auto Finish = [&]( std::vector<TestPage*>& Pages )
+            {
+                const uint64_t Fence = NextFence.fetch_add(1);
+                Retire(Pages, Fence);
+                Pool.DiscardPages(Fence, Pages);
+            };
+
+            auto Recorder = [&]( uint32_t ThreadIndex )
+            {
+                std::mt19937 Random(ThreadIndex);
+                for (uint32_t Context = 0; Context < kContextsPerThread; ++Context)
+                {
+                    std::vector<TestPage*> Pages(1 + Random() % 4);
+                    for (TestPage*& Page : Pages)
+                    {
+                        Page = Pool.RequestPage();
+                        UsePage(Source, Page, kDefaultPageSize);
+                    }
+
+                    if (Random() % 2 == 0)
+                    {
+                        Finish(Pages);
+                        continue;
+                    }
+
+                    std::vector<TestPage*> Other;
+                    {
+                        std::lock_guard<std::mutex> Guard(FinishMutex);
+                        ToFinish.push_back(std::move(Pages));
+                        if (ToFinish.size() > 1)
+                        {
+                            Other = std::move(ToFinish.front());
+                            ToFinish.erase(ToFinish.begin());
+                        }
+                    }
+                    if (!Other.empty())
+                        Finish(Other);
+                }
+                RecordersLeft.fetch_sub(1);
+            };
+
+            // The GPU keeps up, but only ever completes work from a while ago
+            std::thread Gpu([&]
+            {
+                while (RecordersLeft.load() > 0)
+                {
+                    const uint64_t Submitted = NextFence.load();
+                    if (Submitted > 64)
+                        Source.CompleteFence(std::max(Source.GetCompletedFence(), Submitted - 64));
+                    std::this_thread::yield();
+                }
+            });
+
+            std::vector<std::thread> Threads;
+            for (uint32_t i = 0; i < kRecorders; ++i)
+                Threads.emplace_back(Recorder, i);
+            for (std::thread& Thread : Threads)
+                Thread.join();
+            Gpu.join();
+
+            for (std::vector<TestPage*>& Pages : ToFinish)
+                Finish(Pages);
+            Source.CompleteFence(NextFence.load());
+
+            const LinearPagePoolStats& Stats = Pool.GetStats();
+            Check(Stats.PagesCreated.load() < Stats.PagesRequested.load() / 4, "threads recycle most pages");
+            PrintStats("threads", Stats);
+        }
+        Check(Source.GetLivePageCount() == 0, "Destroy() frees every page");
+    }
+
+    void TestLargePages( void )
+    {
+        typedef LinearPagePool<TestPage> Pool;
+
+        // Sizes round up into four classes per power of two
+        bool Rounded = true;
+        for (size_t Size = 1; Size < (1 << 24); Size = Size * 3 / 2 + 1)
+        {
+            const size_t PageSize = Pool::GetLargePageSize(Size);
+            Rounded &= PageSize >= Size && PageSize < Size + Size / 4 + 8 && Pool::GetLargePageSize(PageSize) == PageSize;
+        }
+        Check(Rounded, "large sizes round up by less than a quarter, to a size that rounds to itself");
+
+        MallocPageSource Source;
+        {
+            Pool LargePool(Source);
+            std::mt19937 Random(11);
+
+            uint64_t Fence = 1;
+            for (uint32_t Frame = 0; Frame < 500; ++Frame)
+            {
+                std::vector<TestPage*> Pages;
+                for (uint32_t i = 0; i < 3; ++i)
+                {
+                    const size_t Size = 64 * 1024 + Random() % (2 << 20);
+                    Pages.push_back(LargePool.RequestLargePage(Size));
+                    UsePage(Source, Pages.back(), Size);
+                }
+                Retire(Pages, Fence);
+                LargePool.DiscardLargePages(Fence++, Pages);
+                if (Fence > 4)
+                    Source.CompleteFence(Fence - 4);
+            }
+            Check(LargePool.GetStats().LargePagesCreated.load() < LargePool.GetStats().LargePagesRequested.load(),
+                "large pages are recycled");
+
+            // More than the cache holds comes back at once, so some are destroyed rather than kept
+            std::vector<TestPage*> Huge;
+            for (uint32_t i = 0; i < 12; ++i)
+            {
+                Huge.push_back(LargePool.RequestLargePage(8 << 20));
+                UsePage(Source, Huge.back(), 8 << 20);
+            }
+            Retire(Huge, Fence);
+            LargePool.DiscardLargePages(Fence, Huge);
+            const size_t LiveBefore = Source.GetLivePageCount();
+            Source.CompleteFence(Fence++);
+            TestPage* Page = LargePool.RequestLargePage(8 << 20);
+            UsePage(Source, Page, 8 << 20);
+            Check(Source.GetLivePageCount() < LiveBefore, "large pages past the cache limit are destroyed");
+
+            std::vector<TestPage*> Last(1, Page);
+            Retire(Last, Fence);
+            LargePool.DiscardLargePages(Fence, Last);
+            Source.CompleteFence(Fence);
+
+            PrintStats("large pages", LargePool.GetStats());
+        }
+        Check(Source.GetLivePageCount() == 0, "Destroy() frees every page");
+    }
+}
+
+int main( void )
+{
+    TestSingleThread();
+    TestThreads();
+    TestLargePages();
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks MappedFile on a generated file, then times loading it the way ModelH3D does, with a cold page
+// cache and in a child process per run so each reports its own peak RSS.  The file is split into four
+// arrays like an H3D file's vertex, index and depth data, and each array is copied into a buffer that
+// stands in for its GPU buffer:
+//
+//     read:  new[] copies of every array read from the file and kept, as the loader used to
+//     map:   the mapping copied from directly, prefetching the next array and evicting the last
+//
+// Linux only.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. MappedFileTest.cpp ../MappedFile.cpp -o MappedFileTest
+//     ./MappedFileTest [megabytes]
+//
+
+#include "MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using Utility::MappedFile;
+
+namespace
+{
+    const char* kFileName = "MappedFileTest.bin";
+    const char* kEmptyFileName = "MappedFileTest.empty";
+    const uint32_t kArrayCount = 4;
+
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed)
+        {
+            printf("FAILED: %s\n", What);
+            ++s_Failures;
+        }
+    }
+
+    uint8_t Pattern( uint64_t Offset )
+    {
+        return (uint8_t)(Offset * 7 + Offset / 4096);
+    }
+
+    // Whether Size bytes at Data hold the file's bytes from Offset on
+    bool Matches( const uint8_t* Data, uint64_t Offset, uint64_t Size )
+    {
+        for (uint64_t i = 0; i < Size; ++i)
+        {
+            if (Data[i] != Pattern(Offset + i))
+                return false;
+        }
+        return true;
+    }
+
+    bool WriteFile( const char* FileName, uint64_t Size )
+    {
+        FILE* File = fopen(FileName, "wb");
+        if (File == nullptr)
+            return false;
+
+        std::vector<uint8_t> Chunk(1 << 20);
+        for (uint64_t Offset = 0; Offset < Size; Offset += Chunk.size())
+        {
+            const size_t Bytes = (size_t)std::min<uint64_t>(Chunk.size(), Size - Offset);
+            for (size_t i = 0; i < Bytes; ++i)
+                Chunk[i] = Pattern(Offset + i);
+            fwrite(Chunk.data(), 1, Bytes, File);
+        }
+        return fclose(File) == 0;
+    }
+
+    void DropFromPageCache( const char* FileName )
+    {
+        int File = open(FileName, O_RDONLY);
+        fdatasync(File);
+        posix_fadvise(File, 0, 0, POSIX_FADV_DONTNEED);
+        close(File);
+    }
+
+    void TestMapping( uint64_t Size )
+    {
+        MappedFile Missing;
+        Check(!Missing.Open("MappedFileTest.missing") && !Missing.IsOpen(), "opening a missing file fails");
+
+        fclose(fopen(kEmptyFileName, "wb"));
+        MappedFile Empty;
+        Check(!Empty.Open(kEmptyFileName) && !Empty.IsOpen(), "opening an empty file fails");
+        remove(kEmptyFileName);
+
+        MappedFile File;
+        Check(File.Open(kFileName), "open");
+        Check(File.GetSize() == Size, "size");
+        Check(File.Contains(File.GetData()) && File.Contains(File.GetData() + Size - 1) && !File.Contains(File.GetData() + Size), "contains");
+        Check(Matches(File.GetData(), 0, Size), "contents");
+
+        // Evicted pages come back from the file.  The range has ragged ends, and the bytes just outside it
+        // are written first, so evicting the partial pages at either end would lose them.
+        File.Prefetch(File.GetData(), (size_t)Size);
+        const uint64_t EvictBegin = Size / 3 + 123, EvictEnd = Size / 2 + 4567;
+        File.GetData()[EvictBegin - 1] ^= 0xFF;
+        File.GetData()[EvictEnd] ^= 0xFF;
+        File.Evict(File.GetData() + EvictBegin, (size_t)(EvictEnd - EvictBegin));
+        Check(Matches(File.GetData() + EvictBegin, EvictBegin, EvictEnd - EvictBegin), "contents after evict");
+        Check(File.GetData()[EvictBegin - 1] == (uint8_t)~Pattern(EvictBegin - 1) &&
+            File.GetData()[EvictEnd] == (uint8_t)~Pattern(EvictEnd), "evict keeps partial pages");
+
+        // Writes stay private to the mapping
+        memset(File.GetData(), 0xEE, 4096);
+        MappedFile Second;
+        Check(Second.Open(kFileName) && Matches(Second.GetData(), 0, 4096), "writes don't reach the file");
+        Check(File.GetData()[0] == 0xEE, "writes are seen through the mapping");
+
+        File.Close();
+        Check(!File.IsOpen() && File.GetSize() == 0, "close");
+    }
+
+    // Returns the load time in milliseconds, and fills in the peak RSS in megabytes
+    double TimeLoad( bool UseMapping, uint64_t Size, long& PeakMB )
+    {
+        DropFromPageCache(kFileName);
+
+        int Pipe[2];
+        if (pipe(Pipe) != 0)
+            return 0.0;
+
+        const pid_t Child = fork();
+        if (Child == 0)
+        {
+            const uint64_t ArraySize = Size / kArrayCount;
+            std::vector<std::vector<uint8_t>> GpuBuffers(kArrayCount);
+            std::vector<uint8_t*> CpuCopies;
+
+            const auto Start = std::chrono::steady_clock::now();
+            if (UseMapping)
+            {
+                MappedFile File;
+                File.Open(kFileName);
+                File.Prefetch(File.GetData(), (size_t)ArraySize);
+                for (uint32_t i = 0; i < kArrayCount; ++i)
+                {
+                    const uint8_t* Array = File.GetData() + i * ArraySize;
+                    if (i + 1 < kArrayCount)
+                        File.Prefetch(Array + ArraySize, (size_t)ArraySize);
+                    GpuBuffers[i].assign(Array, Array + ArraySize);
+                    File.Evict(Array, (size_t)ArraySize);
+                }
+            }
+            else
+            {
+                FILE* File = fopen(kFileName, "rb");
+                for (uint32_t i = 0; i < kArrayCount; ++i)
+                {
+                    CpuCopies.push_back(new uint8_t[ArraySize]);
+                    fread(CpuCopies.back(), 1, (size_t)ArraySize, File);
+                }
+                fclose(File);
+                for (uint32_t i = 0; i < kArrayCount; ++i)
+                    GpuBuffers[i].assign(CpuCopies[i], CpuCopies[i] + ArraySize);
+            }
+            double Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+
+            for (uint32_t i = 0; i < kArrayCount; ++i)
+            {
+                if (!Matches(GpuBuffers[i].data(), i * ArraySize, ArraySize))
+                    Milliseconds = -1.0;
+            }
+
+            write(Pipe[1], &Milliseconds, sizeof(Milliseconds));
+            _exit(0);
+        }
+
+        double Milliseconds = 0.0;
+        read(Pipe[0], &Milliseconds, sizeof(Milliseconds));
+        close(Pipe[0]);
+        close(Pipe[1]);
+
+        int Status;
+        struct rusage Usage;
+        wait4(Child, &Status, 0, &Usage);
+        PeakMB = Usage.ru_maxrss / 1024;
+        return Milliseconds;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    const uint64_t Size = (uint64_t)(argc > 1 ? atoi(argv[1]) : 256) << 20;
+    if (Size == 0 || !WriteFile(kFileName, Size))
+    {
+        printf("couldn't write %s\n", kFileName);
+        return 1;
+    }
+
+    TestMapping(Size);
+    printf("mapping: %s\n", s_Failures == 0 ? "passed" : "FAILED");
+
+    for (int Mode = 0; Mode < 2; ++Mode)
+    {
+        long PeakMB = 0;
+        const double Milliseconds = TimeLoad(Mode == 1, Size, PeakMB);
+        Check(Milliseconds >= 0.0, "loaded data");
+        printf("%s load of %llu MB, cold: %.1f ms, peak RSS %ld MB\n", Mode == 1 ? "map " : "read",
+            (unsigned long long)(Size >> 20), Milliseconds, PeakMB);
+    }
+
+    remove(kFileName);
+    return s_Failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Writes a directory of small generated files and a pack of them laid out as BuildPackFile.py does, checks
+// PackFile against them, then times reading every file both ways, as Utility::ReadFileSpan() does:
+//
+//     loose:  each file opened and mapped on its own
+//     pack:   one mapping, and each file found in its table of contents
+//
+// Each is timed cold, after dropping the files from the page cache, and then warm.  Only stored entries
+// are timed; inflating gzip entries is timed by GzipMembersTest.
+//
+// Linux only.  Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. PackFileTest.cpp ../PackFile.cpp ../MappedFile.cpp -o PackFileTest
+//     ./PackFileTest [files]
+//
+
+#include "PackFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using Utility::MappedFile;
+using Utility::PackFile;
+
+namespace
+{
+    const char* kDirectory = "packfiletest";
+    const char* kPackName = "PackFileTest.pak";
+    const char* kCorruptPackName = "PackFileTest.bad";
+
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s\n", What);
+    }
+
+    struct TestFile
+    {
+        std::string Path;
+        std::vector<uint8_t> Contents;
+    };
+
+    uint64_t AlignUp( uint64_t Offset )
+    {
+        return (Offset + PackFile::kAlignment - 1) & ~(uint64_t)(PackFile::kAlignment - 1);
+    }
+
+    bool WriteBytes( const std::string& FileName, const void* Data, size_t Size )
+    {
+        FILE* File = fopen(FileName.c_str(), "wb");
+        if (File == nullptr)
+            return false;
+        if (Size > 0)
+            fwrite(Data, 1, Size, File);
+        return fclose(File) == 0;
+    }
+
+    // Texture-sized files of a few to a few hundred kilobytes, some empty, spread over a few directories
+    std::vector<TestFile> WriteLooseFiles( uint32_t Count )
+    {
+        mkdir(kDirectory, 0755);
+        for (uint32_t i = 0; i < 8; ++i)
+            mkdir((std::string(kDirectory) + "/dir" + std::to_string(i)).c_str(), 0755);
+
+        std::vector<TestFile> Files(Count);
+        uint32_t Random = 12345;
+        for (uint32_t i = 0; i < Count; ++i)
+        {
+            Random = Random * 1664525 + 1013904223;
+            const size_t Size = i % 50 == 0 ? 0 : 1024 + (Random >> 8) % (256 * 1024);
+
+            TestFile& File = Files[i];
+            File.Path = std::string(kDirectory) + "/dir" + std::to_string(i % 8) + "/file" + std::to_string(i) + ".dds";
+            File.Contents.resize(Size);
+            for (size_t j = 0; j < Size; ++j)
+                File.Contents[j] = (uint8_t)(j * 13 + i);
+
+            WriteBytes(File.Path, File.Contents.data(), Size);
+        }
+        return Files;
+    }
+
+    bool WritePack( const std::vector<TestFile>& Files )
+    {
+        struct Sorted
+        {
+            uint64_t Hash;
+            const TestFile* File;
+        };
+        std::vector<Sorted> Order;
+        for (const TestFile& File : Files)
+            Order.push_back({ PackFile::HashPath(File.Path), &File });
+        std::sort(Order.begin(), Order.end(), []( const Sorted& A, const Sorted& B )
+            { return A.Hash != B.Hash ? A.Hash < B.Hash : A.File->Path < B.File->Path; });
+
+        uint64_t PathOffset = sizeof(PackFile::Header) + sizeof(PackFile::TocEntry) * Order.size();
+        uint64_t DataOffset = PathOffset;
+        for (const Sorted& Entry : Order)
+            DataOffset += Entry.File->Path.size();
+        DataOffset = AlignUp(DataOffset);
+
+        std::vector<PackFile::TocEntry> Toc;
+        for (const Sorted& Entry : Order)
+        {
+            const uint64_t Size = Entry.File->Contents.size();
+            Toc.push_back({ Entry.Hash, DataOffset, Size, Size, (uint32_t)PathOffset, (uint32_t)Entry.File->Path.size(), 0, 0 });
+            PathOffset += Entry.File->Path.size();
+            DataOffset = AlignUp(DataOffset + Size);
+        }
+
+        std::vector<uint8_t> Pack(sizeof(PackFile::Header));
+        const PackFile::Header Header = { PackFile::kMagic, PackFile::kVersion, (uint32_t)Order.size(), 0 };
+        memcpy(Pack.data(), &Header, sizeof(Header));
+        Pack.insert(Pack.end(), (const uint8_t*)Toc.data(), (const uint8_t*)(Toc.data() + Toc.size()));
+        for (const Sorted& Entry : Order)
+            Pack.insert(Pack.end(), Entry.File->Path.begin(), Entry.File->Path.end());
+        for (const Sorted& Entry : Order)
+        {
+            Pack.resize((size_t)AlignUp(Pack.size()));
+            Pack.insert(Pack.end(), Entry.File->Contents.begin(), Entry.File->Contents.end());
+        }
+
+        return WriteBytes(kPackName, Pack.data(), Pack.size());
+    }
+
+    std::wstring Widen( const std::string& Path )
+    {
+        return std::wstring(Path.begin(), Path.end());
+    }
+
+    void TestLookups( const std::vector<TestFile>& Files )
+    {
+        PackFile Missing;
+        Check(!Missing.Open(L"PackFileTest.missing"), "opening a missing pack fails");
+
+        PackFile Pack;
+        Check(Pack.Open(Widen(kPackName)), "open");
+
+        for (const TestFile& File : Files)
+        {
+            PackFile::Entry Entry;
+            if (!Pack.Find(Widen(File.Path), Entry))
+            {
+                Check(false, "every file is found");
+                continue;
+            }
+            Check(Entry.Size == File.Contents.size() && Entry.StoredSize == Entry.Size && Entry.Flags == 0, "entry size");
+            Check(((uintptr_t)Entry.Data & (PackFile::kAlignment - 1)) == 0, "entry data is aligned");
+            Check(Entry.Size == 0 || memcmp(Entry.Data, File.Contents.data(), (size_t)Entry.Size) == 0, "entry contents");
+        }
+
+        // Paths match without regard to case, slash direction or a leading "./"
+        PackFile::Entry Entry;
+        Check(Pack.Find(L"PackFileTest\\Dir3\\FILE3.DDS", Entry) && Entry.Size == Files[3].Contents.size(), "case and backslashes");
+        Check(Pack.Find(L"./.\\packfiletest/dir5/file13.dds", Entry) && Entry.Size == Files[13].Contents.size(), "leading ./");
+        Check(!Pack.Find(L"packfiletest/dir3/file3.dd", Entry), "a prefix isn't found");
+        Check(!Pack.Find(L"packfiletest/dir3/file3.ddsx", Entry), "a longer path isn't found");
+        Check(!Pack.Find(L"", Entry), "an empty path isn't found");
+        Check(PackFile::NormalizePath(L"./A\\B\u00E9\U0001F600") == "a/b\xC3\xA9\xF0\x9F\x98\x80", "paths normalize to UTF-8");
+
+        Pack.Close();
+        Check(!Pack.Find(Widen(Files[0].Path), Entry), "nothing is found after close");
+    }
+
+    // Each damaged copy of the pack must be rejected when it's opened, before any lookup trusts it
+    void TestCorruption( void )
+    {
+        MappedFile Original;
+        Original.Open(kPackName);
+        const std::vector<uint8_t> Good(Original.GetData(), Original.GetData() + Original.GetSize());
+        Original.Close();
+
+        auto Rejects = [&]( const char* What, auto Damage )
+        {
+            std::vector<uint8_t> Bad = Good;
+            Damage(Bad);
+            WriteBytes(kCorruptPackName, Bad.data(), Bad.size());
+            PackFile Pack;
+            Check(!Pack.Open(Widen(kCorruptPackName)), What);
+        };
+
+        auto TocAt = []( std::vector<uint8_t>& Pack, uint32_t Index )
+            { return (PackFile::TocEntry*)(Pack.data() + sizeof(PackFile::Header)) + Index; };
+
+        Rejects("bad magic", []( std::vector<uint8_t>& Pack ) { Pack[0] ^= 1; });
+        Rejects("bad version", []( std::vector<uint8_t>& Pack ) { Pack[4] ^= 2; });
+        Rejects("truncated header", []( std::vector<uint8_t>& Pack ) { Pack.resize(sizeof(PackFile::Header) - 1); });
+        Rejects("too many entries", []( std::vector<uint8_t>& Pack ) { ((PackFile::Header*)Pack.data())->NumEntries = 0x7FFFFFFF; });
+        Rejects("data past the end", [&]( std::vector<uint8_t>& Pack ) { TocAt(Pack, 1)->Offset = Pack.size() + 1; });
+        Rejects("size past the end", [&]( std::vector<uint8_t>& Pack ) { TocAt(Pack, 2)->StoredSize = TocAt(Pack, 2)->Size = ~0ull; });
+        Rejects("path past the end", [&]( std::vector<uint8_t>& Pack ) { TocAt(Pack, 3)->PathOffset = 0xFFFFFFF0; });
+        Rejects("stored size mismatch", [&]( std::vector<uint8_t>& Pack ) { TocAt(Pack, 4)->Size += 1; });
+
+        remove(kCorruptPackName);
+    }
+
+    void DropFromPageCache( const std::string& FileName )
+    {
+        int File = open(FileName.c_str(), O_RDONLY);
+        posix_fadvise(File, 0, 0, POSIX_FADV_DONTNEED);
+        close(File);
+    }
+
+    // Reads every file, touching every page, and returns the time in milliseconds
+    double TimeReads( const std::vector<TestFile>& Files, bool UsePack, bool Cold, uint64_t& Checksum )
+    {
+        if (Cold)
+        {
+            for (const TestFile& File : Files)
+                DropFromPageCache(File.Path);
+            DropFromPageCache(kPackName);
+        }
+
+        const auto Start = std::chrono::steady_clock::now();
+
+        auto Touch = [&]( const uint8_t* Data, uint64_t Size )
+        {
+            for (uint64_t i = 0; i < Size; i += 4096)
+                Checksum += Data[i];
+            if (Size > 0)
+                Checksum += Data[Size - 1];
+        };
+
+        if (UsePack)
+        {
+            PackFile Pack;
+            Pack.Open(Widen(kPackName));
+            for (const TestFile& File : Files)
+            {
+                PackFile::Entry Entry;
+                if (Pack.Find(Widen(File.Path), Entry))
+                    Touch(Entry.Data, Entry.Size);
+            }
+        }
+        else
+        {
+            for (const TestFile& File : Files)
+            {
+                // Empty files can't be mapped, and ReadFileSpan() falls back to reading them
+                MappedFile Loose;
+                if (Loose.Open(File.Path.c_str()))
+                    Touch(Loose.GetData(), Loose.GetSize());
+            }
+        }
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+    }
+}
+
+int main( int argc, char** argv )
+{
+    const uint32_t Count = argc > 1 ? (uint32_t)atoi(argv[1]) : 2000;
+    if (Count < 50)
+    {
+        printf("needs at least 50 files\n");
+        return 1;
+    }
+
+    const std::vector<TestFile> Files = WriteLooseFiles(Count);
+    if (!WritePack(Files))
+    {
+        printf("couldn't write %s\n", kPackName);
+        return 1;
+    }
+    sync();
+
+    TestLookups(Files);
+    TestCorruption();
+    printf("lookups: %s\n", s_Failures == 0 ? "passed" : "FAILED");
+
+    uint64_t Bytes = 0;
+    for (const TestFile& File : Files)
+        Bytes += File.Contents.size();
+
+    uint64_t Checksums[2] = {};
+    for (int Cold = 1; Cold >= 0; --Cold)
+    {
+        for (int UsePack = 0; UsePack < 2; ++UsePack)
+        {
+            const double Milliseconds = TimeReads(Files, UsePack == 1, Cold == 1, Checksums[UsePack]);
+            printf("%s read of %u files, %llu MB, %s: %.1f ms\n", UsePack ? "pack " : "loose", Count,
+                (unsigned long long)(Bytes >> 20), Cold ? "cold" : "warm", Milliseconds);
+        }
+    }
+    Check(Checksums[0] == Checksums[1], "loose and packed files read the same");
+
+    for (const TestFile& File : Files)
+        remove(File.Path.c_str());
+    for (uint32_t i = 0; i < 8; ++i)
+        rmdir((std::string(kDirectory) + "/dir" + std::to_string(i)).c_str());
+    rmdir(kDirectory);
+    remove(kPackName);
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
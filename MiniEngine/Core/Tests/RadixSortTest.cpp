@@ -0,0 +1,168 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks RadixSort64 against std::sort on empty, one-element, already sorted, reversed, all-equal and random
+// keys, at sizes on either side of the pass-skipping cases.  Random keys use all 64 bits, only the low bits,
+// or a few distinct high bits over a varying low part, as ModelViewer's draw packets do.  Keys and scratch are
+// allocated to their exact size, so a build with -fsanitize=address catches any access past either.
+//
+// Then times RadixSort64 against std::sort on draw-packet-like and fully random keys.  Builds on its own, for
+// example:
+//
+//     g++ -std=c++14 -O2 -I.. RadixSortTest.cpp -o RadixSortTest
+//
+
+#include "RadixSort.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Utility::RadixSort64;
+
+namespace
+{
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What, const char* Keys, size_t Count )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED: %s (%s keys, %zu of them)\n", What, Keys, Count);
+    }
+
+    enum KeyKind
+    {
+        kSorted,
+        kReversed,
+        kAllEqual,
+        kRandom,
+        kLowBits,
+        kDrawPackets,
+        kKeyKindCount
+    };
+
+    const char* const s_KeyKindNames[kKeyKindCount] =
+    {
+        "sorted", "reversed", "all-equal", "random", "low-bit", "draw packet"
+    };
+
+    std::vector<uint64_t> MakeKeys( KeyKind Kind, size_t Count, std::mt19937_64& Random )
+    {
+        std::vector<uint64_t> Keys(Count);
+        const uint64_t Equal = Random();
+        for (size_t i = 0; i < Count; ++i)
+        {
+            switch (Kind)
+            {
+            case kSorted:       Keys[i] = i * 0x9E3779B97F4A7C15ull / (Count + 1); break;
+            case kReversed:     Keys[i] = (Count - i) * 0x10001ull; break;
+            case kAllEqual:     Keys[i] = Equal; break;
+            case kRandom:       Keys[i] = Random(); break;
+            case kLowBits:      Keys[i] = Random() & 0xFFF; break;
+            // A handful of PSOs in the top byte, a depth in the middle and the mesh index at the bottom
+            case kDrawPackets:  Keys[i] = ((Random() % 5) << 56) | ((Random() & 0xFFFFFF) << 16) | (i & 0xFFFF); break;
+            default:            break;
+            }
+        }
+        if (Kind == kSorted)
+            std::sort(Keys.begin(), Keys.end());
+        return Keys;
+    }
+
+    void TestSort( KeyKind Kind, size_t Count, std::mt19937_64& Random )
+    {
+        std::vector<uint64_t> Keys = MakeKeys(Kind, Count, Random);
+        std::vector<uint64_t> Expected = Keys;
+        std::sort(Expected.begin(), Expected.end());
+
+        std::vector<uint64_t> Scratch(Count);
+        RadixSort64(Keys.data(), Scratch.data(), Count);
+
+        Check(Keys == Expected, "matches std::sort", s_KeyKindNames[Kind], Count);
+    }
+
+    void TestSorts( void )
+    {
+        std::mt19937_64 Random(2024);
+        const size_t Counts[] = { 0, 1, 2, 3, 17, 255, 256, 257, 1000, 4096, 65537, 300000 };
+
+        uint32_t Sorts = 0;
+        for (int Kind = 0; Kind < kKeyKindCount; ++Kind)
+        {
+            for (size_t Count : Counts)
+            {
+                for (int Round = 0; Round < (Count < 1000 ? 20 : 2); ++Round)
+                {
+                    TestSort((KeyKind)Kind, Count, Random);
+                    ++Sorts;
+                }
+            }
+        }
+
+        // A one-key "array" with no scratch at all must be left alone
+        uint64_t Single = 42;
+        RadixSort64(&Single, nullptr, 1);
+        RadixSort64(nullptr, nullptr, 0);
+        Check(Single == 42, "one key is left alone", "single", 1);
+
+        printf("sorts: %u checked, %s\n", Sorts, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    // Returns the best time of a few runs in milliseconds
+    template <typename SortFunction>
+    double TimeSort( const std::vector<uint64_t>& Unsorted, SortFunction Sort )
+    {
+        double Best = 1e30;
+        std::vector<uint64_t> Keys;
+        for (int Run = 0; Run < 5; ++Run)
+        {
+            Keys = Unsorted;
+            const auto Start = std::chrono::steady_clock::now();
+            Sort(Keys);
+            Best = std::min(Best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count());
+        }
+        return Best;
+    }
+
+    void Benchmark( KeyKind Kind, size_t Count )
+    {
+        std::mt19937_64 Random(99);
+        const std::vector<uint64_t> Unsorted = MakeKeys(Kind, Count, Random);
+        std::vector<uint64_t> Scratch(Count);
+
+        const double StdSortTime = TimeSort(Unsorted, []( std::vector<uint64_t>& Keys )
+        {
+            std::sort(Keys.begin(), Keys.end());
+        });
+        const double RadixTime = TimeSort(Unsorted, [&Scratch]( std::vector<uint64_t>& Keys )
+        {
+            RadixSort64(Keys.data(), Scratch.data(), Keys.size());
+        });
+
+        printf("%-11s %8zu keys: std::sort %8.3f ms, RadixSort64 %8.3f ms (%.1fx)\n", s_KeyKindNames[Kind], Count,
+            StdSortTime, RadixTime, StdSortTime / RadixTime);
+    }
+}
+
+int main( void )
+{
+    TestSorts();
+
+    const size_t Counts[] = { 1000, 10000, 100000, 1000000 };
+    for (size_t Count : Counts)
+        Benchmark(kDrawPackets, Count);
+    for (size_t Count : Counts)
+        Benchmark(kRandom, Count);
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
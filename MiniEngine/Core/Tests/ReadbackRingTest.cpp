@@ -0,0 +1,150 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Drives ReadbackRing the way GpuTimeManager does, once per frame, against a simulated fence that
+// completes at a random pace and sometimes stalls.  Each copy is "landed" into its slot only when its
+// fence completes, and the test checks that:
+//
+//     a slot is never given to the GPU while a copy into it is in flight or while the CPU reads it
+//     the CPU only reads landed copies, always the newest, and never goes back in time
+//     frames are only dropped while every other slot is in flight, and reading resumes after a stall
+//
+// Builds on its own, for example:
+//
+//     g++ -std=c++14 -O2 -I.. ReadbackRingTest.cpp -o ReadbackRingTest
+//
+
+#include "ReadbackRing.h"
+#include <cstdio>
+#include <random>
+
+namespace
+{
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What, uint32_t Frame )
+    {
+        if (!Passed && s_Failures++ < 10)
+            printf("FAILED at frame %u: %s\n", Frame, What);
+    }
+
+    template <uint32_t NumSlots>
+    void Simulate( uint32_t Frames, uint32_t Seed )
+    {
+        std::mt19937 Random(Seed);
+        ReadbackRing<NumSlots> Ring;
+
+        uint64_t CompletedFence = 0;
+        uint64_t NextFence = 1;
+        auto IsComplete = [&]( uint64_t Fence ) { return Fence <= CompletedFence; };
+
+        // What each slot holds once its copy lands, and the copy still in flight
+        uint32_t Landed[NumSlots] = {};
+        uint64_t InFlightFence[NumSlots] = {};
+        uint32_t InFlightFrame[NumSlots] = {};
+
+        uint32_t LastRead = 0;
+        uint32_t Reads = 0, Drops = 0, StallFrames = 0;
+
+        for (uint32_t Frame = 1; Frame <= Frames; ++Frame)
+        {
+            // The GPU usually runs a frame or two behind, and stalls outright once in a while
+            if (StallFrames > 0)
+                --StallFrames;
+            else if (Random() % 500 == 0)
+                StallFrames = 1 + Random() % 20;
+            else
+            {
+                const uint64_t Lag = 1 + Random() % 3;
+                if (NextFence > Lag && NextFence - Lag > CompletedFence)
+                    CompletedFence = NextFence - Lag;
+            }
+
+            for (uint32_t i = 0; i < NumSlots; ++i)
+            {
+                if (InFlightFence[i] != 0 && IsComplete(InFlightFence[i]))
+                {
+                    Landed[i] = InFlightFrame[i];
+                    InFlightFence[i] = 0;
+                }
+            }
+
+            const uint32_t ReadSlot = Ring.AcquireRead(IsComplete);
+            Check(ReadSlot == Ring.GetReadSlot(), "GetReadSlot matches AcquireRead", Frame);
+            if (ReadSlot != Ring.kNoSlot)
+            {
+                Check(InFlightFence[ReadSlot] == 0, "read slot has landed", Frame);
+                Check(Landed[ReadSlot] >= LastRead, "reads never go back in time", Frame);
+                for (uint32_t i = 0; i < NumSlots; ++i)
+                    Check(InFlightFence[i] != 0 || Landed[i] <= Landed[ReadSlot], "read slot is the newest landed", Frame);
+                LastRead = Landed[ReadSlot];
+                ++Reads;
+            }
+            else
+            {
+                for (uint32_t i = 0; i < NumSlots; ++i)
+                    Check(Landed[i] == 0, "nothing to read only before the first copy lands", Frame);
+            }
+
+            const uint32_t WriteSlot = Ring.AcquireWrite(IsComplete);
+            if (WriteSlot != Ring.kNoSlot)
+            {
+                Check(WriteSlot != ReadSlot, "the GPU never writes the slot being read", Frame);
+                Check(InFlightFence[WriteSlot] == 0, "the GPU never writes a slot in flight", Frame);
+                InFlightFence[WriteSlot] = NextFence;
+                InFlightFrame[WriteSlot] = Frame;
+                Ring.Submit(WriteSlot, NextFence);
+            }
+            else
+            {
+                uint32_t Busy = 0;
+                for (uint32_t i = 0; i < NumSlots; ++i)
+                    Busy += InFlightFence[i] != 0 || i == ReadSlot;
+                Check(Busy == NumSlots, "frames are only dropped when every slot is busy", Frame);
+                ++Drops;
+            }
+
+            // Every frame signals a fence, whether or not it copied anything
+            ++NextFence;
+        }
+
+        // Once the GPU catches up, the last copy is read
+        CompletedFence = NextFence - 1;
+        const uint32_t ReadSlot = Ring.AcquireRead(IsComplete);
+        for (uint32_t i = 0; i < NumSlots; ++i)
+        {
+            if (InFlightFence[i] != 0)
+                Landed[i] = InFlightFrame[i];
+        }
+        uint32_t Newest = 0;
+        for (uint32_t i = 0; i < NumSlots; ++i)
+            Newest = Landed[i] > Newest ? Landed[i] : Newest;
+        Check(ReadSlot != Ring.kNoSlot && Landed[ReadSlot] == Newest, "the last copy is read after a stall", Frames);
+
+        // Reset forgets every slot
+        Ring.Reset();
+        Check(Ring.AcquireRead(IsComplete) == Ring.kNoSlot, "nothing to read after a reset", Frames);
+
+        printf("%u slots, seed %u: %u frames, %u read, %u dropped\n", NumSlots, Seed, Frames, Reads, Drops);
+    }
+}
+
+int main( void )
+{
+    for (uint32_t Seed = 1; Seed <= 4; ++Seed)
+    {
+        Simulate<2>(200000, Seed);
+        Simulate<3>(200000, Seed);
+        Simulate<4>(200000, Seed);
+    }
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
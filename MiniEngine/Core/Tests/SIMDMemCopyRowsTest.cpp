@@ -0,0 +1,245 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks SIMDMemCopyRows on rows of every size up to a few quadwords and some larger ones, from sources at
+// every alignment with odd pitches, into padded destination rows.  Each source is allocated to end exactly
+// where its last row does, so a build with -fsanitize=address catches any read past it.  Every row must
+// match, the rest of its last quadword must be zero, and nothing past that may be written.
+//
+// Then times copying a texture's worth of rows, from a source 148 bytes into a buffer as DDS texels are,
+// the way TextureStreamer stages them:
+//
+//     memcpy:    a memcpy per row, as MemcpySubresource does
+//     rows:      SIMDMemCopyRows over the whole texture
+//     parallel:  SIMDMemCopyRows in jobs of about 1 MB on every core, as CopyToStaging does
+//
+// The destination here is ordinary memory rather than write-combined upload memory.  Builds on its own,
+// for example:
+//
+//     g++ -std=c++14 -O2 -I.. SIMDMemCopyRowsTest.cpp ../SIMDMemCopyRows.cpp -o SIMDMemCopyRowsTest -pthread
+//
+
+#include "SIMDMemCopyRows.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint8_t kUntouched = 0xCD;
+    const size_t kGuardBytes = 64;
+
+    int s_Failures = 0;
+
+    void Check( bool Passed, const char* What, size_t RowSize, size_t NumRows, size_t Misalignment, size_t SourcePitch )
+    {
+        if (!Passed && s_Failures++ < 10)
+        {
+            printf("FAILED: %s (row size %zu, %zu rows, source +%zu, source pitch %zu)\n", What, RowSize, NumRows,
+                Misalignment, SourcePitch);
+        }
+    }
+
+    size_t AlignUp16( size_t Value )
+    {
+        return (Value + 15) & ~(size_t)15;
+    }
+
+    // 16-byte aligned storage in a vector, which ASan still checks
+    uint8_t* Aligned( std::vector<uint8_t>& Storage, size_t Size )
+    {
+        Storage.assign(Size + 15, kUntouched);
+        return Storage.data() + (AlignUp16((size_t)Storage.data()) - (size_t)Storage.data());
+    }
+
+    void TestCopy( size_t RowSize, size_t NumRows, size_t Misalignment, size_t SourcePitch, size_t DestPitch )
+    {
+        // Allocated to end with the last row
+        const size_t SourceSize = Misalignment + (NumRows - 1) * SourcePitch + RowSize;
+        std::vector<uint8_t> SourceStorage(SourceSize);
+        for (size_t i = 0; i < SourceSize; ++i)
+            SourceStorage[i] = (uint8_t)(i * 31 + RowSize);
+        const uint8_t* Source = SourceStorage.data() + Misalignment;
+
+        std::vector<uint8_t> DestStorage;
+        const size_t DestSize = (NumRows - 1) * DestPitch + AlignUp16(RowSize) + kGuardBytes;
+        uint8_t* Dest = Aligned(DestStorage, DestSize);
+
+        SIMDMemCopyRows(Dest, DestPitch, Source, SourcePitch, RowSize, NumRows);
+
+        bool RowsMatch = true, PaddingZeroed = true, RestUntouched = true;
+        for (size_t Row = 0; Row < NumRows; ++Row)
+        {
+            const uint8_t* DestRow = Dest + Row * DestPitch;
+            RowsMatch &= RowSize == 0 || memcmp(DestRow, Source + Row * SourcePitch, RowSize) == 0;
+
+            for (size_t i = RowSize; i < AlignUp16(RowSize); ++i)
+                PaddingZeroed &= DestRow[i] == 0;
+
+            const size_t RestEnd = Row + 1 < NumRows ? DestPitch : AlignUp16(RowSize) + kGuardBytes;
+            for (size_t i = AlignUp16(RowSize); i < RestEnd; ++i)
+                RestUntouched &= DestRow[i] == kUntouched;
+        }
+
+        Check(RowsMatch, "rows match", RowSize, NumRows, Misalignment, SourcePitch);
+        Check(PaddingZeroed, "the rest of the last quadword is zero", RowSize, NumRows, Misalignment, SourcePitch);
+        Check(RestUntouched, "nothing past the last quadword is written", RowSize, NumRows, Misalignment, SourcePitch);
+    }
+
+    void TestCopies( void )
+    {
+        std::vector<size_t> RowSizes;
+        for (size_t RowSize = 0; RowSize <= 80; ++RowSize)
+            RowSizes.push_back(RowSize);
+        const size_t LargeRowSizes[] = { 127, 128, 129, 255, 256, 257, 1000, 1024, 4099, 8192 };
+        RowSizes.insert(RowSizes.end(), std::begin(LargeRowSizes), std::end(LargeRowSizes));
+
+        const size_t RowCounts[] = { 1, 2, 3, 7 };
+        const size_t SourcePitchExtras[] = { 0, 1, 5, 16, 33 };
+        const size_t DestPitchExtras[] = { 0, 16, 48 };
+
+        uint32_t Copies = 0;
+        for (size_t RowSize : RowSizes)
+        {
+            for (size_t NumRows : RowCounts)
+            {
+                for (size_t Misalignment = 0; Misalignment < 16; ++Misalignment)
+                {
+                    for (size_t SourceExtra : SourcePitchExtras)
+                    {
+                        for (size_t DestExtra : DestPitchExtras)
+                        {
+                            TestCopy(RowSize, NumRows, Misalignment, RowSize + SourceExtra, AlignUp16(RowSize) + DestExtra);
+                            ++Copies;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Tightly packed rows are copied as one, which may end in a partial quadword
+        for (size_t RowSize = 16; RowSize <= 256; RowSize += 16)
+        {
+            for (size_t Misalignment = 0; Misalignment < 16; ++Misalignment)
+            {
+                TestCopy(RowSize, 5, Misalignment, RowSize, RowSize);
+                ++Copies;
+            }
+        }
+        for (size_t RowSize = 1; RowSize <= 40; ++RowSize)
+        {
+            TestCopy(RowSize, 1, 3, RowSize, RowSize);
+            ++Copies;
+        }
+
+        printf("copies: %u checked, %s\n", Copies, s_Failures == 0 ? "passed" : "FAILED");
+    }
+
+    struct RowRun
+    {
+        size_t FirstRow;
+        size_t NumRows;
+    };
+
+    // Returns the rate in MB/s, the best of a few runs
+    template <typename CopyFunction>
+    double TimeCopy( CopyFunction Copy, size_t Bytes )
+    {
+        double Best = 0.0;
+        for (int Run = 0; Run < 5; ++Run)
+        {
+            const auto Start = std::chrono::steady_clock::now();
+            Copy();
+            const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+            Best = std::max(Best, Bytes / Seconds / (1024.0 * 1024.0));
+        }
+        return Best;
+    }
+
+    // A BC7 texture of the given width, square, is a row of 4x4 blocks per four texel rows
+    void BenchmarkTexture( size_t Width )
+    {
+        const size_t RowSize = Width / 4 * 16;
+        const size_t NumRows = Width / 4;
+        const size_t DestPitch = std::max<size_t>(RowSize, 256);
+        const size_t Bytes = RowSize * NumRows;
+
+        std::vector<uint8_t> SourceStorage(148 + Bytes);
+        for (size_t i = 0; i < SourceStorage.size(); ++i)
+            SourceStorage[i] = (uint8_t)i;
+        const uint8_t* Source = SourceStorage.data() + 148;
+
+        std::vector<uint8_t> DestStorage;
+        uint8_t* Dest = Aligned(DestStorage, DestPitch * NumRows);
+
+        const double MemcpyRate = TimeCopy([&]
+        {
+            for (size_t Row = 0; Row < NumRows; ++Row)
+                memcpy(Dest + Row * DestPitch, Source + Row * RowSize, RowSize);
+        }, Bytes);
+
+        const double RowsRate = TimeCopy([&]
+        {
+            SIMDMemCopyRows(Dest, DestPitch, Source, RowSize, RowSize, NumRows);
+        }, Bytes);
+
+        std::vector<RowRun> Jobs;
+        const size_t RowsPerJob = std::max<size_t>(1, (1024 * 1024) / DestPitch);
+        for (size_t Row = 0; Row < NumRows; Row += RowsPerJob)
+            Jobs.push_back({ Row, std::min(RowsPerJob, NumRows - Row) });
+
+        const uint32_t NumThreads = std::max(1u, std::thread::hardware_concurrency());
+        const double ParallelRate = TimeCopy([&]
+        {
+            std::atomic<size_t> NextJob(0);
+            auto Worker = [&]
+            {
+                for (size_t Job = NextJob++; Job < Jobs.size(); Job = NextJob++)
+                {
+                    SIMDMemCopyRows(Dest + Jobs[Job].FirstRow * DestPitch, DestPitch, Source + Jobs[Job].FirstRow * RowSize,
+                        RowSize, RowSize, Jobs[Job].NumRows);
+                }
+            };
+
+            std::vector<std::thread> Threads;
+            for (uint32_t i = 1; i < NumThreads; ++i)
+                Threads.emplace_back(Worker);
+            Worker();
+            for (std::thread& Thread : Threads)
+                Thread.join();
+        }, Bytes);
+
+        bool Matches = true;
+        for (size_t Row = 0; Row < NumRows; ++Row)
+            Matches &= memcmp(Dest + Row * DestPitch, Source + Row * RowSize, RowSize) == 0;
+        Check(Matches, "benchmark copy matches", RowSize, NumRows, 148, RowSize);
+
+        printf("BC7 %4zux%-4zu %6.1f MB: memcpy %6.0f MB/s, rows %6.0f MB/s, parallel on %u threads %6.0f MB/s\n",
+            Width, Width, Bytes / (1024.0 * 1024.0), MemcpyRate, RowsRate, NumThreads, ParallelRate);
+    }
+}
+
+int main( void )
+{
+    TestCopies();
+
+    BenchmarkTexture(256);
+    BenchmarkTexture(1024);
+    BenchmarkTexture(4096);
+    BenchmarkTexture(8192);
+
+    printf("%s\n", s_Failures == 0 ? "passed" : "FAILED");
+    return s_Failures == 0 ? 0 : 1;
+}
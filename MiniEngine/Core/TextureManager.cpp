@@ -18,6 +18,7 @@
 #include "DDSTextureLoader.h"
 #include "GraphicsCore.h"
 #include "CommandContext.h"
+#include "TextureStreamer.h"
 #include <map>
 #include <thread>
 
@@ -29,6 +30,17 @@ static UINT BytesPerPixel( DXGI_FORMAT Format )
     return (UINT)BitsPerPixel(Format) / 8;
 };
 
+void Texture::Destroy( void )
+{
+    GpuResource::Destroy();
+
+    if (m_hCpuDescriptorHandle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_hCpuDescriptorHandle);
+        m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+    }
+}
+
 void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
 {
     m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
@@ -238,7 +250,7 @@ namespace TextureManager
 
 } // namespace TextureManager
 
-void ManagedTexture::WaitForLoad( void ) const
+void ManagedTexture::WaitForDescriptor( void ) const
 {
     volatile D3D12_CPU_DESCRIPTOR_HANDLE& VolHandle = (volatile D3D12_CPU_DESCRIPTOR_HANDLE&)m_hCpuDescriptorHandle;
     volatile bool& VolValid = (volatile bool&)m_IsValid;
@@ -246,12 +258,84 @@ void ManagedTexture::WaitForLoad( void ) const
         this_thread::yield();
 }
 
+void ManagedTexture::WaitForLoad( void ) const
+{
+    WaitForDescriptor();
+
+    while (m_IsLoading)
+        TextureStreamer::Finish();
+}
+
+void ManagedTexture::Destroy( void )
+{
+    if (m_BorrowsDescriptor)
+        m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+
+    Texture::Destroy();
+}
+
 void ManagedTexture::SetToInvalidTexture( void )
 {
+    // A failed load may have allocated a descriptor already
+    if (!m_BorrowsDescriptor && m_hCpuDescriptorHandle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_hCpuDescriptorHandle);
+
     m_hCpuDescriptorHandle = TextureManager::GetMagentaTex2D().GetSRV();
+    m_BorrowsDescriptor = true;
     m_IsValid = false;
 }
 
+void ManagedTexture::StreamDDSFromFile( const wstring& FilePath, bool sRGB )
+{
+    m_IsLoading = true;
+
+    // Whoever already holds the view sees the new texture once it lands, so the descriptor never changes
+    D3D12_CPU_DESCRIPTOR_HANDLE Placeholder = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    g_Device->CopyDescriptorsSimple(1, Placeholder, TextureManager::GetBlackTex2D().GetSRV(),
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_hCpuDescriptorHandle = Placeholder;
+
+    TextureStreamer::Decode( [this, FilePath, sRGB]
+    {
+        Utility::ByteSpan File = Utility::ReadFileSpan(FilePath);
+
+        D3D12_CPU_DESCRIPTOR_HANDLE View = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        ID3D12Resource* Resource = nullptr;
+        vector<D3D12_SUBRESOURCE_DATA> InitData;
+
+        if (File.Size == 0 || FAILED(CreateDDSTextureFromMemoryDeferred(g_Device, File.Data, File.Size, 0, sRGB,
+            &Resource, View, InitData)))
+        {
+            if (Resource != nullptr)
+                Resource->Release();
+            FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, View);
+
+            TextureStreamer::Notify( [this, FilePath]
+            {
+                Utility::Printf(L"Failed to load texture %s\n", FilePath.c_str());
+                g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, TextureManager::GetMagentaTex2D().GetSRV(),
+                    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+                m_IsValid = false;
+                m_IsLoading = false;
+            } );
+            return;
+        }
+
+        Resource->SetName(m_MapKey.c_str());
+
+        // The copy queue leaves the texture in the common state, which is promoted to a shader resource on use
+        TextureStreamer::Upload(Resource, (UINT)InitData.size(), InitData.data(), [this, Resource, View]
+        {
+            g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, View, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+            FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, View);
+
+            m_pResource.Attach(Resource);
+            m_UsageState = D3D12_RESOURCE_STATE_COMMON;
+            m_IsLoading = false;
+        } );
+    } );
+}
+
 const ManagedTexture* TextureManager::LoadFromFile( const std::wstring& fileName, bool sRGB )
 {
     std::wstring CatPath = fileName;
@@ -270,17 +354,19 @@ const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileN
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
 
+    // Returns as soon as the placeholder is ready.  Use WaitForLoad() to wait for the texels.
     if (!RequestsLoad)
     {
-        ManTex->WaitForLoad();
+        ManTex->WaitForDescriptor();
         return ManTex;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() == 0 || !ManTex->CreateDDSFromMemory( ba->data(), ba->size(), sRGB ))
-        ManTex->SetToInvalidTexture();
+    // Whether the file exists is needed now, so that callers can fall back to other textures
+    const wstring FilePath = s_RootPath + fileName;
+    if (Utility::FileExists(FilePath))
+        ManTex->StreamDDSFromFile(FilePath, sRGB);
     else
-        ManTex->GetResource()->SetName(fileName.c_str());
+        ManTex->SetToInvalidTexture();
 
     return ManTex;
 }
@@ -298,10 +384,10 @@ const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileN
         return ManTex;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
+    Utility::ByteSpan File = Utility::ReadFileSpan( s_RootPath + fileName );
+    if (File.Size > 0)
     {
-        ManTex->CreateTGAFromMemory( ba->data(), ba->size(), sRGB );
+        ManTex->CreateTGAFromMemory( File.Data, File.Size, sRGB );
         ManTex->GetResource()->SetName(fileName.c_str());
     }
     else
@@ -324,10 +410,10 @@ const ManagedTexture* TextureManager::LoadPIXImageFromFile( const std::wstring&
         return ManTex;
     }
 
-    Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
+    Utility::ByteSpan File = Utility::ReadFileSpan( s_RootPath + fileName );
+    if (File.Size > 0)
     {
-        ManTex->CreatePIXImageFromMemory(ba->data(), ba->size());
+        ManTex->CreatePIXImageFromMemory(File.Data, File.Size);
         ManTex->GetResource()->SetName(fileName.c_str());
     }
     else
@@ -17,6 +17,7 @@
 #include "pch.h"
 #include "GpuResource.h"
 #include "Utility.h"
+#include <atomic>
 
 class Texture : public GpuResource
 {
@@ -38,15 +39,11 @@ public:
     bool CreateDDSFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     void CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize );
 
-    virtual void Destroy() override
-    {
-        GpuResource::Destroy();
-        m_hCpuDescriptorHandle.ptr = 0;
-    }
+    virtual void Destroy() override;
 
     const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_hCpuDescriptorHandle; }
 
-    bool operator!() { return m_hCpuDescriptorHandle.ptr == 0; }
+    bool operator!() { return m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
 
 protected:
 
@@ -56,10 +53,21 @@ protected:
 class ManagedTexture : public Texture
 {
 public:
-    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true) {}
+    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true), m_BorrowsDescriptor(false),
+        m_IsLoading(false) {}
 
     void operator= ( const Texture& Texture );
 
+    virtual void Destroy() override;
+
+    // Reads and uploads the file in the background.  The view shows black until the texture lands and
+    // magenta if it can't be decoded.
+    void StreamDDSFromFile( const std::wstring& FilePath, bool sRGB );
+
+    // Blocks until another thread's load has a view to hand out, which may still be the placeholder
+    void WaitForDescriptor(void) const;
+
+    // Blocks until the texels have landed, not just the placeholder
     void WaitForLoad(void) const;
     void Unload(void);
 
@@ -69,6 +77,8 @@ public:
 private:
     std::wstring m_MapKey;		// For deleting from the map later
     bool m_IsValid;
+    bool m_BorrowsDescriptor;	// The magenta texture's
+    std::atomic<bool> m_IsLoading;
 };
 
 namespace TextureManager
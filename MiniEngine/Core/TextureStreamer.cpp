@@ -0,0 +1,531 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "GraphicsCore.h"
+#include "CommandListManager.h"
+#include "SystemTime.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <ppl.h>
+
+using namespace Graphics;
+
+namespace
+{
+    // Staging memory is suballocated from pages this large.  Larger textures get a page of their own.
+    const size_t kStagingPageSize = 32 * 1024 * 1024;
+
+    // Copies are submitted without waiting for the next frame once this much is queued
+    const size_t kMaxBatchSize = 64 * 1024 * 1024;
+
+    // Larger textures are copied to staging memory in jobs of about this size, on every core
+    const size_t kCopyJobSize = 1024 * 1024;
+
+    struct StagingPage
+    {
+        ID3D12Resource* Buffer;
+        uint8_t* CpuAddress;
+        size_t Size;
+        size_t Offset;
+        uint32_t UnsubmittedCopies;     // reserved space not yet copied from by a submitted batch
+        uint64_t Fence;                 // of the last batch that copied from the page
+    };
+
+    // With no Dest, only OnLanded
+    struct TextureCopy
+    {
+        ID3D12Resource* Dest;
+        StagingPage* Page;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Layouts;
+        std::function<void()> OnLanded;
+    };
+
+    struct Batch
+    {
+        uint64_t Fence;
+        uint32_t Uploads;               // callbacks that land a texture, rather than report a failed load
+        std::vector<std::function<void()> > Callbacks;
+    };
+
+    std::mutex s_Mutex;
+    StagingPage* s_CurrentPage = nullptr;
+    std::vector<StagingPage*> s_FullPages;
+    std::vector<TextureCopy> s_QueuedCopies;
+    size_t s_QueuedBytes = 0;
+    std::queue<Batch> s_Batches;
+    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*> > s_RetiredAllocators;
+    ID3D12GraphicsCommandList* s_CommandList = nullptr;
+    std::atomic<uint32_t> s_DecodesInFlight(0);
+
+    // From the first texture requested while idle until everything has landed
+    int64_t s_BurstStartTick = 0;
+    uint32_t s_BurstTextures = 0;
+    uint64_t s_BurstBytes = 0;
+
+    std::atomic<uint64_t> s_TexturesStreamed(0);
+    std::atomic<uint64_t> s_BatchesSubmitted(0);
+    std::atomic<uint64_t> s_KilobytesStaged(0);
+
+    bool RegisterCounters( void )
+    {
+        EngineProfiling::RegisterCounter("Textures Streamed", s_TexturesStreamed);
+        EngineProfiling::RegisterCounter("Texture Upload Batches", s_BatchesSubmitted);
+        EngineProfiling::RegisterCounter("Texture KB Staged", s_KilobytesStaged);
+        return true;
+    }
+
+    const bool s_CountersRegistered = RegisterCounters();
+
+    StagingPage* CreatePage( size_t Size )
+    {
+        D3D12_HEAP_PROPERTIES HeapProps;
+        HeapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+        HeapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        HeapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        HeapProps.CreationNodeMask = 1;
+        HeapProps.VisibleNodeMask = 1;
+
+        D3D12_RESOURCE_DESC BufferDesc;
+        BufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+        BufferDesc.Alignment = 0;
+        BufferDesc.Width = Size;
+        BufferDesc.Height = 1;
+        BufferDesc.DepthOrArraySize = 1;
+        BufferDesc.MipLevels = 1;
+        BufferDesc.Format = DXGI_FORMAT_UNKNOWN;
+        BufferDesc.SampleDesc.Count = 1;
+        BufferDesc.SampleDesc.Quality = 0;
+        BufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+        BufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+        StagingPage* Page = new StagingPage();
+        ASSERT_SUCCEEDED(g_Device->CreateCommittedResource(&HeapProps, D3D12_HEAP_FLAG_NONE, &BufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, MY_IID_PPV_ARGS(&Page->Buffer)));
+        Page->Buffer->SetName(L"Texture Staging Page");
+        Page->Buffer->Map(0, nullptr, (void**)&Page->CpuAddress);
+        Page->Size = Size;
+        return Page;
+    }
+
+    void DestroyPage( StagingPage* Page )
+    {
+        Page->Buffer->Unmap(0, nullptr);
+        Page->Buffer->Release();
+        delete Page;
+    }
+
+    struct RowCopy
+    {
+        uint8_t* Dest;
+        const uint8_t* Source;
+        size_t DestPitch;
+        size_t SourcePitch;
+        size_t RowSize;
+        size_t NumRows;
+    };
+
+    void CopyToStaging( uint8_t* PageAddress, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT Layouts[], const UINT NumRows[],
+        const UINT64 RowSizes[], const D3D12_SUBRESOURCE_DATA SubData[], UINT NumSubresources )
+    {
+        // Every slice of every subresource, with large ones cut into runs of rows no bigger than a job
+        std::vector<RowCopy> Copies;
+        for (UINT i = 0; i < NumSubresources; ++i)
+        {
+            const D3D12_SUBRESOURCE_FOOTPRINT& Footprint = Layouts[i].Footprint;
+            const UINT RowsPerCopy = (UINT)std::max<size_t>(1, kCopyJobSize / Footprint.RowPitch);
+
+            for (UINT Slice = 0; Slice < Footprint.Depth; ++Slice)
+            {
+                for (UINT Row = 0; Row < NumRows[i]; Row += RowsPerCopy)
+                {
+                    RowCopy Copy;
+                    Copy.Dest = PageAddress + Layouts[i].Offset + ((size_t)Slice * NumRows[i] + Row) * Footprint.RowPitch;
+                    Copy.Source = (const uint8_t*)SubData[i].pData + Slice * SubData[i].SlicePitch + Row * SubData[i].RowPitch;
+                    Copy.DestPitch = Footprint.RowPitch;
+                    Copy.SourcePitch = (size_t)SubData[i].RowPitch;
+                    Copy.RowSize = (size_t)RowSizes[i];
+                    Copy.NumRows = std::min(RowsPerCopy, NumRows[i] - Row);
+                    Copies.push_back(Copy);
+                }
+            }
+        }
+
+        // Consecutive small copies, such as the mip tail of each array slice, share a job
+        std::vector<size_t> JobStarts(1, 0);
+        size_t JobSize = 0;
+        for (size_t i = 0; i < Copies.size(); ++i)
+        {
+            const size_t CopySize = Copies[i].DestPitch * Copies[i].NumRows;
+            if (JobSize > 0 && JobSize + CopySize > kCopyJobSize)
+            {
+                JobStarts.push_back(i);
+                JobSize = 0;
+            }
+            JobSize += CopySize;
+        }
+        JobStarts.push_back(Copies.size());
+
+        auto RunJob = [&]( size_t Job )
+        {
+            for (size_t i = JobStarts[Job]; i < JobStarts[Job + 1]; ++i)
+            {
+                const RowCopy& Copy = Copies[i];
+                SIMDMemCopyRows(Copy.Dest, Copy.DestPitch, Copy.Source, Copy.SourcePitch, Copy.RowSize, Copy.NumRows);
+            }
+        };
+
+        const size_t NumJobs = JobStarts.size() - 1;
+        if (NumJobs == 1)
+            RunJob(0);
+        else
+            concurrency::parallel_for(size_t(0), NumJobs, RunJob);
+    }
+
+    bool IsPageIdle( const StagingPage& Page )
+    {
+        return Page.UnsubmittedCopies == 0 && (Page.Fence == 0 || g_CommandManager.IsFenceComplete(Page.Fence));
+    }
+
+    // Must hold s_Mutex
+    StagingPage* ReserveStagingMemory( size_t Size, size_t& Offset )
+    {
+        if (s_CurrentPage != nullptr)
+        {
+            Offset = Math::AlignUp(s_CurrentPage->Offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            if (Offset + Size <= s_CurrentPage->Size)
+            {
+                s_CurrentPage->Offset = Offset + Size;
+                s_CurrentPage->UnsubmittedCopies++;
+                return s_CurrentPage;
+            }
+
+            s_FullPages.push_back(s_CurrentPage);
+            s_CurrentPage = nullptr;
+        }
+
+        // Recycle full pages whose copies have all landed, and release oversized ones
+        StagingPage* Page = nullptr;
+        for (size_t i = 0; i < s_FullPages.size(); )
+        {
+            StagingPage* FullPage = s_FullPages[i];
+            if (!IsPageIdle(*FullPage) || (Page != nullptr && FullPage->Size == kStagingPageSize))
+            {
+                ++i;
+                continue;
+            }
+
+            s_FullPages[i] = s_FullPages.back();
+            s_FullPages.pop_back();
+
+            if (FullPage->Size == kStagingPageSize)
+                Page = FullPage;
+            else
+                DestroyPage(FullPage);
+        }
+
+        if (Size > kStagingPageSize)
+        {
+            // Full from the start, so it's released once its copy lands
+            if (Page != nullptr)
+                s_FullPages.push_back(Page);
+            Page = CreatePage(Size);
+            s_FullPages.push_back(Page);
+        }
+        else
+        {
+            if (Page == nullptr)
+                Page = CreatePage(kStagingPageSize);
+            s_CurrentPage = Page;
+        }
+
+        Offset = 0;
+        Page->Offset = Size;
+        Page->UnsubmittedCopies = 1;
+        return Page;
+    }
+
+    // Must hold s_Mutex
+    uint64_t RecordAndExecute( void )
+    {
+        ID3D12CommandAllocator* Allocator = nullptr;
+        if (!s_RetiredAllocators.empty() && g_CommandManager.IsFenceComplete(s_RetiredAllocators.front().first))
+        {
+            Allocator = s_RetiredAllocators.front().second;
+            s_RetiredAllocators.pop();
+            ASSERT_SUCCEEDED(Allocator->Reset());
+        }
+        else
+        {
+            ASSERT_SUCCEEDED(g_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, MY_IID_PPV_ARGS(&Allocator)));
+            Allocator->SetName(L"Texture Streamer Allocator");
+        }
+
+        if (s_CommandList == nullptr)
+        {
+            ASSERT_SUCCEEDED(g_Device->CreateCommandList(1, D3D12_COMMAND_LIST_TYPE_COPY, Allocator, nullptr,
+                MY_IID_PPV_ARGS(&s_CommandList)));
+            s_CommandList->SetName(L"Texture Streamer");
+        }
+        else
+        {
+            ASSERT_SUCCEEDED(s_CommandList->Reset(Allocator, nullptr));
+        }
+
+        for (const TextureCopy& Copy : s_QueuedCopies)
+        {
+            if (Copy.Dest == nullptr)
+                continue;
+
+            for (UINT i = 0; i < (UINT)Copy.Layouts.size(); ++i)
+            {
+                D3D12_TEXTURE_COPY_LOCATION Dest = { Copy.Dest, D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
+                Dest.SubresourceIndex = i;
+
+                D3D12_TEXTURE_COPY_LOCATION Source = { Copy.Page->Buffer, D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT };
+                Source.PlacedFootprint = Copy.Layouts[i];
+
+                s_CommandList->CopyTextureRegion(&Dest, 0, 0, 0, &Source, nullptr);
+            }
+        }
+
+        ASSERT_SUCCEEDED(s_CommandList->Close());
+
+        // Another thread may also submit to the copy queue, but the fence is signaled after this list either way
+        CommandQueue& Queue = g_CommandManager.GetCopyQueue();
+        ID3D12CommandList* Lists[] = { s_CommandList };
+        Queue.GetCommandQueue()->ExecuteCommandLists(1, Lists);
+        const uint64_t Fence = Queue.IncrementFence();
+
+        s_RetiredAllocators.push(std::make_pair(Fence, Allocator));
+        ++s_BatchesSubmitted;
+        return Fence;
+    }
+
+    // Must hold s_Mutex
+    void SubmitQueuedCopies( void )
+    {
+        if (s_QueuedCopies.empty())
+            return;
+
+        Batch NewBatch;
+        NewBatch.Uploads = 0;
+        for (const TextureCopy& Copy : s_QueuedCopies)
+            NewBatch.Uploads += Copy.Dest != nullptr;
+
+        // A batch of only failed loads records nothing, and lands once the batches ahead of it have
+        if (NewBatch.Uploads > 0)
+            NewBatch.Fence = RecordAndExecute();
+        else
+            NewBatch.Fence = s_Batches.empty() ? 0 : s_Batches.back().Fence;
+
+        for (TextureCopy& Copy : s_QueuedCopies)
+        {
+            if (Copy.Page != nullptr)
+            {
+                Copy.Page->UnsubmittedCopies--;
+                Copy.Page->Fence = NewBatch.Fence;
+            }
+            NewBatch.Callbacks.push_back(std::move(Copy.OnLanded));
+        }
+
+        s_Batches.push(std::move(NewBatch));
+        s_QueuedCopies.clear();
+        s_QueuedBytes = 0;
+    }
+
+    // Must hold s_Mutex
+    void CollectLandedBatches( std::vector<std::function<void()> >& Callbacks, uint32_t& Uploads, bool WaitForAll )
+    {
+        while (!s_Batches.empty())
+        {
+            Batch& Oldest = s_Batches.front();
+            if (WaitForAll)
+                g_CommandManager.WaitForFence(Oldest.Fence);
+            else if (!g_CommandManager.IsFenceComplete(Oldest.Fence))
+                break;
+
+            for (auto& Callback : Oldest.Callbacks)
+                Callbacks.push_back(std::move(Callback));
+            Uploads += Oldest.Uploads;
+            s_Batches.pop();
+        }
+    }
+
+    // Must hold s_Mutex
+    bool IsIdle( void )
+    {
+        return s_DecodesInFlight == 0 && s_QueuedCopies.empty() && s_Batches.empty();
+    }
+
+    // Finish() may run on any thread, so the burst is only touched under s_Mutex
+    void ReportLanded( std::vector<std::function<void()> >& Callbacks, uint32_t Uploads, bool Idle )
+    {
+        for (auto& Callback : Callbacks)
+            Callback();
+
+        s_TexturesStreamed += Uploads;
+
+        int64_t StartTick = 0;
+        uint32_t Textures;
+        uint64_t Bytes;
+        {
+            std::lock_guard<std::mutex> CS(s_Mutex);
+            s_BurstTextures += Uploads;
+
+            if (!Idle || s_BurstStartTick == 0)
+                return;
+
+            StartTick = s_BurstStartTick;
+            Textures = s_BurstTextures;
+            Bytes = s_BurstBytes;
+
+            s_BurstStartTick = 0;
+            s_BurstTextures = 0;
+            s_BurstBytes = 0;
+        }
+
+        const double Milliseconds = SystemTime::TimeBetweenTicks(StartTick, SystemTime::GetCurrentTick()) * 1000.0;
+        Utility::Printf("Streamed %u textures (%.1f MB) in %.1f ms, %.0f textures/sec\n", Textures,
+            Bytes / (1024.0 * 1024.0), Milliseconds, Textures * 1000.0 / Milliseconds);
+    }
+}
+
+void TextureStreamer::Decode( std::function<void()> Task )
+{
+    {
+        std::lock_guard<std::mutex> CS(s_Mutex);
+        if (s_BurstStartTick == 0)
+            s_BurstStartTick = SystemTime::GetCurrentTick();
+        ++s_DecodesInFlight;
+    }
+
+    concurrency::create_task( [Task]
+    {
+        Task();
+        --s_DecodesInFlight;
+    } );
+}
+
+void TextureStreamer::Upload( ID3D12Resource* Dest, UINT NumSubresources, const D3D12_SUBRESOURCE_DATA SubData[],
+    std::function<void()> OnLanded )
+{
+    TextureCopy Copy;
+    Copy.Dest = Dest;
+    Copy.Layouts.resize(NumSubresources);
+    Copy.OnLanded = std::move(OnLanded);
+
+    std::vector<UINT> NumRows(NumSubresources);
+    std::vector<UINT64> RowSizes(NumSubresources);
+    UINT64 TotalSize = 0;
+    D3D12_RESOURCE_DESC Desc = Dest->GetDesc();
+    g_Device->GetCopyableFootprints(&Desc, 0, NumSubresources, 0, Copy.Layouts.data(), NumRows.data(), RowSizes.data(), &TotalSize);
+
+    size_t Offset;
+    {
+        std::lock_guard<std::mutex> CS(s_Mutex);
+        Copy.Page = ReserveStagingMemory((size_t)TotalSize, Offset);
+    }
+
+    for (D3D12_PLACED_SUBRESOURCE_FOOTPRINT& Layout : Copy.Layouts)
+        Layout.Offset += Offset;
+
+    // Outside the lock, so that workers fill their staging memory at the same time
+    CopyToStaging(Copy.Page->CpuAddress, Copy.Layouts.data(), NumRows.data(), RowSizes.data(), SubData, NumSubresources);
+
+    s_KilobytesStaged += TotalSize / 1024;
+
+    std::lock_guard<std::mutex> CS(s_Mutex);
+    s_QueuedCopies.push_back(std::move(Copy));
+    s_QueuedBytes += (size_t)TotalSize;
+    s_BurstBytes += TotalSize;
+
+    if (s_QueuedBytes >= kMaxBatchSize)
+        SubmitQueuedCopies();
+}
+
+void TextureStreamer::Notify( std::function<void()> OnLanded )
+{
+    TextureCopy Copy;
+    Copy.Dest = nullptr;
+    Copy.Page = nullptr;
+    Copy.OnLanded = std::move(OnLanded);
+
+    std::lock_guard<std::mutex> CS(s_Mutex);
+    s_QueuedCopies.push_back(std::move(Copy));
+}
+
+void TextureStreamer::Update( void )
+{
+    std::vector<std::function<void()> > Landed;
+    uint32_t Uploads = 0;
+    bool Idle;
+    {
+        std::lock_guard<std::mutex> CS(s_Mutex);
+        SubmitQueuedCopies();
+        CollectLandedBatches(Landed, Uploads, false);
+        Idle = IsIdle();
+    }
+
+    ReportLanded(Landed, Uploads, Idle);
+}
+
+void TextureStreamer::Finish( void )
+{
+    std::vector<std::function<void()> > Landed;
+    uint32_t Uploads = 0;
+    for (;;)
+    {
+        // A decode finishes after queuing its uploads, so once none are left everything has been queued
+        const bool Decoding = s_DecodesInFlight > 0;
+        {
+            std::lock_guard<std::mutex> CS(s_Mutex);
+            SubmitQueuedCopies();
+            CollectLandedBatches(Landed, Uploads, true);
+        }
+
+        if (!Decoding)
+            break;
+
+        std::this_thread::yield();
+    }
+
+    ReportLanded(Landed, Uploads, true);
+}
+
+void TextureStreamer::Shutdown( void )
+{
+    Finish();
+
+    std::lock_guard<std::mutex> CS(s_Mutex);
+
+    if (s_CurrentPage != nullptr)
+        DestroyPage(s_CurrentPage);
+    s_CurrentPage = nullptr;
+
+    for (StagingPage* Page : s_FullPages)
+        DestroyPage(Page);
+    s_FullPages.clear();
+
+    while (!s_RetiredAllocators.empty())
+    {
+        s_RetiredAllocators.front().second->Release();
+        s_RetiredAllocators.pop();
+    }
+
+    if (s_CommandList != nullptr)
+        s_CommandList->Release();
+    s_CommandList = nullptr;
+}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Loads textures in the background.  Files are decoded on worker threads, which copy the
+// texels straight into large staging pages.  Once a frame, every copy queued since the last frame is
+// recorded into one command list for the copy queue and submitted behind a single fence.  When that
+// fence completes, the main thread is told each texture has landed so that it can swap in its view.
+//
+
+#pragma once
+
+#include "pch.h"
+#include <functional>
+
+namespace TextureStreamer
+{
+    // Runs Task on a worker thread.  It may Upload() textures.
+    void Decode( std::function<void()> Task );
+
+    // Copies the subresources to staging memory now and into Dest, which must be in the COPY_DEST or COMMON
+    // state, with the next batch.  OnLanded is called from Update() or Finish() once the GPU has finished.
+    // May be called from any thread.
+    void Upload( ID3D12Resource* Dest, UINT NumSubresources, const D3D12_SUBRESOURCE_DATA SubData[],
+        std::function<void()> OnLanded );
+
+    // Calls OnLanded from Update() or Finish() with the next batch, for a load that has nothing to upload,
+    // such as one that failed.  May be called from any thread.
+    void Notify( std::function<void()> OnLanded );
+
+    // Submits this frame's copies and reports the batches that have landed.  Call from the main thread once
+    // a frame, before rendering starts.
+    void Update( void );
+
+    // Waits for all decoding and uploading to finish, and reports every texture as landed.  Callbacks run on
+    // the calling thread, usually the main thread.
+    void Finish( void );
+
+    void Shutdown( void );
+}
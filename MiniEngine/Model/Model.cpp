@@ -22,6 +22,10 @@ Model::Model()
     , m_pIndexData(nullptr)
     , m_pVertexDataDepth(nullptr)
     , m_pIndexDataDepth(nullptr)
+    , m_pMeshletRanges(nullptr)
+    , m_pMeshlets(nullptr)
+    , m_pMeshletVertices(nullptr)
+    , m_pMeshletPrimitives(nullptr)
     , m_SRVs(nullptr)
 {
     Clear();
@@ -32,6 +36,14 @@ Model::~Model()
     Clear();
 }
 
+template <typename T>
+void Model::ReleaseArray(T*& Array)
+{
+    if (!m_MappedFile.Contains(Array))
+        delete [] Array;
+    Array = nullptr;
+}
+
 void Model::Clear()
 {
     m_VertexBuffer.Destroy();
@@ -47,18 +59,24 @@ void Model::Clear()
     m_pMaterial = nullptr;
     m_Header.materialCount = 0;
 
-    delete [] m_pVertexData;
-    delete [] m_pIndexData;
-    delete [] m_pVertexDataDepth;
-    delete [] m_pIndexDataDepth;
+    if (HasSharedDepthIndices())
+        m_pIndexDataDepth = nullptr;
 
-    m_pVertexData = nullptr;
+    ReleaseArray(m_pVertexData);
     m_Header.vertexDataByteSize = 0;
-    m_pIndexData = nullptr;
+    ReleaseArray(m_pIndexData);
     m_Header.indexDataByteSize = 0;
-    m_pVertexDataDepth = nullptr;
+    ReleaseArray(m_pVertexDataDepth);
     m_Header.vertexDataByteSizeDepth = 0;
-    m_pIndexDataDepth = nullptr;
+    ReleaseArray(m_pIndexDataDepth);
+
+    ReleaseArray(m_pMeshletRanges);
+    ReleaseArray(m_pMeshlets);
+    ReleaseArray(m_pMeshletVertices);
+    ReleaseArray(m_pMeshletPrimitives);
+    memset(&m_MeshletHeader, 0, sizeof(m_MeshletHeader));
+
+    m_MappedFile.Close();
 
     ReleaseTextures();
 
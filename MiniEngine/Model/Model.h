@@ -17,6 +17,7 @@
 #include "VectorMath.h"
 #include "TextureManager.h"
 #include "GpuBuffer.h"
+#include "MappedFile.h"
 
 using namespace Math;
 
@@ -93,6 +94,7 @@ public:
         attrib_format_ushort,
         attrib_format_short,
         attrib_format_float,
+        attrib_format_half,
 
         attrib_formats
     };
@@ -169,19 +171,69 @@ public:
     };
     Material *m_pMaterial;
 
+    // After LoadH3D() the vertex, index and meshlet arrays point into the mapped file
     unsigned char *m_pVertexData;
     unsigned char *m_pIndexData;
     StructuredBuffer m_VertexBuffer;
     ByteAddressBuffer m_IndexBuffer;
     uint32_t m_VertexStride;
 
-    // optimized for depth-only rendering
+    // optimized for depth-only rendering.  When the depth-only indices are the same as the
+    // others, m_pIndexDataDepth is m_pIndexData and m_IndexBufferDepth is left empty.
     unsigned char *m_pVertexDataDepth;
     unsigned char *m_pIndexDataDepth;
     StructuredBuffer m_VertexBufferDepth;
     ByteAddressBuffer m_IndexBufferDepth;
     uint32_t m_VertexStrideDepth;
 
+    bool HasSharedDepthIndices() const
+    {
+        return m_pIndexDataDepth == m_pIndexData;
+    }
+
+    const ByteAddressBuffer& GetIndexBufferDepth() const
+    {
+        return HasSharedDepthIndices() ? m_IndexBuffer : m_IndexBufferDepth;
+    }
+
+    // Optional clusters of each mesh for CPU and GPU culling, built by the converter's
+    // -meshlets option and stored after the vertex and index data. A meshlet covers a
+    // run of its mesh's triangles in index buffer order.
+    enum { maxMeshletVertices = 64, maxMeshletPrimitives = 124 };
+
+    struct Meshlet
+    {
+        float center[3]; // bounding sphere
+        float radius;
+        float coneAxis[3]; // average triangle facing
+        float coneCutoff; // every triangle is backfacing when dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius
+        uint32_t vertexOffset; // first entry in m_pMeshletVertices
+        uint32_t primitiveOffset; // first entry in m_pMeshletPrimitives
+        uint32_t vertexCount;
+        uint32_t primitiveCount;
+    };
+    struct MeshletRange
+    {
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+    };
+    struct MeshletHeader
+    {
+        uint32_t meshletCount;
+        uint32_t vertexCount;
+        uint32_t primitiveCount;
+    };
+    MeshletHeader m_MeshletHeader;
+    MeshletRange *m_pMeshletRanges; // one per mesh
+    Meshlet *m_pMeshlets;
+    uint16_t *m_pMeshletVertices; // vertex indices within the mesh
+    uint32_t *m_pMeshletPrimitives; // three 8-bit meshlet vertex indices per triangle, low byte first
+
+    bool HasMeshlets() const
+    {
+        return m_pMeshlets != nullptr;
+    }
+
 	virtual bool Load(const char* filename)
 	{
 		return LoadH3D(filename);
@@ -192,6 +244,18 @@ public:
 		return m_Header.boundingBox;
 	}
 
+	// Meshes compressed by the converter store 20 byte vertices:
+	//   position   ushort4 normalized, xyz within the mesh bounding box, w is 1 when
+	//              the bitangent is cross(normal, tangent) and 0 when it is negated
+	//   texcoord0  half2
+	//   normal     short2 normalized, octahedral encoding
+	//   tangent    short2 normalized, octahedral encoding
+	// and the depth-only stream holds the ushort4 positions alone.
+	bool HasQuantizedVertices() const
+	{
+		return m_Header.meshCount > 0 && m_pMesh[0].attrib[attrib_position].format == attrib_format_ushort;
+	}
+
     D3D12_CPU_DESCRIPTOR_HANDLE* GetSRVs( uint32_t materialIdx ) const
     {
         return m_SRVs + materialIdx * 6;
@@ -199,6 +263,9 @@ public:
 
 protected:
 
+	// Version 2 files start with a table of chunks, each aligned so it can be used in place
+	// from the mapped file.  Version 1 files, the header followed by each array in turn,
+	// still load.
 	bool LoadH3D(const char *filename);
 	bool SaveH3D(const char *filename) const;
 
@@ -209,4 +276,15 @@ protected:
     void ReleaseTextures();
     void LoadTextures();
     D3D12_CPU_DESCRIPTOR_HANDLE* m_SRVs;
+
+private:
+
+    bool ReadH3DV1();
+    bool ReadH3DV2();
+    void CreateBuffers();
+
+    // Deletes an array unless it lives in the mapped file
+    template <typename T> void ReleaseArray(T*& Array);
+
+    Utility::MappedFile m_MappedFile;
 };
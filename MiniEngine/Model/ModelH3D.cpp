@@ -17,25 +17,127 @@
 #include "GraphicsCore.h"
 #include "DescriptorHeap.h"
 #include "CommandContext.h"
+#include "SystemTime.h"
 #include <stdio.h>
+#include <string.h>
+#include <unordered_set>
 
-bool Model::LoadH3D(const char *filename)
+// Version 1:  optional chunks follow the index data, each starting with a tag
+static const uint32_t kMeshletChunkTag = 0x31544c4d; // "MLT1"
+
+// Version 2:  a table of chunks, each starting on a page boundary so that it can be used in place
+// and its pages dropped independently once uploaded
+namespace
 {
-    FILE *file = nullptr;
-    if (0 != fopen_s(&file, filename, "rb"))
-        return false;
+    const uint32_t kH3DMagic = 0x32443348; // "H3D2", which no version 1 file starts with as a mesh count
+    const uint32_t kH3DVersion = 2;
+    const uint64_t kChunkAlignment = 4096;
 
-    bool ok = false;
+    enum : uint32_t
+    {
+        kHeaderChunk = 0x44414548,              // "HEAD"
+        kMeshChunk = 0x4853454d,                // "MESH"
+        kMaterialChunk = 0x4c54414d,            // "MATL"
+        kVertexChunk = 0x54524556,              // "VERT"
+        kIndexChunk = 0x58444e49,               // "INDX"
+        kVertexDepthChunk = 0x50454456,         // "VDEP"
+        kIndexDepthChunk = 0x50454449,          // "IDEP", left out when it matches INDX
+        kMeshletHeaderChunk = 0x48544c4d,       // "MLTH"
+        kMeshletRangeChunk = 0x52544c4d,        // "MLTR"
+        kMeshletChunk = 0x53544c4d,             // "MLTS"
+        kMeshletVertexChunk = 0x56544c4d,       // "MLTV"
+        kMeshletPrimitiveChunk = 0x50544c4d,    // "MLTP"
+    };
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t chunkCount;
+        uint32_t reserved;
+    };
 
-    if (1 != fread(&m_Header, sizeof(Header), 1, file)) goto h3d_load_fail;
+    struct ChunkEntry
+    {
+        uint32_t tag;
+        uint32_t reserved;
+        uint64_t offset;
+        uint64_t size;
+    };
 
-    m_pMesh = new Mesh [m_Header.meshCount];
-    m_pMaterial = new Material [m_Header.materialCount];
+    uint64_t AlignChunk(uint64_t offset)
+    {
+        return (offset + kChunkAlignment - 1) & ~(kChunkAlignment - 1);
+    }
 
-    if (m_Header.meshCount > 0)
-        if (1 != fread(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_load_fail;
-    if (m_Header.materialCount > 0)
-        if (1 != fread(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_load_fail;
+    // Finds a chunk of the expected size.  A missing chunk leaves data null; a malformed one fails.
+    bool FindChunk(const Utility::MappedFile& file, uint32_t tag, uint64_t size, unsigned char*& data)
+    {
+        data = nullptr;
+
+        const FileHeader* header = (const FileHeader*)file.GetData();
+        const ChunkEntry* table = (const ChunkEntry*)(header + 1);
+        for (uint32_t chunkIndex = 0; chunkIndex < header->chunkCount; ++chunkIndex)
+        {
+            const ChunkEntry& chunk = table[chunkIndex];
+            if (chunk.tag != tag)
+                continue;
+
+            if (chunk.size != size || chunk.offset % kChunkAlignment != 0 ||
+                chunk.offset > file.GetSize() || chunk.size > file.GetSize() - chunk.offset)
+                return false;
+
+            data = file.GetData() + chunk.offset;
+            return true;
+        }
+
+        return true;
+    }
+
+    // Steps through the arrays of a version 1 file
+    class H3DReader
+    {
+    public:
+        H3DReader(const Utility::MappedFile& file) : m_Cursor(file.GetData()), m_End(file.GetData() + file.GetSize()) {}
+
+        unsigned char* Read(uint64_t size)
+        {
+            if (size > (uint64_t)(m_End - m_Cursor))
+                return nullptr;
+
+            unsigned char* data = m_Cursor;
+            m_Cursor += size;
+            return data;
+        }
+
+        // Version 1 doesn't align its arrays, so copy the ones read as structures
+        template <typename T>
+        bool Copy(T* dest, uint64_t count)
+        {
+            const unsigned char* data = Read(sizeof(T) * count);
+            if (data == nullptr)
+                return false;
+
+            memcpy(dest, data, sizeof(T) * count);
+            return true;
+        }
+
+    private:
+        unsigned char* m_Cursor;
+        unsigned char* m_End;
+    };
+}
+
+bool Model::LoadH3D(const char *filename)
+{
+    if (!m_MappedFile.Open(filename))
+        return false;
+
+    const bool isVersion2 = m_MappedFile.GetSize() >= sizeof(FileHeader) &&
+        ((const FileHeader*)m_MappedFile.GetData())->magic == kH3DMagic;
+
+    if (!(isVersion2 ? ReadH3DV2() : ReadH3DV1()))
+        return false;
 
     m_VertexStride = m_pMesh[0].vertexStride;
     m_VertexStrideDepth = m_pMesh[0].vertexStrideDepth;
@@ -50,6 +152,21 @@ bool Model::LoadH3D(const char *filename)
     {
         const Mesh& mesh = m_pMesh[meshIndex];
 
+        if (HasQuantizedVertices())
+        {
+            ASSERT( mesh.attribsEnabled ==
+                (attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent) );
+            ASSERT(mesh.attrib[0].components == 4 && mesh.attrib[0].format == Model::attrib_format_ushort && mesh.attrib[0].normalized); // position
+            ASSERT(mesh.attrib[1].components == 2 && mesh.attrib[1].format == Model::attrib_format_half); // texcoord0
+            ASSERT(mesh.attrib[2].components == 2 && mesh.attrib[2].format == Model::attrib_format_short && mesh.attrib[2].normalized); // normal
+            ASSERT(mesh.attrib[3].components == 2 && mesh.attrib[3].format == Model::attrib_format_short && mesh.attrib[3].normalized); // tangent
+
+            ASSERT( mesh.attribsEnabledDepth ==
+                (attrib_mask_position) );
+            ASSERT(mesh.attribDepth[0].components == 4 && mesh.attribDepth[0].format == Model::attrib_format_ushort); // position
+            continue;
+        }
+
         ASSERT( mesh.attribsEnabled ==
             (attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent | attrib_mask_bitangent) );
         ASSERT(mesh.attrib[0].components == 3 && mesh.attrib[0].format == Model::attrib_format_float); // position
@@ -64,71 +181,190 @@ bool Model::LoadH3D(const char *filename)
     }
 #endif
 
-    m_pVertexData = new unsigned char[ m_Header.vertexDataByteSize ];
-    m_pIndexData = new unsigned char[ m_Header.indexDataByteSize ];
-    m_pVertexDataDepth = new unsigned char[ m_Header.vertexDataByteSizeDepth ];
-    m_pIndexDataDepth = new unsigned char[ m_Header.indexDataByteSize ];
+    CreateBuffers();
 
-    if (m_Header.vertexDataByteSize > 0)
-        if (1 != fread(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_load_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fread(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
+    LoadTextures();
 
-    if (m_Header.vertexDataByteSizeDepth > 0)
-        if (1 != fread(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_load_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fread(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_load_fail;
+    return true;
+}
 
-    m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, m_pVertexData);
-    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
-    delete [] m_pVertexData;
-    m_pVertexData = nullptr;
-    delete [] m_pIndexData;
-    m_pIndexData = nullptr;
+bool Model::ReadH3DV1()
+{
+    H3DReader reader(m_MappedFile);
 
-    m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
-    m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
-    delete [] m_pVertexDataDepth;
-    m_pVertexDataDepth = nullptr;
-    delete [] m_pIndexDataDepth;
-    m_pIndexDataDepth = nullptr;
+    if (!reader.Copy(&m_Header, 1) || m_Header.meshCount == 0)
+        return false;
 
-    LoadTextures();
+    m_pMesh = new Mesh [m_Header.meshCount];
+    m_pMaterial = new Material [m_Header.materialCount];
 
-    ok = true;
+    if (!reader.Copy(m_pMesh, m_Header.meshCount)) return false;
+    if (!reader.Copy(m_pMaterial, m_Header.materialCount)) return false;
 
-h3d_load_fail:
+    // The depth-only indices follow a copy of the others
+    if (nullptr == (m_pVertexData = reader.Read(m_Header.vertexDataByteSize))) return false;
+    if (nullptr == (m_pIndexData = reader.Read(m_Header.indexDataByteSize))) return false;
+    if (nullptr == (m_pVertexDataDepth = reader.Read(m_Header.vertexDataByteSizeDepth))) return false;
+    if (nullptr == (m_pIndexDataDepth = reader.Read(m_Header.indexDataByteSize))) return false;
 
-    if (EOF == fclose(file))
-        ok = false;
+    if (memcmp(m_pIndexDataDepth, m_pIndexData, m_Header.indexDataByteSize) == 0)
+        m_pIndexDataDepth = m_pIndexData;
 
-    return ok;
+    uint32_t chunkTag;
+    if (reader.Copy(&chunkTag, 1) && chunkTag == kMeshletChunkTag)
+    {
+        if (!reader.Copy(&m_MeshletHeader, 1)) return false;
+
+        m_pMeshletRanges = new MeshletRange[m_Header.meshCount];
+        m_pMeshlets = new Meshlet[m_MeshletHeader.meshletCount];
+        m_pMeshletVertices = new uint16_t[m_MeshletHeader.vertexCount];
+        m_pMeshletPrimitives = new uint32_t[m_MeshletHeader.primitiveCount];
+
+        if (!reader.Copy(m_pMeshletRanges, m_Header.meshCount)) return false;
+        if (!reader.Copy(m_pMeshlets, m_MeshletHeader.meshletCount)) return false;
+        if (!reader.Copy(m_pMeshletVertices, m_MeshletHeader.vertexCount)) return false;
+        if (!reader.Copy(m_pMeshletPrimitives, m_MeshletHeader.primitiveCount)) return false;
+    }
+
+    return true;
+}
+
+bool Model::ReadH3DV2()
+{
+    const FileHeader* header = (const FileHeader*)m_MappedFile.GetData();
+    if (header->version != kH3DVersion ||
+        header->chunkCount > (m_MappedFile.GetSize() - sizeof(FileHeader)) / sizeof(ChunkEntry))
+        return false;
+
+    unsigned char* data;
+    if (!FindChunk(m_MappedFile, kHeaderChunk, sizeof(Header), data) || data == nullptr)
+        return false;
+    memcpy(&m_Header, data, sizeof(Header));
+    if (m_Header.meshCount == 0)
+        return false;
+
+    // Meshes and materials are small and get edited, so they are the only arrays copied out of the file
+    if (!FindChunk(m_MappedFile, kMeshChunk, sizeof(Mesh) * m_Header.meshCount, data) || data == nullptr)
+        return false;
+    m_pMesh = new Mesh [m_Header.meshCount];
+    memcpy(m_pMesh, data, sizeof(Mesh) * m_Header.meshCount);
+
+    if (!FindChunk(m_MappedFile, kMaterialChunk, sizeof(Material) * m_Header.materialCount, data) || data == nullptr)
+        return false;
+    m_pMaterial = new Material [m_Header.materialCount];
+    memcpy(m_pMaterial, data, sizeof(Material) * m_Header.materialCount);
+
+    if (!FindChunk(m_MappedFile, kVertexChunk, m_Header.vertexDataByteSize, m_pVertexData) || m_pVertexData == nullptr) return false;
+    if (!FindChunk(m_MappedFile, kIndexChunk, m_Header.indexDataByteSize, m_pIndexData) || m_pIndexData == nullptr) return false;
+    if (!FindChunk(m_MappedFile, kVertexDepthChunk, m_Header.vertexDataByteSizeDepth, m_pVertexDataDepth) || m_pVertexDataDepth == nullptr) return false;
+    if (!FindChunk(m_MappedFile, kIndexDepthChunk, m_Header.indexDataByteSize, m_pIndexDataDepth)) return false;
+
+    if (m_pIndexDataDepth == nullptr)
+        m_pIndexDataDepth = m_pIndexData;
+
+    if (!FindChunk(m_MappedFile, kMeshletHeaderChunk, sizeof(MeshletHeader), data)) return false;
+    if (data != nullptr)
+    {
+        memcpy(&m_MeshletHeader, data, sizeof(MeshletHeader));
+
+        if (!FindChunk(m_MappedFile, kMeshletRangeChunk, sizeof(MeshletRange) * m_Header.meshCount, data) || data == nullptr) return false;
+        m_pMeshletRanges = (MeshletRange*)data;
+        if (!FindChunk(m_MappedFile, kMeshletChunk, sizeof(Meshlet) * m_MeshletHeader.meshletCount, data) || data == nullptr) return false;
+        m_pMeshlets = (Meshlet*)data;
+        if (!FindChunk(m_MappedFile, kMeshletVertexChunk, sizeof(uint16_t) * m_MeshletHeader.vertexCount, data) || data == nullptr) return false;
+        m_pMeshletVertices = (uint16_t*)data;
+        if (!FindChunk(m_MappedFile, kMeshletPrimitiveChunk, sizeof(uint32_t) * m_MeshletHeader.primitiveCount, data) || data == nullptr) return false;
+        m_pMeshletPrimitives = (uint32_t*)data;
+    }
+
+    return true;
+}
+
+void Model::CreateBuffers()
+{
+    // Each array is copied to the GPU straight out of the mapped file.  The next one is read ahead
+    // while a copy runs, and the pages of each are given back once it has been copied.
+    m_MappedFile.Prefetch(m_pVertexData, m_Header.vertexDataByteSize);
+    m_MappedFile.Prefetch(m_pIndexData, m_Header.indexDataByteSize);
+
+    m_VertexBuffer.Create(L"VertexBuffer", m_Header.vertexDataByteSize / m_VertexStride, m_VertexStride, m_pVertexData);
+    m_MappedFile.Evict(m_pVertexData, m_Header.vertexDataByteSize);
+    m_MappedFile.Prefetch(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth);
+
+    m_IndexBuffer.Create(L"IndexBuffer", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexData);
+    m_MappedFile.Evict(m_pIndexData, m_Header.indexDataByteSize);
+    if (!HasSharedDepthIndices())
+        m_MappedFile.Prefetch(m_pIndexDataDepth, m_Header.indexDataByteSize);
+
+    m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
+    m_MappedFile.Evict(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth);
+
+    if (!HasSharedDepthIndices())
+    {
+        m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
+        m_MappedFile.Evict(m_pIndexDataDepth, m_Header.indexDataByteSize);
+    }
 }
 
 bool Model::SaveH3D(const char *filename) const
 {
+    struct Chunk
+    {
+        uint32_t tag;
+        const void* data;
+        uint64_t size;
+    };
+    Chunk chunks[12];
+    uint32_t chunkCount = 0;
+
+    chunks[chunkCount++] = { kHeaderChunk, &m_Header, sizeof(Header) };
+    chunks[chunkCount++] = { kMeshChunk, m_pMesh, sizeof(Mesh) * m_Header.meshCount };
+    chunks[chunkCount++] = { kMaterialChunk, m_pMaterial, sizeof(Material) * m_Header.materialCount };
+    chunks[chunkCount++] = { kVertexChunk, m_pVertexData, m_Header.vertexDataByteSize };
+    chunks[chunkCount++] = { kIndexChunk, m_pIndexData, m_Header.indexDataByteSize };
+    chunks[chunkCount++] = { kVertexDepthChunk, m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth };
+
+    if (!HasSharedDepthIndices() && memcmp(m_pIndexDataDepth, m_pIndexData, m_Header.indexDataByteSize) != 0)
+        chunks[chunkCount++] = { kIndexDepthChunk, m_pIndexDataDepth, m_Header.indexDataByteSize };
+
+    if (HasMeshlets())
+    {
+        chunks[chunkCount++] = { kMeshletHeaderChunk, &m_MeshletHeader, sizeof(MeshletHeader) };
+        chunks[chunkCount++] = { kMeshletRangeChunk, m_pMeshletRanges, sizeof(MeshletRange) * m_Header.meshCount };
+        chunks[chunkCount++] = { kMeshletChunk, m_pMeshlets, sizeof(Meshlet) * m_MeshletHeader.meshletCount };
+        chunks[chunkCount++] = { kMeshletVertexChunk, m_pMeshletVertices, sizeof(uint16_t) * m_MeshletHeader.vertexCount };
+        chunks[chunkCount++] = { kMeshletPrimitiveChunk, m_pMeshletPrimitives, sizeof(uint32_t) * m_MeshletHeader.primitiveCount };
+    }
+
+    FileHeader header = { kH3DMagic, kH3DVersion, chunkCount, 0 };
+    ChunkEntry table[12];
+    uint64_t offset = AlignChunk(sizeof(FileHeader) + sizeof(ChunkEntry) * chunkCount);
+    for (uint32_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+    {
+        table[chunkIndex] = { chunks[chunkIndex].tag, 0, offset, chunks[chunkIndex].size };
+        offset = AlignChunk(offset + chunks[chunkIndex].size);
+    }
+
     FILE *file = nullptr;
     if (0 != fopen_s(&file, filename, "wb"))
         return false;
 
+    static const unsigned char padding[kChunkAlignment] = {};
+    uint64_t written = sizeof(FileHeader) + sizeof(ChunkEntry) * chunkCount;
     bool ok = false;
 
-    if (1 != fwrite(&m_Header, sizeof(Header), 1, file)) goto h3d_save_fail;
-
-    if (m_Header.meshCount > 0)
-        if (1 != fwrite(m_pMesh, sizeof(Mesh) * m_Header.meshCount, 1, file)) goto h3d_save_fail;
-    if (m_Header.materialCount > 0)
-        if (1 != fwrite(m_pMaterial, sizeof(Material) * m_Header.materialCount, 1, file)) goto h3d_save_fail;
+    if (1 != fwrite(&header, sizeof(FileHeader), 1, file)) goto h3d_save_fail;
+    if (1 != fwrite(table, sizeof(ChunkEntry) * chunkCount, 1, file)) goto h3d_save_fail;
 
-    if (m_Header.vertexDataByteSize > 0)
-        if (1 != fwrite(m_pVertexData, m_Header.vertexDataByteSize, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexData, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
-
-    if (m_Header.vertexDataByteSizeDepth > 0)
-        if (1 != fwrite(m_pVertexDataDepth, m_Header.vertexDataByteSizeDepth, 1, file)) goto h3d_save_fail;
-    if (m_Header.indexDataByteSize > 0)
-        if (1 != fwrite(m_pIndexDataDepth, m_Header.indexDataByteSize, 1, file)) goto h3d_save_fail;
+    for (uint32_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+    {
+        const size_t paddingSize = (size_t)(table[chunkIndex].offset - written);
+        if (paddingSize > 0)
+            if (1 != fwrite(padding, paddingSize, 1, file)) goto h3d_save_fail;
+        if (chunks[chunkIndex].size > 0)
+            if (1 != fwrite(chunks[chunkIndex].data, (size_t)chunks[chunkIndex].size, 1, file)) goto h3d_save_fail;
+        written = table[chunkIndex].offset + chunks[chunkIndex].size;
+    }
 
     ok = true;
 
@@ -167,6 +403,10 @@ void Model::LoadTextures(void)
 
     const ManagedTexture* MatTextures[6] = {};
 
+    // DDS textures stream in afterward, so this measures how long requesting them holds up the caller
+    const int64_t StartTick = SystemTime::GetCurrentTick();
+    std::unordered_set<const ManagedTexture*> UniqueTextures;
+
     for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
     {
         const Material& pMaterial = m_pMaterial[materialIdx];
@@ -209,5 +449,15 @@ void Model::LoadTextures(void)
         m_SRVs[materialIdx * 6 + 3] = MatTextures[3]->GetSRV();
         m_SRVs[materialIdx * 6 + 4] = MatTextures[0]->GetSRV();
         m_SRVs[materialIdx * 6 + 5] = MatTextures[0]->GetSRV();
+
+        UniqueTextures.insert(MatTextures[0]);
+        UniqueTextures.insert(MatTextures[1]);
+        UniqueTextures.insert(MatTextures[3]);
     }
+
+    // One line per model rather than per texture
+    const double StallMs = SystemTime::TicksToMillisecs(SystemTime::GetCurrentTick() - StartTick);
+    Utility::Printf("Requested %u textures for %u materials, main thread stalled %.1f ms (%.0f textures/sec)\n",
+        (uint32_t)UniqueTextures.size(), m_Header.materialCount, StallMs,
+        StallMs > 0.0 ? UniqueTextures.size() * 1000.0 / StallMs : 0.0);
 }
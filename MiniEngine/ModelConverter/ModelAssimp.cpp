@@ -12,6 +12,7 @@
 //
 
 #include "ModelAssimp.h"
+#include "SystemTime.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -42,9 +43,11 @@ int AssimpModel::FormatFromFilename(const char *filename)
 bool AssimpModel::Load(const char *filename)
 {
 	Clear();
+	m_PassTimes = {};
 
 	int format = FormatFromFilename(filename);
 
+	int64_t start = SystemTime::GetCurrentTick();
 	bool rval = false;
 	bool needToOptimize = true;
 	switch (format)
@@ -59,15 +62,36 @@ bool AssimpModel::Load(const char *filename)
 		break;
 	}
 
+	m_PassTimes.import = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+
 	if (!rval)
 		return false;
 
 	if (needToOptimize)
+	{
 		Optimize();
+	}
+	else if (m_BuildMeshlets && !HasMeshlets())
+	{
+		// add meshlets to a model converted without them
+		start = SystemTime::GetCurrentTick();
+		BuildMeshlets();
+		m_PassTimes.meshlets = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+	}
 
 	return true;
 }
 
+bool AssimpModel::LoadUnoptimized(const char *filename)
+{
+	Clear();
+
+	if (FormatFromFilename(filename) != format_none)
+		return false;
+
+	return LoadAssimp(filename);
+}
+
 bool AssimpModel::Save(const char *filename) const
 {
 	int format = FormatFromFilename(filename);
@@ -27,16 +27,66 @@ public:
 	static const char *s_FormatString[];
 	static int FormatFromFilename(const char *filename);
 
+	// how OptimizeRemoveDuplicateVertices decides two vertices are the same
+	enum
+	{
+		weld_exact = 0, // identical bytes
+		weld_quantize, // same cell of a grid with the tolerance as spacing
+		weld_epsilon, // every component within tolerance
+
+		weld_modes,
+	};
+	struct WeldOptions
+	{
+		int mode;
+
+		// per attribute tolerances for float data, 0 keeps the attribute exact.
+		// normalTolerance also applies to tangents and bitangents.
+		float positionTolerance;
+		float normalTolerance;
+		float texcoordTolerance;
+	};
+	void SetWeldOptions(const WeldOptions &options) { m_WeldOptions = options; }
+
+	// write quantized vertex streams, see Model::HasQuantizedVertices()
+	void SetCompressVertices(bool compress) { m_CompressVertices = compress; }
+
+	// cluster each mesh into meshlets with culling bounds, see Model::Meshlet
+	void SetBuildMeshlets(bool build) { m_BuildMeshlets = build; }
+
+	// seconds spent in each stage of the last Load
+	struct PassTimes
+	{
+		double import;
+		double removeDuplicateVertices;
+		double postTransform;
+		double preTransform;
+		double quantize;
+		double meshlets;
+	};
+	const PassTimes &GetPassTimes() const { return m_PassTimes; }
+
 	virtual bool Load(const char* filename) override;
 	bool Save(const char* filename) const;
 
+	// imports a source model without running the optimization passes
+	bool LoadUnoptimized(const char* filename);
+
+	void OptimizeRemoveDuplicateVertices(bool depth);
+
 private:
 
 	bool LoadAssimp(const char *filename);
 
 	void Optimize();
-	void OptimizeRemoveDuplicateVertices(bool depth);
 	void OptimizePostTransform(bool depth);
 	void OptimizePreTransform(bool depth);
+	void QuantizeVertices(bool depth);
+	void BuildMeshlets();
+
+	WeldOptions m_WeldOptions = { weld_exact, 0.0f, 0.0f, 0.0f };
+	bool m_CompressVertices = false;
+	bool m_BuildMeshlets = false;
+	PassTimes m_PassTimes = {};
 };
 
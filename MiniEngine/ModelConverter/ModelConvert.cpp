@@ -12,15 +12,229 @@
 //
 
 #include "ModelAssimp.h"
+#include "ModelConvertBatch.h"
+#include "SystemTime.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
 
 void PrintHelp()
 {
     printf("model_convert\n");
 
     printf("usage:\n");
-    printf("model_convert input_file output_file\n");
+    printf("model_convert [options] input_file output_file\n");
+    printf("model_convert [options] -batch manifest_or_directory [-out directory] [-report file] [-jobs n] [-force]\n");
+    printf("model_convert -benchmark input_file...\n");
+    printf("model_convert [options] -meshlet_benchmark input_file...\n");
+    printf("options:\n");
+    printf("  -quantize pos normal uv   merge vertices that fall in the same grid cell\n");
+    printf("  -weld pos normal uv       merge vertices within the given tolerances\n");
+    printf("  -compress                 quantize positions, normals, tangents and uvs\n");
+    printf("  -meshlets                 cluster meshes into meshlets with culling bounds\n");
+    printf("tolerances of 0 keep an attribute exact\n");
+    printf("batch manifests list one \"input_file output_file\" pair per line\n");
+}
+
+// The original O(n^2) pass, kept as the reference the hashed pass has to match
+static void RemoveDuplicateVerticesReference(Model &model, bool depth)
+{
+    unsigned char *deduplicatedVertexData = new unsigned char [depth ? model.m_Header.vertexDataByteSizeDepth : model.m_Header.vertexDataByteSize];
+    uint32_t deduplicatedVertexDataSize = 0;
+
+    for (unsigned int meshIndex = 0; meshIndex < model.m_Header.meshCount; meshIndex++)
+    {
+        Model::Mesh *mesh = model.m_pMesh + meshIndex;
+        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
+        unsigned char *meshVertexData = depth ? (model.m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (model.m_pVertexData + mesh->vertexDataByteOffset);
+        uint16_t *indexArray = (uint16_t*)((depth ? model.m_pIndexDataDepth : model.m_pIndexData) + mesh->indexDataByteOffset);
+
+        unsigned char *meshDeduplicatedVertexData = deduplicatedVertexData + deduplicatedVertexDataSize;
+        std::vector<uint32_t> vertexRemap(vertexCount);
+        uint32_t deduplicatedCount = 0;
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            unsigned char *vData = meshVertexData + v * vertexStride;
+            uint32_t n = 0;
+            while (n < deduplicatedCount && memcmp(meshDeduplicatedVertexData + n * vertexStride, vData, vertexStride) != 0)
+                n++;
+
+            if (n == deduplicatedCount)
+                memcpy(meshDeduplicatedVertexData + deduplicatedCount++ * vertexStride, vData, vertexStride);
+            vertexRemap[v] = n;
+        }
+
+        for (unsigned int n = 0; n < mesh->indexCount; n++)
+            indexArray[n] = (uint16_t)vertexRemap[indexArray[n]];
+
+        if (depth)
+        {
+            mesh->vertexCountDepth = deduplicatedCount;
+            mesh->vertexDataByteOffsetDepth = deduplicatedVertexDataSize;
+        }
+        else
+        {
+            mesh->vertexCount = deduplicatedCount;
+            mesh->vertexDataByteOffset = deduplicatedVertexDataSize;
+        }
+        deduplicatedVertexDataSize += deduplicatedCount * vertexStride;
+    }
+
+    if (depth)
+    {
+        delete [] model.m_pVertexDataDepth;
+        model.m_pVertexDataDepth = deduplicatedVertexData;
+        model.m_Header.vertexDataByteSizeDepth = deduplicatedVertexDataSize;
+    }
+    else
+    {
+        delete [] model.m_pVertexData;
+        model.m_pVertexData = deduplicatedVertexData;
+        model.m_Header.vertexDataByteSize = deduplicatedVertexDataSize;
+    }
+}
+
+static bool IsSameVertexData(const Model &a, const Model &b)
+{
+    return a.m_Header.vertexDataByteSize == b.m_Header.vertexDataByteSize
+        && a.m_Header.vertexDataByteSizeDepth == b.m_Header.vertexDataByteSizeDepth
+        && memcmp(a.m_pVertexData, b.m_pVertexData, a.m_Header.vertexDataByteSize) == 0
+        && memcmp(a.m_pVertexDataDepth, b.m_pVertexDataDepth, a.m_Header.vertexDataByteSizeDepth) == 0
+        && memcmp(a.m_pIndexData, b.m_pIndexData, a.m_Header.indexDataByteSize) == 0
+        && memcmp(a.m_pIndexDataDepth, b.m_pIndexDataDepth, a.m_Header.indexDataByteSize) == 0;
+}
+
+//
+// Times exact vertex deduplication over a corpus of source models, hashed against
+// the reference pass. Both run on the same imported data and must produce
+// identical vertex and index buffers.
+//
+static int RunBenchmark(int fileCount, char **files)
+{
+    double totalHashed = 0.0;
+    double totalReference = 0.0;
+    int failures = 0;
+
+    printf("%-40s %10s %10s %12s %12s\n", "file", "vertices", "unique", "hashed ms", "reference ms");
+    for (int fileIndex = 0; fileIndex < fileCount; fileIndex++)
+    {
+        AssimpModel hashed, reference;
+        if (!hashed.LoadUnoptimized(files[fileIndex]) || !reference.LoadUnoptimized(files[fileIndex]))
+        {
+            printf("failed to load model: %s\n", files[fileIndex]);
+            failures++;
+            continue;
+        }
+
+        uint32_t vertexCount = 0;
+        for (unsigned int meshIndex = 0; meshIndex < hashed.m_Header.meshCount; meshIndex++)
+            vertexCount += hashed.m_pMesh[meshIndex].vertexCount;
+
+        int64_t start = SystemTime::GetCurrentTick();
+        hashed.OptimizeRemoveDuplicateVertices(false);
+        hashed.OptimizeRemoveDuplicateVertices(true);
+        int64_t end = SystemTime::GetCurrentTick();
+        double hashedTime = SystemTime::TimeBetweenTicks(start, end);
+
+        start = SystemTime::GetCurrentTick();
+        RemoveDuplicateVerticesReference(reference, false);
+        RemoveDuplicateVerticesReference(reference, true);
+        end = SystemTime::GetCurrentTick();
+        double referenceTime = SystemTime::TimeBetweenTicks(start, end);
+
+        uint32_t uniqueCount = 0;
+        for (unsigned int meshIndex = 0; meshIndex < hashed.m_Header.meshCount; meshIndex++)
+            uniqueCount += hashed.m_pMesh[meshIndex].vertexCount;
+
+        printf("%-40s %10u %10u %12.3f %12.3f\n", files[fileIndex], vertexCount, uniqueCount,
+            hashedTime * 1000.0, referenceTime * 1000.0);
+
+        if (!IsSameVertexData(hashed, reference))
+        {
+            printf("output mismatch: %s\n", files[fileIndex]);
+            failures++;
+        }
+
+        totalHashed += hashedTime;
+        totalReference += referenceTime;
+    }
+
+    printf("total: hashed %.3f ms, reference %.3f ms\n", totalHashed * 1000.0, totalReference * 1000.0);
+    return failures == 0 ? 0 : -1;
+}
+
+// Average cache miss ratio, the vertices transformed per triangle by a FIFO cache
+static uint32_t CountCacheMisses(const Model &model)
+{
+    const unsigned int kCacheSize = 32;
+
+    uint32_t misses = 0;
+    for (unsigned int meshIndex = 0; meshIndex < model.m_Header.meshCount; meshIndex++)
+    {
+        const Model::Mesh &mesh = model.m_pMesh[meshIndex];
+        const uint16_t *indices = (const uint16_t*)(model.m_pIndexData + mesh.indexDataByteOffset);
+
+        // each vertex remembers when it entered the cache
+        std::vector<uint32_t> cacheTime(mesh.vertexCount, 0);
+        uint32_t time = kCacheSize + 1;
+        for (unsigned int n = 0; n < mesh.indexCount; n++)
+        {
+            if (time - cacheTime[indices[n]] > kCacheSize)
+            {
+                cacheTime[indices[n]] = time++;
+                misses++;
+            }
+        }
+    }
+    return misses;
+}
+
+//
+// Compares the vertex reuse of the imported index order, the post-transform
+// optimized order and the meshlets cut from it. A meshlet transforms each of its
+// vertices once, so its vertices per triangle are directly comparable to ACMR.
+//
+static int RunMeshletBenchmark(int fileCount, char **files, const AssimpModel::WeldOptions &weldOptions, bool compressVertices)
+{
+    int failures = 0;
+
+    printf("%-40s %10s %8s %8s %8s %10s %10s %10s %12s\n", "file", "triangles", "acmr in", "acmr opt", "meshlet",
+        "meshlets", "vert fill", "prim fill", "build ms");
+    for (int fileIndex = 0; fileIndex < fileCount; fileIndex++)
+    {
+        AssimpModel imported, optimized;
+        imported.SetWeldOptions(weldOptions);
+        optimized.SetWeldOptions(weldOptions);
+        optimized.SetCompressVertices(compressVertices);
+        optimized.SetBuildMeshlets(true);
+        if (!imported.LoadUnoptimized(files[fileIndex]) || !optimized.Load(files[fileIndex]))
+        {
+            printf("failed to load model: %s\n", files[fileIndex]);
+            failures++;
+            continue;
+        }
+
+        uint32_t triangleCount = 0;
+        for (unsigned int meshIndex = 0; meshIndex < optimized.m_Header.meshCount; meshIndex++)
+            triangleCount += optimized.m_pMesh[meshIndex].indexCount / 3;
+        if (triangleCount == 0)
+            continue;
+
+        const Model::MeshletHeader &meshlets = optimized.m_MeshletHeader;
+        const uint32_t meshletCount = meshlets.meshletCount > 0 ? meshlets.meshletCount : 1;
+        printf("%-40s %10u %8.3f %8.3f %8.3f %10u %9.1f%% %9.1f%% %12.3f\n", files[fileIndex], triangleCount,
+            (double)CountCacheMisses(imported) / triangleCount, (double)CountCacheMisses(optimized) / triangleCount,
+            (double)meshlets.vertexCount / triangleCount, meshlets.meshletCount,
+            100.0 * meshlets.vertexCount / (meshletCount * Model::maxMeshletVertices),
+            100.0 * meshlets.primitiveCount / (meshletCount * Model::maxMeshletPrimitives),
+            optimized.GetPassTimes().meshlets * 1000.0);
+    }
+
+    return failures == 0 ? 0 : -1;
 }
 
 void PrintModelStats(const Model *model)
@@ -35,6 +249,11 @@ void PrintModelStats(const Model *model)
     printf("vertex data size: %u\n", model->m_Header.vertexDataByteSize);
     printf("index data size: %u\n", model->m_Header.indexDataByteSize);
     printf("vertex data size depth-only: %u\n", model->m_Header.vertexDataByteSizeDepth);
+    if (model->HasMeshlets())
+    {
+        printf("meshlets: %u, meshlet vertices: %u, meshlet primitives: %u\n", model->m_MeshletHeader.meshletCount,
+            model->m_MeshletHeader.vertexCount, model->m_MeshletHeader.primitiveCount);
+    }
     printf("\n");
 
     printf("mesh count: %u\n", model->m_Header.meshCount);
@@ -65,6 +284,10 @@ void PrintModelStats(const Model *model)
             case Model::attrib_format_float:
                 printf("float");
                 break;
+
+            case Model::attrib_format_half:
+                printf("half");
+                break;
             }
         };
 
@@ -94,7 +317,7 @@ void PrintModelStats(const Model *model)
             printf("attrib %d: offset %u, normalized %u, components %u, format "
                 , n, mesh->attribDepth[n].offset, mesh->attribDepth[n].normalized
                 , mesh->attribDepth[n].components);
-            printAttribFormat(mesh->attrib[n].format);
+            printAttribFormat(mesh->attribDepth[n].format);
             printf("\n");
         }
     }
@@ -112,19 +335,108 @@ void PrintModelStats(const Model *model)
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    SystemTime::Initialize();
+
+    if (argc >= 3 && strcmp(argv[1], "-benchmark") == 0)
+        return RunBenchmark(argc - 2, argv + 2);
+
+    AssimpModel::WeldOptions weldOptions = { AssimpModel::weld_exact, 0.0f, 0.0f, 0.0f };
+    BatchOptions batchOptions = {};
+
+    // the last option given that only means something with -batch
+    const char *batchOnlyOption = nullptr;
+
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-')
+    {
+        const char *option = argv[arg];
+        if (strcmp(option, "-force") == 0)
+        {
+            batchOptions.force = true;
+            batchOnlyOption = option;
+            arg++;
+            continue;
+        }
+
+        if (strcmp(option, "-compress") == 0)
+        {
+            batchOptions.compressVertices = true;
+            arg++;
+            continue;
+        }
+
+        if (strcmp(option, "-meshlets") == 0)
+        {
+            batchOptions.buildMeshlets = true;
+            arg++;
+            continue;
+        }
+
+        if (strcmp(option, "-meshlet_benchmark") == 0)
+        {
+            arg++;
+            if (arg == argc)
+                break;
+            return RunMeshletBenchmark(argc - arg, argv + arg, weldOptions, batchOptions.compressVertices);
+        }
+
+        if (strcmp(option, "-quantize") == 0 || strcmp(option, "-weld") == 0)
+        {
+            if (arg + 3 >= argc)
+                break;
+            weldOptions.mode = strcmp(option, "-weld") == 0 ? AssimpModel::weld_epsilon : AssimpModel::weld_quantize;
+            weldOptions.positionTolerance = (float)atof(argv[arg + 1]);
+            weldOptions.normalTolerance = (float)atof(argv[arg + 2]);
+            weldOptions.texcoordTolerance = (float)atof(argv[arg + 3]);
+            arg += 4;
+            continue;
+        }
+
+        if (arg + 1 >= argc)
+            break;
+        if (strcmp(option, "-batch") == 0)
+            batchOptions.source = argv[arg + 1];
+        else if (strcmp(option, "-out") == 0)
+            batchOptions.outputDirectory = argv[arg + 1];
+        else if (strcmp(option, "-report") == 0)
+            batchOptions.reportFile = argv[arg + 1];
+        else if (strcmp(option, "-jobs") == 0)
+            batchOptions.jobs = (unsigned int)atoi(argv[arg + 1]);
+        else
+            break;
+        if (strcmp(option, "-batch") != 0)
+            batchOnlyOption = option;
+        arg += 2;
+    }
+
+    if (batchOptions.source && arg == argc)
+    {
+        batchOptions.weldOptions = weldOptions;
+        return RunBatch(batchOptions);
+    }
+
+    if (batchOptions.source || argc - arg != 2)
     {
         PrintHelp();
         return -1;
     }
 
-    const char *input_file = argv[1];
-    const char *output_file = argv[2];
+    if (batchOnlyOption)
+    {
+        printf("error: %s only applies to -batch\n", batchOnlyOption);
+        return -1;
+    }
+
+    const char *input_file = argv[arg];
+    const char *output_file = argv[arg + 1];
 
     printf("input file %s\n", input_file);
     printf("output file %s\n", output_file);
 
 	AssimpModel model;
+    model.SetWeldOptions(weldOptions);
+    model.SetCompressVertices(batchOptions.compressVertices);
+    model.SetBuildMeshlets(batchOptions.buildMeshlets);
 
     printf("loading...\n");
     if (!model.Load(input_file))
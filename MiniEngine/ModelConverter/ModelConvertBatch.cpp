@@ -0,0 +1,439 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "ModelConvertBatch.h"
+#include "Hash.h"
+#include "SystemTime.h"
+
+#include <assimp/Importer.hpp>
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <ppl.h>
+#include <concrt.h>
+
+using Utility::Hash128;
+
+namespace
+{
+    enum
+    {
+        asset_converted,
+        asset_skipped,
+        asset_failed,
+    };
+    const char *s_StatusString[] = { "converted", "skipped", "failed" };
+
+    struct Asset
+    {
+        std::string input;
+        std::string output;
+
+        int status;
+        uint64_t sourceSize;
+        Hash128 sourceHash;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+
+        // seconds
+        double hashTime;
+        AssimpModel::PassTimes passTimes;
+        double saveTime;
+        double totalTime;
+    };
+
+    // Hashes a whole file a megabyte at a time, seeded with its size so
+    // truncations never match.  The hash is 128 bits, so that a changed source
+    // is never mistaken for the one its stamp was written for.  Returns false if
+    // the file can't be read.
+    bool HashFile(const char *filename, uint64_t &size, Hash128 &hash)
+    {
+        FILE *file = nullptr;
+        if (0 != fopen_s(&file, filename, "rb"))
+            return false;
+
+        _fseeki64(file, 0, SEEK_END);
+        const int64_t fileSize = _ftelli64(file);
+        _fseeki64(file, 0, SEEK_SET);
+
+        size = fileSize < 0 ? 0 : (uint64_t)fileSize;
+        hash.Lo = size;
+        hash.Hi = 0;
+
+        std::vector<uint8_t> chunk(1 << 20);
+        uint64_t bytesRead = 0;
+        for (size_t count; (count = fread(chunk.data(), 1, chunk.size(), file)) > 0; bytesRead += count)
+            hash = Utility::HashBytes128(chunk.data(), count, hash);
+
+        const bool ok = fileSize >= 0 && !ferror(file) && bytesRead == size;
+        fclose(file);
+        return ok;
+    }
+
+    //
+    // Anything that changes what the converter writes has to change this hash: the
+    // executable itself, so rebuilding the converter invalidates every output, and
+    // the options of this run.
+    //
+    Hash128 ComputeConverterHash(const AssimpModel::WeldOptions &weldOptions, bool compressVertices, bool buildMeshlets)
+    {
+        char modulePath[MAX_PATH];
+        GetModuleFileNameA(nullptr, modulePath, MAX_PATH);
+
+        uint64_t size = 0;
+        Hash128 hash = {};
+        HashFile(modulePath, size, hash);
+
+        hash = Utility::HashBytes128(&weldOptions, sizeof(weldOptions), hash);
+
+        const uint32_t flags = (compressVertices ? 1 : 0) | (buildMeshlets ? 2 : 0);
+        return Utility::HashBytes128(&flags, sizeof(flags), hash);
+    }
+
+    std::string GetStampFilename(const std::string &output)
+    {
+        return output + ".stamp";
+    }
+
+    bool IsUpToDate(const Asset &asset, const Hash128 &converterHash)
+    {
+        if (GetFileAttributesA(asset.output.c_str()) == INVALID_FILE_ATTRIBUTES)
+            return false;
+
+        FILE *file = nullptr;
+        if (0 != fopen_s(&file, GetStampFilename(asset.output).c_str(), "r"))
+            return false;
+
+        // Stamps from before sizes were recorded don't parse, so their assets are converted again
+        unsigned long long sourceSize = 0;
+        Hash128 sourceHash = {}, stampConverterHash = {};
+        int fields = fscanf_s(file, "source %llu %16llx%16llx\nconverter %16llx%16llx\n", &sourceSize,
+            &sourceHash.Hi, &sourceHash.Lo, &stampConverterHash.Hi, &stampConverterHash.Lo);
+        fclose(file);
+
+        return fields == 5 && sourceSize == asset.sourceSize && sourceHash == asset.sourceHash && stampConverterHash == converterHash;
+    }
+
+    void WriteStamp(const Asset &asset, const Hash128 &converterHash)
+    {
+        FILE *file = nullptr;
+        if (0 != fopen_s(&file, GetStampFilename(asset.output).c_str(), "w"))
+            return;
+
+        fprintf(file, "source %llu %016llx%016llx\nconverter %016llx%016llx\n", (unsigned long long)asset.sourceSize,
+            (unsigned long long)asset.sourceHash.Hi, (unsigned long long)asset.sourceHash.Lo,
+            (unsigned long long)converterHash.Hi, (unsigned long long)converterHash.Lo);
+        fclose(file);
+    }
+
+    void CreateParentDirectories(const std::string &path)
+    {
+        for (size_t n = path.find_first_of("\\/"); n != std::string::npos; n = path.find_first_of("\\/", n + 1))
+        {
+            if (n > 0 && path[n - 1] != ':')
+                CreateDirectoryA(path.substr(0, n).c_str(), nullptr);
+        }
+    }
+
+    std::string ReplaceExtension(const std::string &path, const char *extension)
+    {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("\\/");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return path + extension;
+        return path.substr(0, dot) + extension;
+    }
+
+    // Splits a manifest line into whitespace separated, optionally quoted, tokens
+    std::vector<std::string> TokenizeLine(const char *line)
+    {
+        std::vector<std::string> tokens;
+        const char *p = line;
+        for (;;)
+        {
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+                p++;
+            if (*p == 0 || *p == '#')
+                break;
+
+            const char *start = p;
+            if (*p == '"')
+            {
+                start = ++p;
+                while (*p && *p != '"')
+                    p++;
+                tokens.emplace_back(start, p);
+                if (*p)
+                    p++;
+            }
+            else
+            {
+                while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                    p++;
+                tokens.emplace_back(start, p);
+            }
+        }
+        return tokens;
+    }
+
+    bool ReadManifest(const char *filename, std::vector<Asset> &assets)
+    {
+        FILE *file = nullptr;
+        if (0 != fopen_s(&file, filename, "r"))
+        {
+            printf("failed to open manifest: %s\n", filename);
+            return false;
+        }
+
+        char line[4096];
+        unsigned int lineNumber = 0;
+        bool ok = true;
+        while (fgets(line, sizeof(line), file))
+        {
+            lineNumber++;
+            std::vector<std::string> tokens = TokenizeLine(line);
+            if (tokens.empty())
+                continue;
+
+            if (tokens.size() != 2)
+            {
+                printf("%s(%u): expected input_file output_file\n", filename, lineNumber);
+                ok = false;
+                continue;
+            }
+
+            Asset asset = {};
+            asset.input = tokens[0];
+            asset.output = tokens[1];
+            assets.push_back(asset);
+        }
+        fclose(file);
+
+        return ok;
+    }
+
+    // Two assets writing the same output would be converted at the same time and
+    // overwrite each other's .h3d and .stamp, so report every such pair.  Windows
+    // paths compare without regard to case or slash direction.
+    bool CheckUniqueOutputs(const std::vector<Asset> &assets)
+    {
+        std::map<std::string, const Asset*> outputs;
+        bool ok = true;
+        for (const Asset &asset : assets)
+        {
+            std::string key = asset.output;
+            std::replace(key.begin(), key.end(), '/', '\\');
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            auto inserted = outputs.emplace(key, &asset);
+            if (!inserted.second)
+            {
+                printf("%s and %s both convert to %s\n", inserted.first->second->input.c_str(), asset.input.c_str(),
+                    asset.output.c_str());
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    // Collects every file ASSIMP can import under directory, skipping converted .h3d files
+    void GatherDirectory(const std::string &directory, const std::string &relativePath,
+        const char *outputDirectory, const Assimp::Importer &importer, std::vector<Asset> &assets)
+    {
+        WIN32_FIND_DATAA findData;
+        HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &findData);
+        if (find == INVALID_HANDLE_VALUE)
+            return;
+
+        do
+        {
+            if (strcmp(findData.cFileName, ".") == 0 || strcmp(findData.cFileName, "..") == 0)
+                continue;
+
+            std::string path = directory + "\\" + findData.cFileName;
+            std::string relative = relativePath.empty() ? findData.cFileName : relativePath + "\\" + findData.cFileName;
+
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                GatherDirectory(path, relative, outputDirectory, importer, assets);
+                continue;
+            }
+
+            const char *extension = strrchr(findData.cFileName, '.');
+            if (!extension || AssimpModel::FormatFromFilename(findData.cFileName) != AssimpModel::format_none ||
+                !importer.IsExtensionSupported(extension))
+                continue;
+
+            Asset asset = {};
+            asset.input = path;
+            asset.output = ReplaceExtension(outputDirectory ? std::string(outputDirectory) + "\\" + relative : path, ".h3d");
+            assets.push_back(asset);
+        }
+        while (FindNextFileA(find, &findData));
+
+        FindClose(find);
+    }
+
+    void ConvertAsset(Asset &asset, const BatchOptions &options, const Hash128 &converterHash)
+    {
+        int64_t start = SystemTime::GetCurrentTick();
+
+        if (!HashFile(asset.input.c_str(), asset.sourceSize, asset.sourceHash))
+        {
+            asset.status = asset_failed;
+            return;
+        }
+        asset.hashTime = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+
+        if (!options.force && IsUpToDate(asset, converterHash))
+        {
+            asset.status = asset_skipped;
+            asset.totalTime = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+            return;
+        }
+
+        AssimpModel model;
+        model.SetWeldOptions(options.weldOptions);
+        model.SetCompressVertices(options.compressVertices);
+        model.SetBuildMeshlets(options.buildMeshlets);
+
+        asset.status = asset_failed;
+        if (model.Load(asset.input.c_str()))
+        {
+            asset.passTimes = model.GetPassTimes();
+            for (unsigned int meshIndex = 0; meshIndex < model.m_Header.meshCount; meshIndex++)
+                asset.vertexCount += model.m_pMesh[meshIndex].vertexCount;
+            asset.indexCount = model.m_Header.indexDataByteSize / sizeof(uint16_t);
+
+            int64_t saveStart = SystemTime::GetCurrentTick();
+            CreateParentDirectories(asset.output);
+            if (model.Save(asset.output.c_str()))
+            {
+                WriteStamp(asset, converterHash);
+                asset.status = asset_converted;
+            }
+            asset.saveTime = SystemTime::TimeBetweenTicks(saveStart, SystemTime::GetCurrentTick());
+        }
+
+        asset.totalTime = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+    }
+
+    void WriteJsonString(FILE *file, const std::string &string)
+    {
+        fputc('"', file);
+        for (char c : string)
+        {
+            if (c == '"' || c == '\\')
+                fputc('\\', file);
+            fputc(c, file);
+        }
+        fputc('"', file);
+    }
+
+    bool WriteReport(const char *filename, const std::vector<Asset> &assets, const Hash128 &converterHash, double totalTime)
+    {
+        FILE *file = nullptr;
+        if (0 != fopen_s(&file, filename, "w"))
+            return false;
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"converter_hash\": \"%016llx%016llx\",\n", (unsigned long long)converterHash.Hi, (unsigned long long)converterHash.Lo);
+        fprintf(file, "  \"total_ms\": %.3f,\n", totalTime * 1000.0);
+        fprintf(file, "  \"assets\": [\n");
+        for (size_t n = 0; n < assets.size(); n++)
+        {
+            const Asset &asset = assets[n];
+            fprintf(file, "    { \"input\": ");
+            WriteJsonString(file, asset.input);
+            fprintf(file, ", \"output\": ");
+            WriteJsonString(file, asset.output);
+            fprintf(file, ", \"status\": \"%s\", \"source_size\": %llu, \"source_hash\": \"%016llx%016llx\"", s_StatusString[asset.status],
+                (unsigned long long)asset.sourceSize, (unsigned long long)asset.sourceHash.Hi, (unsigned long long)asset.sourceHash.Lo);
+            fprintf(file, ", \"vertices\": %u, \"indices\": %u", asset.vertexCount, asset.indexCount);
+            fprintf(file, ", \"hash_ms\": %.3f, \"import_ms\": %.3f, \"remove_duplicate_vertices_ms\": %.3f",
+                asset.hashTime * 1000.0, asset.passTimes.import * 1000.0, asset.passTimes.removeDuplicateVertices * 1000.0);
+            fprintf(file, ", \"post_transform_ms\": %.3f, \"pre_transform_ms\": %.3f, \"quantize_ms\": %.3f, \"meshlets_ms\": %.3f, \"save_ms\": %.3f, \"total_ms\": %.3f }%s\n",
+                asset.passTimes.postTransform * 1000.0, asset.passTimes.preTransform * 1000.0, asset.passTimes.quantize * 1000.0, asset.passTimes.meshlets * 1000.0, asset.saveTime * 1000.0,
+                asset.totalTime * 1000.0, n + 1 < assets.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n");
+        fprintf(file, "}\n");
+
+        fclose(file);
+        return true;
+    }
+}
+
+int RunBatch(const BatchOptions &options)
+{
+    std::vector<Asset> assets;
+    DWORD sourceAttributes = GetFileAttributesA(options.source);
+    if (sourceAttributes == INVALID_FILE_ATTRIBUTES)
+    {
+        printf("batch source not found: %s\n", options.source);
+        return -1;
+    }
+    else if (sourceAttributes & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        Assimp::Importer importer;
+        GatherDirectory(options.source, std::string(), options.outputDirectory, importer, assets);
+    }
+    else if (!ReadManifest(options.source, assets))
+    {
+        return -1;
+    }
+
+    if (!CheckUniqueOutputs(assets))
+        return -1;
+
+    printf("converting %u assets\n", (unsigned int)assets.size());
+
+    const Hash128 converterHash = ComputeConverterHash(options.weldOptions, options.compressVertices, options.buildMeshlets);
+
+    // meshes are optimized with nested parallel loops, so assets and meshes share
+    // the same worker threads
+    if (options.jobs > 0)
+    {
+        concurrency::CurrentScheduler::Create(concurrency::SchedulerPolicy(2,
+            concurrency::MinConcurrency, 1, concurrency::MaxConcurrency, options.jobs));
+    }
+
+    int64_t start = SystemTime::GetCurrentTick();
+    concurrency::parallel_for(size_t(0), assets.size(), [&](size_t assetIndex)
+    {
+        Asset &asset = assets[assetIndex];
+        ConvertAsset(asset, options, converterHash);
+        printf("%s %s -> %s (%.3f ms)\n", s_StatusString[asset.status], asset.input.c_str(), asset.output.c_str(), asset.totalTime * 1000.0);
+    });
+    double totalTime = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+
+    if (options.jobs > 0)
+        concurrency::CurrentScheduler::Detach();
+
+    unsigned int counts[_countof(s_StatusString)] = {};
+    for (const Asset &asset : assets)
+        counts[asset.status]++;
+    printf("done in %.3f ms: %u converted, %u skipped, %u failed\n", totalTime * 1000.0,
+        counts[asset_converted], counts[asset_skipped], counts[asset_failed]);
+
+    if (options.reportFile && !WriteReport(options.reportFile, assets, converterHash, totalTime))
+    {
+        printf("failed to write report: %s\n", options.reportFile);
+        return -1;
+    }
+
+    return counts[asset_failed] == 0 ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#pragma once
+
+#include "ModelAssimp.h"
+
+struct BatchOptions
+{
+    // manifest file with one "input_file output_file" pair per line, or a
+    // directory whose model files are all converted
+    const char *source;
+
+    // where outputs of a directory source go, next to the sources if null
+    const char *outputDirectory;
+
+    // optional JSON report of per asset status and pass timings
+    const char *reportFile;
+
+    // worker threads, 0 uses every core
+    unsigned int jobs;
+
+    // convert assets even when their stamp says they are up to date
+    bool force;
+
+    AssimpModel::WeldOptions weldOptions;
+    bool compressVertices;
+    bool buildMeshlets;
+};
+
+// Converts every asset of a batch on a thread pool. An asset is skipped when the
+// stamp written next to its output matches the hash of its source and of the
+// converter. Returns 0 when no asset failed.
+int RunBatch(const BatchOptions &options);
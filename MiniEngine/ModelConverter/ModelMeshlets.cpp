@@ -0,0 +1,283 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "ModelAssimp.h"
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <ppl.h>
+
+namespace
+{
+    // Reads positions of either the float or the quantized vertex layout
+    struct PositionReader
+    {
+        PositionReader(const Model::Mesh &mesh, const unsigned char *vertexData)
+        {
+            const Model::Attrib &attrib = mesh.attrib[Model::attrib_position];
+            m_pData = vertexData + mesh.vertexDataByteOffset + attrib.offset;
+            m_Stride = mesh.vertexStride;
+            m_Quantized = attrib.format == Model::attrib_format_ushort;
+
+            const float boundsMin[3] = { (float)mesh.boundingBox.min.GetX(), (float)mesh.boundingBox.min.GetY(), (float)mesh.boundingBox.min.GetZ() };
+            const float boundsMax[3] = { (float)mesh.boundingBox.max.GetX(), (float)mesh.boundingBox.max.GetY(), (float)mesh.boundingBox.max.GetZ() };
+            for (int c = 0; c < 3; c++)
+            {
+                m_Offset[c] = boundsMin[c];
+                m_Scale[c] = (boundsMax[c] - boundsMin[c]) / 65535.0f;
+            }
+        }
+
+        void Read(unsigned int vertex, float *position) const
+        {
+            const unsigned char *p = m_pData + vertex * m_Stride;
+            for (int c = 0; c < 3; c++)
+                position[c] = m_Quantized ? m_Offset[c] + ((const uint16_t*)p)[c] * m_Scale[c] : ((const float*)p)[c];
+        }
+
+        const unsigned char *m_pData;
+        unsigned int m_Stride;
+        bool m_Quantized;
+        float m_Offset[3];
+        float m_Scale[3];
+    };
+
+    float Dot(const float *a, const float *b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    float DistanceSquared(const float *a, const float *b)
+    {
+        const float d[3] = { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+        return Dot(d, d);
+    }
+
+    // Ritter's bounding sphere: start from two far apart points, then grow to include outliers
+    void ComputeBoundingSphere(const std::vector<float> &points, Model::Meshlet &meshlet)
+    {
+        const size_t count = points.size() / 3;
+        const float *p = points.data();
+
+        size_t far0 = 0;
+        for (size_t n = 1; n < count; n++)
+        {
+            if (DistanceSquared(p, p + n * 3) > DistanceSquared(p, p + far0 * 3))
+                far0 = n;
+        }
+        size_t far1 = far0;
+        for (size_t n = 0; n < count; n++)
+        {
+            if (DistanceSquared(p + far0 * 3, p + n * 3) > DistanceSquared(p + far0 * 3, p + far1 * 3))
+                far1 = n;
+        }
+
+        float *center = meshlet.center;
+        for (int c = 0; c < 3; c++)
+            center[c] = (p[far0 * 3 + c] + p[far1 * 3 + c]) * 0.5f;
+        float radius = sqrtf(DistanceSquared(p + far0 * 3, p + far1 * 3)) * 0.5f;
+
+        for (size_t n = 0; n < count; n++)
+        {
+            const float distance = sqrtf(DistanceSquared(center, p + n * 3));
+            if (distance > radius)
+            {
+                const float newRadius = (radius + distance) * 0.5f;
+                const float shift = (newRadius - radius) / distance;
+                for (int c = 0; c < 3; c++)
+                    center[c] += (p[n * 3 + c] - center[c]) * shift;
+                radius = newRadius;
+            }
+        }
+        meshlet.radius = radius;
+    }
+
+    // The cone bounds the triangle normals. Cones wider than about 84 degrees can't
+    // cull anything useful and get a cutoff that never passes the culling test.
+    void ComputeNormalCone(const std::vector<float> &normals, Model::Meshlet &meshlet)
+    {
+        float axis[3] = { 0.0f, 0.0f, 0.0f };
+        for (size_t n = 0; n < normals.size(); n += 3)
+        {
+            for (int c = 0; c < 3; c++)
+                axis[c] += normals[n + c];
+        }
+
+        const float length = sqrtf(Dot(axis, axis));
+        float minDot = 1.0f;
+        if (length > 0.0f)
+        {
+            for (int c = 0; c < 3; c++)
+                axis[c] /= length;
+            for (size_t n = 0; n < normals.size(); n += 3)
+                minDot = fminf(minDot, Dot(axis, &normals[n]));
+        }
+
+        if (length == 0.0f || minDot <= 0.1f)
+        {
+            meshlet.coneAxis[0] = meshlet.coneAxis[1] = meshlet.coneAxis[2] = 0.0f;
+            meshlet.coneCutoff = 1.0f;
+            return;
+        }
+
+        for (int c = 0; c < 3; c++)
+            meshlet.coneAxis[c] = axis[c];
+        meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+
+    struct MeshMeshlets
+    {
+        std::vector<Model::Meshlet> meshlets;
+        std::vector<uint16_t> vertices;
+        std::vector<uint32_t> primitives;
+    };
+
+    //
+    // Cuts the index buffer into runs of triangles that fit the meshlet limits. The
+    // indices were already ordered for the post-transform cache, so consecutive
+    // triangles share most of their vertices.
+    //
+    void BuildMeshMeshlets(const Model::Mesh &mesh, const unsigned char *vertexData, const uint16_t *indices, MeshMeshlets &result)
+    {
+        const PositionReader positions(mesh, vertexData);
+
+        const uint8_t kNotInMeshlet = 0xff;
+        std::vector<uint8_t> localIndex(mesh.vertexCount, kNotInMeshlet);
+
+        Model::Meshlet meshlet = {};
+        std::vector<float> points, normals;
+
+        auto finishMeshlet = [&]()
+        {
+            if (meshlet.primitiveCount == 0)
+                return;
+
+            points.resize(meshlet.vertexCount * 3);
+            for (uint32_t n = 0; n < meshlet.vertexCount; n++)
+            {
+                const uint16_t vertex = result.vertices[meshlet.vertexOffset + n];
+                positions.Read(vertex, &points[n * 3]);
+                localIndex[vertex] = kNotInMeshlet;
+            }
+
+            normals.clear();
+            for (uint32_t n = 0; n < meshlet.primitiveCount; n++)
+            {
+                const uint32_t primitive = result.primitives[meshlet.primitiveOffset + n];
+                const float *p0 = &points[(primitive & 0xff) * 3];
+                const float *p1 = &points[((primitive >> 8) & 0xff) * 3];
+                const float *p2 = &points[((primitive >> 16) & 0xff) * 3];
+                const float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                const float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                float normal[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+
+                // degenerate triangles face nowhere and don't widen the cone
+                const float length = sqrtf(Dot(normal, normal));
+                if (length == 0.0f)
+                    continue;
+                normals.push_back(normal[0] / length);
+                normals.push_back(normal[1] / length);
+                normals.push_back(normal[2] / length);
+            }
+
+            ComputeBoundingSphere(points, meshlet);
+            ComputeNormalCone(normals, meshlet);
+            result.meshlets.push_back(meshlet);
+
+            meshlet = {};
+            meshlet.vertexOffset = (uint32_t)result.vertices.size();
+            meshlet.primitiveOffset = (uint32_t)result.primitives.size();
+        };
+
+        for (unsigned int n = 0; n < mesh.indexCount; n += 3)
+        {
+            const uint16_t *triangle = indices + n;
+
+            uint32_t newVertices = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                if (localIndex[triangle[c]] == kNotInMeshlet && (c < 1 || triangle[c] != triangle[0]) && (c < 2 || triangle[c] != triangle[1]))
+                    newVertices++;
+            }
+
+            if (meshlet.vertexCount + newVertices > Model::maxMeshletVertices || meshlet.primitiveCount + 1 > Model::maxMeshletPrimitives)
+                finishMeshlet();
+
+            uint32_t primitive = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                if (localIndex[triangle[c]] == kNotInMeshlet)
+                {
+                    localIndex[triangle[c]] = (uint8_t)meshlet.vertexCount++;
+                    result.vertices.push_back(triangle[c]);
+                }
+                primitive |= (uint32_t)localIndex[triangle[c]] << (c * 8);
+            }
+            result.primitives.push_back(primitive);
+            meshlet.primitiveCount++;
+        }
+        finishMeshlet();
+    }
+}
+
+void AssimpModel::BuildMeshlets()
+{
+    std::vector<MeshMeshlets> meshMeshlets(m_Header.meshCount);
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        const Mesh &mesh = m_pMesh[meshIndex];
+        BuildMeshMeshlets(mesh, m_pVertexData, (const uint16_t*)(m_pIndexData + mesh.indexDataByteOffset), meshMeshlets[meshIndex]);
+    });
+
+    delete [] m_pMeshletRanges;
+    delete [] m_pMeshlets;
+    delete [] m_pMeshletVertices;
+    delete [] m_pMeshletPrimitives;
+
+    memset(&m_MeshletHeader, 0, sizeof(m_MeshletHeader));
+    for (const MeshMeshlets &meshlets : meshMeshlets)
+    {
+        m_MeshletHeader.meshletCount += (uint32_t)meshlets.meshlets.size();
+        m_MeshletHeader.vertexCount += (uint32_t)meshlets.vertices.size();
+        m_MeshletHeader.primitiveCount += (uint32_t)meshlets.primitives.size();
+    }
+
+    m_pMeshletRanges = new MeshletRange[m_Header.meshCount];
+    m_pMeshlets = new Meshlet[m_MeshletHeader.meshletCount];
+    m_pMeshletVertices = new uint16_t[m_MeshletHeader.vertexCount];
+    m_pMeshletPrimitives = new uint32_t[m_MeshletHeader.primitiveCount];
+
+    // concatenate the meshes, rebasing meshlet offsets onto the shared arrays
+    uint32_t meshletCount = 0, vertexCount = 0, primitiveCount = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        const MeshMeshlets &meshlets = meshMeshlets[meshIndex];
+
+        m_pMeshletRanges[meshIndex].firstMeshlet = meshletCount;
+        m_pMeshletRanges[meshIndex].meshletCount = (uint32_t)meshlets.meshlets.size();
+
+        for (const Meshlet &meshlet : meshlets.meshlets)
+        {
+            Meshlet &dst = m_pMeshlets[meshletCount++];
+            dst = meshlet;
+            dst.vertexOffset += vertexCount;
+            dst.primitiveOffset += primitiveCount;
+        }
+
+        if (!meshlets.vertices.empty())
+            memcpy(m_pMeshletVertices + vertexCount, meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint16_t));
+        if (!meshlets.primitives.empty())
+            memcpy(m_pMeshletPrimitives + primitiveCount, meshlets.primitives.data(), meshlets.primitives.size() * sizeof(uint32_t));
+        vertexCount += (uint32_t)meshlets.vertices.size();
+        primitiveCount += (uint32_t)meshlets.primitives.size();
+    }
+}
@@ -13,63 +13,292 @@
 
 #include "ModelAssimp.h"
 #include "IndexOptimizePostTransform.h"
+#include "Hash.h"
+#include "SystemTime.h"
 
+#include <DirectXPackedVector.h>
 #include <string.h>
+#include <math.h>
+#include <vector>
+#include <ppl.h>
 
-void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
+namespace
 {
-    unsigned char *deduplicatedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
-    uint32_t deduplicatedVertexDataSize = 0;
+    const uint32_t kNoSlot = (uint32_t)-1;
 
-    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    // open addressing multimap from vertex hash to unique vertex slot
+    class VertexHashTable
     {
-        Mesh *mesh = m_pMesh + meshIndex;
-        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
-        unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
+    public:
+        VertexHashTable(uint32_t maxEntries)
+        {
+            uint32_t capacity = 16;
+            while (capacity < maxEntries * 2)
+                capacity *= 2;
+            m_Mask = capacity - 1;
+            m_Hashes.resize(capacity);
+            m_Slots.resize(capacity, kNoSlot);
+        }
+
+        // returns the first slot stored under hash that isMatch accepts, or kNoSlot
+        template <typename MatchFunc>
+        uint32_t Find(size_t hash, MatchFunc isMatch) const
+        {
+            for (size_t n = hash & m_Mask; m_Slots[n] != kNoSlot; n = (n + 1) & m_Mask)
+            {
+                if (m_Hashes[n] == hash && isMatch(m_Slots[n]))
+                    return m_Slots[n];
+            }
+            return kNoSlot;
+        }
 
-        unsigned char *meshDeduplicatedVertexData = deduplicatedVertexData + deduplicatedVertexDataSize;
-        unsigned int deduplicatedCount = 0;
+        void Insert(size_t hash, uint32_t slot)
+        {
+            size_t n = hash & m_Mask;
+            while (m_Slots[n] != kNoSlot)
+                n = (n + 1) & m_Mask;
+            m_Hashes[n] = hash;
+            m_Slots[n] = slot;
+        }
 
-        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
-        uint32_t *vertexRemap = new uint32_t [vertexCount];
-        memset(vertexRemap, (uint32_t)-1, sizeof(uint32_t) * vertexCount);
-        assert(vertexCount <= (uint32_t)-1);
+    private:
+        size_t m_Mask;
+        std::vector<size_t> m_Hashes;
+        std::vector<uint32_t> m_Slots;
+    };
 
-        for (unsigned int v1 = 0; v1 < vertexCount; v1++)
+    // per attribute tolerance, 0 means the attribute has to match exactly
+    float GetWeldTolerance(const AssimpModel::WeldOptions &options, unsigned int attrib)
+    {
+        switch (attrib)
         {
-            if (vertexRemap[v1] != (uint32_t)-1)
-                continue; // this was already found to be a duplicate
+        case Model::attrib_position:
+            return options.positionTolerance;
+        case Model::attrib_normal:
+        case Model::attrib_tangent:
+        case Model::attrib_bitangent:
+            return options.normalTolerance;
+        case Model::attrib_texcoord0:
+            return options.texcoordTolerance;
+        default:
+            return 0.0f;
+        }
+    }
 
-            const unsigned char *v1Data = meshVertexData + v1 * vertexStride;
+    unsigned int GetAttribFormatSize(unsigned int format)
+    {
+        static const unsigned int formatSize[] = { 0, 1, 1, 2, 2, 4, 2 };
+        static_assert(_countof(formatSize) == Model::attrib_formats, "formatSize doesn't match attrib format enum");
+        return formatSize[format];
+    }
 
-            // this is a new unique vertex
-            uint32_t remappedSlot = deduplicatedCount++;
-            vertexRemap[v1] = remappedSlot;
-            memcpy(meshDeduplicatedVertexData + remappedSlot * vertexStride, v1Data, vertexStride);
+    struct MeshVertexFormat
+    {
+        unsigned int stride;
+        unsigned int attribsEnabled;
+        const Model::Attrib *attrib;
+    };
+
+    //
+    // Writes the key a vertex is hashed and compared by in weld_quantize mode: the
+    // vertex with each toleranced float component replaced by its grid cell. Bytes
+    // outside of any attribute are zeroed so padding never splits vertices.
+    //
+    void QuantizeVertex(const MeshVertexFormat &format, const AssimpModel::WeldOptions &options,
+        const unsigned char *vertex, uint32_t *key)
+    {
+        memset(key, 0, format.stride);
+        for (unsigned int a = 0; a < Model::maxAttribs; a++)
+        {
+            const Model::Attrib &attrib = format.attrib[a];
+            if (!(format.attribsEnabled & (1 << a)) || attrib.format == Model::attrib_format_none)
+                continue;
 
-            // scan for duplicates
-            for (unsigned int v2 = v1 + 1; v2 < vertexCount; v2++)
+            const float tolerance = GetWeldTolerance(options, a);
+            if (attrib.format != Model::attrib_format_float || tolerance <= 0.0f)
             {
-                if (vertexRemap[v2] != (uint32_t)-1)
-                    continue; // this was already found to be a duplicate of another vertex
+                memcpy((unsigned char*)key + attrib.offset, vertex + attrib.offset, attrib.components * GetAttribFormatSize(attrib.format));
+                continue;
+            }
+
+            const float *src = (const float*)(vertex + attrib.offset);
+            int32_t *dst = (int32_t*)((unsigned char*)key + attrib.offset);
+            for (unsigned int c = 0; c < attrib.components; c++)
+                dst[c] = (int32_t)floorf(src[c] / tolerance + 0.5f);
+        }
+    }
+
+    // weld_epsilon comparison: toleranced float components within tolerance, everything else identical
+    bool AreVerticesWithinTolerance(const MeshVertexFormat &format, const AssimpModel::WeldOptions &options,
+        const unsigned char *v1, const unsigned char *v2)
+    {
+        for (unsigned int a = 0; a < Model::maxAttribs; a++)
+        {
+            const Model::Attrib &attrib = format.attrib[a];
+            if (!(format.attribsEnabled & (1 << a)) || attrib.format == Model::attrib_format_none)
+                continue;
 
-                const unsigned char *v2Data = meshVertexData + v2 * vertexStride;
+            const float tolerance = GetWeldTolerance(options, a);
+            if (attrib.format != Model::attrib_format_float || tolerance <= 0.0f)
+            {
+                if (0 != memcmp(v1 + attrib.offset, v2 + attrib.offset, attrib.components * GetAttribFormatSize(attrib.format)))
+                    return false;
+                continue;
+            }
 
-                if (0 == memcmp(v1Data, v2Data, vertexStride))
+            const float *f1 = (const float*)(v1 + attrib.offset);
+            const float *f2 = (const float*)(v2 + attrib.offset);
+            for (unsigned int c = 0; c < attrib.components; c++)
+            {
+                if (!(fabsf(f1[c] - f2[c]) <= tolerance))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    size_t HashWords(const uint32_t *words, unsigned int wordCount)
+    {
+        return Utility::HashRange(words, words + wordCount, 2166136261U);
+    }
+
+    //
+    // Removes duplicates from one mesh's vertices in place and remaps its indices. The
+    // first vertex of each group of duplicates is kept, so unique vertices keep their
+    // relative order and, in weld_exact mode, the result is the same as comparing every
+    // pair of vertices. Returns the number of unique vertices.
+    //
+    uint32_t RemoveDuplicateVertices(const MeshVertexFormat &format, const AssimpModel::WeldOptions &options,
+        unsigned char *vertexData, unsigned int vertexCount, uint16_t *indexArray, unsigned int indexCount)
+    {
+        assert(format.stride % 4 == 0);
+        const unsigned int strideWords = format.stride / 4;
+
+        VertexHashTable table(vertexCount);
+        std::vector<uint32_t> vertexRemap(vertexCount);
+        std::vector<uint32_t> quantizedVertex(options.mode == AssimpModel::weld_quantize ? strideWords : 0);
+        std::vector<uint32_t> uniqueKeys;
+        if (options.mode == AssimpModel::weld_quantize)
+            uniqueKeys.resize((size_t)vertexCount * strideWords);
+
+        // weld_epsilon buckets vertices by the grid cell of their position and searches
+        // the neighboring cells, so any two positions within tolerance are compared
+        const Model::Attrib &position = format.attrib[Model::attrib_position];
+        const bool weldByCell = options.mode == AssimpModel::weld_epsilon && options.positionTolerance > 0.0f &&
+            (format.attribsEnabled & Model::attrib_mask_position) && position.format == Model::attrib_format_float &&
+            position.components == 3;
+
+        uint32_t uniqueCount = 0;
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            const unsigned char *vData = vertexData + v * format.stride;
+            uint32_t match = kNoSlot;
+            size_t hash;
+
+            if (weldByCell)
+            {
+                const float *p = (const float*)(vData + position.offset);
+                int32_t cell[3];
+                for (int c = 0; c < 3; c++)
+                    cell[c] = (int32_t)floorf(p[c] / options.positionTolerance);
+
+                for (int n = 0; n < 27 && match == kNoSlot; n++)
                 {
-                    vertexRemap[v2] = remappedSlot;
+                    const int32_t neighbor[3] = { cell[0] + n % 3 - 1, cell[1] + (n / 3) % 3 - 1, cell[2] + n / 9 - 1 };
+                    match = table.Find(HashWords((const uint32_t*)neighbor, 3), [&](uint32_t slot)
+                    {
+                        return AreVerticesWithinTolerance(format, options, vertexData + slot * format.stride, vData);
+                    });
                 }
+                hash = HashWords((const uint32_t*)cell, 3);
             }
+            else if (options.mode == AssimpModel::weld_exact)
+            {
+                hash = HashWords((const uint32_t*)vData, strideWords);
+                match = table.Find(hash, [&](uint32_t slot)
+                {
+                    return 0 == memcmp(vertexData + slot * format.stride, vData, format.stride);
+                });
+            }
+            else if (options.mode == AssimpModel::weld_quantize)
+            {
+                QuantizeVertex(format, options, vData, quantizedVertex.data());
+                hash = HashWords(quantizedVertex.data(), strideWords);
+                match = table.Find(hash, [&](uint32_t slot)
+                {
+                    return 0 == memcmp(uniqueKeys.data() + slot * strideWords, quantizedVertex.data(), format.stride);
+                });
+            }
+            else
+            {
+                // weld_epsilon without a position tolerance, positions have to match exactly
+                hash = HashWords((const uint32_t*)(vData + position.offset), position.components * GetAttribFormatSize(position.format) / 4);
+                match = table.Find(hash, [&](uint32_t slot)
+                {
+                    return AreVerticesWithinTolerance(format, options, vertexData + slot * format.stride, vData);
+                });
+            }
+
+            if (match != kNoSlot)
+            {
+                vertexRemap[v] = match;
+                continue;
+            }
+
+            // this is a new unique vertex, slots never pass the vertex being read
+            uint32_t remappedSlot = uniqueCount++;
+            vertexRemap[v] = remappedSlot;
+            if (remappedSlot != v)
+                memcpy(vertexData + remappedSlot * format.stride, vData, format.stride);
+            if (options.mode == AssimpModel::weld_quantize)
+                memcpy(uniqueKeys.data() + remappedSlot * strideWords, quantizedVertex.data(), format.stride);
+            table.Insert(hash, remappedSlot);
         }
 
-        unsigned int indexCount = mesh->indexCount;
-        uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
         for (unsigned int n = 0; n < indexCount; n++)
         {
-            indexArray[n] = vertexRemap[indexArray[n]];
+            indexArray[n] = (uint16_t)vertexRemap[indexArray[n]];
         }
 
-        delete [] vertexRemap;
+        return uniqueCount;
+    }
+}
+
+void AssimpModel::OptimizeRemoveDuplicateVertices(bool depth)
+{
+    unsigned char *vertexData = depth ? m_pVertexDataDepth : m_pVertexData;
+    std::vector<uint32_t> deduplicatedCounts(m_Header.meshCount);
+
+    // meshes are independent, each one is compacted within its own range of vertexData
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+
+        MeshVertexFormat format;
+        format.stride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+        format.attribsEnabled = depth ? mesh->attribsEnabledDepth : mesh->attribsEnabled;
+        format.attrib = depth ? mesh->attribDepth : mesh->attrib;
+
+        unsigned char *meshVertexData = vertexData + (depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset);
+        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
+        uint16_t *indexArray = (uint16_t*)((depth ? m_pIndexDataDepth : m_pIndexData) + mesh->indexDataByteOffset);
+
+        deduplicatedCounts[meshIndex] = RemoveDuplicateVertices(format, m_WeldOptions,
+            meshVertexData, vertexCount, indexArray, mesh->indexCount);
+    });
+
+    // pack the meshes back together
+    unsigned char *deduplicatedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
+    uint32_t deduplicatedVertexDataSize = 0;
+
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+        unsigned int deduplicatedCount = deduplicatedCounts[meshIndex];
+        unsigned char *meshVertexData = vertexData + (depth ? mesh->vertexDataByteOffsetDepth : mesh->vertexDataByteOffset);
+
+        memcpy(deduplicatedVertexData + deduplicatedVertexDataSize, meshVertexData, deduplicatedCount * vertexStride);
 
         if (depth)
         {
@@ -102,7 +331,7 @@ void AssimpModel::OptimizePostTransform(bool depth)
 {
     enum {lruCacheSize = 64};
 
-    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
     {
         Mesh *mesh = m_pMesh + meshIndex;
 
@@ -113,14 +342,15 @@ void AssimpModel::OptimizePostTransform(bool depth)
         OptimizeFaces<uint16_t>(srcIndices, mesh->indexCount, dstIndices, lruCacheSize);
 
         delete [] srcIndices;
-    }
+    });
 }
 
 void AssimpModel::OptimizePreTransform(bool depth)
 {
     unsigned char *reorderedVertexData = new unsigned char [depth ? m_Header.vertexDataByteSizeDepth : m_Header.vertexDataByteSize];
 
-    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    // every mesh reorders into its own range of the new buffer
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
     {
         Mesh *mesh = m_pMesh + meshIndex;
         unsigned int indexCount = mesh->indexCount;
@@ -153,7 +383,7 @@ void AssimpModel::OptimizePreTransform(bool depth)
         }
 
         delete [] vertexRemap;
-    }
+    });
 
     if (depth)
     {
@@ -167,18 +397,202 @@ void AssimpModel::OptimizePreTransform(bool depth)
     }
 }
 
-void AssimpModel::Optimize()
+namespace
 {
-    // TODO: quantize/compress vertex data
+    uint16_t QuantizeUnorm16(float v)
+    {
+        v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+        return (uint16_t)(v * 65535.0f + 0.5f);
+    }
+
+    int16_t QuantizeSnorm16(float v)
+    {
+        v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+        return (int16_t)floorf(v * 32767.0f + 0.5f);
+    }
+
+    // project onto the octahedron and unfold the lower half, decoded by OctahedralDecode() in the shaders
+    void OctahedralEncode(const float *v, int16_t *encoded)
+    {
+        float length = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+        if (length == 0.0f)
+        {
+            encoded[0] = encoded[1] = 0;
+            return;
+        }
+
+        float x = v[0] / length;
+        float y = v[1] / length;
+        if (v[2] < 0.0f)
+        {
+            float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x = foldedX;
+            y = foldedY;
+        }
+        encoded[0] = QuantizeSnorm16(x);
+        encoded[1] = QuantizeSnorm16(y);
+    }
+
+    void SetAttrib(Model::Attrib &attrib, uint16_t offset, uint16_t components, uint16_t format, uint16_t normalized)
+    {
+        attrib.offset = offset;
+        attrib.normalized = normalized;
+        attrib.components = components;
+        attrib.format = format;
+    }
+}
+
+//
+// Converts the float vertex streams to the layout described by
+// Model::HasQuantizedVertices(). Positions are stored relative to the mesh bounding
+// box, which the renderer turns into a scale and offset per draw.
+//
+void AssimpModel::QuantizeVertices(bool depth)
+{
+    const unsigned int quantizedStride = depth ? 8 : 20;
+
+    std::vector<uint32_t> quantizedOffsets(m_Header.meshCount);
+    uint32_t quantizedVertexDataSize = 0;
+    for (unsigned int meshIndex = 0; meshIndex < m_Header.meshCount; meshIndex++)
+    {
+        quantizedOffsets[meshIndex] = quantizedVertexDataSize;
+        quantizedVertexDataSize += quantizedStride * (depth ? m_pMesh[meshIndex].vertexCountDepth : m_pMesh[meshIndex].vertexCount);
+    }
+    unsigned char *quantizedVertexData = new unsigned char [quantizedVertexDataSize];
 
-    OptimizeRemoveDuplicateVertices(false);
-    OptimizeRemoveDuplicateVertices(true);
+    concurrency::parallel_for(0u, m_Header.meshCount, [&](unsigned int meshIndex)
+    {
+        Mesh *mesh = m_pMesh + meshIndex;
+        Attrib *attrib = depth ? mesh->attribDepth : mesh->attrib;
+        unsigned int vertexStride = depth ? mesh->vertexStrideDepth : mesh->vertexStride;
+        unsigned int vertexCount = depth ? mesh->vertexCountDepth : mesh->vertexCount;
+        const unsigned char *meshVertexData = depth ? (m_pVertexDataDepth + mesh->vertexDataByteOffsetDepth) : (m_pVertexData + mesh->vertexDataByteOffset);
+        unsigned char *meshQuantizedVertexData = quantizedVertexData + quantizedOffsets[meshIndex];
+
+        assert(attrib[attrib_position].format == attrib_format_float && attrib[attrib_position].components == 3);
+
+        const float boundsMin[3] = { (float)mesh->boundingBox.min.GetX(), (float)mesh->boundingBox.min.GetY(), (float)mesh->boundingBox.min.GetZ() };
+        const float boundsMax[3] = { (float)mesh->boundingBox.max.GetX(), (float)mesh->boundingBox.max.GetY(), (float)mesh->boundingBox.max.GetZ() };
+        float positionScale[3];
+        for (int c = 0; c < 3; c++)
+            positionScale[c] = boundsMax[c] > boundsMin[c] ? 1.0f / (boundsMax[c] - boundsMin[c]) : 0.0f;
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            const unsigned char *vSrc = meshVertexData + v * vertexStride;
+            unsigned char *vDst = meshQuantizedVertexData + v * quantizedStride;
+
+            const float *position = (const float*)(vSrc + attrib[attrib_position].offset);
+            uint16_t *dstPosition = (uint16_t*)vDst;
+            for (int c = 0; c < 3; c++)
+                dstPosition[c] = QuantizeUnorm16((position[c] - boundsMin[c]) * positionScale[c]);
+            dstPosition[3] = 0;
+
+            if (depth)
+                continue;
+
+            const float *texcoord0 = (const float*)(vSrc + attrib[attrib_texcoord0].offset);
+            const float *normal = (const float*)(vSrc + attrib[attrib_normal].offset);
+            const float *tangent = (const float*)(vSrc + attrib[attrib_tangent].offset);
+            const float *bitangent = (const float*)(vSrc + attrib[attrib_bitangent].offset);
+
+            // only the handedness of the bitangent is kept
+            const float cross[3] =
+            {
+                normal[1] * tangent[2] - normal[2] * tangent[1],
+                normal[2] * tangent[0] - normal[0] * tangent[2],
+                normal[0] * tangent[1] - normal[1] * tangent[0],
+            };
+            const float handedness = cross[0] * bitangent[0] + cross[1] * bitangent[1] + cross[2] * bitangent[2];
+            dstPosition[3] = handedness < 0.0f ? 0 : 0xffff;
+
+            DirectX::PackedVector::HALF *dstTexcoord0 = (DirectX::PackedVector::HALF*)(vDst + 8);
+            dstTexcoord0[0] = DirectX::PackedVector::XMConvertFloatToHalf(texcoord0[0]);
+            dstTexcoord0[1] = DirectX::PackedVector::XMConvertFloatToHalf(texcoord0[1]);
+
+            OctahedralEncode(normal, (int16_t*)(vDst + 12));
+            OctahedralEncode(tangent, (int16_t*)(vDst + 16));
+        }
+
+        if (depth)
+        {
+            memset(mesh->attribDepth, 0, sizeof(mesh->attribDepth));
+            SetAttrib(mesh->attribDepth[attrib_position], 0, 4, attrib_format_ushort, 1);
+            mesh->vertexStrideDepth = quantizedStride;
+            mesh->vertexDataByteOffsetDepth = quantizedOffsets[meshIndex];
+        }
+        else
+        {
+            memset(mesh->attrib, 0, sizeof(mesh->attrib));
+            SetAttrib(mesh->attrib[attrib_position], 0, 4, attrib_format_ushort, 1);
+            SetAttrib(mesh->attrib[attrib_texcoord0], 8, 2, attrib_format_half, 0);
+            SetAttrib(mesh->attrib[attrib_normal], 12, 2, attrib_format_short, 1);
+            SetAttrib(mesh->attrib[attrib_tangent], 16, 2, attrib_format_short, 1);
+            mesh->attribsEnabled = attrib_mask_position | attrib_mask_texcoord0 | attrib_mask_normal | attrib_mask_tangent;
+            mesh->vertexStride = quantizedStride;
+            mesh->vertexDataByteOffset = quantizedOffsets[meshIndex];
+        }
+    });
+
+    if (depth)
+    {
+        delete [] m_pVertexDataDepth;
+        m_pVertexDataDepth = quantizedVertexData;
+        m_Header.vertexDataByteSizeDepth = quantizedVertexDataSize;
+    }
+    else
+    {
+        delete [] m_pVertexData;
+        m_pVertexData = quantizedVertexData;
+        m_Header.vertexDataByteSize = quantizedVertexDataSize;
+    }
+}
+
+void AssimpModel::Optimize()
+{
+    // the depth-only and full vertex streams are independent, each pass runs
+    // on both at once and the meshes of a stream in parallel
+    int64_t start = SystemTime::GetCurrentTick();
+    concurrency::parallel_invoke(
+        [this] { OptimizeRemoveDuplicateVertices(false); },
+        [this] { OptimizeRemoveDuplicateVertices(true); });
+    int64_t end = SystemTime::GetCurrentTick();
+    m_PassTimes.removeDuplicateVertices = SystemTime::TimeBetweenTicks(start, end);
 
     // re-order indices for post transform cache
-    OptimizePostTransform(false);
-    OptimizePostTransform(true);
+    start = end;
+    concurrency::parallel_invoke(
+        [this] { OptimizePostTransform(false); },
+        [this] { OptimizePostTransform(true); });
+    end = SystemTime::GetCurrentTick();
+    m_PassTimes.postTransform = SystemTime::TimeBetweenTicks(start, end);
 
     // re-order vertices for linear memory access
-    OptimizePreTransform(false);
-    OptimizePreTransform(true);
+    start = end;
+    concurrency::parallel_invoke(
+        [this] { OptimizePreTransform(false); },
+        [this] { OptimizePreTransform(true); });
+    end = SystemTime::GetCurrentTick();
+    m_PassTimes.preTransform = SystemTime::TimeBetweenTicks(start, end);
+
+    if (m_CompressVertices)
+    {
+        // vertices that only differed below the quantized precision are merged afterwards,
+        // which keeps the first use order of the pre-transform pass
+        start = end;
+        concurrency::parallel_invoke(
+            [this] { QuantizeVertices(false); OptimizeRemoveDuplicateVertices(false); },
+            [this] { QuantizeVertices(true); OptimizeRemoveDuplicateVertices(true); });
+        end = SystemTime::GetCurrentTick();
+        m_PassTimes.quantize = SystemTime::TimeBetweenTicks(start, end);
+    }
+
+    // meshlets reference final vertex indices, so they are cut last
+    if (m_BuildMeshlets)
+    {
+        start = end;
+        BuildMeshlets();
+        m_PassTimes.meshlets = SystemTime::TimeBetweenTicks(start, SystemTime::GetCurrentTick());
+    }
 }
@@ -32,6 +32,10 @@
 #include "ShadowCamera.h"
 #include "ParticleEffectManager.h"
 #include "GameInput.h"
+#include "JobSystem.h"
+#include "Math/FrustumCuller.h"
+#include "RadixSort.h"
+#include "FileUtility.h"
 #include "./ForwardPlusLighting.h"
 
 // To enable wave intrinsics, uncomment this macro and #define DXIL in Core/GraphcisCore.cpp.
@@ -39,12 +43,16 @@
 //#define _WAVE_OP
 
 #include "CompiledShaders/DepthViewerVS.h"
+#include "CompiledShaders/DepthViewerQuantizedVS.h"
 #include "CompiledShaders/DepthViewerPS.h"
 #include "CompiledShaders/ModelViewerVS.h"
+#include "CompiledShaders/ModelViewerQuantizedVS.h"
 #include "CompiledShaders/ModelViewerPS.h"
 #ifdef _WAVE_OP
 #include "CompiledShaders/DepthViewerVS_SM6.h"
+#include "CompiledShaders/DepthViewerQuantizedVS_SM6.h"
 #include "CompiledShaders/ModelViewerVS_SM6.h"
+#include "CompiledShaders/ModelViewerQuantizedVS_SM6.h"
 #include "CompiledShaders/ModelViewerPS_SM6.h"
 #endif
 #include "CompiledShaders/WaveTileCountPS.h"
@@ -64,13 +72,19 @@ public:
 
     virtual void Update( float deltaT ) override;
     virtual void RenderScene( void ) override;
+    virtual void RenderUI( class GraphicsContext& ) override;
 
 private:
 
-    void RenderLightShadows(GraphicsContext& gfxContext);
+    void SetupGraphicsState(GraphicsContext& gfxContext);
+    GraphicsContext* RenderLightShadows(void);
+    GraphicsContext* RenderSunShadow(void);
 
     enum eObjectFilter { kOpaque = 0x1, kCutout = 0x2, kTransparent = 0x4, kAll = 0xF, kNone = 0x0 };
-    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll );
+    enum eCullView { kCameraView, kSunView, kLightView, kNumCullViews };
+    void CullObjects( void );
+    void BuildDrawPackets( void );
+    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eCullView View, eObjectFilter Filter = kAll );
     void CreateParticleEffects();
     Camera m_Camera;
     std::auto_ptr<CameraController> m_CameraController;
@@ -101,6 +115,25 @@ private:
 
     Vector3 m_SunDirection;
     ShadowCamera m_SunShadow;
+
+    // mesh bounds, culled against every view of the frame in one pass
+    FrustumCuller m_MeshCuller;
+    uint32_t m_CullViews[kNumCullViews];
+    uint32_t m_ShadowedLightIndex;
+
+    // sorted draw packets of every view, and the run of each view's opaque and cutout draws
+    std::vector<uint64_t> m_DrawPackets;
+    std::vector<uint64_t> m_DrawPacketScratch;
+    uint32_t m_DrawPacketRanges[kNumCullViews][2][2];
+
+    struct DrawStats
+    {
+        uint32_t draws;
+        uint32_t descriptorTableSets;
+        uint32_t rootConstantSets;
+        int64_t cpuTicks; // sorting and command emission
+    };
+    DrawStats m_DrawStats[kNumCullViews]; // views record on different threads
 };
 
 CREATE_APPLICATION( ModelViewer )
@@ -114,6 +147,23 @@ NumVar ShadowDimY("Application/Lighting/Shadow Dim Y", 3000, 1000, 10000, 100 );
 NumVar ShadowDimZ("Application/Lighting/Shadow Dim Z", 3000, 1000, 10000, 100 );
 
 BoolVar ShowWaveTileCounts("Application/Forward+/Show Wave Tile Counts", false);
+BoolVar EnableFrustumCulling("Application/Frustum Culling", true);
+BoolVar SortDrawPackets("Application/Sort Draw Packets", true);
+BoolVar ShowDrawStats("Application/Show Draw Stats", false);
+
+namespace
+{
+    // A draw packet is a 64-bit key, from the top bit down:
+    //   view (2) | cutout (1) | material (13) | depth bucket (16) | mesh index (32)
+    // Sorting them puts each RenderObjects call in one contiguous run, groups draws
+    // by material so textures are bound once per material, and orders a material's
+    // draws front to back.
+    const uint32_t kPacketViewShift = 62;
+    const uint32_t kPacketCutoutShift = 61;
+    const uint32_t kPacketMaterialShift = 48;
+    const uint32_t kPacketDepthShift = 32;
+    const uint32_t kMaxPacketMaterials = 1 << 13;
+}
 #ifdef _WAVE_OP
 BoolVar EnableWaveOps("Application/Forward+/Enable Wave Ops", true);
 #endif
@@ -130,13 +180,21 @@ void ModelViewer::Startup( void )
     m_RootSig[1].InitAsConstantBuffer(0, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 6, D3D12_SHADER_VISIBILITY_PIXEL);
     m_RootSig[3].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 64, 6, D3D12_SHADER_VISIBILITY_PIXEL);
-    m_RootSig[4].InitAsConstants(1, 2, D3D12_SHADER_VISIBILITY_VERTEX);
+    m_RootSig[4].InitAsConstants(1, 8, D3D12_SHADER_VISIBILITY_VERTEX);
     m_RootSig.Finalize(L"ModelViewer", D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     DXGI_FORMAT ColorFormat = g_SceneColorBuffer.GetFormat();
     DXGI_FORMAT DepthFormat = g_SceneDepthBuffer.GetFormat();
     DXGI_FORMAT ShadowFormat = g_ShadowBuffer.GetFormat();
 
+    // The vertex layout and shaders depend on whether the converter quantized the model
+    // Built by Tools/Scripts/BuildPackFile.py.  Without it the loose files are loaded.
+    Utility::MountPackFile(L"ModelViewer.pak");
+    TextureManager::Initialize(L"Textures/");
+    ASSERT(m_Model.Load("Models/sponza.h3d"), "Failed to load model");
+    ASSERT(m_Model.m_Header.meshCount > 0, "Model contains no meshes");
+    const bool quantized = m_Model.HasQuantizedVertices();
+
     D3D12_INPUT_ELEMENT_DESC vertElem[] =
     {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
@@ -146,15 +204,30 @@ void ModelViewer::Startup( void )
         { "BITANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
     };
 
+    // 20 bytes per vertex instead of 56, see Model::HasQuantizedVertices()
+    D3D12_INPUT_ELEMENT_DESC quantizedVertElem[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+
     // Depth-only (2x rate)
     m_DepthPSO.SetRootSignature(m_RootSig);
     m_DepthPSO.SetRasterizerState(RasterizerDefault);
     m_DepthPSO.SetBlendState(BlendNoColorWrite);
     m_DepthPSO.SetDepthStencilState(DepthStateReadWrite);
-    m_DepthPSO.SetInputLayout(_countof(vertElem), vertElem);
+    if (quantized)
+        m_DepthPSO.SetInputLayout(_countof(quantizedVertElem), quantizedVertElem);
+    else
+        m_DepthPSO.SetInputLayout(_countof(vertElem), vertElem);
     m_DepthPSO.SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
     m_DepthPSO.SetRenderTargetFormats(0, nullptr, DepthFormat);
-    m_DepthPSO.SetVertexShader(g_pDepthViewerVS, sizeof(g_pDepthViewerVS));
+    if (quantized)
+        m_DepthPSO.SetVertexShader(g_pDepthViewerQuantizedVS, sizeof(g_pDepthViewerQuantizedVS));
+    else
+        m_DepthPSO.SetVertexShader(g_pDepthViewerVS, sizeof(g_pDepthViewerVS));
     m_DepthPSO.Finalize();
 
     // Depth-only shading but with alpha testing
@@ -180,17 +253,26 @@ void ModelViewer::Startup( void )
     m_ModelPSO.SetBlendState(BlendDisable);
     m_ModelPSO.SetDepthStencilState(DepthStateTestEqual);
     m_ModelPSO.SetRenderTargetFormats(1, &ColorFormat, DepthFormat);
-    m_ModelPSO.SetVertexShader( g_pModelViewerVS, sizeof(g_pModelViewerVS) );
+    if (quantized)
+        m_ModelPSO.SetVertexShader( g_pModelViewerQuantizedVS, sizeof(g_pModelViewerQuantizedVS) );
+    else
+        m_ModelPSO.SetVertexShader( g_pModelViewerVS, sizeof(g_pModelViewerVS) );
     m_ModelPSO.SetPixelShader( g_pModelViewerPS, sizeof(g_pModelViewerPS) );
     m_ModelPSO.Finalize();
 
 #ifdef _WAVE_OP
     m_DepthWaveOpsPSO = m_DepthPSO;
-    m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerVS_SM6, sizeof(g_pDepthViewerVS_SM6) );
+    if (quantized)
+        m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerQuantizedVS_SM6, sizeof(g_pDepthViewerQuantizedVS_SM6) );
+    else
+        m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerVS_SM6, sizeof(g_pDepthViewerVS_SM6) );
     m_DepthWaveOpsPSO.Finalize();
 
     m_ModelWaveOpsPSO = m_ModelPSO;
-    m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerVS_SM6, sizeof(g_pModelViewerVS_SM6) );
+    if (quantized)
+        m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerQuantizedVS_SM6, sizeof(g_pModelViewerQuantizedVS_SM6) );
+    else
+        m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerVS_SM6, sizeof(g_pModelViewerVS_SM6) );
     m_ModelWaveOpsPSO.SetPixelShader( g_pModelViewerPS_SM6, sizeof(g_pModelViewerPS_SM6) );
     m_ModelWaveOpsPSO.Finalize();
 #endif
@@ -209,11 +291,17 @@ void ModelViewer::Startup( void )
     m_ExtraTextures[0] = g_SSAOFullScreen.GetSRV();
     m_ExtraTextures[1] = g_ShadowBuffer.GetSRV();
 
-    TextureManager::Initialize(L"Textures/");
-    ASSERT(m_Model.Load("Models/sponza.h3d"), "Failed to load model");
-    ASSERT(m_Model.m_Header.meshCount > 0, "Model contains no meshes");
-
     // The caller of this function can override which materials are considered cutouts
+    m_MeshCuller.ClearBoxes();
+    for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
+    {
+        XMFLOAT3 minBound, maxBound;
+        XMStoreFloat3(&minBound, m_Model.m_pMesh[meshIndex].boundingBox.min);
+        XMStoreFloat3(&maxBound, m_Model.m_pMesh[meshIndex].boundingBox.max);
+        m_MeshCuller.AddBox(&minBound.x, &maxBound.x);
+    }
+    m_ShadowedLightIndex = 0;
+
     m_pMaterialIsCutout.resize(m_Model.m_Header.materialCount);
     for (uint32_t i = 0; i < m_Model.m_Header.materialCount; ++i)
     {
@@ -257,6 +345,7 @@ void ModelViewer::Cleanup( void )
 {
     m_Model.Clear();
     Lighting::Shutdown();
+    Utility::UnmountPackFiles();
 }
 
 namespace Graphics
@@ -303,8 +392,84 @@ void ModelViewer::Update( float deltaT )
     m_MainScissor.bottom = (LONG)g_SceneColorBuffer.GetHeight();
 }
 
-void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter )
+void ModelViewer::CullObjects( void )
 {
+    ScopedTimer _prof(L"Frustum Culling");
+
+    m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
+        (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
+
+    auto AddCullView = [this]( const Matrix4& ViewProjMat )
+    {
+        XMFLOAT4X4 M;
+        XMStoreFloat4x4(&M, ViewProjMat);
+        return m_MeshCuller.AddView(M.m);
+    };
+
+    // Only one light shadow map is rendered per frame, so only that light gets a view
+    m_MeshCuller.ClearViews();
+    m_CullViews[kCameraView] = AddCullView(m_ViewProjMatrix);
+    m_CullViews[kSunView] = AddCullView(m_SunShadow.GetViewProjMatrix());
+    if (m_ShadowedLightIndex < Lighting::MaxLights)
+        m_CullViews[kLightView] = AddCullView(Lighting::m_LightShadowMatrix[m_ShadowedLightIndex]);
+
+    m_MeshCuller.Cull();
+}
+
+void ModelViewer::BuildDrawPackets( void )
+{
+    ScopedTimer _prof(L"Sort Draw Packets");
+
+    int64_t start = SystemTime::GetCurrentTick();
+
+    memset(m_DrawPacketRanges, 0, sizeof(m_DrawPacketRanges));
+    m_DrawPackets.clear();
+
+    // Depth buckets span the model's bounds as seen from the camera
+    const Model::BoundingBox& modelBounds = m_Model.GetBoundingBox();
+    const float depthScale = 65535.0f / Max(1.0f, (float)Length(modelBounds.max - modelBounds.min));
+    const Vector3 cameraPos = m_Camera.GetPosition();
+
+    for (uint32_t view = 0; view < m_MeshCuller.GetViewCount(); view++)
+    {
+        const uint32_t* visibleMeshes = m_MeshCuller.GetVisibleBoxes(view);
+        const uint32_t visibleCount = EnableFrustumCulling ? m_MeshCuller.GetVisibleCount(view) : m_Model.m_Header.meshCount;
+
+        for (uint32_t visibleIndex = 0; visibleIndex < visibleCount; visibleIndex++)
+        {
+            const uint32_t meshIndex = EnableFrustumCulling ? visibleMeshes[visibleIndex] : visibleIndex;
+            const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
+            ASSERT(mesh.materialIndex < kMaxPacketMaterials);
+
+            const Vector3 center = (mesh.boundingBox.min + mesh.boundingBox.max) * 0.5f;
+            const uint64_t depth = (uint64_t)Min(65535.0f, (float)Length(center - cameraPos) * depthScale);
+            const uint64_t cutout = m_pMaterialIsCutout[mesh.materialIndex] ? 1 : 0;
+
+            m_DrawPackets.push_back((uint64_t)view << kPacketViewShift | cutout << kPacketCutoutShift |
+                (uint64_t)mesh.materialIndex << kPacketMaterialShift | depth << kPacketDepthShift | meshIndex);
+        }
+    }
+
+    m_DrawPacketScratch.resize(m_DrawPackets.size());
+    Utility::RadixSort64(m_DrawPackets.data(), m_DrawPacketScratch.data(), m_DrawPackets.size());
+
+    // Views and cutout flags occupy the top bits, so each combination is a single run
+    for (uint32_t n = 0; n < (uint32_t)m_DrawPackets.size(); n++)
+    {
+        const uint64_t packet = m_DrawPackets[n];
+        uint32_t* range = m_DrawPacketRanges[packet >> kPacketViewShift][(packet >> kPacketCutoutShift) & 1];
+        if (range[0] == range[1])
+            range[0] = n;
+        range[1] = n + 1;
+    }
+
+    m_DrawStats[kCameraView].cpuTicks += SystemTime::GetCurrentTick() - start;
+}
+
+void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eCullView View, eObjectFilter Filter )
+{
+    int64_t start = SystemTime::GetCurrentTick();
+
     struct VSConstants
     {
         Matrix4 modelToProjection;
@@ -317,11 +482,27 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
 
     gfxContext.SetDynamicConstantBufferView(0, sizeof(vsConstants), &vsConstants);
 
+    // matches MeshConstants in the vertex shaders
+    struct MeshConstants
+    {
+        XMFLOAT3 positionScale;
+        uint32_t baseVertex;
+        XMFLOAT3 positionOffset;
+        uint32_t materialIdx;
+    } meshConstants;
+    meshConstants.positionScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+    meshConstants.positionOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+    const bool quantized = m_Model.HasQuantizedVertices();
+
     uint32_t materialIdx = 0xFFFFFFFFul;
 
     uint32_t VertexStride = m_Model.m_VertexStride;
 
-    for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
+    DrawStats& stats = m_DrawStats[View];
+
+    // The root constants hold the mesh's base vertex, so they change with every draw
+    auto DrawMesh = [&]( uint32_t meshIndex )
     {
         const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
 
@@ -331,36 +512,87 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
 
         if (mesh.materialIndex != materialIdx)
         {
-            if ( m_pMaterialIsCutout[mesh.materialIndex] && !(Filter & kCutout) ||
-                !m_pMaterialIsCutout[mesh.materialIndex] && !(Filter & kOpaque) )
-                continue;
-
             materialIdx = mesh.materialIndex;
             gfxContext.SetDynamicDescriptors(2, 0, 6, m_Model.GetSRVs(materialIdx) );
+            stats.descriptorTableSets++;
         }
 
-        gfxContext.SetConstants(4, baseVertex, materialIdx);
+        if (quantized)
+        {
+            XMStoreFloat3(&meshConstants.positionScale, mesh.boundingBox.max - mesh.boundingBox.min);
+            XMStoreFloat3(&meshConstants.positionOffset, mesh.boundingBox.min);
+        }
+        meshConstants.baseVertex = baseVertex;
+        meshConstants.materialIdx = materialIdx;
+        gfxContext.SetConstantArray(4, sizeof(meshConstants) / 4, &meshConstants);
+        stats.rootConstantSets++;
 
         gfxContext.DrawIndexed(indexCount, startIndex, baseVertex);
+        stats.draws++;
+    };
+
+    if (SortDrawPackets)
+    {
+        for (uint32_t cutout = 0; cutout < 2; cutout++)
+        {
+            if (!(Filter & (cutout ? kCutout : kOpaque)))
+                continue;
+
+            const uint32_t* range = m_DrawPacketRanges[m_CullViews[View]][cutout];
+            for (uint32_t n = range[0]; n < range[1]; n++)
+                DrawMesh((uint32_t)m_DrawPackets[n]);
+        }
+    }
+    else
+    {
+        // visible meshes in file order
+        const uint32_t* visibleMeshes = m_MeshCuller.GetVisibleBoxes(m_CullViews[View]);
+        const uint32_t visibleCount = EnableFrustumCulling ? m_MeshCuller.GetVisibleCount(m_CullViews[View]) : m_Model.m_Header.meshCount;
+
+        for (uint32_t visibleIndex = 0; visibleIndex < visibleCount; visibleIndex++)
+        {
+            const uint32_t meshIndex = EnableFrustumCulling ? visibleMeshes[visibleIndex] : visibleIndex;
+            const uint32_t meshMaterial = m_Model.m_pMesh[meshIndex].materialIndex;
+            if ( m_pMaterialIsCutout[meshMaterial] && !(Filter & kCutout) ||
+                !m_pMaterialIsCutout[meshMaterial] && !(Filter & kOpaque) )
+                continue;
+
+            DrawMesh(meshIndex);
+        }
     }
+
+    stats.cpuTicks += SystemTime::GetCurrentTick() - start;
 }
 
-void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
+void ModelViewer::SetupGraphicsState(GraphicsContext& gfxContext)
 {
-    using namespace Lighting;
+    gfxContext.SetRootSignature(m_RootSig);
+    gfxContext.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    gfxContext.SetIndexBuffer(m_Model.m_IndexBuffer.IndexBufferView());
+    gfxContext.SetVertexBuffer(0, m_Model.m_VertexBuffer.VertexBufferView());
+}
 
-    ScopedTimer _prof(L"RenderLightShadows", gfxContext);
+// Records this frame's cone light shadow map on its own context, or returns null once every
+// light has one.  Runs as a job, so it only touches the light shadow buffers.
+GraphicsContext* ModelViewer::RenderLightShadows(void)
+{
+    using namespace Lighting;
 
-    static uint32_t LightIndex = 0;
+    uint32_t& LightIndex = m_ShadowedLightIndex;
     if (LightIndex >= MaxLights)
-        return;
+        return nullptr;
+
+    GraphicsContext& gfxContext = GraphicsContext::Begin(L"Light Shadows");
+    SetupGraphicsState(gfxContext);
+
+    ScopedTimer _prof(L"RenderLightShadows", gfxContext);
 
     m_LightShadowTempBuffer.BeginRendering(gfxContext);
     {
         gfxContext.SetPipelineState(m_ShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kOpaque);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightView, kOpaque);
         gfxContext.SetPipelineState(m_CutoutShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kCutout);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightView, kCutout);
     }
     m_LightShadowTempBuffer.EndRendering(gfxContext);
 
@@ -372,6 +604,25 @@ void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
     gfxContext.TransitionResource(m_LightShadowArray, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 
     ++LightIndex;
+    return &gfxContext;
+}
+
+// Records the sun shadow map on its own context.  Runs as a job.
+GraphicsContext* ModelViewer::RenderSunShadow(void)
+{
+    GraphicsContext& gfxContext = GraphicsContext::Begin(L"Sun Shadow");
+    SetupGraphicsState(gfxContext);
+
+    ScopedTimer _prof(L"Render Shadow Map", gfxContext);
+
+    g_ShadowBuffer.BeginRendering(gfxContext);
+    gfxContext.SetPipelineState(m_ShadowPSO);
+    RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunView, kOpaque);
+    gfxContext.SetPipelineState(m_CutoutShadowPSO);
+    RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunView, kCutout);
+    g_ShadowBuffer.EndRendering(gfxContext);
+
+    return &gfxContext;
 }
 
 void ModelViewer::RenderScene( void )
@@ -423,18 +674,22 @@ void ModelViewer::RenderScene( void )
     psConstants.FirstLightIndex[1] = Lighting::m_FirstConeShadowedLight;
     psConstants.FrameIndexMod2 = FrameIndex;
 
-    // Set the default state for command lists
-    auto& pfnSetupGraphicsState = [&](void)
-    {
-        gfxContext.SetRootSignature(m_RootSig);
-        gfxContext.SetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        gfxContext.SetIndexBuffer(m_Model.m_IndexBuffer.IndexBufferView());
-        gfxContext.SetVertexBuffer(0, m_Model.m_VertexBuffer.VertexBufferView());
-    };
+    SetupGraphicsState(gfxContext);
 
-    pfnSetupGraphicsState();
+    memset(m_DrawStats, 0, sizeof(m_DrawStats));
+    CullObjects();
+    if (SortDrawPackets)
+        BuildDrawPackets();
 
-    RenderLightShadows(gfxContext);
+    // The shadow maps don't depend on anything else in the frame, so they record on their
+    // own contexts while this thread records the main passes.  They are submitted ahead of
+    // the main context, whose color pass samples them.
+    GraphicsContext* lightShadowContext = nullptr;
+    GraphicsContext* sunShadowContext = nullptr;
+    JobSystem::JobCounter shadowJobs;
+    JobSystem::Run([&]{ lightShadowContext = RenderLightShadows(); }, shadowJobs);
+    if (!SSAO::DebugDraw)
+        JobSystem::Run([&]{ sunShadowContext = RenderSunShadow(); }, shadowJobs);
 
     {
         ScopedTimer _prof(L"Z PrePass", gfxContext);
@@ -453,13 +708,13 @@ void ModelViewer::RenderScene( void )
 #endif
             gfxContext.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kCameraView, kOpaque );
         }
 
         {
             ScopedTimer _prof(L"Cutout", gfxContext);
             gfxContext.SetPipelineState(m_CutoutDepthPSO);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kCutout );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kCameraView, kCutout );
         }
     }
 
@@ -474,26 +729,12 @@ void ModelViewer::RenderScene( void )
         gfxContext.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, true);
         gfxContext.ClearColor(g_SceneColorBuffer);
 
-        pfnSetupGraphicsState();
-
-        {
-            ScopedTimer _prof(L"Render Shadow Map", gfxContext);
-
-            m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
-                (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
-
-            g_ShadowBuffer.BeginRendering(gfxContext);
-            gfxContext.SetPipelineState(m_ShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kOpaque);
-            gfxContext.SetPipelineState(m_CutoutShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kCutout);
-            g_ShadowBuffer.EndRendering(gfxContext);
-        }
+        SetupGraphicsState(gfxContext);
 
         if (SSAO::AsyncCompute)
         {
             gfxContext.Flush();
-            pfnSetupGraphicsState();
+            SetupGraphicsState(gfxContext);
 
             // Make the 3D queue wait for the Compute queue to finish SSAO
             g_CommandManager.GetGraphicsQueue().StallForProducer(g_CommandManager.GetComputeQueue());
@@ -515,12 +756,12 @@ void ModelViewer::RenderScene( void )
             gfxContext.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
 
-            RenderObjects( gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects( gfxContext, m_ViewProjMatrix, kCameraView, kOpaque );
 
             if (!ShowWaveTileCounts)
             {
                 gfxContext.SetPipelineState(m_CutoutModelPSO);
-                RenderObjects( gfxContext, m_ViewProjMatrix, kCutout );
+                RenderObjects( gfxContext, m_ViewProjMatrix, kCameraView, kCutout );
             }
         }
 
@@ -541,9 +782,39 @@ void ModelViewer::RenderScene( void )
     else
         MotionBlur::RenderObjectBlur(gfxContext, g_VelocityBuffer);
 
+    JobSystem::Wait(shadowJobs);
+    if (lightShadowContext != nullptr)
+        lightShadowContext->Finish();
+    if (sunShadowContext != nullptr)
+        sunShadowContext->Finish();
+
     gfxContext.Finish();
 }
 
+void ModelViewer::RenderUI( class GraphicsContext& gfxContext )
+{
+    if (!ShowDrawStats)
+        return;
+
+    DrawStats total = {};
+    for (const DrawStats& stats : m_DrawStats)
+    {
+        total.draws += stats.draws;
+        total.descriptorTableSets += stats.descriptorTableSets;
+        total.rootConstantSets += stats.rootConstantSets;
+        total.cpuTicks += stats.cpuTicks;
+    }
+
+    const double cpuTime = SystemTime::TicksToMillisecs(total.cpuTicks);
+    TextContext Text(gfxContext);
+    Text.Begin();
+    Text.DrawFormattedString("\nDraws: %u  Descriptor table sets: %u  Root constant sets: %u\n",
+        total.draws, total.descriptorTableSets, total.rootConstantSets);
+    Text.DrawFormattedString("Submission CPU: %.3f ms, %.3f ms per 10k draws\n",
+        cpuTime, total.draws > 0 ? cpuTime * 10000.0 / total.draws : 0.0);
+    Text.End();
+}
+
 void ModelViewer::CreateParticleEffects()
 {
     ParticleEffectProperties Effect = ParticleEffectProperties();
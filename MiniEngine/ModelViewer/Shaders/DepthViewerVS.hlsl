@@ -19,6 +19,23 @@ cbuffer VSConstants : register(b0)
     float4x4 modelToProjection;
 };
 
+cbuffer MeshConstants : register(b1)
+{
+    float3 positionScale;
+    uint baseVertex;
+    float3 positionOffset;
+    uint materialIdx;
+};
+
+#ifdef QUANTIZED_VERTICES
+struct VSInput
+{
+    float4 position : POSITION;
+    float2 texcoord0 : TEXCOORD;
+    float2 normal : NORMAL;
+    float2 tangent : TANGENT;
+};
+#else
 struct VSInput
 {
     float3 position : POSITION;
@@ -27,6 +44,7 @@ struct VSInput
     float3 tangent : TANGENT;
     float3 bitangent : BITANGENT;
 };
+#endif
 
 struct VSOutput
 {
@@ -38,7 +56,12 @@ struct VSOutput
 VSOutput main(VSInput vsInput)
 {
     VSOutput vsOutput;
-    vsOutput.pos = mul(modelToProjection, float4(vsInput.position, 1.0));
+#ifdef QUANTIZED_VERTICES
+    float3 position = positionOffset + vsInput.position.xyz * positionScale;
+#else
+    float3 position = vsInput.position;
+#endif
+    vsOutput.pos = mul(modelToProjection, float4(position, 1.0));
     vsOutput.uv = vsInput.texcoord0;
     return vsOutput;
 }
@@ -21,6 +21,32 @@ cbuffer VSConstants : register(b0)
     float3 ViewerPos;
 };
 
+// Per mesh position decoding, only used with quantized vertices
+cbuffer MeshConstants : register(b1)
+{
+    float3 positionScale;
+    uint baseVertex;
+    float3 positionOffset;
+    uint materialIdx;
+};
+
+#ifdef QUANTIZED_VERTICES
+struct VSInput
+{
+    float4 position : POSITION;     // unorm16 within the mesh bounds, w is the bitangent sign
+    float2 texcoord0 : TEXCOORD;    // half
+    float2 normal : NORMAL;         // snorm16 octahedral
+    float2 tangent : TANGENT;       // snorm16 octahedral
+};
+
+float3 OctahedralDecode(float2 e)
+{
+    float3 v = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * (v.xy >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+#else
 struct VSInput
 {
     float3 position : POSITION;
@@ -29,6 +55,7 @@ struct VSInput
     float3 tangent : TANGENT;
     float3 bitangent : BITANGENT;
 };
+#endif
 
 struct VSOutput
 {
@@ -47,15 +74,27 @@ VSOutput main(VSInput vsInput)
 {
     VSOutput vsOutput;
 
-    vsOutput.position = mul(modelToProjection, float4(vsInput.position, 1.0));
-    vsOutput.worldPos = vsInput.position;
+#ifdef QUANTIZED_VERTICES
+    float3 position = positionOffset + vsInput.position.xyz * positionScale;
+    float3 normal = OctahedralDecode(vsInput.normal);
+    float3 tangent = OctahedralDecode(vsInput.tangent);
+    float3 bitangent = cross(normal, tangent) * (vsInput.position.w * 2.0 - 1.0);
+#else
+    float3 position = vsInput.position;
+    float3 normal = vsInput.normal;
+    float3 tangent = vsInput.tangent;
+    float3 bitangent = vsInput.bitangent;
+#endif
+
+    vsOutput.position = mul(modelToProjection, float4(position, 1.0));
+    vsOutput.worldPos = position;
     vsOutput.texCoord = vsInput.texcoord0;
-    vsOutput.viewDir = vsInput.position - ViewerPos;
-    vsOutput.shadowCoord = mul(modelToShadow, float4(vsInput.position, 1.0)).xyz;
+    vsOutput.viewDir = position - ViewerPos;
+    vsOutput.shadowCoord = mul(modelToShadow, float4(position, 1.0)).xyz;
 
-    vsOutput.normal = vsInput.normal;
-    vsOutput.tangent = vsInput.tangent;
-    vsOutput.bitangent = vsInput.bitangent;
+    vsOutput.normal = normal;
+    vsOutput.tangent = tangent;
+    vsOutput.bitangent = bitangent;
 
     return vsOutput;
 }
@@ -0,0 +1,113 @@
+# -*- coding: utf-8 -*-
+'''
+Copyright (c) Microsoft. All rights reserved.
+This code is licensed under the MIT License (MIT).
+THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+
+Developed by Minigraph
+
+Builds a pack file for Utility::MountPackFile() from files and directories.
+Run it from the directory the engine runs in, since files are found by their
+path relative to it.  Files are stored as they are, so they can be read in
+place.  With --compress, those that shrink by at least an eighth are stored as
+chunked gzip instead, which only pays off when the disk is slower than inflating
+on every core.  See Core/PackFile.h for the layout.
+
+    python BuildPackFile.py [--compress] ModelViewer.pak Textures
+'''
+
+import os
+import struct
+import sys
+
+from ChunkedGzip import gzip_member
+
+MAGIC = 0x4B41504D
+VERSION = 1
+ALIGNMENT = 4096
+FLAG_GZIP = 1
+HEADER_FORMAT = '<IIII'
+TOC_FORMAT = '<QQQQIIII'
+
+def normalize_path(path):
+    '''Matches PackFile::NormalizePath()'''
+    path = os.path.relpath(path).replace('\\', '/').lower()
+    while path.startswith('./'):
+        path = path[2:]
+    return path.encode('utf-8')
+
+def hash_path(path):
+    '''FNV-1a, as PackFile::HashPath()'''
+    value = 14695981039346656037
+    for c in path:
+        value = ((value ^ c) * 1099511628211) & 0xFFFFFFFFFFFFFFFF
+    return value
+
+def gather_files(paths):
+    '''Lists the files named and those under the directories named'''
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, names in os.walk(path):
+                files.extend(os.path.join(root, name) for name in names)
+        else:
+            files.append(path)
+    return sorted(set(files))
+
+def compress(contents, chunk_size=1 << 20, level=9):
+    '''Chunked gzip, so that large files inflate in parallel'''
+    return b''.join(gzip_member(contents[i : i + chunk_size], level) for i in range(0, len(contents), chunk_size))
+
+def align(offset):
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+def build_pack(pack_name, paths, allow_compression=False):
+    entries = []
+    for filename in gather_files(paths):
+        if os.path.abspath(filename) == os.path.abspath(pack_name):
+            continue
+        with open(filename, 'rb') as infile:
+            contents = infile.read()
+        stored, flags = contents, 0
+        if allow_compression and contents:
+            packed = compress(contents)
+            if len(packed) <= len(contents) - len(contents) // 8:
+                stored, flags = packed, FLAG_GZIP
+        path = normalize_path(filename)
+        entries.append((hash_path(path), path, stored, len(contents), flags))
+        print('{0}: {1} -> {2} bytes'.format(path.decode('utf-8'), len(contents), len(stored)))
+
+    entries.sort(key=lambda entry: (entry[0], entry[1]))
+
+    toc_offset = struct.calcsize(HEADER_FORMAT)
+    path_offset = toc_offset + struct.calcsize(TOC_FORMAT) * len(entries)
+    data_offset = align(path_offset + sum(len(entry[1]) for entry in entries))
+
+    toc = b''
+    for path_hash, path, stored, size, flags in entries:
+        toc += struct.pack(TOC_FORMAT, path_hash, data_offset, len(stored), size, path_offset, len(path), flags, 0)
+        path_offset += len(path)
+        data_offset = align(data_offset + len(stored))
+
+    with open(pack_name, 'wb') as outfile:
+        outfile.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(entries), 0))
+        outfile.write(toc)
+        for entry in entries:
+            outfile.write(entry[1])
+        for entry in entries:
+            outfile.write(b'\0' * (align(outfile.tell()) - outfile.tell()))
+            outfile.write(entry[2])
+
+    print('Wrote {0} files to {1}'.format(len(entries), pack_name))
+
+if __name__ == "__main__":
+    args = sys.argv[1:]
+    allow_compression = '--compress' in args
+    args = [arg for arg in args if arg != '--compress']
+    if len(args) < 2:
+        print(__doc__)
+        sys.exit(1)
+    build_pack(args[0], args[1:], allow_compression)
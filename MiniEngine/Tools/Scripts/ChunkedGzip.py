@@ -0,0 +1,48 @@
+# -*- coding: utf-8 -*-
+'''
+Copyright (c) Microsoft. All rights reserved.
+This code is licensed under the MIT License (MIT).
+THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+
+Developed by Minigraph
+
+Compresses files to <name>.gz as a series of gzip members that the engine can
+inflate in parallel.  Each member holds one chunk of the file, and its header
+carries an extra field, 'M' 'C' and the size of the whole member, so that the
+members can be found without inflating them.  The result is still an ordinary
+gzip file.
+'''
+
+import struct
+import sys
+import zlib
+
+def gzip_member(chunk, level):
+    '''Compresses one chunk as a complete gzip member'''
+    compressor = zlib.compressobj(level, zlib.DEFLATED, -15)
+    body = compressor.compress(chunk) + compressor.flush()
+    trailer = struct.pack('<II', zlib.crc32(chunk) & 0xFFFFFFFF, len(chunk))
+
+    # ID1 ID2 CM FLG(FEXTRA) MTIME XFL OS XLEN, then the 'MC' subfield
+    header_size = 10 + 2 + 8
+    member_size = header_size + len(body) + len(trailer)
+    header = struct.pack('<BBBBIBBH', 0x1F, 0x8B, 8, 4, 0, 0, 255, 8)
+    header += struct.pack('<ccHI', b'M', b'C', 4, member_size)
+    return header + body + trailer
+
+def compress_file(filename, chunk_size=1 << 20, level=9):
+    '''Writes filename.gz in chunks of chunk_size bytes'''
+    print('compressing ' + filename)
+    with open(filename, 'rb') as infile, open(filename + '.gz', 'wb') as outfile:
+        while True:
+            chunk = infile.read(chunk_size)
+            if not chunk:
+                break
+            outfile.write(gzip_member(chunk, level))
+
+if __name__ == "__main__":
+    for name in sys.argv[1:]:
+        compress_file(name)